@@ -8,6 +8,7 @@
 #pragma once
 
 #include <arch/arm64/mmu.h>
+#include <kernel/mutex.h>
 #include <kernel/vm/arch_vm_aspace.h>
 #include <magenta/compiler.h>
 #include <mxtl/canary.h>
@@ -82,6 +83,12 @@ private:
 
     mxtl::Canary<mxtl::magic("VAAS")> canary_;
 
+    // Serializes changes to (and walks of) the translation tables. The
+    // VmAspace lock no longer covers page faults, which only hold the lock
+    // of the vmo being faulted, so faults in different mappings may get
+    // here at once.
+    Mutex lock_;
+
     uint16_t asid_ = 0;
 
     // Pointer to the translation table.
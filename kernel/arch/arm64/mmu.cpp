@@ -12,6 +12,7 @@
 #include <debug.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/auto_lock.h>
 #include <kernel/mutex.h>
 #include <kernel/vm.h>
 #include <kernel/vm/arch_vm_aspace.h>
@@ -133,6 +134,7 @@ status_t ArmArchVmAspace::Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags)
     vaddr_t vaddr_rem;
 
     canary_.Assert();
+    AutoLock a(&lock_);
     LTRACEF("aspace %p, vaddr 0x%lx\n", this, vaddr);
 
     DEBUG_ASSERT(tt_virt_);
@@ -663,6 +665,7 @@ status_t ArmArchVmAspace::ProtectPages(vaddr_t vaddr, size_t size, pte_t attrs,
 status_t ArmArchVmAspace::Map(vaddr_t vaddr, paddr_t paddr, size_t count,
                               uint mmu_flags, size_t* mapped) {
     canary_.Assert();
+    AutoLock a(&lock_);
     LTRACEF("vaddr %#" PRIxPTR " paddr %#" PRIxPTR " count %zu flags %#x\n",
             vaddr, paddr, count, mmu_flags);
 
@@ -709,6 +712,7 @@ status_t ArmArchVmAspace::Map(vaddr_t vaddr, paddr_t paddr, size_t count,
 
 status_t ArmArchVmAspace::Unmap(vaddr_t vaddr, size_t count, size_t* unmapped) {
     canary_.Assert();
+    AutoLock a(&lock_);
     LTRACEF("vaddr %#" PRIxPTR " count %zu\n", vaddr, count);
 
     DEBUG_ASSERT(tt_virt_);
@@ -747,6 +751,7 @@ status_t ArmArchVmAspace::Unmap(vaddr_t vaddr, size_t count, size_t* unmapped) {
 
 status_t ArmArchVmAspace::Protect(vaddr_t vaddr, size_t count, uint mmu_flags) {
     canary_.Assert();
+    AutoLock a(&lock_);
 
     if (!IsValidVaddr(vaddr))
         return MX_ERR_INVALID_ARGS;
@@ -10,6 +10,7 @@
 #include <arch/x86/ioport.h>
 #include <arch/x86/mmu.h>
 #include <kernel/atomic.h>
+#include <kernel/mutex.h>
 #include <kernel/vm/arch_vm_aspace.h>
 #include <magenta/compiler.h>
 #include <mxtl/canary.h>
@@ -127,6 +128,11 @@ private:
     mxtl::Canary<mxtl::magic("VAAS")> canary_;
     IoBitmap io_bitmap_;
 
+    // Serializes changes to (and walks of) the page tables. The VmAspace
+    // lock no longer covers page faults, which only hold the lock of the vmo
+    // being faulted, so faults in different mappings may get here at once.
+    Mutex lock_;
+
     // Pointer to the translation table.
     paddr_t pt_phys_ = 0;
     pt_entry_t* pt_virt_ = nullptr;
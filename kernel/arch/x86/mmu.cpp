@@ -16,6 +16,7 @@
 #include <arch/x86/feature.h>
 #include <arch/x86/mmu.h>
 #include <arch/x86/mmu_mem_types.h>
+#include <kernel/auto_lock.h>
 #include <kernel/mp.h>
 #include <kernel/vm.h>
 #include <kernel/vm/arch_vm_aspace.h>
@@ -1134,6 +1135,8 @@ status_t X86ArchVmAspace::UnmapPages(vaddr_t vaddr, const size_t count,
 }
 
 status_t X86ArchVmAspace::Unmap(vaddr_t vaddr, size_t count, size_t* unmapped) {
+    AutoLock a(&lock_);
+
     if (flags_ & ARCH_ASPACE_FLAG_GUEST_PASPACE) {
         return UnmapPages<ExtendedPageTable>(vaddr, count, unmapped);
     } else {
@@ -1184,6 +1187,8 @@ status_t X86ArchVmAspace::MapPages(vaddr_t vaddr, paddr_t paddr,
 
 status_t X86ArchVmAspace::Map(vaddr_t vaddr, paddr_t paddr, size_t count,
                               uint mmu_flags, size_t* mapped) {
+    AutoLock a(&lock_);
+
     if (flags_ & ARCH_ASPACE_FLAG_GUEST_PASPACE) {
         if (mmu_flags & ~kValidEptFlags)
             return MX_ERR_INVALID_ARGS;
@@ -1224,6 +1229,8 @@ status_t X86ArchVmAspace::ProtectPages(vaddr_t vaddr, size_t count, uint mmu_fla
 }
 
 status_t X86ArchVmAspace::Protect(vaddr_t vaddr, size_t count, uint mmu_flags) {
+    AutoLock a(&lock_);
+
     if (flags_ & ARCH_ASPACE_FLAG_GUEST_PASPACE) {
         if (mmu_flags & ~kValidEptFlags)
             return MX_ERR_INVALID_ARGS;
@@ -1433,6 +1440,8 @@ status_t X86ArchVmAspace::QueryVaddr(vaddr_t vaddr, paddr_t* paddr,
 }
 
 status_t X86ArchVmAspace::Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) {
+    AutoLock a(&lock_);
+
     if (flags_ & ARCH_ASPACE_FLAG_GUEST_PASPACE) {
         return QueryVaddr<ExtendedPageTable>(vaddr, paddr, mmu_flags,
                                              ept_mmu_flags);
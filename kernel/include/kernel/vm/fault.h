@@ -17,6 +17,9 @@ const uint VMM_PF_FLAG_NOT_PRESENT = (1u << 3);
 const uint VMM_PF_FLAG_HW_FAULT = (1u << 4); // hardware is requesting a fault
 const uint VMM_PF_FLAG_SW_FAULT = (1u << 5); // software fault
 const uint VMM_PF_FLAG_FAULT_MASK = (VMM_PF_FLAG_HW_FAULT | VMM_PF_FLAG_SW_FAULT);
+// rather than zero a new page with the vmo lock held, return MX_ERR_SHOULD_WAIT
+// so that the caller can supply a zeroed one without it and try again
+const uint VMM_PF_FLAG_NO_ZERO_FILL = (1u << 6);
 
 // convenience routine for convering page fault flags to a string
 static const char* vmm_pf_flags_to_string(uint pf_flags, char str[5]) {
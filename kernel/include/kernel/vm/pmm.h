@@ -86,5 +86,6 @@ paddr_t vaddr_to_paddr(const void* va);
 // vm_page_t to physical address
 paddr_t vm_page_to_paddr(const vm_page_t* page);
 
-// paddr to vm_page_t
+// paddr to vm_page_t. If the page structure has not been initialized yet, this
+// may block until it is, so it must not be called with a spinlock held.
 vm_page_t* paddr_to_vm_page(paddr_t addr);
@@ -112,10 +112,6 @@ public:
     mxtl::RefPtr<VmAddressRegion> as_vm_address_region();
     mxtl::RefPtr<VmMapping> as_vm_mapping();
 
-    // Page fault in an address within the region.  Recursively traverses
-    // the regions to find the target mapping, if it exists.
-    virtual status_t PageFault(vaddr_t va, uint pf_flags) = 0;
-
     // WAVL tree key function
     vaddr_t GetKey() const { return base(); }
 
@@ -234,7 +230,6 @@ public:
     bool is_mapping() const override { return false; }
 
     void Dump(uint depth, bool verbose) const override;
-    status_t PageFault(vaddr_t va, uint pf_flags) override;
 
 protected:
     // constructor for use in creating a VmAddressRegionDummy
@@ -249,6 +244,11 @@ protected:
     // |aspace_->lock()| must be held.
     virtual bool EnumerateChildrenLocked(VmEnumerator* ve, uint depth);
 
+    // Find the mapping containing |va|, descending through subregions.
+    // Used to implement VmAspace::PageFault.
+    // |aspace_->lock()| must be held.
+    mxtl::RefPtr<VmMapping> FindMappingLocked(vaddr_t va);
+
     friend class VmMapping;
     // Remove *region* from the subregion list
     void RemoveSubregion(VmAddressRegionOrMapping* region);
@@ -367,12 +367,6 @@ public:
         return;
     }
 
-    status_t PageFault(vaddr_t va, uint pf_flags) override {
-        // We should never be trying to page fault on this...
-        ASSERT(false);
-        return MX_ERR_BAD_STATE;
-    }
-
     size_t AllocatedPages() const override {
         return 0;
     }
@@ -431,7 +425,19 @@ public:
     bool is_mapping() const override { return true; }
 
     void Dump(uint depth, bool verbose) const override;
-    status_t PageFault(vaddr_t va, uint pf_flags) override;
+
+    // Page fault in an address within the mapping.  Unlike the other
+    // operations here, this is called without the aspace lock held: the
+    // caller looks the mapping up and reads |vmo| from vmo() under the aspace
+    // lock, then drops it, and only the vmo lock is held while the page is
+    // faulted in.  Returns MX_ERR_SHOULD_WAIT if the mapping was unmapped,
+    // split or destroyed in between, in which case the caller should look
+    // the address up again.  It is also returned if |pf_flags| has
+    // VMM_PF_FLAG_NO_ZERO_FILL set and the vmo needs a zero-filled page that
+    // |free_list| does not have, in which case the caller should supply a
+    // zeroed one and retry.
+    status_t PageFault(vaddr_t va, uint pf_flags, const mxtl::RefPtr<VmObject>& vmo,
+                       list_node* free_list);
 
 protected:
     ~VmMapping() override;
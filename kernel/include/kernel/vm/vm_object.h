@@ -177,6 +177,29 @@ public:
     Mutex* lock() TA_RET_CAP(lock_) { return &lock_; }
     Mutex& lock_ref() TA_RET_CAP(lock_) { return lock_; }
 
+    // Holds the object's lock, like AutoLock, and once it has been released
+    // finishes the work that was deferred while it was held: passing range
+    // changes on to children, and then freeing any pages that were removed.
+    // Anything that may add or remove pages (including faulting them in with
+    // GetPageLocked()) must hold the lock through one of these.
+    class TA_SCOPED_CAP Guard {
+    public:
+        explicit Guard(VmObject* vmo) TA_ACQ(vmo->lock_) : vmo_(vmo) { vmo_->lock_.Acquire(); }
+        ~Guard() TA_REL() { release(); }
+
+        void release() TA_REL() {
+            if (vmo_) {
+                vmo_->ReleaseLockAndUpdate();
+                vmo_ = nullptr;
+            }
+        }
+
+        DISALLOW_COPY_ASSIGN_AND_MOVE(Guard);
+
+    private:
+        VmObject* vmo_;
+    };
+
     void AddMappingLocked(VmMapping* r) TA_REQ(lock_);
     void RemoveMappingLocked(VmMapping* r) TA_REQ(lock_);
     uint32_t num_mappings() const;
@@ -189,8 +212,8 @@ public:
     // is mapped into.
     uint32_t share_count() const;
 
-    void AddChildLocked(VmObject* r) TA_REQ(lock_);
-    void RemoveChildLocked(VmObject* r) TA_REQ(lock_);
+    void AddChildLocked(VmObject* r) TA_REQ(children_lock_);
+    void RemoveChildLocked(VmObject* r) TA_REQ(children_lock_);
     uint32_t num_children() const;
 
     // Calls the provided |func(const VmObject&)| on every VMO in the system,
@@ -221,38 +244,60 @@ protected:
     DISALLOW_COPY_ASSIGN_AND_MOVE(VmObject);
 
     // inform all mappings and children that a range of this vmo's pages were added or removed.
+    // mappings are updated right away, children once the lock is released (see Guard).
     void RangeChangeUpdateLocked(uint64_t offset, uint64_t len) TA_REQ(lock_);
 
-    // above call but called from a parent
-    virtual void RangeChangeUpdateFromParentLocked(uint64_t offset, uint64_t len)
-        // Called under the parent's lock, which confuses analysis.
-        TA_NO_THREAD_SAFETY_ANALYSIS { RangeChangeUpdateLocked(offset, len); }
+    // above call but called from a parent, with none of its locks held
+    virtual void RangeChangeUpdateFromParent(VmObject* parent, uint64_t offset, uint64_t len);
+
+    // queue a range of this vmo for updating in its children once the lock is released
+    void DeferChildrenUpdateLocked(uint64_t offset, uint64_t len) TA_REQ(lock_);
+
+    // free a page removed from this vmo once the lock is released and the
+    // children, which may have it mapped, have been updated
+    void DeferFreePageLocked(vm_page_t* p) TA_REQ(lock_);
+
+    // pass a range change on to every child, called with no locks held
+    void RangeChangeUpdateChildren(uint64_t offset, uint64_t len);
 
     // magic value
     mxtl::Canary<mxtl::magic("VMO_")> canary_;
 
     // members
 
-    // declare a local mutex and default to pointing at it
-    // if constructed with a parent vmo, point lock_ at the parent's lock
-private:
-    Mutex local_lock_;
+    // Each object has its own lock, including clones. When several are held at
+    // once they are taken child first, working up the chain of parents, which
+    // is the direction page lookups go. Updates that flow the other way, from
+    // a parent to its children, are deferred until the parent's lock has been
+    // dropped.
+    mutable Mutex lock_;
 
-protected:
-    Mutex& lock_;
+    // Protects the list of children. May be taken with lock_ held, but nothing
+    // else is acquired while holding it, other than a child's children_lock_
+    // while collapsing that child out of a clone chain.
+    mutable Mutex children_lock_;
 
     // list of every mapping
     mxtl::DoublyLinkedList<VmMapping*> mapping_list_ TA_GUARDED(lock_);
 
     // list of every child
-    mxtl::DoublyLinkedList<VmObject*> children_list_ TA_GUARDED(lock_);
+    mxtl::DoublyLinkedList<VmObject*> children_list_ TA_GUARDED(children_lock_);
 
     // parent pointer (may be null)
     mxtl::RefPtr<VmObject> parent_ TA_GUARDED(lock_);
 
     // lengths of corresponding lists
     uint32_t mapping_list_len_ TA_GUARDED(lock_) = 0;
-    uint32_t children_list_len_ TA_GUARDED(lock_) = 0;
+    uint32_t children_list_len_ TA_GUARDED(children_lock_) = 0;
+
+    // work deferred until the lock is released, see Guard
+    uint64_t pending_offset_ TA_GUARDED(lock_) = 0;
+    uint64_t pending_len_ TA_GUARDED(lock_) = 0;
+    list_node pending_free_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(pending_free_list_);
+
+    // a former parent this object has been collapsed past, released along
+    // with its remaining pages once our children have been updated
+    mxtl::RefPtr<VmObject> collapsed_parent_ TA_GUARDED(lock_);
 
     uint64_t user_id_ TA_GUARDED(lock_) = 0;
 
@@ -261,6 +306,9 @@ protected:
     mxtl::Name<MX_MAX_NAME_LEN> name_;
 
 private:
+    // drops the lock and performs the work queued up while it was held
+    void ReleaseLockAndUpdate() TA_REL(lock_);
+
     // Per-node state for the global VMO list.
     using NodeState = mxtl::DoublyLinkedListNodeState<VmObject*>;
     NodeState global_list_state_;
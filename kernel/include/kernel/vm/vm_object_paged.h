@@ -69,18 +69,14 @@ public:
     status_t SyncCache(const uint64_t offset, const uint64_t len) override;
 
     status_t GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
-                           vm_page_t**, paddr_t*) override
-        // Calls a Locked method of the parent, which confuses analysis.
-        TA_NO_THREAD_SAFETY_ANALYSIS;
+                           vm_page_t**, paddr_t*) override TA_REQ(lock_);
 
     status_t CloneCOW(uint64_t offset, uint64_t size, bool copy_name,
                       mxtl::RefPtr<VmObject>* clone_vmo) override
         // Calls a Locked method of the child, which confuses analysis.
         TA_NO_THREAD_SAFETY_ANALYSIS;
 
-    void RangeChangeUpdateFromParentLocked(uint64_t offset, uint64_t len) override
-        // Called under the parent's lock, which confuses analysis.
-        TA_NO_THREAD_SAFETY_ANALYSIS;
+    void RangeChangeUpdateFromParent(VmObject* parent, uint64_t offset, uint64_t len) override;
 
 private:
     // private constructor (use Create())
@@ -120,12 +116,25 @@ private:
     // set our offset within our parent
     status_t SetParentOffsetLocked(uint64_t o) TA_REQ(lock_);
 
+    // look up an existing page at |offset| in our chain of parents
+    status_t GetPageFromParentLocked(uint64_t offset, vm_page_t** page, paddr_t* pa)
+        // Takes the parent's lock and calls its Locked method, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    // if nothing but us refers to our parent, take its pages and skip past it
+    void CollapseParentLocked()
+        // Takes the parent's locks, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
     // maximum size of a VMO is one page less than the full 64bit range
     static const uint64_t MAX_SIZE = ROUNDDOWN(UINT64_MAX, PAGE_SIZE);
 
     // members
     uint64_t size_ TA_GUARDED(lock_) = 0;
     uint64_t parent_offset_ TA_GUARDED(lock_) = 0;
+    // only offsets below this are looked up in the parent, for when the
+    // object we were cloned from has since been collapsed out of the chain
+    uint64_t parent_limit_ TA_GUARDED(lock_) = UINT64_MAX;
     uint32_t pmm_alloc_flags_ TA_GUARDED(lock_) = PMM_ALLOC_FLAG_ANY;
 
     // a tree of pages
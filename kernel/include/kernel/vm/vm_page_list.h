@@ -188,6 +188,9 @@ public:
 
     status_t AddPage(vm_page*, uint64_t offset);
     vm_page* GetPage(uint64_t offset);
+    // removes the page at |offset| from the list without freeing it, returning
+    // it, or nullptr if there was none
+    vm_page* RemovePage(uint64_t offset);
     status_t FreePage(uint64_t offset);
     size_t FreeAllPages();
 
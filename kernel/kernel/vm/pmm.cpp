@@ -10,9 +10,12 @@
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/atomic.h>
 #include <kernel/auto_lock.h>
+#include <kernel/event.h>
 #include <kernel/mp.h>
 #include <kernel/mutex.h>
+#include <kernel/thread.h>
 #include <kernel/timer.h>
 #include <kernel/vm.h>
 #include <lib/console.h>
@@ -38,6 +41,20 @@ static Mutex arena_lock;
 static mxtl::DoublyLinkedList<PmmArena*> arena_list TA_GUARDED(arena_lock);
 static size_t arena_cumulative_size TA_GUARDED(arena_lock);
 
+// the number of page structure init threads still running, see pmm_init_threads()
+static volatile int pmm_init_thread_count;
+static lk_time_t pmm_init_start;
+// signalled whenever an init thread publishes a chunk of page structures
+static event_t pmm_init_event = EVENT_INITIAL_VALUE(pmm_init_event, false, 0);
+
+// Blocks until an init thread publishes a chunk. The init threads run at
+// default priority, so waiters must block rather than spin: a higher priority
+// allocator yielding on the same cpu would never let them run.
+static void pmm_init_wait() {
+    DEBUG_ASSERT(!arch_ints_disabled());
+    event_wait(&pmm_init_event);
+}
+
 #if PMM_ENABLE_FREE_FILL
 static void pmm_enforce_fill(uint level) {
     for (auto& a : arena_list) {
@@ -59,12 +76,27 @@ paddr_t vm_page_to_paddr(const vm_page_t* page) TA_NO_THREAD_SAFETY_ANALYSIS {
     return -1;
 }
 
-// We don't need to hold the arena lock while executing this, since it is
-// only accesses values that are set once during system initialization.
+// We don't need to hold the arena lock to find the arena, since it is only
+// accesses values that are set once during system initialization. If the
+// page's structure has not been initialized yet, though, this takes the arena
+// lock and may block until an init thread is done with it, so it must not be
+// called with a spinlock held or interrupts disabled. Pages which have been
+// allocated, and so are already initialized, never take that path.
 vm_page_t* paddr_to_vm_page(paddr_t addr) TA_NO_THREAD_SAFETY_ANALYSIS {
     for (auto& a : arena_list) {
         if (a.address_in_arena(addr)) {
             size_t index = (addr - a.base()) / PAGE_SIZE;
+            // page structures are initialized lazily, so make sure this one is
+            while (!a.page_initialized(index)) {
+                {
+                    AutoLock al(&arena_lock);
+                    if (a.EnsurePageInit(index))
+                        break;
+                    // an init thread has the chunk
+                    event_unsignal(&pmm_init_event);
+                }
+                pmm_init_wait();
+            }
             return a.get_page(index);
         }
     }
@@ -108,21 +140,43 @@ done_add:
     return MX_OK;
 }
 
+// Returns true if some arena has page structures being initialized outside
+// the lock. Allocations that come up short should then drop the lock, wait
+// for them to be published with pmm_init_wait(), and retry rather than fail.
+static bool pmm_init_should_wait_locked() TA_REQ(arena_lock) {
+    for (const auto& a : arena_list) {
+        if (a.init_busy()) {
+            // armed under the lock, so a chunk published after this is not missed
+            event_unsignal(&pmm_init_event);
+            return true;
+        }
+    }
+    return false;
+}
+
 vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
-    AutoLock al(&arena_lock);
+    for (;;) {
+        {
+            AutoLock al(&arena_lock);
+
+            /* walk the arenas in order until we find one with a free page */
+            for (auto& a : arena_list) {
+                /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
+                if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
+                    if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+                        continue;
+                }
+
+                // try to allocate the page out of the arena
+                vm_page_t* page = a.AllocPage(pa);
+                if (page)
+                    return page;
+            }
 
-    /* walk the arenas in order until we find one with a free page */
-    for (auto& a : arena_list) {
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
-                continue;
+            if (!pmm_init_should_wait_locked())
+                break;
         }
-
-        // try to allocate the page out of the arena
-        vm_page_t* page = a.AllocPage(pa);
-        if (page)
-            return page;
+        pmm_init_wait();
     }
 
     LTRACEF("failed to allocate page\n");
@@ -138,24 +192,32 @@ size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
     if (count == 0)
         return 0;
 
-    AutoLock al(&arena_lock);
-
-    /* walk the arenas in order, allocating as many pages as we can from each */
     size_t allocated = 0;
-    for (auto& a : arena_list) {
-        DEBUG_ASSERT(count > allocated);
+    for (;;) {
+        {
+            AutoLock al(&arena_lock);
+
+            /* walk the arenas in order, allocating as many pages as we can from each */
+            for (auto& a : arena_list) {
+                DEBUG_ASSERT(count > allocated);
+
+                /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
+                if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
+                    if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+                        continue;
+                }
+
+                // ask the arena to allocate some pages
+                allocated += a.AllocPages(count - allocated, list);
+                DEBUG_ASSERT(allocated <= count);
+                if (allocated == count)
+                    return allocated;
+            }
 
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
-                continue;
+            if (!pmm_init_should_wait_locked())
+                break;
         }
-
-        // ask the arena to allocate some pages
-        allocated += a.AllocPages(count - allocated, list);
-        DEBUG_ASSERT(allocated <= count);
-        if (allocated == count)
-            break;
+        pmm_init_wait();
     }
 
     return allocated;
@@ -170,24 +232,32 @@ size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list) {
 
     address = ROUNDDOWN(address, PAGE_SIZE);
 
-    AutoLock al(&arena_lock);
+    for (;;) {
+        {
+            AutoLock al(&arena_lock);
 
-    /* walk through the arenas, looking to see if the physical page belongs to it */
-    for (auto& a : arena_list) {
-        while (allocated < count && a.address_in_arena(address)) {
-            vm_page_t* page = a.AllocSpecific(address);
-            if (!page)
-                break;
+            /* walk through the arenas, looking to see if the physical page belongs to it */
+            for (auto& a : arena_list) {
+                while (allocated < count && a.address_in_arena(address)) {
+                    vm_page_t* page = a.AllocSpecific(address);
+                    if (!page)
+                        break;
 
-            if (list)
-                list_add_tail(list, &page->free.node);
+                    if (list)
+                        list_add_tail(list, &page->free.node);
 
-            allocated++;
-            address += PAGE_SIZE;
-        }
+                    allocated++;
+                    address += PAGE_SIZE;
+                }
 
-        if (allocated == count)
-            break;
+                if (allocated == count)
+                    return allocated;
+            }
+
+            if (!pmm_init_should_wait_locked())
+                break;
+        }
+        pmm_init_wait();
     }
 
     return allocated;
@@ -202,26 +272,92 @@ size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_lo
     if (alignment_log2 < PAGE_SIZE_SHIFT)
         alignment_log2 = PAGE_SIZE_SHIFT;
 
-    AutoLock al(&arena_lock);
+    for (;;) {
+        {
+            AutoLock al(&arena_lock);
+
+            for (auto& a : arena_list) {
+                /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
+                if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
+                    if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+                        continue;
+                }
+
+                size_t allocated = a.AllocContiguous(count, alignment_log2, pa, list);
+                if (allocated > 0) {
+                    DEBUG_ASSERT(allocated == count);
+                    return allocated;
+                }
+            }
 
-    for (auto& a : arena_list) {
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
-                continue;
+            if (!pmm_init_should_wait_locked())
+                break;
+        }
+        pmm_init_wait();
+    }
+
+    LTRACEF("couldn't find run\n");
+    return 0;
+}
+
+// Initializes the page structures of one uninitialized chunk after another,
+// until there are none left.
+static int pmm_init_thread(void*) {
+    for (;;) {
+        PmmArena* arena = nullptr;
+        size_t chunk;
+        {
+            AutoLock al(&arena_lock);
+            for (auto& a : arena_list) {
+                if (a.ClaimChunk(&chunk)) {
+                    arena = &a;
+                    break;
+                }
+            }
         }
+        if (!arena)
+            break;
+
+        list_node list = LIST_INITIAL_VALUE(list);
+        arena->InitChunk(chunk, &list);
 
-        size_t allocated = a.AllocContiguous(count, alignment_log2, pa, list);
-        if (allocated > 0) {
-            DEBUG_ASSERT(allocated == count);
-            return allocated;
+        {
+            AutoLock al(&arena_lock);
+            arena->PublishChunk(chunk, &list);
         }
+        // wake any allocations waiting for it
+        event_signal(&pmm_init_event, true);
     }
 
-    LTRACEF("couldn't find run\n");
+    if (atomic_add(&pmm_init_thread_count, -1) == 1) {
+        dprintf(INFO, "PMM: page structures initialized in %" PRIu64 " ms\n",
+                (current_time() - pmm_init_start) / LK_MSEC(1));
+    }
     return 0;
 }
 
+// Until now, page structures have only been initialized as the allocator
+// needed them. Now that the secondary cpus are up, finish the job with a
+// thread per cpu.
+static void pmm_init_threads(uint level) {
+    int cpus = __builtin_popcount(mp_get_online_mask());
+
+    pmm_init_start = current_time();
+    pmm_init_thread_count = cpus;
+    for (int i = 0; i < cpus; i++) {
+        thread_t* t = thread_create("pmm init", &pmm_init_thread, nullptr,
+                                    DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+        if (!t) {
+            // the other threads, or the allocator, will pick up the slack
+            atomic_add(&pmm_init_thread_count, -1);
+            continue;
+        }
+        thread_detach_and_resume(t);
+    }
+}
+
+LK_INIT_HOOK(pmm_init, &pmm_init_threads, LK_INIT_LEVEL_PLATFORM);
+
 /* physically allocate a run from arenas marked as KMAP */
 void* pmm_alloc_kpages(size_t count, struct list_node* list, paddr_t* _pa) {
     LTRACEF("count %zu\n", count);
@@ -49,31 +49,125 @@ void PmmArena::CheckFreeFill(vm_page_t* page) {
 
 void PmmArena::BootAllocArray() {
     /* allocate an array of pages to back this one */
-    size_t page_count = size() / PAGE_SIZE;
-    size_t size = page_count * VM_PAGE_STRUCT_SIZE;
+    size_t size = page_count() * VM_PAGE_STRUCT_SIZE;
     void* raw_page_array = boot_alloc_mem(size);
 
     LTRACEF("arena for base 0%#" PRIxPTR " size %#zx page array at %p size %zu\n", info_.base, info_.size,
             raw_page_array, size);
 
-    memset(raw_page_array, 0, size);
-
     page_array_ = (vm_page_t*)raw_page_array;
 
-    /* add them to the free list */
-    for (size_t i = 0; i < page_count; i++) {
-        auto& p = page_array_[i];
+    /* the page structures are initialized later, a chunk at a time; on large
+     * machines doing it all here would dominate boot time.
+     */
+    chunk_count_ = (page_count() + kChunkPages - 1) / kChunkPages;
+    chunk_state_ = (volatile int*)boot_alloc_mem(chunk_count_ * sizeof(int));
+    for (size_t i = 0; i < chunk_count_; i++) {
+        chunk_state_[i] = kChunkUninit;
+    }
+
+    free_count_ += page_count();
+}
+
+bool PmmArena::NextUninitChunk(size_t* chunk) {
+    /* chunks may also be initialized out of order by AllocSpecific */
+    while (next_chunk_ < chunk_count_) {
+        size_t i = next_chunk_++;
+        if (chunk_state_[i] == kChunkUninit) {
+            *chunk = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PmmArena::ClaimChunk(size_t* chunk) {
+    if (!NextUninitChunk(chunk))
+        return false;
+
+    chunk_state_[*chunk] = kChunkBusy;
+    busy_chunks_++;
+    return true;
+}
+
+void PmmArena::InitChunk(size_t chunk, list_node* list) {
+    DEBUG_ASSERT(chunk_state_[chunk] == kChunkBusy);
+
+    vm_page_t* first = &page_array_[chunk * kChunkPages];
+    size_t count = chunk_pages(chunk);
+
+    memset(first, 0, count * VM_PAGE_STRUCT_SIZE);
+
+    for (size_t i = 0; i < count; i++) {
+#if PMM_ENABLE_FREE_FILL
+        if (enforce_fill_)
+            FreeFill(&first[i]);
+#endif
+        list_add_tail(list, &first[i].free.node);
+    }
+}
 
-        list_add_tail(&free_list_, &p.free.node);
+void PmmArena::PublishChunk(size_t chunk, list_node* list) {
+    DEBUG_ASSERT(chunk_state_[chunk] == kChunkBusy);
+    DEBUG_ASSERT(busy_chunks_ > 0);
+
+    /* splice the chunk's pages onto the tail of the free list */
+    if (!list_is_empty(list)) {
+        list_node* head = list->next;
+        list_node* tail = list->prev;
+        head->prev = free_list_.prev;
+        free_list_.prev->next = head;
+        tail->next = &free_list_;
+        free_list_.prev = tail;
+        list_initialize(list);
     }
 
-    free_count_ += page_count;
+    busy_chunks_--;
+    atomic_store(&chunk_state_[chunk], kChunkReady);
+}
+
+void PmmArena::InitChunkLocked(size_t chunk) {
+    DEBUG_ASSERT(chunk_state_[chunk] == kChunkUninit);
+
+    LTRACEF("initializing chunk %zu synchronously\n", chunk);
+
+    list_node list = LIST_INITIAL_VALUE(list);
+
+    chunk_state_[chunk] = kChunkBusy;
+    busy_chunks_++;
+    InitChunk(chunk, &list);
+    PublishChunk(chunk, &list);
+}
+
+bool PmmArena::GrowLocked() {
+    size_t chunk;
+    if (!NextUninitChunk(&chunk))
+        return false;
+
+    InitChunkLocked(chunk);
+    return true;
+}
+
+bool PmmArena::EnsurePageInit(size_t index) {
+    size_t chunk = index / kChunkPages;
+    switch (chunk_state_[chunk]) {
+    case kChunkReady:
+        return true;
+    case kChunkBusy:
+        return false;
+    default:
+        InitChunkLocked(chunk);
+        return true;
+    }
 }
 
 vm_page_t* PmmArena::AllocPage(paddr_t* pa) {
     vm_page_t* page = list_remove_head_type(&free_list_, vm_page_t, free.node);
-    if (!page)
-        return nullptr;
+    if (!page) {
+        if (!GrowLocked())
+            return nullptr;
+        page = list_remove_head_type(&free_list_, vm_page_t, free.node);
+    }
 
     DEBUG_ASSERT(free_count_ > 0);
 
@@ -105,6 +199,9 @@ vm_page_t* PmmArena::AllocSpecific(paddr_t pa) {
 
     DEBUG_ASSERT(index < size() / PAGE_SIZE);
 
+    if (!EnsurePageInit(index))
+        return nullptr;
+
     vm_page_t* page = get_page(index);
     if (!page_is_free(page)) {
         /* we hit an allocated page */
@@ -127,8 +224,11 @@ size_t PmmArena::AllocPages(size_t count, list_node* list) {
 
     while (allocated < count) {
         vm_page_t* page = list_remove_head_type(&free_list_, vm_page_t, free.node);
-        if (!page)
-            return allocated;
+        if (!page) {
+            if (!GrowLocked())
+                return allocated;
+            continue;
+        }
 
         LTRACEF("allocating page %p, pa %#" PRIxPTR "\n", page, page_address_from_arena(page));
 
@@ -171,7 +271,7 @@ retry:
     while ((start < size() / PAGE_SIZE) && ((start + count) <= size() / PAGE_SIZE)) {
         vm_page_t* p = &page_array_[start];
         for (uint i = 0; i < count; i++) {
-            if (!page_is_free(p)) {
+            if (!EnsurePageInit(start + i) || !page_is_free(p)) {
                 /* this run is broken, break out of the inner loop.
                  * start over at the next alignment boundary
                  */
@@ -234,8 +334,17 @@ status_t PmmArena::FreePage(vm_page_t* page) {
 }
 
 void PmmArena::CountStates(size_t state_count[_VM_PAGE_STATE_COUNT]) const {
-    for (size_t i = 0; i < size() / PAGE_SIZE; i++) {
-        state_count[page_array_[i].state]++;
+    for (size_t chunk = 0; chunk < chunk_count_; chunk++) {
+        size_t first = chunk * kChunkPages;
+        size_t count = chunk_pages(chunk);
+        if (chunk_state_[chunk] != kChunkReady) {
+            /* not yet initialized, so necessarily free */
+            state_count[VM_PAGE_STATE_FREE] += count;
+            continue;
+        }
+        for (size_t i = first; i < first + count; i++) {
+            state_count[page_array_[i].state]++;
+        }
     }
 }
 
@@ -245,10 +354,19 @@ void PmmArena::Dump(bool dump_pages, bool dump_free_ranges) {
            format_size(pbuf, sizeof(pbuf), size()), size(), priority(), flags());
     printf("\tpage_array %p, free_count %zu\n", page_array_, free_count_);
 
+    size_t uninit_chunks = 0;
+    for (size_t i = 0; i < chunk_count_; i++) {
+        if (chunk_state_[i] != kChunkReady)
+            uninit_chunks++;
+    }
+    if (uninit_chunks > 0)
+        printf("\t%zu of %zu page chunks not yet initialized\n", uninit_chunks, chunk_count_);
+
     /* dump all of the pages */
     if (dump_pages) {
         for (size_t i = 0; i < size() / PAGE_SIZE; i++) {
-            dump_page(&page_array_[i]);
+            if (page_initialized(i))
+                dump_page(&page_array_[i]);
         }
     }
 
@@ -267,7 +385,7 @@ void PmmArena::Dump(bool dump_pages, bool dump_free_ranges) {
         printf("\tfree ranges:\n");
         ssize_t last = -1;
         for (size_t i = 0; i < size() / PAGE_SIZE; i++) {
-            if (page_is_free(&page_array_[i])) {
+            if (!page_initialized(i) || page_is_free(&page_array_[i])) {
                 if (last == -1) {
                     last = i;
                 }
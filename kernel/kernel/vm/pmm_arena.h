@@ -8,6 +8,7 @@
 #include <mxtl/intrusive_double_list.h>
 #include <mxtl/macros.h>
 
+#include <kernel/atomic.h>
 #include <kernel/vm/pmm.h>
 #include <trace.h>
 
@@ -21,7 +22,9 @@ public:
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(PmmArena);
 
-    // set up the per page structures, allocated out of the boot time allocator
+    // set up the per page structures, allocated out of the boot time allocator.
+    // the structures themselves are not initialized until they are first needed,
+    // see below.
     void BootAllocArray();
 
 #if PMM_ENABLE_FREE_FILL
@@ -37,6 +40,7 @@ public:
     size_t size() const { return info_.size; }
     unsigned int flags() const { return info_.flags; }
     unsigned int priority() const { return info_.priority; }
+    // includes pages whose structures have not yet been initialized
     size_t free_count() const { return free_count_; };
 
     // Counts the number of pages in every state. For each page in the arena,
@@ -53,6 +57,29 @@ public:
     size_t AllocContiguous(size_t count, uint8_t alignment_log2, paddr_t* pa, struct list_node* list);
     status_t FreePage(vm_page_t* page);
 
+    // Page structures are initialized a chunk at a time: synchronously by the
+    // allocation routines when they run out of initialized pages, or by the
+    // pmm's init threads once the secondary cpus are up. A chunk being
+    // initialized outside the lock is busy, and none of its pages can be
+    // allocated until it has been published.
+
+    // Claims the next uninitialized chunk, marking it busy.
+    bool ClaimChunk(size_t* chunk);
+    // Initializes the structures of a claimed chunk, linking its pages onto
+    // |list|. May be called without holding the pmm lock.
+    void InitChunk(size_t chunk, list_node* list);
+    // Moves the pages of an initialized chunk onto the free list.
+    void PublishChunk(size_t chunk, list_node* list);
+
+    // Makes sure the structure of the page at |index| is initialized, doing
+    // so synchronously if need be. Returns false if the chunk is busy.
+    bool EnsurePageInit(size_t index);
+
+    bool page_initialized(size_t index) const {
+        return atomic_load(&chunk_state_[index / kChunkPages]) == kChunkReady;
+    }
+    bool init_busy() const { return busy_chunks_ > 0; }
+
     // helpers
     bool page_belongs_to_arena(const vm_page* page) const {
         uintptr_t page_addr = reinterpret_cast<uintptr_t>(page);
@@ -74,6 +101,24 @@ public:
     }
 
 private:
+    enum : int {
+        kChunkUninit = 0,
+        kChunkBusy,
+        kChunkReady,
+    };
+
+    // 128MB worth of 4k pages
+    static constexpr size_t kChunkPages = 32768;
+
+    size_t page_count() const { return info_.size / PAGE_SIZE; }
+    size_t chunk_pages(size_t chunk) const {
+        size_t left = page_count() - chunk * kChunkPages;
+        return (left < kChunkPages) ? left : kChunkPages;
+    }
+    bool NextUninitChunk(size_t* chunk);
+    bool GrowLocked();
+    void InitChunkLocked(size_t chunk);
+
 #if PMM_ENABLE_FREE_FILL
     void FreeFill(vm_page_t* page);
     void CheckFreeFill(vm_page_t* page);
@@ -85,6 +130,14 @@ private:
     size_t free_count_ = 0;
     list_node free_list_ = LIST_INITIAL_VALUE(free_list_);
 
+    // one kChunk* state per chunk; only ever moves forward, so a chunk seen to
+    // be ready may be used without the lock
+    volatile int* chunk_state_ = nullptr;
+    size_t chunk_count_ = 0;
+    // no chunk below this one is uninitialized
+    size_t next_chunk_ = 0;
+    size_t busy_chunks_ = 0;
+
 #if PMM_ENABLE_FREE_FILL
     bool enforce_fill_ = false;
 #endif
@@ -377,7 +377,7 @@ size_t VmAddressRegion::AllocatedPagesLocked() const {
     return sum;
 }
 
-status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags) {
+mxtl::RefPtr<VmMapping> VmAddressRegion::FindMappingLocked(vaddr_t va) {
     canary_.Assert();
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
 
@@ -385,10 +385,10 @@ status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags) {
          auto next = vmar->FindRegionLocked(va);
          vmar = next->as_vm_address_region()) {
         if (next->is_mapping())
-            return next->PageFault(va, pf_flags);
+            return next->as_vm_mapping();
     }
 
-    return MX_ERR_NOT_FOUND;
+    return nullptr;
 }
 
 bool VmAddressRegion::IsRangeAvailableLocked(vaddr_t base, size_t size) {
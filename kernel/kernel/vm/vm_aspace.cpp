@@ -7,6 +7,7 @@
 #include <kernel/vm/vm_aspace.h>
 
 #include "vm_priv.h"
+#include <arch/ops.h>
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
@@ -14,6 +15,8 @@
 #include <kernel/cmdline.h>
 #include <kernel/thread.h>
 #include <kernel/vm.h>
+#include <kernel/vm/fault.h>
+#include <kernel/vm/pmm.h>
 #include <kernel/vm/vm_address_region.h>
 #include <kernel/vm/vm_object.h>
 #include <kernel/vm/vm_object_paged.h>
@@ -521,12 +524,54 @@ status_t VmAspace::PageFault(vaddr_t va, uint flags) {
     DEBUG_ASSERT(!aspace_destroyed_);
     LTRACEF("va %#" PRIxPTR ", flags %#x\n", va, flags);
 
-    // for now, hold the aspace lock across the page fault operation,
-    // which stops any other operations on the address space from moving
-    // the region out from underneath it
-    AutoLock a(&lock_);
+    // Clearing a new page is the most expensive part of a write fault, so it is
+    // not done with the vmo lock held: the first attempt asks the vmo not to
+    // zero-fill, and only if it turns out to need a zero-filled page is one
+    // allocated and zeroed here, with no locks held, before trying again.
+    // Copy-on-write faults overwrite their new page, so the vmo allocates
+    // those itself. Faults which are denied, find their page already present,
+    // or land on a physical vmo never allocate at all.
+    list_node free_list = LIST_INITIAL_VALUE(free_list);
+    auto ac = mxtl::MakeAutoCall([&free_list]() {
+        if (!list_is_empty(&free_list))
+            pmm_free(&free_list);
+    });
+    uint pf_flags = flags;
+    if (pf_flags & VMM_PF_FLAG_WRITE)
+        pf_flags |= VMM_PF_FLAG_NO_ZERO_FILL;
+
+    // Hold the aspace lock only to find the mapping, so that faults on
+    // different mappings, and operations elsewhere in the address space,
+    // are not serialized behind each other. The mapping does the rest under
+    // the vmo lock, and asks us to look again if it changed in between.
+    for (;;) {
+        mxtl::RefPtr<VmMapping> mapping;
+        mxtl::RefPtr<VmObject> vmo;
+        {
+            AutoLock a(&lock_);
+            mapping = root_vmar_->FindMappingLocked(va);
+            if (!mapping)
+                return MX_ERR_NOT_FOUND;
+            vmo = mapping->vmo();
+        }
+
+        status_t status = mapping->PageFault(va, pf_flags, vmo, &free_list);
+        if (status != MX_ERR_SHOULD_WAIT)
+            return status;
 
-    return root_vmar_->PageFault(va, flags);
+        // either the mapping changed, or the vmo needs a zeroed page
+        if ((pf_flags & VMM_PF_FLAG_NO_ZERO_FILL) && list_is_empty(&free_list)) {
+            paddr_t pa;
+            vm_page_t* p = pmm_alloc_page(PMM_ALLOC_FLAG_KMAP, &pa);
+            if (p) {
+                arch_zero_page(paddr_to_kvaddr(pa));
+                list_add_tail(&free_list, &p->free.node);
+            } else {
+                // let the vmo try for itself, and report the failure
+                pf_flags &= ~VMM_PF_FLAG_NO_ZERO_FILL;
+            }
+        }
+    }
 }
 
 void VmAspace::Dump(bool verbose) const {
@@ -396,7 +396,7 @@ status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
         pf_flags |= VMM_PF_FLAG_SW_FAULT;
 
     // grab the lock for the vmo
-    AutoLock al(object_->lock());
+    VmObject::Guard al(object_.get());
 
     // set the currently faulting flag for any recursive calls the vmo may make back into us.
     DEBUG_ASSERT(!currently_faulting_);
@@ -506,11 +506,23 @@ status_t VmMapping::DestroyLocked() {
     return MX_OK;
 }
 
-status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
+status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags,
+                             const mxtl::RefPtr<VmObject>& vmo, list_node* free_list) {
     canary_.Assert();
-    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+    DEBUG_ASSERT(vmo);
 
-    DEBUG_ASSERT(va >= base_ && va <= base_ + size_ - 1);
+    // grab the lock for the vmo
+    //
+    // Every change to our range, protection or object happens with this lock
+    // held, so once we have it they are stable without the aspace lock. If
+    // the mapping was shrunk or destroyed since the caller looked it up (a
+    // destroyed mapping has a size of zero), have the caller retry.
+    VmObject::Guard al(vmo.get());
+    if (va < base_ || va - base_ >= size_) {
+        LTRACEF("%p va %#" PRIxPTR " no longer in mapping\n", this, va);
+        return MX_ERR_SHOULD_WAIT;
+    }
+    DEBUG_ASSERT(object_.get() == vmo.get());
 
     va = ROUNDDOWN(va, PAGE_SIZE);
     uint64_t vmo_offset = va - base_ + object_offset_;
@@ -537,9 +549,6 @@ status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
         return MX_ERR_ACCESS_DENIED;
     }
 
-    // grab the lock for the vmo
-    AutoLock al(object_->lock());
-
     // set the currently faulting flag for any recursive calls the vmo may make back into us
     // The specific path we're avoiding is if the VMO calls back into us during vmo->GetPageLocked()
     // via UnmapVmoRangeLocked(). Since we're responsible for that page, signal to ourself to skip
@@ -551,7 +560,11 @@ status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
     // fault in or grab an existing page
     paddr_t new_pa;
     vm_page_t* page;
-    status_t status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, &page, &new_pa);
+    status_t status = vmo->GetPageLocked(vmo_offset, pf_flags, free_list, &page, &new_pa);
+    if (status == MX_ERR_SHOULD_WAIT) {
+        // the vmo needs a zeroed page, which the caller supplies without our lock
+        return status;
+    }
     if (status < 0) {
         TRACEF("ERROR: failed to fault in or grab existing page\n");
         TRACEF("%p vmo_offset %#" PRIx64 ", pf_flags %#x\n", this, vmo_offset, pf_flags);
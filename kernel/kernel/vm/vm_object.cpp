@@ -13,6 +13,7 @@
 #include <inttypes.h>
 #include <kernel/auto_lock.h>
 #include <kernel/vm.h>
+#include <kernel/vm/pmm.h>
 #include <kernel/vm/vm_address_region.h>
 #include <lib/console.h>
 #include <mxtl/ref_ptr.h>
@@ -27,8 +28,7 @@ Mutex VmObject::all_vmos_lock_ = {};
 VmObject::GlobalList VmObject::all_vmos_ = {};
 
 VmObject::VmObject(mxtl::RefPtr<VmObject> parent)
-    : lock_(parent ? parent->lock_ref() : local_lock_),
-      parent_(mxtl::move(parent)) {
+    : parent_(mxtl::move(parent)) {
     LTRACEF("%p\n", this);
 
     // Add ourself to the global VMO list, newer VMOs at the end.
@@ -46,19 +46,14 @@ VmObject::~VmObject() {
     if (parent_) {
         LTRACEF("removing ourself from our parent %p\n", parent_.get());
 
-        // conditionally grab our shared lock with the parent, but only if it's
-        // not held. There are some destruction paths that may try to tear
-        // down the object with the parent locks held.
-        bool need_lock = !lock_.IsHeld();
-        if (need_lock)
-            lock_.Acquire();
+        AutoLock a(&parent_->children_lock_);
         parent_->RemoveChildLocked(this);
-        if (need_lock)
-            lock_.Release();
     }
 
     DEBUG_ASSERT(mapping_list_.is_empty());
     DEBUG_ASSERT(children_list_.is_empty());
+    DEBUG_ASSERT(pending_len_ == 0);
+    DEBUG_ASSERT(list_is_empty(&pending_free_list_));
 
     // Remove ourself from the global VMO list.
     {
@@ -93,17 +88,12 @@ uint64_t VmObject::user_id() const {
 
 uint64_t VmObject::parent_user_id() const {
     canary_.Assert();
-    // Don't hold both our lock and our parent's lock at the same time, because
-    // it's probably the same lock.
-    mxtl::RefPtr<VmObject> parent;
-    {
-        AutoLock a(&lock_);
-        if (parent_ == nullptr) {
-            return 0u;
-        }
-        parent = parent_;
+    // Taking our parent's lock while holding ours is the usual order.
+    AutoLock a(&lock_);
+    if (parent_ == nullptr) {
+        return 0u;
     }
-    return parent->user_id();
+    return parent_->user_id();
 }
 
 bool VmObject::is_cow_clone() const {
@@ -192,14 +182,14 @@ uint32_t VmObject::share_count() const {
 
 void VmObject::AddChildLocked(VmObject* o) {
     canary_.Assert();
-    DEBUG_ASSERT(lock_.IsHeld());
+    DEBUG_ASSERT(children_lock_.IsHeld());
     children_list_.push_front(o);
     children_list_len_++;
 }
 
 void VmObject::RemoveChildLocked(VmObject* o) {
     canary_.Assert();
-    DEBUG_ASSERT(lock_.IsHeld());
+    DEBUG_ASSERT(children_lock_.IsHeld());
     children_list_.erase(*o);
     DEBUG_ASSERT(children_list_len_ > 0);
     children_list_len_--;
@@ -207,7 +197,7 @@ void VmObject::RemoveChildLocked(VmObject* o) {
 
 uint32_t VmObject::num_children() const {
     canary_.Assert();
-    AutoLock a(&lock_);
+    AutoLock a(&children_lock_);
     return children_list_len_;
 }
 
@@ -225,8 +215,111 @@ void VmObject::RangeChangeUpdateLocked(uint64_t offset, uint64_t len) {
     }
 
     // inform all our children this as well, so they can inform their mappings
-    for (auto& child : children_list_) {
-        child.RangeChangeUpdateFromParentLocked(offset, len);
+    DeferChildrenUpdateLocked(offset, len);
+}
+
+void VmObject::RangeChangeUpdateFromParent(VmObject* parent, uint64_t offset, uint64_t len) {
+    canary_.Assert();
+
+    Guard g(this);
+    RangeChangeUpdateLocked(offset, len);
+}
+
+void VmObject::DeferChildrenUpdateLocked(uint64_t offset, uint64_t len) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    if (len == 0)
+        return;
+
+    // merge into a single range covering everything queued so far
+    if (pending_len_ == 0) {
+        pending_offset_ = offset;
+        pending_len_ = len;
+    } else {
+        uint64_t start = MIN(pending_offset_, offset);
+        uint64_t end = MAX(pending_offset_ + pending_len_, offset + len);
+        pending_offset_ = start;
+        pending_len_ = end - start;
+    }
+}
+
+void VmObject::DeferFreePageLocked(vm_page_t* p) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    list_add_tail(&pending_free_list_, &p->free.node);
+}
+
+void VmObject::ReleaseLockAndUpdate() {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    // take the queued work while we still hold the lock, so that it is done by
+    // the thread that queued it, before it returns to its caller
+    const uint64_t offset = pending_offset_;
+    const uint64_t len = pending_len_;
+    pending_len_ = 0;
+
+    list_node free_list = LIST_INITIAL_VALUE(free_list);
+    list_move(&pending_free_list_, &free_list);
+
+    mxtl::RefPtr<VmObject> collapsed_parent = mxtl::move(collapsed_parent_);
+
+    lock_.Release();
+
+    // Our children may still have the pages being freed mapped, and they look
+    // them up with their own lock held, so they have to be updated first.
+    if (len > 0) {
+        RangeChangeUpdateChildren(offset, len);
+    }
+
+    if (!list_is_empty(&free_list)) {
+        pmm_free(&free_list);
+    }
+
+    // dropping the last reference frees whatever pages are left in it
+    collapsed_parent.reset();
+}
+
+// Returns a reference to the first child at or after |iter| that is not
+// already being destroyed.
+template <typename Iter>
+static mxtl::RefPtr<VmObject> NextLiveChild(Iter iter, const Iter& end) {
+    for (; iter != end; ++iter) {
+        auto child = mxtl::MakeRefPtrUpgradeFromRaw(&*iter);
+        if (child) {
+            return child;
+        }
+    }
+    return nullptr;
+}
+
+void VmObject::RangeChangeUpdateChildren(uint64_t offset, uint64_t len) {
+    canary_.Assert();
+    DEBUG_ASSERT(!lock_.IsHeld());
+
+    // Walk the children one at a time, holding a reference to the current one
+    // rather than our children_lock_ while it is updated, since updating it
+    // takes its lock. A child we hold a reference to stays in our list: it can
+    // only leave it by being destroyed, or by collapsing us out of its chain,
+    // which can't happen while its caller is holding a reference to us.
+    mxtl::RefPtr<VmObject> child;
+    {
+        AutoLock a(&children_lock_);
+        child = NextLiveChild(children_list_.begin(), children_list_.end());
+    }
+
+    while (child) {
+        child->RangeChangeUpdateFromParent(this, offset, len);
+
+        mxtl::RefPtr<VmObject> next;
+        {
+            AutoLock a(&children_lock_);
+            next = NextLiveChild(++children_list_.make_iterator(*child), children_list_.end());
+        }
+        // may drop the last reference to the child, which takes our children_lock_
+        child = mxtl::move(next);
     }
 }
 
@@ -101,20 +101,27 @@ status_t VmObjectPaged::CloneCOW(uint64_t offset, uint64_t size, bool copy_name,
     if (!ac.check())
         return MX_ERR_NO_MEMORY;
 
-    AutoLock a(&lock_);
-
     // add it as a child to us
-    AddChildLocked(vmo.get());
+    {
+        AutoLock a(&children_lock_);
+        AddChildLocked(vmo.get());
+    }
 
-    // set the new clone's size
-    auto status = vmo->ResizeLocked(size);
-    if (status != MX_OK)
-        return status;
+    // the clone has its own lock, which it's set up under; should it fail,
+    // its destructor removes it from our children again
+    {
+        Guard g(vmo.get());
 
-    // set the offset with the parent
-    status = vmo->SetParentOffsetLocked(offset);
-    if (status != MX_OK)
-        return status;
+        // set the new clone's size
+        auto status = vmo->ResizeLocked(size);
+        if (status != MX_OK)
+            return status;
+
+        // set the offset with the parent
+        status = vmo->SetParentOffsetLocked(offset);
+        if (status != MX_OK)
+            return status;
+    }
 
     if (copy_name)
         vmo->name_ = name_;
@@ -178,7 +185,7 @@ size_t VmObjectPaged::AllocatedPagesInRange(uint64_t offset, uint64_t len) const
 }
 
 status_t VmObjectPaged::AddPage(vm_page_t* p, uint64_t offset) {
-    AutoLock a(&lock_);
+    Guard g(this);
 
     return AddPageLocked(p, offset);
 }
@@ -265,7 +272,11 @@ mx_status_t VmObjectPaged::CreateFromROData(const void* data, size_t size, mxtl:
 // |free_list|, if not NULL, is a list of allocated but unused vm_page_t that
 // this function may allocate from.  This function will need at most one entry,
 // and will not fail if |free_list| is a non-empty list, faulting in was requested,
-// and offset is in range.
+// and offset is in range.  Pages on |free_list| must already be zeroed, so that
+// callers can do that work before taking the lock.  If a zero-filled page is
+// needed, none is on |free_list| and VMM_PF_FLAG_NO_ZERO_FILL is set, returns
+// MX_ERR_SHOULD_WAIT.  Copy-on-write faults overwrite the whole page, so they
+// allocate one themselves rather than have the caller zero it for nothing.
 status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
                                       vm_page_t** const page_out, paddr_t* const pa_out) {
     canary_.Assert();
@@ -293,15 +304,11 @@ status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_node*
 
     // if we have a parent see if they have a page for us
     if (parent_) {
-        safeint::CheckedNumeric<uint64_t> parent_offset = parent_offset_;
-        parent_offset += offset;
-        DEBUG_ASSERT(parent_offset.IsValid());
+        // first drop any parent that only we still refer to, so the lookup doesn't have to go through it
+        CollapseParentLocked();
 
         // make sure we don't cause the parent to fault in new pages, just ask for any that already exist
-        uint parent_pf_flags = pf_flags & ~(VMM_PF_FLAG_FAULT_MASK);
-
-        status_t status = parent_->GetPageLocked(parent_offset.ValueOrDie(), parent_pf_flags,
-                                                 nullptr, &p, &pa);
+        status_t status = GetPageFromParentLocked(offset, &p, &pa);
         if (status == MX_OK) {
             // we have a page from them. if we're read-only faulting, return that page so they can map
             // or read from it directly
@@ -373,14 +380,18 @@ status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_node*
         return MX_OK;
     }
 
-    // allocate a page
+    // allocate a page, preferring one the caller has already zeroed
+    bool zeroed = false;
     if (free_list) {
         p = list_remove_head_type(free_list, vm_page_t, free.node);
         if (p) {
             pa = vm_page_to_paddr(p);
+            zeroed = true;
         }
     }
     if (!p) {
+        if (pf_flags & VMM_PF_FLAG_NO_ZERO_FILL)
+            return MX_ERR_SHOULD_WAIT;
         p = pmm_alloc_page(pmm_alloc_flags_, &pa);
     }
     if (!p) {
@@ -390,7 +401,9 @@ status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_node*
     InitializeVmPage(p);
 
     // TODO: remove once pmm returns zeroed pages
-    ZeroPage(pa);
+    if (!zeroed) {
+        ZeroPage(pa);
+    }
 
     status_t status = AddPageLocked(p, offset);
     DEBUG_ASSERT(status == MX_OK);
@@ -408,6 +421,132 @@ status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_node*
     return MX_OK;
 }
 
+// Looks up an existing page at |offset| in our parent, or failing that in its parents, without
+// faulting anything in.
+//
+// The lock of each parent is taken in turn going up the chain, and held until the lookup is done,
+// so a page can't be moved or freed while it is being looked at. It may be freed once that lock
+// is dropped, but not while our caller still holds our lock: a parent that frees a page first
+// passes the change on to all its descendants, taking each of their locks to do so.
+status_t VmObjectPaged::GetPageFromParentLocked(uint64_t offset, vm_page_t** page_out,
+                                                paddr_t* pa_out) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    if (!parent_ || offset >= parent_limit_)
+        return MX_ERR_NOT_FOUND;
+
+    safeint::CheckedNumeric<uint64_t> parent_offset = parent_offset_;
+    parent_offset += offset;
+    DEBUG_ASSERT(parent_offset.IsValid());
+
+    // only paged objects can be cloned, so our parent is one as well
+    DEBUG_ASSERT(parent_->is_paged());
+    auto parent = static_cast<VmObjectPaged*>(parent_.get());
+
+    AutoLock a(&parent->lock_);
+
+    if (parent_offset.ValueOrDie() >= parent->size_)
+        return MX_ERR_OUT_OF_RANGE;
+
+    vm_page_t* p = parent->page_list_.GetPage(parent_offset.ValueOrDie());
+    if (p) {
+        *page_out = p;
+        *pa_out = vm_page_to_paddr(p);
+        return MX_OK;
+    }
+
+    return parent->GetPageFromParentLocked(parent_offset.ValueOrDie(), page_out, pa_out);
+}
+
+// Once every handle and mapping of an intermediate clone is gone, the only thing still referring
+// to it is its one child, and it only lives on to hold the pages that child sees through it.
+// Move those into the child and attach the child directly to the grandparent, so that lookups
+// skip it, and chains don't grow longer than the number of clones still in use.
+//
+// The old parent is kept alive until our lock is released, and is destroyed, along with any pages
+// of it that we had already replaced with our own, after our children have been told about them.
+void VmObjectPaged::CollapseParentLocked() {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    // only one collapse per time the lock is held
+    if (!parent_ || collapsed_parent_)
+        return;
+
+    DEBUG_ASSERT(parent_->is_paged());
+    auto parent = static_cast<VmObjectPaged*>(parent_.get());
+
+    // and only of a parent no one else refers to
+    if (parent->ref_count_debug() != 1)
+        return;
+
+    AutoLock pl(&parent->lock_);
+
+    // leave a parent at the root of the chain in place, so that we remain a clone
+    if (!parent->parent_)
+        return;
+
+    safeint::CheckedNumeric<uint64_t> new_offset = parent_offset_;
+    new_offset += parent->parent_offset_;
+    safeint::CheckedNumeric<uint64_t> new_end = new_offset;
+    new_end += size_;
+    if (!new_end.IsValid())
+        return;
+
+    auto grandparent = static_cast<VmObjectPaged*>(parent->parent_.get());
+
+    // Anything walking the grandparent's children takes a reference to each one with its
+    // children_lock_ held, so checking again here makes sure none is looking at our parent, and
+    // that any that come along later will find us in its place instead.
+    AutoLock gcl(&grandparent->children_lock_);
+    if (parent->ref_count_debug() != 1)
+        return;
+
+    AutoLock pcl(&parent->children_lock_);
+    DEBUG_ASSERT(parent->children_list_len_ == 1);
+
+    // take the pages of the parent we can see, unless we've already made our own copies
+    const uint64_t start = parent_offset_;
+    const uint64_t end = ROUNDUP_PAGE_SIZE(start + MIN(size_, parent_limit_));
+    status_t status = parent->page_list_.ForEveryPageInRange(
+            [this, start](vm_page_t*& p, uint64_t off) {
+                const uint64_t offset = off - start;
+                if (page_list_.GetPage(offset)) {
+                    // this one goes away with the parent, and our children may still
+                    // have it mapped from before we made our copy
+                    DeferChildrenUpdateLocked(offset, PAGE_SIZE);
+                    return MX_ERR_NEXT;
+                }
+                if (page_list_.AddPage(p, offset) != MX_OK)
+                    return MX_ERR_NO_MEMORY;
+                p = nullptr;
+                return MX_ERR_NEXT;
+            }, start, end);
+    if (status != MX_OK) {
+        // the pages moved so far are ours now, and the rest stay with the parent,
+        // so the chain is still consistent as it is
+        return;
+    }
+
+    // we could only see as much of the grandparent as the parent covered, and none of it past
+    // our own size, since the parent's pages beyond that weren't moved (and would otherwise
+    // shadow the grandparent if we grew)
+    const uint64_t parent_visible = MIN(parent->size_, parent->parent_limit_);
+    const uint64_t limit = (parent_visible > parent_offset_) ? parent_visible - parent_offset_ : 0;
+    parent_limit_ = MIN(parent_limit_, MIN(limit, size_));
+
+    // take the parent's place in the grandparent's children
+    parent->RemoveChildLocked(this);
+    grandparent->children_list_.insert(*parent, this);
+    grandparent->children_list_.erase(*parent);
+
+    collapsed_parent_ = mxtl::move(parent_);
+    parent_ = mxtl::move(parent->parent_);
+    parent_offset_ = new_offset.ValueOrDie();
+
+    LTRACEF("vmo %p collapsed parent %p, now %p offset %#" PRIx64 " limit %#" PRIx64 "\n",
+            this, parent, parent_.get(), parent_offset_, parent_limit_);
+}
+
 status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t* committed) {
     canary_.Assert();
     LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
@@ -415,7 +554,7 @@ status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t* com
     if (committed)
         *committed = 0;
 
-    AutoLock a(&lock_);
+    Guard g(this);
 
     // trim the size
     uint64_t new_len;
@@ -460,6 +599,12 @@ status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t* com
         return MX_ERR_NO_MEMORY;
     }
 
+    // GetPageLocked expects the pages it is handed to be zeroed already
+    vm_page_t* page;
+    list_for_every_entry (&page_list, page, vm_page_t, free.node) {
+        ZeroPage(page);
+    }
+
     // unmap all of the pages in this range on all the mapping regions
     RangeChangeUpdateLocked(offset, end - offset);
 
@@ -499,7 +644,7 @@ status_t VmObjectPaged::CommitRangeContiguous(uint64_t offset, uint64_t len, uin
     if (committed)
         *committed = 0;
 
-    AutoLock a(&lock_);
+    Guard g(this);
 
     // This function does not support cloned VMOs.
     if (unlikely(parent_)) {
@@ -582,7 +727,7 @@ status_t VmObjectPaged::DecommitRange(uint64_t offset, uint64_t len, uint64_t* d
     if (decommitted)
         *decommitted = 0;
 
-    AutoLock a(&lock_);
+    Guard g(this);
 
     // trim the size
     uint64_t new_len;
@@ -613,11 +758,14 @@ status_t VmObjectPaged::DecommitRange(uint64_t offset, uint64_t len, uint64_t* d
     // unmap all of the pages in this range on all the mapping regions
     RangeChangeUpdateLocked(start, page_aligned_len);
 
-    // iterate through the pages, freeing them
+    // iterate through the pages, freeing them once our children have been updated
     while (start < end) {
-        auto status = page_list_.FreePage(start);
-        if (status == MX_OK && decommitted) {
-            *decommitted += PAGE_SIZE;
+        vm_page_t* page = page_list_.RemovePage(start);
+        if (page) {
+            DeferFreePageLocked(page);
+            if (decommitted) {
+                *decommitted += PAGE_SIZE;
+            }
         }
         start += PAGE_SIZE;
     }
@@ -758,9 +906,12 @@ status_t VmObjectPaged::ResizeLocked(uint64_t s) {
             // unmap all of the pages in this range on all the mapping regions
             RangeChangeUpdateLocked(start, page_aligned_len);
 
-            // iterate through the pages, freeing them
+            // iterate through the pages, freeing them once our children have been updated
             while (start < end) {
-                page_list_.FreePage(start);
+                vm_page_t* page = page_list_.RemovePage(start);
+                if (page) {
+                    DeferFreePageLocked(page);
+                }
                 start += PAGE_SIZE;
             }
         }
@@ -771,6 +922,12 @@ status_t VmObjectPaged::ResizeLocked(uint64_t s) {
         uint64_t end = ROUNDUP_PAGE_SIZE(s);
         uint64_t page_aligned_len = end - start;
 
+        // the new range starts out zero, rather than showing whatever the parent has there,
+        // so that it reads the same whether or not our parent has since been collapsed
+        if (parent_) {
+            parent_limit_ = MIN(parent_limit_, start);
+        }
+
         // we're only worried about whole pages to be added
         if (page_aligned_len > 0) {
             // inform all our children or mapping that there's new bits
@@ -785,7 +942,7 @@ status_t VmObjectPaged::ResizeLocked(uint64_t s) {
 }
 
 status_t VmObjectPaged::Resize(uint64_t s) {
-    AutoLock a(&lock_);
+    Guard g(this);
 
     return ResizeLocked(s);
 }
@@ -819,7 +976,7 @@ status_t VmObjectPaged::ReadWriteInternal(uint64_t offset, size_t len, size_t* b
     if (bytes_copied)
         *bytes_copied = 0;
 
-    AutoLock a(&lock_);
+    Guard g(this);
 
     // trim the size
     uint64_t new_len;
@@ -905,7 +1062,7 @@ status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
     if (unlikely(len == 0))
         return MX_ERR_INVALID_ARGS;
 
-    AutoLock a(&lock_);
+    Guard g(this);
 
     // verify that the range is within the object
     if (unlikely(!InRange(offset, len, size_)))
@@ -1049,7 +1206,7 @@ status_t VmObjectPaged::CacheOp(const uint64_t start_offset, const uint64_t len,
     if (unlikely(len == 0))
         return MX_ERR_INVALID_ARGS;
 
-    AutoLock a(&lock_);
+    Guard g(this);
 
     if (unlikely(!InRange(start_offset, len, size_)))
         return MX_ERR_OUT_OF_RANGE;
@@ -1101,17 +1258,28 @@ status_t VmObjectPaged::CacheOp(const uint64_t start_offset, const uint64_t len,
     return MX_OK;
 }
 
-void VmObjectPaged::RangeChangeUpdateFromParentLocked(const uint64_t offset, const uint64_t len) {
+void VmObjectPaged::RangeChangeUpdateFromParent(VmObject* parent, const uint64_t offset,
+                                                const uint64_t len) {
     canary_.Assert();
 
+    Guard g(this);
+
     LTRACEF("offset %#" PRIx64 " len %#" PRIx64 " p_offset %#" PRIx64 " size_ %#" PRIx64 "\n",
             offset, len, parent_offset_, size_);
 
+    // if we've been collapsed onto a new parent since this update started, its offsets
+    // no longer line up with ours, so treat all of us as changed
+    if (parent_.get() != parent) {
+        if (size_ > 0)
+            RangeChangeUpdateLocked(0, size_);
+        return;
+    }
+
     // our parent is notifying that a range of theirs changed, see where it intersects
     // with our offset into the parent and pass it on
     uint64_t offset_new;
     uint64_t len_new;
-    if (!GetIntersect(parent_offset_, size_, offset, len,
+    if (!GetIntersect(parent_offset_, MIN(size_, parent_limit_), offset, len,
                       &offset_new, &len_new))
         return;
 
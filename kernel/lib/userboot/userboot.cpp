@@ -353,6 +353,8 @@ static int attempt_userboot() {
         return hv;
 
     dprintf(SPEW, "userboot: %-23s @ %#" PRIxPTR "\n", "entry point", entry);
+    dprintf(INFO, "userboot: starting %" PRIu64 " ms after boot\n",
+            current_time() / LK_MSEC(1));
 
     // Start the process's initial thread.
     status = thread->Start(entry, sp, hv, vdso_base,
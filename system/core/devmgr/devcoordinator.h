@@ -31,6 +31,7 @@ struct dc_pending {
     list_node_t node;
     void* ctx;
     uint32_t op;
+    mx_time_t start;
 };
 
 #define PENDING_BIND 1
@@ -121,6 +122,24 @@ struct dc_driver {
     uint32_t flags;
     struct list_node node;
     const char* libname;
+
+    // listnode for this driver in the bind index
+    list_node_t inode;
+
+    // drivers earlier in bind order are tried first
+    int64_t bind_order;
+
+    // if bind_keyed, this driver can only bind to devices
+    // whose BIND_PROTOCOL is bind_protocol
+    uint32_t bind_protocol;
+    bool bind_keyed;
+
+    // time from sending each bind request to a devhost until
+    // the reply, and when the last reply arrived
+    uint32_t bind_count;
+    mx_time_t bind_total;
+    mx_time_t bind_max;
+    mx_time_t bind_done;
 };
 
 #define DRIVER_NAME_LEN_MAX 64
@@ -140,6 +159,34 @@ bool dc_is_bindable(driver_t* drv, uint32_t protocol_id,
                     mx_device_prop_t* props, size_t prop_count,
                     bool autobind);
 
+// The bind index finds the drivers which may bind to a device without
+// running every driver's bind program.  Drivers are kept in the order in
+// which they were added: dc_bind_index_add() with first set puts |drv|
+// ahead of every driver already in the index.
+void dc_bind_index_add(driver_t* drv, bool first);
+
+typedef struct {
+    list_node_t* keyed_list;
+    driver_t* keyed;
+    driver_t* any;
+    uint32_t protocol_id;
+} dc_bind_iter_t;
+
+// Iterates, in bind order, over the drivers whose bind programs might
+// match a device with these properties.  Drivers must not be added to
+// the index while iterating.
+void dc_bind_iter_init(dc_bind_iter_t* it, uint32_t protocol_id,
+                       const mx_device_prop_t* props, size_t prop_count);
+driver_t* dc_bind_iter_next(dc_bind_iter_t* it);
+
+// Counts of bind programs run and skipped by way of the index.
+typedef struct {
+    uint64_t evaluated;
+    uint64_t skipped;
+} dc_bind_stats_t;
+
+void dc_get_bind_stats(dc_bind_stats_t* stats);
+
 #define DC_MAX_DATA 4096
 
 // The first two fields of devcoordinator messages align
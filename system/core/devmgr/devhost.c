@@ -144,6 +144,105 @@ done:
     return drv->status;
 }
 
+typedef struct {
+    mx_device_t* dev;
+    mx_driver_t* drv;
+} bind_job_t;
+
+// Runs a driver's bind hook and reports the result to the devcoordinator.
+// The job holds a reference to the device, so that it survives a
+// concurrent remove.
+static int dh_bind_thread(void* arg) {
+    bind_job_t* job = arg;
+    mx_device_t* dev = job->dev;
+    mx_driver_t* drv = job->drv;
+    free(job);
+
+    char buffer[512];
+    const char* path = mkdevpath(dev, buffer, sizeof(buffer));
+
+    mx_status_t r;
+    void* cookie = NULL;
+    if (drv->ops->bind) {
+        r = drv->ops->bind(drv->ctx, dev, &cookie);
+    } else {
+        r = MX_ERR_NOT_SUPPORTED;
+    }
+
+    DM_LOCK();
+    if (r < 0) {
+        log(ERROR, "devhost[%s] bind driver '%s' failed: %d\n", path, drv->libname, r);
+    } else {
+        //TODO: Best behaviour for multibind? maybe retire "owner"?
+        //      For now this is extermely rare, so we mostly can ignore
+        //      it.
+        if (drv->ops->unbind || cookie) {
+            log(INFO, "devhost[%s] driver '%s' unbind=%p, cookie=%p\n",
+                path, drv->libname, drv->ops->unbind, cookie);
+
+            if (dev->flags & DEV_FLAG_DEAD) {
+                // removed while binding: the owner has already been detached,
+                // so undo the bind now rather than take a reference no one
+                // will ever drop
+                log(INFO, "devhost[%s] driver '%s' device removed while binding\n",
+                    path, drv->libname);
+                if (drv->ops->unbind) {
+                    drv->ops->unbind(drv->ctx, dev, cookie);
+                }
+            } else if (dev->owner) {
+                log(ERROR, "devhost[%s] driver '%s' device already owned!\n", path, drv->libname);
+            } else {
+                dev->owner = drv;
+                dev->owner_cookie = cookie;
+                dev->refcount++;
+            }
+        }
+    }
+    // The rpc channel is closed (under the api lock) if the
+    // device was removed while binding.
+    if (dev->rpc != MX_HANDLE_INVALID) {
+        dc_msg_t reply = {
+            .txid = 0,
+            .op = DC_OP_STATUS,
+            .status = r,
+        };
+        mx_channel_write(dev->rpc, 0, &reply, sizeof(reply), NULL, 0);
+    }
+    dev_ref_release(dev);
+    DM_UNLOCK();
+    return 0;
+}
+
+// Binds |drv| to |dev| on a thread of its own, so that a driver which
+// is slow to bind (probing hardware, enumerating a bus) does not hold up
+// binding or io for the other devices in this devhost.  Drivers are
+// loaded and initialized before this, on the rpc thread.
+static void dh_start_bind(mx_device_t* dev, mx_driver_t* drv) {
+    bind_job_t* job = malloc(sizeof(bind_job_t));
+    if (job == NULL) {
+        dc_msg_t reply = {
+            .txid = 0,
+            .op = DC_OP_STATUS,
+            .status = MX_ERR_NO_MEMORY,
+        };
+        mx_channel_write(dev->rpc, 0, &reply, sizeof(reply), NULL, 0);
+        return;
+    }
+    job->dev = dev;
+    job->drv = drv;
+
+    DM_LOCK();
+    dev_ref_acquire(dev);
+    DM_UNLOCK();
+
+    thrd_t t;
+    if (thrd_create_with_name(&t, dh_bind_thread, job, "devhost-bind") == thrd_success) {
+        thrd_detach(t);
+    } else {
+        dh_bind_thread(job);
+    }
+}
+
 static void dh_handle_open(mxrio_msg_t* msg, size_t len,
                            mx_handle_t h, iostate_t* ios) {
     if ((msg->hcount != 1) ||
@@ -304,7 +403,6 @@ static mx_status_t dh_handle_rpc_read(mx_handle_t h, iostate_t* ios) {
             r = MX_ERR_INVALID_ARGS;
             break;
         }
-        //TODO: api lock integration
         log(RPC_IN, "devhost[%s] bind driver '%s'\n", path, name);
         mx_driver_t* drv;
         if (ios->dev->flags & DEV_FLAG_DEAD) {
@@ -313,33 +411,8 @@ static mx_status_t dh_handle_rpc_read(mx_handle_t h, iostate_t* ios) {
         } else if ((r = dh_find_driver(name, hin[0], &drv)) < 0) {
             log(ERROR, "devhost[%s] driver load failed: %d\n", path, r);
         } else {
-            void* cookie = NULL;
-            if (drv->ops->bind) {
-                r = drv->ops->bind(drv->ctx, ios->dev, &cookie);
-            } else {
-                r = MX_ERR_NOT_SUPPORTED;
-            }
-            if (r < 0) {
-                log(ERROR, "devhost[%s] bind driver '%s' failed: %d\n", path, name, r);
-            } else {
-                //TODO: Best behaviour for multibind? maybe retire "owner"?
-                //      For now this is extermely rare, so we mostly can ignore
-                //      it.
-                if (drv->ops->unbind || cookie) {
-                    log(INFO, "devhost[%s] driver '%s' unbind=%p, cookie=%p\n",
-                        path, name, drv->ops->unbind, cookie);
-
-                    DM_LOCK();
-                    if (ios->dev->owner) {
-                        log(ERROR, "devhost[%s] driver '%s' device already owned!\n", path, name);
-                    } else {
-                        ios->dev->owner = drv;
-                        ios->dev->owner_cookie = cookie;
-                        ios->dev->refcount++;
-                    }
-                    DM_UNLOCK();
-                }
-            }
+            dh_start_bind(ios->dev, drv);
+            return MX_OK;
         }
         dc_msg_t reply = {
             .txid = 0,
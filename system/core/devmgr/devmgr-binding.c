@@ -138,12 +138,140 @@ next_instruction:
     return false;
 }
 
+static dc_bind_stats_t bind_stats;
+
+// The protocol a device is matched against, as dev_get_prop() sees it.
+static uint32_t dev_protocol(uint32_t protocol_id,
+                             const mx_device_prop_t* props, size_t prop_count) {
+    for (size_t i = 0; i < prop_count; i++) {
+        if (props[i].id == BIND_PROTOCOL) {
+            return props[i].value;
+        }
+    }
+    return protocol_id;
+}
+
+static bool is_protocol_inst(uint32_t inst, uint32_t cond) {
+    return (BINDINST_CC(inst) == cond) && (BINDINST_PB(inst) == BIND_PROTOCOL);
+}
+
+// Determines whether a bind program can only ever match devices of a
+// single protocol, which is the case when either
+//  - every MATCH in the program is conditional on BIND_PROTOCOL == X, or
+//  - before any MATCH or GOTO, there is an ABORT_IF(NE, BIND_PROTOCOL, X)
+// which together cover nearly every driver.
+static bool binding_protocol(const mx_bind_inst_t* binding, size_t count,
+                             uint32_t* protocol_id) {
+    // ABORT_IF(NE, BIND_PROTOCOL, X) ahead of any MATCH or GOTO
+    for (size_t i = 0; i < count; i++) {
+        uint32_t inst = binding[i].op;
+        uint32_t op = BINDINST_OP(inst);
+        if (op == OP_MATCH || op == OP_GOTO) {
+            break;
+        }
+        if (op == OP_ABORT && is_protocol_inst(inst, COND_NE)) {
+            *protocol_id = binding[i].arg;
+            return true;
+        }
+    }
+
+    // every MATCH conditional on BIND_PROTOCOL == X
+    bool found = false;
+    uint32_t value = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t inst = binding[i].op;
+        if (BINDINST_OP(inst) != OP_MATCH) {
+            continue;
+        }
+        if (!is_protocol_inst(inst, COND_EQ) ||
+            (found && binding[i].arg != value)) {
+            return false;
+        }
+        found = true;
+        value = binding[i].arg;
+    }
+    *protocol_id = value;
+    return found;
+}
+
+// Keyed drivers are hashed by protocol into buckets, each in bind order.
+// Drivers which could match any protocol are kept on a separate list.
+#define BIND_INDEX_BUCKETS 64
+
+static list_node_t bind_index[BIND_INDEX_BUCKETS];
+static list_node_t bind_index_any = LIST_INITIAL_VALUE(bind_index_any);
+static bool bind_index_ready;
+static int64_t bind_order_first;
+static int64_t bind_order_last;
+
+static list_node_t* bind_bucket(uint32_t protocol_id) {
+    if (!bind_index_ready) {
+        for (size_t i = 0; i < BIND_INDEX_BUCKETS; i++) {
+            list_initialize(&bind_index[i]);
+        }
+        bind_index_ready = true;
+    }
+    return &bind_index[(protocol_id * 2654435761u) >> 26];
+}
+
+void dc_bind_index_add(driver_t* drv, bool first) {
+    drv->bind_keyed = binding_protocol(drv->binding,
+                                       drv->binding_size / sizeof(mx_bind_inst_t),
+                                       &drv->bind_protocol);
+    list_node_t* list = drv->bind_keyed ? bind_bucket(drv->bind_protocol)
+                                        : &bind_index_any;
+    if (first) {
+        drv->bind_order = --bind_order_first;
+        list_add_head(list, &drv->inode);
+    } else {
+        drv->bind_order = ++bind_order_last;
+        list_add_tail(list, &drv->inode);
+    }
+}
+
+void dc_bind_iter_init(dc_bind_iter_t* it, uint32_t protocol_id,
+                       const mx_device_prop_t* props, size_t prop_count) {
+    it->protocol_id = dev_protocol(protocol_id, props, prop_count);
+    it->keyed_list = bind_bucket(it->protocol_id);
+    it->keyed = list_peek_head_type(it->keyed_list, driver_t, inode);
+    it->any = list_peek_head_type(&bind_index_any, driver_t, inode);
+}
+
+driver_t* dc_bind_iter_next(dc_bind_iter_t* it) {
+    // skip other protocols sharing this bucket
+    while ((it->keyed != NULL) && (it->keyed->bind_protocol != it->protocol_id)) {
+        it->keyed = list_next_type(it->keyed_list, &it->keyed->inode, driver_t, inode);
+    }
+    driver_t* drv;
+    if ((it->keyed != NULL) &&
+        ((it->any == NULL) || (it->keyed->bind_order < it->any->bind_order))) {
+        drv = it->keyed;
+        it->keyed = list_next_type(it->keyed_list, &drv->inode, driver_t, inode);
+    } else if (it->any != NULL) {
+        drv = it->any;
+        it->any = list_next_type(&bind_index_any, &drv->inode, driver_t, inode);
+    } else {
+        return NULL;
+    }
+    return drv;
+}
+
+void dc_get_bind_stats(dc_bind_stats_t* stats) {
+    *stats = bind_stats;
+}
+
 bool dc_is_bindable(driver_t* drv, uint32_t protocol_id,
                     mx_device_prop_t* props, size_t prop_count,
                     bool autobind) {
     if (drv->binding_size == 0) {
         return false;
     }
+    if (drv->bind_keyed &&
+        (drv->bind_protocol != dev_protocol(protocol_id, props, prop_count))) {
+        bind_stats.skipped++;
+        return false;
+    }
+    bind_stats.evaluated++;
     bpctx_t ctx;
     ctx.props = props;
     ctx.end = props + prop_count;
@@ -4,6 +4,7 @@
 
 #include <ctype.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
@@ -32,6 +33,7 @@ uint32_t log_flags = LOG_ERROR | LOG_INFO;
 static void dc_dump_state(void);
 static void dc_dump_devprops(void);
 static void dc_dump_drivers(void);
+static void dc_dump_bind_stats(void);
 
 static mx_handle_t dmctl_socket;
 
@@ -68,6 +70,7 @@ static mx_status_t handle_dmctl_write(size_t len, const char* cmd) {
                      "acpi-ps0    - invoke the _PS0 method on an acpi object\n"
                      "devprops    - dump published devices and their binding properties\n"
                      "drivers     - list discovered drivers and their properties\n"
+                     "bindstats   - show the time spent matching and binding drivers\n"
                      );
             return MX_OK;
         }
@@ -96,6 +99,10 @@ static mx_status_t handle_dmctl_write(size_t len, const char* cmd) {
             return MX_OK;
         }
     }
+    if ((len == 9) && !memcmp(cmd, "bindstats", 9)) {
+        dc_dump_bind_stats();
+        return MX_OK;
+    }
     if ((len == 9) && (!memcmp(cmd, "ktraceoff", 9))) {
         mx_ktrace_control(get_root_resource(), KTRACE_ACTION_STOP, 0, NULL);
         mx_ktrace_control(get_root_resource(), KTRACE_ACTION_REWIND, 0, NULL);
@@ -351,6 +358,9 @@ static void dc_dump_drivers(void) {
         dmprintf("%sName    : %s\n", first ? "" : "\n", drv->name);
         dmprintf("Driver  : %s\n", drv->libname ? drv->libname : "(null)");
         dmprintf("Flags   : 0x%08x\n", drv->flags);
+        if (drv->bind_keyed) {
+            dmprintf("Indexed : protocol 0x%08x\n", drv->bind_protocol);
+        }
         if (drv->binding_size) {
             char line[256];
             uint32_t count = drv->binding_size / sizeof(drv->binding[0]);
@@ -877,10 +887,24 @@ static mx_status_t dc_bind_device(device_t* dev, const char* drvlibname) {
 
     //TODO: disallow if we're in the middle of enumeration, etc
     driver_t* drv;
+    if (autobind) {
+        dc_bind_iter_t it;
+        dc_bind_iter_init(&it, dev->protocol_id, dev->props, dev->prop_count);
+        while ((drv = dc_bind_iter_next(&it)) != NULL) {
+            if (dc_is_bindable(drv, dev->protocol_id,
+                               dev->props, dev->prop_count, true)) {
+                log(INFO, "devcoord: drv='%s' bindable to dev='%s'\n",
+                    drv->name, dev->name);
+                dc_attempt_bind(drv, dev);
+                break;
+            }
+        }
+        return MX_OK;
+    }
     list_for_every_entry(&list_drivers, drv, driver_t, node) {
-        if (autobind || !strcmp(drv->libname, drvlibname)) {
+        if (!strcmp(drv->libname, drvlibname)) {
             if (dc_is_bindable(drv, dev->protocol_id,
-                               dev->props, dev->prop_count, autobind)) {
+                               dev->props, dev->prop_count, false)) {
                 log(INFO, "devcoord: drv='%s' bindable to dev='%s'\n",
                     drv->name, dev->name);
                 dc_attempt_bind(drv, dev);
@@ -892,6 +916,24 @@ static mx_status_t dc_bind_device(device_t* dev, const char* drvlibname) {
     return MX_OK;
 };
 
+static mx_time_t dc_start_time;
+
+// Devhosts bind drivers concurrently, so the boot is gated not by the
+// sum of bind times but by the drivers whose binds finish last.
+// Record, per driver, how long binds take and when the last finished.
+static void dc_bind_complete(driver_t* drv, device_t* dev, mx_time_t start) {
+    mx_time_t now = mx_time_get(MX_CLOCK_MONOTONIC);
+    mx_time_t elapsed = now - start;
+    drv->bind_count++;
+    drv->bind_total += elapsed;
+    if (elapsed > drv->bind_max) {
+        drv->bind_max = elapsed;
+    }
+    drv->bind_done = now - dc_start_time;
+    log(DEVLC, "devcoord: bind drv='%s' dev='%s' took %" PRIu64 "ms\n",
+        drv->name, dev->name, elapsed / 1000000);
+}
+
 static mx_status_t dc_handle_device_read(device_t* dev) {
     dc_msg_t msg;
     mx_handle_t hin[2];
@@ -1011,6 +1053,7 @@ static mx_status_t dc_handle_device_read(device_t* dev) {
         }
         switch (pending->op) {
         case PENDING_BIND:
+            dc_bind_complete(pending->ctx, dev, pending->start);
             if (msg.status != MX_OK) {
                 log(ERROR, "devcoord: rpc: bind-driver '%s' status %d\n",
                     dev->name, msg.status);
@@ -1179,7 +1222,8 @@ static mx_status_t dc_create_shadow(device_t* parent) {
 }
 
 // send message to devhost, requesting the binding of a driver to a device
-static mx_status_t dh_bind_driver(device_t* dev, const char* libname) {
+static mx_status_t dh_bind_driver(device_t* dev, driver_t* drv) {
+    const char* libname = drv->libname;
     dc_msg_t msg;
     uint32_t mlen;
 
@@ -1210,7 +1254,8 @@ static mx_status_t dh_bind_driver(device_t* dev, const char* libname) {
 
     dev->flags |= DEV_CTX_BOUND;
     pending->op = PENDING_BIND;
-    pending->ctx = NULL;
+    pending->ctx = drv;
+    pending->start = mx_time_get(MX_CLOCK_MONOTONIC);
     list_add_tail(&dev->pending, &pending->node);
     return MX_OK;
 }
@@ -1226,7 +1271,7 @@ static mx_status_t dc_attempt_bind(driver_t* drv, device_t* dev) {
             log(ERROR, "devcoord: can't bind to device without devhost\n");
             return MX_ERR_BAD_STATE;
         }
-        return dh_bind_driver(dev, drv->libname);
+        return dh_bind_driver(dev, drv);
     }
 
     // busdev args are "processname,args"
@@ -1259,13 +1304,53 @@ static mx_status_t dc_attempt_bind(driver_t* drv, device_t* dev) {
         }
     }
 
-    return dh_bind_driver(dev->shadow, drv->libname);
+    return dh_bind_driver(dev->shadow, drv);
+}
+
+// Time spent finding drivers for new devices and devices for new
+// drivers, and the number of each, for "dm bindstats".
+static mx_time_t bind_time;
+static uint32_t bind_new_devices;
+static uint32_t bind_new_drivers;
+
+static void dc_dump_bind_stats(void) {
+    dc_bind_stats_t stats;
+    dc_get_bind_stats(&stats);
+    dmprintf("bind: %u devices, %u drivers added, %" PRIu64 "us matching\n",
+             bind_new_devices, bind_new_drivers, bind_time / 1000);
+    dmprintf("bind: %" PRIu64 " bind programs run, %" PRIu64 " skipped by protocol\n",
+             stats.evaluated, stats.skipped);
+
+    // The drivers whose binds completed last, latest first.
+    dmprintf("%-24s %5s %8s %8s %8s\n", "driver", "binds", "total", "max", "done");
+    mx_time_t after = INT64_MAX;
+    for (int n = 0; n < 16; n++) {
+        driver_t* last = NULL;
+        driver_t* drv;
+        list_for_every_entry(&list_drivers, drv, driver_t, node) {
+            if ((drv->bind_count > 0) && (drv->bind_done < after) &&
+                ((last == NULL) || (drv->bind_done > last->bind_done))) {
+                last = drv;
+            }
+        }
+        if (last == NULL) {
+            break;
+        }
+        dmprintf("%-24s %5u %6" PRIu64 "ms %6" PRIu64 "ms %6" PRIu64 "ms\n",
+                 last->name, last->bind_count, last->bind_total / 1000000,
+                 last->bind_max / 1000000, last->bind_done / 1000000);
+        after = last->bind_done;
+    }
 }
 
 static void dc_handle_new_device(device_t* dev) {
     driver_t* drv;
+    dc_bind_iter_t it;
 
-    list_for_every_entry(&list_drivers, drv, driver_t, node) {
+    mx_time_t start = mx_time_get(MX_CLOCK_MONOTONIC);
+    bind_new_devices++;
+    dc_bind_iter_init(&it, dev->protocol_id, dev->props, dev->prop_count);
+    while ((drv = dc_bind_iter_next(&it)) != NULL) {
         if (dc_is_bindable(drv, dev->protocol_id,
                            dev->props, dev->prop_count, true)) {
             log(INFO, "devcoord: drv='%s' bindable to dev='%s'\n",
@@ -1277,6 +1362,7 @@ static void dc_handle_new_device(device_t* dev) {
             }
         }
     }
+    bind_time += mx_time_get(MX_CLOCK_MONOTONIC) - start;
 }
 
 // device binding program that pure (parentless)
@@ -1327,8 +1413,10 @@ void dc_driver_added(driver_t* drv, const char* version) {
         // debugging / development hack
         // prioritize drivers with version "!..." over others
         list_add_head(&list_drivers, &drv->node);
+        dc_bind_index_add(drv, true);
     } else {
         list_add_tail(&list_drivers, &drv->node);
+        dc_bind_index_add(drv, false);
     }
 }
 
@@ -1384,6 +1472,8 @@ void dc_bind_driver(driver_t* drv) {
                (platform_device.hrsrc != MX_HANDLE_INVALID)) {
         dc_attempt_bind(drv, &platform_device);
     } else if (dc_running) {
+        mx_time_t start = mx_time_get(MX_CLOCK_MONOTONIC);
+        bind_new_drivers++;
         device_t* dev;
         list_for_every_entry(&list_devices, dev, device_t, anode) {
             if (dev->flags & (DEV_CTX_BOUND | DEV_CTX_DEAD | DEV_CTX_ZOMBIE)) {
@@ -1398,6 +1488,7 @@ void dc_bind_driver(driver_t* drv) {
                 dc_attempt_bind(drv, dev);
             }
         }
+        bind_time += mx_time_get(MX_CLOCK_MONOTONIC) - start;
     }
 }
 
@@ -1405,6 +1496,7 @@ void dc_handle_new_driver(void) {
     driver_t* drv;
     while ((drv = list_remove_head_type(&list_drivers_new, driver_t, node)) != NULL) {
         list_add_tail(&list_drivers, &drv->node);
+        dc_bind_index_add(drv, false);
         dc_bind_driver(drv);
     }
 }
@@ -1439,6 +1531,7 @@ void load_system_drivers(void) {
 
 void coordinator(void) {
     log(INFO, "devmgr: coordinator()\n");
+    dc_start_time = mx_time_get(MX_CLOCK_MONOTONIC);
 
     if (getenv("devmgr.verbose")) {
         log_flags |= LOG_DEVLC;
@@ -8,12 +8,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
 #include "devcoordinator.h"
 
 #include <driver-info/driver-info.h>
 
 #include <magenta/driver/binding.h>
+#include <magenta/driver/manifest.h>
 
 static bool is_driver_disabled(const char* name) {
     // driver.<driver_name>.disable
@@ -68,11 +70,88 @@ static void found_driver(magenta_driver_note_payload_t* note,
     dc_driver_added(drv, note->version);
 }
 
+// The drivers described by a directory's driver manifest.
+typedef struct {
+    const char* filename;
+    magenta_driver_note_payload_t* note;
+    const mx_bind_inst_t* binding;
+} manifest_entry_t;
+
+typedef struct {
+    void* data;
+    manifest_entry_t* entries;
+    size_t count;
+} manifest_t;
+
+static void found_manifest_entry(const char* filename,
+                                 magenta_driver_note_payload_t* note,
+                                 const mx_bind_inst_t* binding, void* cookie) {
+    manifest_t* manifest = cookie;
+    manifest_entry_t* entry = &manifest->entries[manifest->count++];
+    entry->filename = filename;
+    entry->note = note;
+    entry->binding = binding;
+}
+
+// Reads the whole manifest in one go.  On failure, |manifest| is left
+// empty and every driver in the directory is examined individually.
+static void read_manifest(int dirfd, const char* path, manifest_t* manifest) {
+    memset(manifest, 0, sizeof(*manifest));
+    int fd;
+    if ((fd = openat(dirfd, DRIVER_MANIFEST_NAME, O_RDONLY)) < 0) {
+        return;
+    }
+    struct stat st;
+    if ((fstat(fd, &st) < 0) || (st.st_size < (off_t)sizeof(driver_manifest_header_t))) {
+        close(fd);
+        return;
+    }
+    void* data = malloc(st.st_size);
+    if ((data == NULL) || (read(fd, data, st.st_size) != st.st_size)) {
+        free(data);
+        close(fd);
+        return;
+    }
+    close(fd);
+
+    const driver_manifest_header_t* hdr = data;
+    // Each record holds at least a driver_manifest_record_t.
+    if (hdr->count > (st.st_size / sizeof(driver_manifest_record_t))) {
+        free(data);
+        return;
+    }
+    manifest->entries = calloc(hdr->count, sizeof(manifest_entry_t));
+    if ((manifest->entries == NULL) ||
+        (di_read_driver_manifest(data, st.st_size, manifest, found_manifest_entry) < 0)) {
+        printf("devcoord: ignoring bad driver manifest in '%s'\n", path);
+        free(manifest->entries);
+        free(data);
+        memset(manifest, 0, sizeof(*manifest));
+        return;
+    }
+    manifest->data = data;
+}
+
+static manifest_entry_t* find_manifest_entry(manifest_t* manifest, const char* filename) {
+    for (size_t n = 0; n < manifest->count; n++) {
+        if (!strcmp(manifest->entries[n].filename, filename)) {
+            return &manifest->entries[n];
+        }
+    }
+    return NULL;
+}
+
+// Drivers listed in the directory's manifest are added from it directly.
+// Any other driver (one installed after the manifest was built) is opened
+// and its driver note read.
 void find_loadable_drivers(const char* path) {
     DIR* dir = opendir(path);
     if (dir == NULL) {
         return;
     }
+    manifest_t manifest;
+    read_manifest(dirfd(dir), path, &manifest);
+
     struct dirent* de;
     while ((de = readdir(dir)) != NULL) {
         if (de->d_name[0] == '.') {
@@ -80,14 +159,17 @@ void find_loadable_drivers(const char* path) {
         }
 
         char libname[256 + 32];
-        if (de->d_name[0] == '.') {
-            continue;
-        }
         int r = snprintf(libname, sizeof(libname), "%s/%s", path, de->d_name);
         if ((r < 0) || (r >= (int)sizeof(libname))) {
             continue;
         }
 
+        manifest_entry_t* entry = find_manifest_entry(&manifest, de->d_name);
+        if (entry != NULL) {
+            found_driver(entry->note, entry->binding, libname);
+            continue;
+        }
+
         int fd;
         if ((fd = openat(dirfd(dir), de->d_name, O_RDONLY)) < 0) {
             continue;
@@ -104,6 +186,8 @@ void find_loadable_drivers(const char* path) {
         }
     }
     closedir(dir);
+    free(manifest.entries);
+    free(manifest.data);
 }
 
 void load_driver(const char* path) {
@@ -278,7 +278,7 @@ static void setup_bootfs(void) {
             case BOOTDATA_BOOTFS_SYSTEM: {
                 const char* errmsg;
                 mx_handle_t bootfs_vmo;
-                status = decompress_bootdata(mx_vmar_root_self(), vmo,
+                status = decompress_bootdata(mx_vmar_root_self(), MX_HANDLE_INVALID, vmo,
                                              off, bootdata.length + sizeof(bootdata),
                                              &bootfs_vmo, &errmsg);
                 if (status < 0) {
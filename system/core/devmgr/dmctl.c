@@ -63,6 +63,25 @@ static mx_status_t dmctl_ioctl(void* ctx, uint32_t op,
         memcpy(out_buf, &out_channel, sizeof(mx_handle_t));
         *out_actual = sizeof(mx_handle_t);
         return MX_OK;
+    case IOCTL_DMCTL_GET_LOADER_STATS: {
+        if (in_len != 0 || out_buf == NULL || out_len != sizeof(dmctl_loader_stats_t)) {
+            return MX_ERR_INVALID_ARGS;
+        }
+        if (multiloader == NULL) {
+            return MX_ERR_BAD_STATE;
+        }
+        mxio_multiloader_stats_t stats;
+        mx_status_t status = mxio_multiloader_get_stats(multiloader, &stats);
+        if (status < 0) {
+            return status;
+        }
+        dmctl_loader_stats_t* out = out_buf;
+        out->hits = stats.hits;
+        out->misses = stats.misses;
+        out->entries = stats.entries;
+        *out_actual = sizeof(dmctl_loader_stats_t);
+        return MX_OK;
+    }
     case IOCTL_DMCTL_COMMAND:
         if (in_len != sizeof(dmctl_cmd_t)) {
             return MX_ERR_INVALID_ARGS;
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <fs/dentry-cache.h>
 #include <fs/vfs.h>
 #include <mxalloc/new.h>
 #include <mxtl/ref_ptr.h>
@@ -44,6 +45,7 @@ void Dnode::RemoveFromParent() {
 
     // Detach from parent
     if (parent_) {
+        fs::vfs_dcache.Invalidate(parent_->vnode_.get(), name_.get(), NameLen());
         parent_->children_.erase(*this);
         if (IsDirectory()) {
             // '..' no longer references parent.
@@ -81,6 +83,9 @@ void Dnode::AddChild(mxtl::RefPtr<Dnode> parent, mxtl::RefPtr<Dnode> child) {
     MX_DEBUG_ASSERT(child != parent);
     MX_DEBUG_ASSERT(parent->IsDirectory());
 
+    // Children may be added without passing through the VFS (for example,
+    // by bootfs), so forget any cached lookup of this name.
+    fs::vfs_dcache.Invalidate(parent->vnode_.get(), child->name_.get(), child->NameLen());
     child->parent_ = parent;
     child->vnode_->link_count_++;
     if (child->IsDirectory()) {
@@ -67,10 +67,19 @@ public:
 private:
     ssize_t Read(void* data, size_t len, size_t off) final;
     ssize_t Write(const void* data, size_t len, size_t off) final;
+    ssize_t ReadVmo(mx_handle_t vmo, size_t len, size_t off) final;
+    ssize_t WriteVmo(mx_handle_t vmo, size_t len, size_t off) final;
     mx_status_t Truncate(size_t len) final;
     mx_status_t Getattr(vnattr_t* a) final;
     mx_status_t Mmap(int flags, size_t len, size_t* off, mx_handle_t* out) final;
 
+    // Sizes vmo_ for a write of 'len' bytes at 'off', and returns the
+    // length of the file once it is done.
+    mx_status_t PrepareWrite(size_t len, size_t off, size_t* newlen);
+    // Accounts for a write of 'actual' bytes at 'off', prepared by
+    // PrepareWrite(), and returns the result of the write.
+    ssize_t FinishWrite(size_t actual, size_t off, size_t newlen);
+
     mx_handle_t vmo_;
     mx_off_t length_;
 };
@@ -192,6 +201,6 @@ VnodeDir* vfs_create_root(void);
 
 // shared among all memory filesystems
 mx_status_t memfs_create_directory(const char* path, uint32_t flags);
-void memfs_mount(VnodeDir* parent, VnodeDir* subtree) TA_EXCL(vfs_lock);
+void memfs_mount(VnodeDir* parent, VnodeDir* subtree);
 
 __END_CDECLS
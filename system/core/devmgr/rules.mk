@@ -44,6 +44,7 @@ MODULE_STATIC_LIBS := \
     system/ulib/fs \
     system/ulib/mx \
     system/ulib/bootdata \
+    system/ulib/runtime \
     third_party/ulib/lz4 \
     system/ulib/mxalloc \
     system/ulib/mxcpp \
@@ -62,9 +62,11 @@ static mx_status_t add_file(mxtl::RefPtr<VnodeDir> vnb, const char* path, mx_han
 // be exposed to C:
 
 mx_status_t bootfs_add_file(const char* path, mx_handle_t vmo, mx_off_t off, size_t len) {
+    fs::ExclusiveLock lock(&fs::vfs_namespace_lock);
     return add_file(BootfsRoot(), path, vmo, off, len);
 }
 
 mx_status_t systemfs_add_file(const char* path, mx_handle_t vmo, mx_off_t off, size_t len) {
+    fs::ExclusiveLock lock(&fs::vfs_namespace_lock);
     return add_file(SystemfsRoot(), path, vmo, off, len);
 }
@@ -169,7 +169,7 @@ ssize_t VnodeVmo::Read(void* data, size_t len, size_t off) {
     return len;
 }
 
-ssize_t VnodeFile::Write(const void* data, size_t len, size_t off) {
+mx_status_t VnodeFile::PrepareWrite(size_t len, size_t off, size_t* newlen_out) {
     mx_status_t status;
     size_t newlen = off + len;
     newlen = newlen > kMemfsMaxFileSize ? kMemfsMaxFileSize : newlen;
@@ -187,12 +187,11 @@ ssize_t VnodeFile::Write(const void* data, size_t len, size_t off) {
             return status;
         }
     }
+    *newlen_out = newlen;
+    return MX_OK;
+}
 
-    size_t actual;
-    if ((status = mx_vmo_write(vmo_, data, off, len, &actual)) != MX_OK) {
-        return status;
-    }
-
+ssize_t VnodeFile::FinishWrite(size_t actual, size_t off, size_t newlen) {
     if (newlen > length_) {
         length_ = newlen;
     }
@@ -204,6 +203,53 @@ ssize_t VnodeFile::Write(const void* data, size_t len, size_t off) {
     return actual;
 }
 
+ssize_t VnodeFile::Write(const void* data, size_t len, size_t off) {
+    mx_status_t status;
+    size_t newlen;
+    if ((status = PrepareWrite(len, off, &newlen)) != MX_OK) {
+        return status;
+    }
+
+    size_t actual;
+    if ((status = mx_vmo_write(vmo_, data, off, len, &actual)) != MX_OK) {
+        return status;
+    }
+    return FinishWrite(actual, off, newlen);
+}
+
+// READ_VMO and WRITE_VMO copy straight between the file's VMO and the
+// client's, rather than through a buffer.
+ssize_t VnodeFile::ReadVmo(mx_handle_t vmo, size_t len, size_t off) {
+    if ((off >= length_) || (vmo_ == MX_HANDLE_INVALID)) {
+        return 0;
+    }
+    if (len > length_ - off) {
+        len = length_ - off;
+    }
+
+    size_t actual;
+    mx_status_t status;
+    if ((status = fs::vfs_vmo_copy(vmo_, off, vmo, len, true, &actual)) != MX_OK) {
+        return status;
+    }
+    return actual;
+}
+
+ssize_t VnodeFile::WriteVmo(mx_handle_t vmo, size_t len, size_t off) {
+    mx_status_t status;
+    size_t newlen;
+    if ((status = PrepareWrite(len, off, &newlen)) != MX_OK) {
+        return status;
+    }
+
+    // The file may not grow past kMemfsMaxFileSize.
+    len = (off < newlen) ? mxtl::min(len, newlen - off) : 0;
+    size_t actual;
+    if ((status = fs::vfs_vmo_copy(vmo_, off, vmo, len, false, &actual)) != MX_OK) {
+        return status;
+    }
+    return FinishWrite(actual, off, newlen);
+}
 
 mx_status_t VnodeFile::Mmap(int flags, size_t len, size_t* off, mx_handle_t* out) {
     if (vmo_ == MX_HANDLE_INVALID) {
@@ -585,7 +631,6 @@ ssize_t VnodeDir::Ioctl(uint32_t op, const void* in_buf, size_t in_len,
             return status;
         }
 
-        mxtl::AutoLock lock(&vfs_lock);
         bool vmofile = false;
         return CreateFromVmo(vmofile, name, namelen, config->vmo, 0, size);
     }
@@ -621,7 +666,8 @@ static mx_status_t memfs_create_fs(const char* name, mxtl::RefPtr<VnodeDir>* out
     return MX_OK;
 }
 
-static void memfs_mount_locked(mxtl::RefPtr<VnodeDir> parent, mxtl::RefPtr<VnodeDir> subtree) TA_REQ(vfs_lock) {
+static void memfs_mount_locked(mxtl::RefPtr<VnodeDir> parent, mxtl::RefPtr<VnodeDir> subtree)
+    TA_REQ(fs::vfs_namespace_lock) {
     Dnode::AddChild(parent->dnode_, subtree->dnode_);
 }
 
@@ -689,6 +735,7 @@ mx_status_t VnodeDir::AttachVnode(mxtl::RefPtr<VnodeMemfs> vn, const char* name,
 
 // postcondition: new vnode linked into namespace
 mx_status_t memfs_create_directory(const char* path, uint32_t flags) {
+    fs::ExclusiveLock lock(&fs::vfs_namespace_lock);
     mx_status_t r;
     const char* pathout;
     mxtl::RefPtr<fs::Vnode> parent_vn;
@@ -755,6 +802,7 @@ mxtl::RefPtr<memfs::VnodeDir> BootfsRoot() {
 }
 
 mx_status_t devfs_mount(mx_handle_t h) {
+    fs::ExclusiveLock lock(&fs::vfs_namespace_lock);
     return DevfsRoot()->AttachRemote(h);
 }
 
@@ -783,6 +831,6 @@ VnodeDir* vfs_create_global_root() {
 }
 
 void memfs_mount(memfs::VnodeDir* parent, memfs::VnodeDir* subtree) {
-    mxtl::AutoLock lock(&vfs_lock);
+    fs::ExclusiveLock lock(&fs::vfs_namespace_lock);
     memfs_mount_locked(mxtl::RefPtr<VnodeDir>(parent), mxtl::RefPtr<VnodeDir>(subtree));
 }
@@ -8,7 +8,7 @@
 #include <string.h>
 #include <threads.h>
 
-#include <fs/mxio-dispatcher.h>
+#include <fs/vfs-dispatcher.h>
 #include <fs/vfs.h>
 #include <magenta/device/device.h>
 #include <magenta/device/vfs.h>
@@ -33,6 +33,9 @@ namespace memfs {
 
 static VnodeMemfs* global_vfs_root;
 
+// Number of threads serving requests for the in-memory filesystems.
+constexpr uint32_t kPoolSize = 4;
+
 void VnodeDir::Notify(const char* name, size_t len, unsigned event) { watcher_.Notify(name, len, event); }
 mx_status_t VnodeDir::WatchDir(mx_handle_t* out) { return watcher_.WatchDir(out); }
 mx_status_t VnodeDir::WatchDirV2(const vfs_watch_dir_t* cmd) {
@@ -67,7 +70,11 @@ mx_handle_t vfs_create_root_handle(VnodeMemfs* vn) {
 // Initialize the global root VFS node and dispatcher
 void vfs_global_init(VnodeDir* root) {
     memfs::global_vfs_root = root;
-    fs::MxioDispatcher::Create(&memfs::memfs_global_dispatcher);
+    if (fs::VfsDispatcher::Create(mxrio_handler, memfs::kPoolSize,
+                                  &memfs::memfs_global_dispatcher) != MX_OK) {
+        printf("fatal error: could not create memfs dispatcher\n");
+        panic();
+    }
 }
 
 // Return a RIO handle to the global root
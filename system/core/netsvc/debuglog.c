@@ -77,7 +77,7 @@ static void debuglog_send(void) {
             goto done;
         }
     }
-    udp6_send(&pkt, pkt_len, &ip6_ll_all_nodes, DEBUGLOG_PORT, DEBUGLOG_ACK_PORT);
+    udp6_send_more(&pkt, pkt_len, &ip6_ll_all_nodes, DEBUGLOG_PORT, DEBUGLOG_ACK_PORT);
 done:
     debuglog_next_timeout = mx_time_get(MX_CLOCK_MONOTONIC) + MX_MSEC(100);
 }
@@ -102,5 +102,7 @@ void debuglog_recv(void* data, size_t len, bool is_mcast) {
 
 void debuglog_timeout(void) {
     debuglog_send();
+    // not called from udp6_recv(), so nothing else will flush the packet
+    udp6_flush();
 }
 
@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include "netsvc.h"
+#include "netboot_lz4.h"
 
 #include <assert.h>
 #include <errno.h>
@@ -45,6 +46,9 @@ static nbfilecontainer_t nbbootdata;
 // Pointer to the currently active transfer.
 static nbfile* active;
 
+// Whether the active transfer is compressed (NB_SEND_FILE_LZ4).
+static bool active_lz4;
+
 mx_status_t nbfilecontainer_init(size_t size, nbfilecontainer_t* target) {
     mx_status_t st = MX_OK;
 
@@ -128,8 +132,8 @@ void netboot_advertise(const char* nodename) {
     msg->cmd = NB_ADVERTISE;
     msg->arg = NB_VERSION_CURRENT;
 
-    snprintf((char*)msg->data, MAX_ADVERTISE_DATA_LEN, "version=%s;nodename=%s",
-             BOOTLOADER_VERSION, nodename);
+    snprintf((char*)msg->data, MAX_ADVERTISE_DATA_LEN, "version=%s;nodename=%s;lz4streams=%d",
+             BOOTLOADER_VERSION, nodename, NB_LZ4_MAX_STREAMS);
     const size_t data_len = strlen((char*)msg->data) + 1;
     udp6_send(buffer, sizeof(nbmsg) + data_len, &ip6_ll_all_nodes,
               NB_ADVERT_PORT, NB_SERVER_PORT);
@@ -142,7 +146,7 @@ static void nb_open(const char* filename, uint32_t cookie, uint32_t arg,
     m.cookie = cookie;
     m.cmd = NB_ACK;
     m.arg = netfile_open(filename, arg);
-    udp6_send(&m, sizeof(m), saddr, sport, dport);
+    udp6_send_more(&m, sizeof(m), saddr, sport, dport);
 }
 
 static void nb_read(uint32_t cookie, uint32_t arg,
@@ -175,7 +179,7 @@ static void nb_read(uint32_t cookie, uint32_t arg,
         // Ignore bogus read requests -- host will timeout if they're confused
         return;
     }
-    udp6_send(&m, msg_size, saddr, sport, dport);
+    udp6_send_more(&m, msg_size, saddr, sport, dport);
 }
 
 static void nb_write(const char* data, size_t len, uint32_t cookie, uint32_t arg,
@@ -193,7 +197,7 @@ static void nb_write(const char* data, size_t len, uint32_t cookie, uint32_t arg
         blocknum = arg;
     }
     m.cookie = cookie;
-    udp6_send(&m, sizeof(m), saddr, sport, dport);
+    udp6_send_more(&m, sizeof(m), saddr, sport, dport);
 }
 
 static void nb_close(uint32_t cookie,
@@ -203,7 +207,7 @@ static void nb_close(uint32_t cookie,
     m.cookie = cookie;
     m.cmd = NB_ACK;
     m.arg = netfile_close();
-    udp6_send(&m, sizeof(m), saddr, sport, dport);
+    udp6_send_more(&m, sizeof(m), saddr, sport, dport);
 }
 
 static void bootloader_recv(void* data, size_t len,
@@ -242,6 +246,7 @@ static void bootloader_recv(void* data, size_t len,
         msg->data[len - 1] = 0;
         break;
     case NB_SEND_FILE:
+    case NB_SEND_FILE_LZ4:
         xfer_active = true;
         if (len == 0)
             return;
@@ -252,10 +257,13 @@ static void bootloader_recv(void* data, size_t len,
             }
         }
         active = netboot_get_buffer((const char*)msg->data, msg->arg);
+        active_lz4 = (msg->cmd == NB_SEND_FILE_LZ4);
+        nb_lz4_reset();
         if (active) {
             active->offset = 0;
             ack.arg = msg->arg;
-            printf("netboot: Receive File '%s'...\n", (char*) msg->data);
+            printf("netboot: Receive File '%s'%s...\n", (char*) msg->data,
+                   active_lz4 ? " (compressed)" : "");
         } else {
             printf("netboot: Rejected File '%s'...\n", (char*) msg->data);
             ack.cmd = NB_ERROR_BAD_FILE;
@@ -269,6 +277,17 @@ static void bootloader_recv(void* data, size_t len,
             printf("netboot: > received chunk before NB_FILE\n");
             return;
         }
+        if (active_lz4) {
+            do_transmit = nb_lz4_recv(active, msg, len, sport, &ack);
+            if (nb_lz4_done()) {
+                if (active->offset != active->size) {
+                    printf("netboot: compressed transfer ended %zu bytes short\n",
+                           active->size - active->offset);
+                }
+                xfer_active = false;
+            }
+            break;
+        }
         if (msg->arg != active->offset) {
             // printf("netboot: < received chunk at offset %d but current offset is %zu\n", msg->arg, active->offset);
             ack.arg = active->offset;
@@ -306,10 +325,12 @@ static void bootloader_recv(void* data, size_t len,
     ack.magic = NB_MAGIC;
 transmit:
     if (do_transmit) {
-        udp6_send(&ack, sizeof(ack), saddr, sport, NB_SERVER_PORT);
+        udp6_send_more(&ack, sizeof(ack), saddr, sport, NB_SERVER_PORT);
     }
 
     if (do_boot) {
+        // the host is waiting for the ack
+        udp6_flush();
         mx_system_mexec(nbkernel.data, nbbootdata.data);
     }
 }
@@ -343,7 +364,7 @@ void netboot_recv(void *data, size_t len, bool is_mcast,
         msg->cmd = NB_ACK;
         memcpy(buf, msg, sizeof(nbmsg));
         memcpy(buf + sizeof(nbmsg), nodename, dlen);
-        udp6_send(buf, sizeof(nbmsg) + dlen, saddr, sport, dport);
+        udp6_send_more(buf, sizeof(nbmsg) + dlen, saddr, sport, dport);
         break;
     case NB_SHELL_CMD:
         if (!is_mcast) {
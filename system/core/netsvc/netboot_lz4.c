@@ -0,0 +1,189 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "netboot_lz4.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <lz4/lz4frame.h>
+#include <magenta/types.h>
+
+// A stream of a compressed transfer, identified by the host port it is sent
+// from. Frames are decompressed straight into the file as each packet
+// arrives, so a stream only holds on to the little it cannot yet decode.
+typedef struct nbstream {
+    uint16_t port;      // 0 if unused
+    bool done;          // NB_LAST_DATA has been received
+    size_t offset;      // bytes of the stream received
+
+    LZ4F_decompressionContext_t dctx;
+
+    // The header of the next frame, which may be split across packets.
+    nblz4chunk hdr;
+    size_t hdr_len;
+
+    // Where the current frame is being decompressed to, or NULL between
+    // frames.
+    uint8_t* dst;
+    size_t dst_avail;
+    size_t src_avail;
+} nbstream_t;
+
+static nbstream_t streams[NB_LZ4_MAX_STREAMS];
+
+void nb_lz4_reset(void) {
+    for (size_t i = 0; i < NB_LZ4_MAX_STREAMS; i++) {
+        nbstream_t* st = &streams[i];
+        if (st->dctx != NULL) {
+            // A context abandoned mid-frame cannot be reused.
+            LZ4F_freeDecompressionContext(st->dctx);
+        }
+        memset(st, 0, sizeof(*st));
+    }
+}
+
+// Returns the stream sent from |port|, or NULL if there is none. If
+// |create| is set, a new stream is set up for the port if there is room.
+static nbstream_t* nb_stream_get(uint16_t port, bool create) {
+    nbstream_t* unused = NULL;
+    for (size_t i = 0; i < NB_LZ4_MAX_STREAMS; i++) {
+        if (streams[i].port == port) {
+            return &streams[i];
+        }
+        if (streams[i].port == 0 && unused == NULL) {
+            unused = &streams[i];
+        }
+    }
+    if (unused == NULL || !create) {
+        return NULL;
+    }
+    LZ4F_errorCode_t r = LZ4F_createDecompressionContext(&unused->dctx, LZ4F_VERSION);
+    if (LZ4F_isError(r)) {
+        printf("netboot: cannot create lz4 context: %s\n", LZ4F_getErrorName(r));
+        unused->dctx = NULL;
+        return NULL;
+    }
+    unused->port = port;
+    return unused;
+}
+
+// Decompresses the next |len| bytes of the stream into |file|.
+static mx_status_t nb_stream_write(nbstream_t* st, nbfile* file, const uint8_t* data, size_t len) {
+    while (len > 0) {
+        if (st->dst == NULL) {
+            size_t n = sizeof(st->hdr) - st->hdr_len;
+            if (n > len) {
+                n = len;
+            }
+            memcpy((uint8_t*)&st->hdr + st->hdr_len, data, n);
+            st->hdr_len += n;
+            data += n;
+            len -= n;
+            if (st->hdr_len < sizeof(st->hdr)) {
+                break;
+            }
+            st->hdr_len = 0;
+
+            size_t start = (size_t)st->hdr.index * NB_LZ4_CHUNK_SIZE;
+            if (start >= file->size || st->hdr.size == 0) {
+                printf("netboot: bad chunk %u (%u bytes)\n", st->hdr.index, st->hdr.size);
+                return MX_ERR_OUT_OF_RANGE;
+            }
+            st->dst = file->data + start;
+            st->dst_avail = file->size - start;
+            if (st->dst_avail > NB_LZ4_CHUNK_SIZE) {
+                st->dst_avail = NB_LZ4_CHUNK_SIZE;
+            }
+            st->src_avail = st->hdr.size;
+            continue;
+        }
+
+        // Only hand the decoder the frame itself: it expects to be called
+        // again with whatever it leaves unconsumed.
+        size_t out = st->dst_avail;
+        size_t in = len < st->src_avail ? len : st->src_avail;
+        size_t r = LZ4F_decompress(st->dctx, st->dst, &out, data, &in, NULL);
+        if (LZ4F_isError(r)) {
+            printf("netboot: lz4 decompression failed: %s\n", LZ4F_getErrorName(r));
+            return MX_ERR_IO_DATA_INTEGRITY;
+        }
+        st->dst += out;
+        st->dst_avail -= out;
+        file->offset += out;
+        data += in;
+        len -= in;
+        st->src_avail -= in;
+        if (r == 0) {
+            // End of frame
+            if (st->src_avail != 0) {
+                return MX_ERR_IO_DATA_INTEGRITY;
+            }
+            st->dst = NULL;
+        } else if (st->src_avail == 0 || (in == 0 && out == 0)) {
+            // The frame is truncated, or decompresses to more than its chunk.
+            printf("netboot: bad lz4 frame for chunk %u\n", st->hdr.index);
+            return MX_ERR_IO_DATA_INTEGRITY;
+        }
+    }
+    return MX_OK;
+}
+
+bool nb_lz4_recv(nbfile* file, const nbmsg* msg, size_t len, uint16_t sport, nbmsg* ack) {
+    nbstream_t* st = nb_stream_get(sport, msg->arg == 0);
+    if (st == NULL) {
+        if (msg->arg != 0) {
+            // The start of the stream was lost: have the host rewind, as
+            // for any other missing packet.
+            ack->cmd = NB_ACK;
+            ack->arg = 0;
+        } else {
+            ack->cmd = NB_ERROR_BAD_PARAM;
+            ack->arg = msg->arg;
+        }
+        return true;
+    }
+    if (st->done) {
+        ack->cmd = NB_FILE_RECEIVED;
+        ack->arg = msg->arg;
+        return true;
+    }
+    if (msg->arg != st->offset) {
+        ack->cmd = NB_ACK;
+        ack->arg = st->offset;
+        return true;
+    }
+    if (nb_stream_write(st, file, msg->data, len) != MX_OK) {
+        ack->cmd = NB_ERROR;
+        ack->arg = msg->arg;
+        return true;
+    }
+    st->offset += len;
+    if (msg->cmd != NB_LAST_DATA) {
+        return false;
+    }
+    if (st->dst != NULL || st->hdr_len != 0) {
+        printf("netboot: stream ends part way through a frame\n");
+        ack->cmd = NB_ERROR;
+        ack->arg = msg->arg;
+        return true;
+    }
+    st->done = true;
+    ack->cmd = NB_FILE_RECEIVED;
+    ack->arg = msg->arg;
+    return true;
+}
+
+bool nb_lz4_done(void) {
+    bool seen = false;
+    for (size_t i = 0; i < NB_LZ4_MAX_STREAMS; i++) {
+        if (streams[i].port != 0) {
+            if (!streams[i].done) {
+                return false;
+            }
+            seen = true;
+        }
+    }
+    return seen;
+}
@@ -0,0 +1,25 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <magenta/boot/netboot.h>
+
+// Reassembly of compressed (NB_SEND_FILE_LZ4) transfers. This has no
+// dependencies on the rest of netsvc, so that it can also be built into the
+// host-side protocol test.
+
+// Forgets the streams of any previous transfer.
+void nb_lz4_reset(void);
+
+// Handles NB_DATA and NB_LAST_DATA sent from |sport| for a compressed
+// transfer into |file|, and returns whether |ack| should be sent.
+bool nb_lz4_recv(nbfile* file, const nbmsg* msg, size_t len, uint16_t sport, nbmsg* ack);
+
+// Returns whether every stream seen so far has received all of its data.
+bool nb_lz4_done(void);
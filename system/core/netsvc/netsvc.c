@@ -62,6 +62,8 @@ static void run_server(const char* progname, const char* bin, mx_handle_t h) {
 
 const char* nodename = "magenta";
 
+// Replies are sent with udp6_send_more(): netifc_poll() flushes them
+// together once it has handled the packets it received.
 void udp6_recv(void* data, size_t len,
                const ip6_addr_t* daddr, uint16_t dport,
                const ip6_addr_t* saddr, uint16_t sport) {
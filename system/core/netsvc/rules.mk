@@ -13,6 +13,7 @@ MODULE_TYPE := userapp
 MODULE_SRCS += \
     $(LOCAL_DIR)/netsvc.c \
     $(LOCAL_DIR)/netboot.c \
+    $(LOCAL_DIR)/netboot_lz4.c \
     $(LOCAL_DIR)/netfile.c \
     $(LOCAL_DIR)/device_id.c \
     $(LOCAL_DIR)/tftp.c \
@@ -20,6 +21,11 @@ MODULE_SRCS += \
 
 MODULE_STATIC_LIBS := system/ulib/inet6 system/ulib/tftp
 
-MODULE_LIBS := system/ulib/mxio system/ulib/launchpad system/ulib/magenta system/ulib/c
+MODULE_LIBS := \
+    system/ulib/mxio \
+    system/ulib/launchpad \
+    third_party/ulib/lz4 \
+    system/ulib/magenta \
+    system/ulib/c
 
 include make/module.mk
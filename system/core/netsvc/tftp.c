@@ -111,6 +111,10 @@ void tftp_recv(void* data, size_t len,
                                         file_read, file_write, file_close};
         tftp_session_set_file_interface(session, &file_ifc);
 
+        // Each DATA message (4 byte header and a block) must fit in a single
+        // frame, so ask the sender for smaller blocks if need be.
+        tftp_session_set_max_block_size(session, UDP6_MAX_PAYLOAD - 4);
+
         // Initialize transport interface
         memcpy(&transport_info.dest_addr, saddr, sizeof(ip6_addr_t));
         transport_info.dest_port = sport;
@@ -8,7 +8,7 @@
 
 #include <magenta/types.h>
 
-mx_handle_t bootdata_get_bootfs(mx_handle_t log, mx_handle_t vmar_self,
-                                mx_handle_t bootdata_vmo);
+mx_handle_t bootdata_get_bootfs(mx_handle_t log, mx_handle_t proc_self,
+                                mx_handle_t vmar_self, mx_handle_t bootdata_vmo);
 
 #pragma GCC visibility pop
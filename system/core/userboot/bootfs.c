@@ -7,36 +7,14 @@
 
 #pragma GCC visibility push(hidden)
 
+#include <limits.h>
 #include <magenta/boot/bootdata.h>
 #include <magenta/syscalls.h>
+#include <stdbool.h>
 #include <string.h>
 
 #pragma GCC visibility pop
 
-void bootfs_mount(mx_handle_t vmar, mx_handle_t log, mx_handle_t vmo, struct bootfs *fs) {
-    uint64_t size;
-    mx_status_t status = mx_vmo_get_size(vmo, &size);
-    check(log, status, "mx_vmo_get_size failed on bootfs vmo\n");
-    uintptr_t addr = 0;
-    status = mx_vmar_map(vmar, 0, vmo, 0, size, MX_VM_FLAG_PERM_READ, &addr);
-    check(log, status, "mx_vmar_map failed on bootfs vmo\n");
-    fs->contents = (const void*)addr;
-    fs->len = size;
-    status = mx_handle_duplicate(
-        vmo,
-        MX_RIGHT_READ | MX_RIGHT_EXECUTE | MX_RIGHT_MAP |
-        MX_RIGHT_TRANSFER | MX_RIGHT_DUPLICATE | MX_RIGHT_GET_PROPERTY,
-        &fs->vmo);
-    check(log, status, "mx_handle_duplicate failed on bootfs VMO handle\n");
-}
-
-void bootfs_unmount(mx_handle_t vmar, mx_handle_t log, struct bootfs *fs) {
-    mx_status_t status = mx_vmar_unmap(vmar, (uintptr_t)fs->contents, fs->len);
-    check(log, status, "mx_vmar_unmap failed\n");
-    status = mx_handle_close(fs->vmo);
-    check(log, status, "mx_handle_close failed\n");
-}
-
 struct bootfs_magic {
     bootdata_t boothdr;
     char fsmagic[16];
@@ -51,25 +29,30 @@ struct bootfs_header {
     struct bootfs_file file;
 };
 
-static struct bootfs_file bootfs_search(mx_handle_t log,
-                                        struct bootfs *fs,
-                                        const char* filename) {
+// Returns the offset of the first directory entry.
+static size_t bootfs_dir_start(mx_handle_t log, struct bootfs *fs) {
     static const char FSMAGIC[16] = "[BOOTFS]\0\0\0\0\0\0\0\0";
-    size_t magic_size = sizeof(bootdata_t);
     if (fs->len < sizeof(struct bootfs_magic))
         fail(log, MX_ERR_INVALID_ARGS, "bootfs image too small!\n");
     struct bootfs_magic* magic = (struct bootfs_magic*)fs->contents;
     if (magic->boothdr.type != BOOTDATA_BOOTFS_BOOT)
         fail(log, MX_ERR_INVALID_ARGS, "bootdata is not a bootfs!\n");
     // This field is obsolete, so we can skip it if it doesn't exist.
-    if (!memcmp(magic->fsmagic, FSMAGIC, sizeof(FSMAGIC))) {
-        magic_size = sizeof(struct bootfs_magic);
-    }
-    const uint8_t* p = &fs->contents[magic_size];
-
-    size_t filename_len = strlen(filename) + 1;
+    if (!memcmp(magic->fsmagic, FSMAGIC, sizeof(FSMAGIC)))
+        return sizeof(struct bootfs_magic);
+    return sizeof(bootdata_t);
+}
 
+// Calls func on each directory entry, stopping if it returns true.
+// Returns the number of entries visited.
+static size_t bootfs_walk(mx_handle_t log, struct bootfs *fs,
+                          bool (*func)(struct bootfs *fs, size_t n,
+                                       const uint8_t* entry, void* cookie),
+                          void* cookie) {
+    const uint8_t* p = &fs->contents[bootfs_dir_start(log, fs)];
+    size_t n = 0;
     while ((size_t)(p - fs->contents) < fs->len) {
+        const uint8_t* entry = p;
         struct bootfs_header header;
         memcpy(&header, p, sizeof(header));
         p += sizeof(header);
@@ -81,16 +64,136 @@ static struct bootfs_file bootfs_search(mx_handle_t log,
         if (header.namelen > left)
             fail(log, MX_ERR_INVALID_ARGS,
                  "bootfs has bogus namelen in header\n");
-
-        const char* name = (const void*)p;
         p += header.namelen;
 
-        if (!memcmp(name, filename, filename_len))
-            return header.file;
+        if (func != NULL && func(fs, n, entry, cookie))
+            break;
+        n++;
     }
+    return n;
+}
+
+static bool index_entry(struct bootfs *fs, size_t n,
+                        const uint8_t* entry, void* cookie) {
+    uint32_t* index = cookie;
+    index[n] = entry - fs->contents;
+    return false;
+}
 
-    struct bootfs_file runt = { 0, 0 };
-    return runt;
+// For a sorted bootfs, make a table of the directory entries, so that
+// files may be found by binary search rather than by a scan of the
+// whole directory.
+static void bootfs_index(mx_handle_t vmar, mx_handle_t log, struct bootfs *fs) {
+    struct bootfs_magic* magic = (struct bootfs_magic*)fs->contents;
+    if (!(magic->boothdr.flags & BOOTDATA_BOOTFS_FLAG_SORTED))
+        return;
+
+    size_t count = bootfs_walk(log, fs, NULL, NULL);
+    if (count == 0)
+        return;
+    size_t size = (count * sizeof(uint32_t) + PAGE_SIZE - 1) & -PAGE_SIZE;
+    mx_handle_t vmo;
+    mx_status_t status = mx_vmo_create(size, 0, &vmo);
+    check(log, status, "mx_vmo_create failed for bootfs index\n");
+    uintptr_t addr = 0;
+    status = mx_vmar_map(vmar, 0, vmo, 0, size,
+                         MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE, &addr);
+    check(log, status, "mx_vmar_map failed for bootfs index\n");
+    mx_handle_close(vmo);
+
+    bootfs_walk(log, fs, index_entry, (void*)addr);
+    fs->index = (const uint32_t*)addr;
+    fs->index_count = count;
+    fs->index_addr = addr;
+    fs->index_size = size;
+}
+
+void bootfs_mount(mx_handle_t vmar, mx_handle_t log, mx_handle_t vmo, struct bootfs *fs) {
+    uint64_t size;
+    mx_status_t status = mx_vmo_get_size(vmo, &size);
+    check(log, status, "mx_vmo_get_size failed on bootfs vmo\n");
+    uintptr_t addr = 0;
+    status = mx_vmar_map(vmar, 0, vmo, 0, size, MX_VM_FLAG_PERM_READ, &addr);
+    check(log, status, "mx_vmar_map failed on bootfs vmo\n");
+    fs->contents = (const void*)addr;
+    fs->len = size;
+    status = mx_handle_duplicate(
+        vmo,
+        MX_RIGHT_READ | MX_RIGHT_EXECUTE | MX_RIGHT_MAP |
+        MX_RIGHT_TRANSFER | MX_RIGHT_DUPLICATE | MX_RIGHT_GET_PROPERTY,
+        &fs->vmo);
+    check(log, status, "mx_handle_duplicate failed on bootfs VMO handle\n");
+    fs->index = NULL;
+    fs->index_count = 0;
+    bootfs_index(vmar, log, fs);
+}
+
+void bootfs_unmount(mx_handle_t vmar, mx_handle_t log, struct bootfs *fs) {
+    mx_status_t status = mx_vmar_unmap(vmar, (uintptr_t)fs->contents, fs->len);
+    check(log, status, "mx_vmar_unmap failed\n");
+    if (fs->index != NULL) {
+        status = mx_vmar_unmap(vmar, fs->index_addr, fs->index_size);
+        check(log, status, "mx_vmar_unmap failed\n");
+    }
+    status = mx_handle_close(fs->vmo);
+    check(log, status, "mx_handle_close failed\n");
+}
+
+struct search {
+    const char* filename;
+    size_t filename_len;
+    struct bootfs_file file;
+};
+
+static bool match_entry(struct bootfs *fs, size_t n,
+                        const uint8_t* entry, void* cookie) {
+    struct search* search = cookie;
+    struct bootfs_header header;
+    memcpy(&header, entry, sizeof(header));
+    const char* name = (const void*)(entry + sizeof(header));
+    if (header.namelen == search->filename_len &&
+        !memcmp(name, search->filename, search->filename_len)) {
+        search->file = header.file;
+        return true;
+    }
+    return false;
+}
+
+static struct bootfs_file bootfs_search(mx_handle_t log,
+                                        struct bootfs *fs,
+                                        const char* filename) {
+    struct search search = {
+        .filename = filename,
+        .filename_len = strlen(filename) + 1,
+        .file = { 0, 0 },
+    };
+
+    if (fs->index == NULL) {
+        bootfs_walk(log, fs, match_entry, &search);
+        return search.file;
+    }
+
+    // Find the first entry not less than filename.  Entries were
+    // validated as the index was built.
+    size_t lo = 0, hi = fs->index_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const uint8_t* entry = &fs->contents[fs->index[mid]];
+        struct bootfs_header header;
+        memcpy(&header, entry, sizeof(header));
+        size_t len = header.namelen < search.filename_len ?
+            header.namelen : search.filename_len;
+        // Names include their '\0', so comparing the shorter length
+        // orders a name before the names it is a prefix of.
+        if (memcmp(entry + sizeof(header), filename, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < fs->index_count)
+        match_entry(fs, lo, &fs->contents[fs->index[lo]], &search);
+    return search.file;
 }
 
 mx_handle_t bootfs_open(mx_handle_t log, const char* purpose,
@@ -14,6 +14,12 @@ struct bootfs {
     mx_handle_t vmo;
     const uint8_t* contents;
     size_t len;
+    // For a sorted bootfs, the offset of each directory entry in
+    // contents, mapped at index_addr.  Otherwise, NULL.
+    const uint32_t* index;
+    size_t index_count;
+    uintptr_t index_addr;
+    size_t index_size;
 };
 
 void bootfs_mount(mx_handle_t vmar, mx_handle_t log, mx_handle_t vmo, struct bootfs *fs);
@@ -46,6 +46,7 @@
 #define AHCI_PORT_FLAG_IMPLEMENTED (1 << 0)
 #define AHCI_PORT_FLAG_PRESENT     (1 << 1)
 #define AHCI_PORT_FLAG_SYNC_PAUSED (1 << 2) // port is paused until pending xfers are done
+#define AHCI_PORT_FLAG_EXCLUSIVE   (1 << 3) // a non-queued command is running
 //clang-format on
 
 typedef struct ahci_port {
@@ -174,8 +175,15 @@ static void ahci_port_reset(ahci_port_t* port) {
     ahci_write(&port->regs->serr, ahci_read(&port->regs->serr));
 }
 
-static bool ahci_port_cmd_busy(ahci_port_t* port, int slot) {
-    return ((ahci_read(&port->regs->sact) | ahci_read(&port->regs->ci)) & (1 << slot)) || (port->commands[slot] != NULL) || (port->running & (1 << slot));
+// Returns a free command slot no greater than 'max', or -1 if there is none.
+// A slot is free once the hardware is done with it as well as the driver,
+// since the watchdog may abandon a slot the hardware still owns.
+static int ahci_port_free_slot(ahci_device_t* dev, ahci_port_t* port, int max) {
+    max = MIN(max, (int)((dev->cap >> 8) & 0x1f));
+    uint32_t mask = (max == AHCI_MAX_COMMANDS - 1) ? 0xffffffff : ((1u << (max + 1)) - 1);
+    uint32_t busy = port->running | ahci_read(&port->regs->sact) | ahci_read(&port->regs->ci);
+    uint32_t free = ~busy & mask;
+    return free ? __builtin_ctz(free) : -1;
 }
 
 static bool cmd_is_read(uint8_t cmd) {
@@ -202,13 +210,22 @@ static bool cmd_is_queued(uint8_t cmd) {
     return (cmd == SATA_CMD_READ_FPDMA_QUEUED) || (cmd == SATA_CMD_WRITE_FPDMA_QUEUED);
 }
 
+// Reads and writes are issued as NCQ commands if both the HBA and the device
+// support it (the sata layer sets max_cmd to 0 for devices which don't).
+static bool ahci_txn_is_queued(ahci_device_t* dev, sata_pdata_t* pdata) {
+    if (!(dev->cap & AHCI_CAP_NCQ) || (pdata->max_cmd == 0)) {
+        return false;
+    }
+    return (pdata->cmd == SATA_CMD_READ_DMA_EXT) || (pdata->cmd == SATA_CMD_WRITE_DMA_EXT) ||
+           cmd_is_queued(pdata->cmd);
+}
+
 static void ahci_port_complete_txn(ahci_device_t* dev, ahci_port_t* port, mx_status_t status) {
     mtx_lock(&port->lock);
-    uint32_t sact = ahci_read(&port->regs->sact);
-    uint32_t running = port->running;
-    uint32_t done = sact ^ running;
-    // assert if a channel without an outstanding transaction is active
-    MX_DEBUG_ASSERT(!(done & sact));
+    // Queued commands are done once their bit in SACT clears; others once
+    // their bit in CI clears. Reap every finished slot at once.
+    uint32_t active = ahci_read(&port->regs->sact) | ahci_read(&port->regs->ci);
+    uint32_t done = port->running & ~active;
     port->completed |= done;
     mtx_unlock(&port->lock);
     // hit the worker thread to complete commands
@@ -217,7 +234,7 @@ static void ahci_port_complete_txn(ahci_device_t* dev, ahci_port_t* port, mx_sta
 
 static mx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot, iotxn_t* txn) {
     assert(slot < AHCI_MAX_COMMANDS);
-    assert(!ahci_port_cmd_busy(port, slot));
+    assert(!(port->running & (1u << slot)));
 
     sata_pdata_t* pdata = sata_iotxn_pdata(txn);
     mx_status_t status = iotxn_physmap(txn);
@@ -229,7 +246,7 @@ static mx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
     iotxn_phys_iter_t iter;
     iotxn_phys_iter_init(&iter, txn, AHCI_PRD_MAX_SIZE);
 
-    if (dev->cap & AHCI_CAP_NCQ) {
+    if (ahci_txn_is_queued(dev, pdata)) {
         if (pdata->cmd == SATA_CMD_READ_DMA_EXT) {
             pdata->cmd = SATA_CMD_READ_FPDMA_QUEUED;
         } else if (pdata->cmd == SATA_CMD_WRITE_DMA_EXT) {
@@ -317,7 +334,6 @@ static mx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
     // set the watchdog
     // TODO: general timeout mechanism
     pdata->timeout = mx_time_get(MX_CLOCK_MONOTONIC) + MX_SEC(1);
-    completion_signal(&dev->watchdog_completion);
     return MX_OK;
 }
 
@@ -451,74 +467,91 @@ static int ahci_worker_thread(void* arg) {
     ahci_device_t* dev = (ahci_device_t*)arg;
     ahci_port_t* port;
     iotxn_t* txn;
+    iotxn_t* done[AHCI_MAX_COMMANDS];
     for (;;) {
+        // reset before scanning the ports, so that no wakeup is lost
+        completion_reset(&dev->worker_completion);
+        bool issued = false;
         // iterate all the ports and run or complete commands
         for (int i = 0; i < AHCI_MAX_PORTS; i++) {
             port = &dev->ports[i];
+            size_t done_count = 0;
             mtx_lock(&port->lock);
             if (!(port->flags & (AHCI_PORT_FLAG_IMPLEMENTED | AHCI_PORT_FLAG_PRESENT))) {
                 goto next;
             }
 
-            // complete commands first
+            // reap every completed command, freeing their slots
             while (port->completed) {
                 unsigned slot = 32 - __builtin_clz(port->completed) - 1;
                 txn = port->commands[slot];
                 if (txn == NULL) {
                     xprintf("ahci.%d: illegal state, completing slot %d but txn == NULL\n", port->nr, slot);
                 } else {
-                    mtx_unlock(&port->lock);
-                    iotxn_complete(txn, MX_OK, txn->length);
-                    mtx_lock(&port->lock);
+                    done[done_count++] = txn;
                 }
                 port->completed &= ~(1 << slot);
                 port->running &= ~(1 << slot);
                 port->commands[slot] = NULL;
-                // resume the port if paused for sync and no outstanding transactions
-                if ((port->flags & AHCI_PORT_FLAG_SYNC_PAUSED) && !port->running) {
-                    port->flags &= ~AHCI_PORT_FLAG_SYNC_PAUSED;
-                }
             }
-
-            if (port->flags & AHCI_PORT_FLAG_SYNC_PAUSED) {
-                goto next;
+            // resume the port if paused for sync and no outstanding transactions
+            if (!port->running) {
+                port->flags &= ~(AHCI_PORT_FLAG_SYNC_PAUSED | AHCI_PORT_FLAG_EXCLUSIVE);
             }
 
-            txn = list_peek_head_type(&port->txn_list, iotxn_t, node);
-            if (!txn) {
-                goto next;
-            }
+            // fill as many command slots as possible
+            while (!(port->flags & AHCI_PORT_FLAG_SYNC_PAUSED)) {
+                txn = list_peek_head_type(&port->txn_list, iotxn_t, node);
+                if (!txn) {
+                    break;
+                }
 
-            // if IOTXN_SYNC_BEFORE, pause the port if there are transactions in flight
-            if ((txn->flags & IOTXN_SYNC_BEFORE) && port->running) {
-                port->flags |= AHCI_PORT_FLAG_SYNC_PAUSED;
-                goto next;
-            }
+                // if IOTXN_SYNC_BEFORE, pause the port if there are transactions in flight
+                if ((txn->flags & IOTXN_SYNC_BEFORE) && port->running) {
+                    port->flags |= AHCI_PORT_FLAG_SYNC_PAUSED;
+                    break;
+                }
 
-            // find a free command tag
-            sata_pdata_t* pdata = sata_iotxn_pdata(txn);
-            int max = MIN(pdata->max_cmd, (int)((dev->cap >> 8) & 0x1f));
-            int i = 0;
-            for (i = 0; i <= max; i++) {
-                if (!ahci_port_cmd_busy(port, i)) break;
-            }
-            if (i > max) {
-                goto next;
-            }
+                // non-queued commands may not run alongside any other command
+                sata_pdata_t* pdata = sata_iotxn_pdata(txn);
+                bool queued = ahci_txn_is_queued(dev, pdata);
+                if (port->running && (!queued || (port->flags & AHCI_PORT_FLAG_EXCLUSIVE))) {
+                    break;
+                }
+
+                // find a free command tag
+                int slot = ahci_port_free_slot(dev, port, queued ? pdata->max_cmd : 0);
+                if (slot < 0) {
+                    break;
+                }
 
-            list_delete(&txn->node);
-            // if IOTXN_SYNC_AFTER, pause the port until this command is complete
-            if (txn->flags & IOTXN_SYNC_AFTER) {
-                port->flags |= AHCI_PORT_FLAG_SYNC_PAUSED;
+                list_delete(&txn->node);
+                // if IOTXN_SYNC_AFTER, pause the port until this command is complete
+                if (txn->flags & IOTXN_SYNC_AFTER) {
+                    port->flags |= AHCI_PORT_FLAG_SYNC_PAUSED;
+                }
+                // run the command
+                if (ahci_do_txn(dev, port, slot, txn) == MX_OK) {
+                    if (!queued) {
+                        port->flags |= AHCI_PORT_FLAG_EXCLUSIVE;
+                    }
+                    issued = true;
+                }
             }
-            // run the command
-            ahci_do_txn(dev, port, i, txn);
 next:
             mtx_unlock(&port->lock);
+
+            // complete the reaped commands once the freed slots have been refilled
+            for (size_t j = 0; j < done_count; j++) {
+                iotxn_complete(done[j], MX_OK, done[j]->length);
+            }
+        }
+        if (issued) {
+            // arm the watchdog
+            completion_signal(&dev->watchdog_completion);
         }
         // wait here until more commands are queued, or a port becomes idle
         completion_wait(&dev->worker_completion, MX_TIME_INFINITE);
-        completion_reset(&dev->worker_completion);
     }
     return 0;
 }
@@ -15,6 +15,7 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -37,6 +38,11 @@
 #define SATA_FLAG_DMA   (1 << 0)
 #define SATA_FLAG_LBA48 (1 << 1)
 
+// The largest transfer issued as a single command. The PRDT must be able to
+// describe it even when it does not start on a page boundary, and its sector
+// count must fit in the command FIS.
+#define sata_max_xfer(dev) MIN((uint64_t)(AHCI_MAX_PRDS - 1) * PAGE_SIZE, 0xffffull * (dev)->sector_sz)
+
 typedef struct sata_device {
     mx_device_t* mxdev;
     mx_device_t* parent;
@@ -128,8 +134,14 @@ static mx_status_t sata_device_identify(sata_device_t* dev, mx_device_t* control
     } else {
         xprintf(" PIO");
     }
-    dev->max_cmd = *(devinfo + SATA_DEVINFO_QUEUE_DEPTH);
-    xprintf(" %d commands\n", dev->max_cmd + 1);
+    if (*(devinfo + SATA_DEVINFO_SATA_CAP) & (1 << 8)) {
+        // NCQ is supported; the queue depth is 0-based
+        dev->max_cmd = *(devinfo + SATA_DEVINFO_QUEUE_DEPTH) & 0x1f;
+        xprintf(" NCQ %d commands\n", dev->max_cmd + 1);
+    } else {
+        dev->max_cmd = 0;
+        xprintf(" 1 command\n");
+    }
     if (cap & (1 << 9)) {
         dev->sector_sz = 512; // default
         if ((*(devinfo + SATA_DEVINFO_SECTOR_SIZE) & 0xd000) == 0x5000) {
@@ -168,6 +180,13 @@ static void sata_iotxn_queue(void* ctx, iotxn_t* txn) {
     // constrain to device capacity and round down to block aligned
     txn->length = MIN(ROUNDDOWN(txn->length, device->sector_sz), device->capacity - txn->offset);
 
+    // a single command cannot describe more than this; callers are expected
+    // to split larger requests according to max_transfer_size
+    if (txn->length > sata_max_xfer(device)) {
+        iotxn_complete(txn, MX_ERR_INVALID_ARGS, 0);
+        return;
+    }
+
     sata_pdata_t* pdata = sata_iotxn_pdata(txn);
     pdata->cmd = txn->opcode == IOTXN_OP_READ ? SATA_CMD_READ_DMA_EXT : SATA_CMD_WRITE_DMA_EXT;
     pdata->device = 0x40;
@@ -187,7 +206,7 @@ static void sata_get_info(sata_device_t* dev, block_info_t* info) {
     memset(info, 0, sizeof(*info));
     info->block_size = dev->sector_sz;
     info->block_count = dev->capacity / dev->sector_sz;
-    info->max_transfer_size = AHCI_MAX_PRDS * PAGE_SIZE; // fully discontiguous
+    info->max_transfer_size = sata_max_xfer(dev);
 }
 
 static mx_status_t sata_ioctl(void* ctx, uint32_t op, const void* cmd, size_t cmdlen, void* reply,
@@ -267,6 +286,66 @@ static void sata_block_complete(iotxn_t* txn, void* cookie) {
     iotxn_release(txn);
 }
 
+// Tracks a block request which was split into several commands.
+typedef struct sata_split {
+    sata_device_t* dev;
+    void* cookie;
+    atomic_uint pending;
+    atomic_int status;
+} sata_split_t;
+
+static void sata_split_put(sata_split_t* split, mx_status_t status, unsigned count) {
+    if (status != MX_OK) {
+        int expected = MX_OK;
+        atomic_compare_exchange_strong(&split->status, &expected, status);
+    }
+    if (atomic_fetch_sub(&split->pending, count) == count) {
+        split->dev->callbacks->complete(split->cookie, atomic_load(&split->status));
+        free(split);
+    }
+}
+
+static void sata_block_split_complete(iotxn_t* txn, void* cookie) {
+    mx_status_t status = txn->status;
+    iotxn_release(txn);
+    sata_split_put(cookie, status, 1);
+}
+
+// Issues a request too large for one command as several, all queued at once
+// so that they occupy separate command slots.
+static void sata_block_split_txn(sata_device_t* dev, uint32_t opcode, mx_handle_t vmo,
+                                 uint64_t length, uint64_t vmo_offset, uint64_t dev_offset,
+                                 void* cookie) {
+    uint64_t max = sata_max_xfer(dev);
+    unsigned count = (unsigned)((length + max - 1) / max);
+    sata_split_t* split = malloc(sizeof(sata_split_t));
+    if (split == NULL) {
+        dev->callbacks->complete(cookie, MX_ERR_NO_MEMORY);
+        return;
+    }
+    split->dev = dev;
+    split->cookie = cookie;
+    atomic_init(&split->pending, count);
+    atomic_init(&split->status, MX_OK);
+
+    for (unsigned i = 0; i < count; i++) {
+        uint64_t off = i * max;
+        mx_status_t status;
+        iotxn_t* txn;
+        if ((status = iotxn_alloc_vmo(&txn, IOTXN_ALLOC_POOL, vmo, vmo_offset + off,
+                                      MIN(max, length - off))) != MX_OK) {
+            // account for this piece and every one after it
+            sata_split_put(split, status, count - i);
+            return;
+        }
+        txn->opcode = opcode;
+        txn->offset = dev_offset + off;
+        txn->complete_cb = sata_block_split_complete;
+        txn->cookie = split;
+        iotxn_queue(dev->mxdev, txn);
+    }
+}
+
 static void sata_block_txn(sata_device_t* dev, uint32_t opcode, mx_handle_t vmo,
                            uint64_t length, uint64_t vmo_offset, uint64_t dev_offset,
                            void* cookie) {
@@ -278,6 +357,10 @@ static void sata_block_txn(sata_device_t* dev, uint32_t opcode, mx_handle_t vmo,
         dev->callbacks->complete(cookie, MX_ERR_OUT_OF_RANGE);
         return;
     }
+    if (length > sata_max_xfer(dev)) {
+        sata_block_split_txn(dev, opcode, vmo, length, vmo_offset, dev_offset, cookie);
+        return;
+    }
 
     mx_status_t status;
     iotxn_t* txn;
@@ -7,6 +7,7 @@
 #include <ddk/binding.h>
 #include <ddk/protocol/block.h>
 
+#include <magenta/listnode.h>
 #include <magenta/process.h>
 #include <magenta/types.h>
 #include <sys/param.h>
@@ -26,28 +27,54 @@ typedef struct blkdev {
     block_protocol_t proto;
 
     mtx_t lock;
+    list_node_t queues; // Open instances of the device
+    bool dead; // Release has been called; we should free memory once all queues are gone.
+} blkdev_t;
+
+// Each open of the block device creates an instance with its own fifo server,
+// served by its own thread. Clients submit I/O independently of one another,
+// and completions are written back to the fifo of the queue which submitted
+// the request.
+typedef struct blkqueue {
+    mx_device_t* mxdev;
+    blkdev_t* bdev;
+    list_node_t node;
+
+    // Protected by bdev->lock.
     uint32_t threadcount;
     BlockServer* bs;
     bool dead; // Release has been called; we should free memory and leave.
-} blkdev_t;
+} blkqueue_t;
+
+// Frees the queue, returning true if the device it belongs to should be freed too.
+static bool blkqueue_free_locked(blkqueue_t* queue) {
+    blkdev_t* bdev = queue->bdev;
+    list_delete(&queue->node);
+    free(queue);
+    return bdev->dead && list_is_empty(&bdev->queues);
+}
 
 static int blockserver_thread(void* arg) {
-    blkdev_t* bdev = (blkdev_t*)arg;
-    BlockServer* bs = bdev->bs;
-    bdev->threadcount++;
+    blkqueue_t* queue = (blkqueue_t*)arg;
+    blkdev_t* bdev = queue->bdev;
+    BlockServer* bs = queue->bs;
+    queue->threadcount++;
     mtx_unlock(&bdev->lock);
 
     blockserver_serve(bs, &bdev->proto);
 
     mtx_lock(&bdev->lock);
-    if (bdev->bs == bs) {
+    if (queue->bs == bs) {
         // Only nullify 'bs' if no one has replaced it yet. This is the
         // case when the blockserver shuts itself down because the fifo
         // has closed.
-        bdev->bs = NULL;
+        queue->bs = NULL;
+    }
+    queue->threadcount--;
+    bool cleanup = false;
+    if (queue->dead && (queue->threadcount == 0)) {
+        cleanup = blkqueue_free_locked(queue);
     }
-    bdev->threadcount--;
-    bool cleanup = bdev->dead & (bdev->threadcount == 0);
     mtx_unlock(&bdev->lock);
 
     blockserver_free(bs);
@@ -58,13 +85,14 @@ static int blockserver_thread(void* arg) {
     return 0;
 }
 
-static mx_status_t blkdev_get_fifos(blkdev_t* bdev, void* out_buf, size_t out_len) {
+static mx_status_t blkqueue_get_fifos(blkqueue_t* queue, void* out_buf, size_t out_len) {
     if (out_len < sizeof(mx_handle_t)) {
         return MX_ERR_INVALID_ARGS;
     }
+    blkdev_t* bdev = queue->bdev;
     mx_status_t status;
     mtx_lock(&bdev->lock);
-    if (bdev->bs != NULL) {
+    if (queue->bs != NULL) {
         status = MX_ERR_ALREADY_BOUND;
         goto done;
     }
@@ -75,12 +103,12 @@ static mx_status_t blkdev_get_fifos(blkdev_t* bdev, void* out_buf, size_t out_le
     }
 
     // As soon as we launch a thread, the background thread is responsible
-    // for the blockserver in the bdev->bs field.
-    bdev->bs = bs;
+    // for the blockserver in the queue->bs field.
+    queue->bs = bs;
     thrd_t thread;
-    if (thrd_create(&thread, blockserver_thread, bdev) != thrd_success) {
+    if (thrd_create(&thread, blockserver_thread, queue) != thrd_success) {
         blockserver_free(bs);
-        bdev->bs = NULL;
+        queue->bs = NULL;
         status = MX_ERR_NO_MEMORY;
         goto done;
     }
@@ -93,22 +121,23 @@ done:
     return status;
 }
 
-static mx_status_t blkdev_attach_vmo(blkdev_t* bdev,
-                                 const void* in_buf, size_t in_len,
-                                 void* out_buf, size_t out_len, size_t* out_actual) {
+static mx_status_t blkqueue_attach_vmo(blkqueue_t* queue,
+                                       const void* in_buf, size_t in_len,
+                                       void* out_buf, size_t out_len, size_t* out_actual) {
     if ((in_len < sizeof(mx_handle_t)) || (out_len < sizeof(vmoid_t))) {
         return MX_ERR_INVALID_ARGS;
     }
 
+    blkdev_t* bdev = queue->bdev;
     mx_status_t status;
     mtx_lock(&bdev->lock);
-    if (bdev->bs == NULL) {
+    if (queue->bs == NULL) {
         status = MX_ERR_BAD_STATE;
         goto done;
     }
 
     mx_handle_t h = *(mx_handle_t*)in_buf;
-    if ((status = blockserver_attach_vmo(bdev->bs, h, out_buf)) != MX_OK) {
+    if ((status = blockserver_attach_vmo(queue->bs, h, out_buf)) != MX_OK) {
         goto done;
     }
     *out_actual = sizeof(vmoid_t);
@@ -118,21 +147,22 @@ done:
     return status;
 }
 
-static mx_status_t blkdev_alloc_txn(blkdev_t* bdev,
-                                const void* in_buf, size_t in_len,
-                                void* out_buf, size_t out_len, size_t* out_actual) {
+static mx_status_t blkqueue_alloc_txn(blkqueue_t* queue,
+                                      const void* in_buf, size_t in_len,
+                                      void* out_buf, size_t out_len, size_t* out_actual) {
     if ((in_len != 0) || (out_len < sizeof(txnid_t))) {
         return MX_ERR_INVALID_ARGS;
     }
 
+    blkdev_t* bdev = queue->bdev;
     mx_status_t status;
     mtx_lock(&bdev->lock);
-    if (bdev->bs == NULL) {
+    if (queue->bs == NULL) {
         status = MX_ERR_BAD_STATE;
         goto done;
     }
 
-    if ((status = blockserver_allocate_txn(bdev->bs, out_buf)) != MX_OK) {
+    if ((status = blockserver_allocate_txn(queue->bs, out_buf)) != MX_OK) {
         goto done;
     }
     *out_actual = sizeof(vmoid_t);
@@ -142,57 +172,178 @@ done:
     return status;
 }
 
-static mx_status_t blkdev_free_txn(blkdev_t* bdev, const void* in_buf,
-                                   size_t in_len) {
+static mx_status_t blkqueue_free_txn(blkqueue_t* queue, const void* in_buf,
+                                     size_t in_len) {
     if (in_len != sizeof(txnid_t)) {
         return MX_ERR_INVALID_ARGS;
     }
 
+    blkdev_t* bdev = queue->bdev;
     mx_status_t status;
     mtx_lock(&bdev->lock);
-    if (bdev->bs == NULL) {
+    if (queue->bs == NULL) {
         status = MX_ERR_BAD_STATE;
         goto done;
     }
 
     txnid_t txnid = *(txnid_t*)in_buf;
-    blockserver_free_txn(bdev->bs, txnid);
+    blockserver_free_txn(queue->bs, txnid);
     status = MX_OK;
 done:
     mtx_unlock(&bdev->lock);
     return status;
 }
 
-static mx_status_t blkdev_fifo_close_locked(blkdev_t* bdev) {
-    if (bdev->bs != NULL) {
-        blockserver_shutdown(bdev->bs);
+// Reports the statistics of every queue serving the device.
+static mx_status_t blkdev_get_stats(blkdev_t* bdev, void* out_buf, size_t out_len,
+                                    size_t* out_actual) {
+    if (out_len < sizeof(block_stats_t)) {
+        return MX_ERR_INVALID_ARGS;
+    }
+
+    block_stats_t* out = out_buf;
+    memset(out, 0, sizeof(*out));
+    mx_status_t status = MX_ERR_BAD_STATE;
+    mtx_lock(&bdev->lock);
+    blkqueue_t* queue;
+    list_for_every_entry(&bdev->queues, queue, blkqueue_t, node) {
+        if (queue->bs == NULL) {
+            continue;
+        }
+        block_stats_t stats;
+        blockserver_get_stats(queue->bs, &stats);
+        out->reads += stats.reads;
+        out->writes += stats.writes;
+        out->bytes_read += stats.bytes_read;
+        out->bytes_written += stats.bytes_written;
+        out->device_ops += stats.device_ops;
+        out->merged += stats.merged;
+        out->queue_depth += stats.queue_depth;
+        out->max_queue_depth = MAX(out->max_queue_depth, stats.max_queue_depth);
+        out->total_latency += stats.total_latency;
+        out->max_latency = MAX(out->max_latency, stats.max_latency);
+        status = MX_OK;
+    }
+    mtx_unlock(&bdev->lock);
+    if (status == MX_OK) {
+        *out_actual = sizeof(block_stats_t);
+    }
+    return status;
+}
+
+static mx_status_t blkqueue_fifo_close_locked(blkqueue_t* queue) {
+    if (queue->bs != NULL) {
+        blockserver_shutdown(queue->bs);
         // Ensure that the next thread to call "get_fifos" will
         // not see the previous block server.
-        bdev->bs = NULL;
+        queue->bs = NULL;
     }
     return MX_OK;
 }
 
 // implement device protocol:
 
-static mx_status_t blkdev_ioctl(void* ctx, uint32_t op, const void* cmd,
-                            size_t cmdlen, void* reply, size_t max, size_t* out_actual) {
-    blkdev_t* blkdev = ctx;
+static mx_status_t blkqueue_ioctl(void* ctx, uint32_t op, const void* cmd,
+                                  size_t cmdlen, void* reply, size_t max, size_t* out_actual) {
+    blkqueue_t* queue = ctx;
+    blkdev_t* bdev = queue->bdev;
     switch (op) {
     case IOCTL_BLOCK_GET_FIFOS:
-        return blkdev_get_fifos(blkdev, reply, max);
+        return blkqueue_get_fifos(queue, reply, max);
     case IOCTL_BLOCK_ATTACH_VMO:
-        return blkdev_attach_vmo(blkdev, cmd, cmdlen, reply, max, out_actual);
+        return blkqueue_attach_vmo(queue, cmd, cmdlen, reply, max, out_actual);
     case IOCTL_BLOCK_ALLOC_TXN:
-        return blkdev_alloc_txn(blkdev, cmd, cmdlen, reply, max, out_actual);
+        return blkqueue_alloc_txn(queue, cmd, cmdlen, reply, max, out_actual);
     case IOCTL_BLOCK_FREE_TXN:
-        return blkdev_free_txn(blkdev, cmd, cmdlen);
+        return blkqueue_free_txn(queue, cmd, cmdlen);
     case IOCTL_BLOCK_FIFO_CLOSE: {
-        mtx_lock(&blkdev->lock);
-        mx_status_t status = blkdev_fifo_close_locked(blkdev);
-        mtx_unlock(&blkdev->lock);
+        mtx_lock(&bdev->lock);
+        mx_status_t status = blkqueue_fifo_close_locked(queue);
+        mtx_unlock(&bdev->lock);
         return status;
     }
+    case IOCTL_BLOCK_GET_STATS:
+        return blkdev_get_stats(bdev, reply, max, out_actual);
+    default:
+        return device_ioctl(bdev->parent, op, cmd, cmdlen, reply, max, out_actual);
+    }
+}
+
+static void blkqueue_iotxn_queue(void* ctx, iotxn_t* txn) {
+    blkqueue_t* queue = ctx;
+    iotxn_queue(queue->bdev->parent, txn);
+}
+
+static mx_off_t blkqueue_get_size(void* ctx) {
+    blkqueue_t* queue = ctx;
+    return device_get_size(queue->bdev->parent);
+}
+
+static void blkqueue_release(void* ctx) {
+    blkqueue_t* queue = ctx;
+    blkdev_t* bdev = queue->bdev;
+    mtx_lock(&bdev->lock);
+    blkqueue_fifo_close_locked(queue);
+    queue->dead = true;
+    bool cleanup = false;
+    if (queue->threadcount == 0) {
+        // If the background thread isn't running, we need to clean up.
+        // Otherwise, it'll free the queue's memory when it's done.
+        cleanup = blkqueue_free_locked(queue);
+    }
+    mtx_unlock(&bdev->lock);
+
+    if (cleanup) {
+        free(bdev);
+    }
+}
+
+static mx_protocol_device_t blkqueue_ops = {
+    .version = DEVICE_OPS_VERSION,
+    .ioctl = blkqueue_ioctl,
+    .iotxn_queue = blkqueue_iotxn_queue,
+    .get_size = blkqueue_get_size,
+    .release = blkqueue_release,
+};
+
+static mx_status_t blkdev_open(void* ctx, mx_device_t** out, uint32_t flags) {
+    blkdev_t* bdev = ctx;
+
+    blkqueue_t* queue;
+    if ((queue = calloc(1, sizeof(blkqueue_t))) == NULL) {
+        return MX_ERR_NO_MEMORY;
+    }
+    queue->bdev = bdev;
+
+    device_add_args_t args = {
+        .version = DEVICE_ADD_ARGS_VERSION,
+        .name = "block",
+        .ctx = queue,
+        .ops = &blkqueue_ops,
+        .proto_id = MX_PROTOCOL_BLOCK,
+        .flags = DEVICE_ADD_INSTANCE,
+    };
+
+    mx_status_t status;
+    if ((status = device_add(bdev->mxdev, &args, &queue->mxdev)) != MX_OK) {
+        free(queue);
+        return status;
+    }
+
+    mtx_lock(&bdev->lock);
+    list_add_tail(&bdev->queues, &queue->node);
+    mtx_unlock(&bdev->lock);
+
+    *out = queue->mxdev;
+    return MX_OK;
+}
+
+static mx_status_t blkdev_ioctl(void* ctx, uint32_t op, const void* cmd,
+                            size_t cmdlen, void* reply, size_t max, size_t* out_actual) {
+    blkdev_t* blkdev = ctx;
+    switch (op) {
+    case IOCTL_BLOCK_GET_STATS:
+        return blkdev_get_stats(blkdev, reply, max, out_actual);
     default:
         return device_ioctl(blkdev->parent, op, cmd, cmdlen, reply, max, out_actual);
     }
@@ -210,28 +361,35 @@ static mx_off_t blkdev_get_size(void* ctx) {
 
 static void blkdev_unbind(void* ctx) {
     blkdev_t* blkdev = ctx;
+
+    // Shut down the fifo servers, to encourage any open instances to close.
+    mtx_lock(&blkdev->lock);
+    blkqueue_t* queue;
+    list_for_every_entry(&blkdev->queues, queue, blkqueue_t, node) {
+        blkqueue_fifo_close_locked(queue);
+    }
+    mtx_unlock(&blkdev->lock);
+
     device_remove(blkdev->mxdev);
 }
 
 static void blkdev_release(void* ctx) {
     blkdev_t* blkdev = ctx;
     mtx_lock(&blkdev->lock);
-    bool bg_thread_running = (blkdev->threadcount != 0);
-    blkdev_fifo_close_locked(blkdev);
     blkdev->dead = true;
+    bool queues_remain = !list_is_empty(&blkdev->queues);
     mtx_unlock(&blkdev->lock);
 
-    if (!bg_thread_running) {
-        // If it isn't running, we need to clean up.
-        // Otherwise, it'll free blkdev's memory when it's done,
-        // since (1) no one else can call get_fifos anymore, and
-        // (2) it'll clean up when it sees that blkdev is dead.
+    if (!queues_remain) {
+        // Otherwise, the last queue will free blkdev's memory when it's done,
+        // since no one else can open the device anymore.
         free(blkdev);
     }
 }
 
 static mx_protocol_device_t blkdev_ops = {
     .version = DEVICE_OPS_VERSION,
+    .open = blkdev_open,
     .ioctl = blkdev_ioctl,
     .iotxn_queue = blkdev_iotxn_queue,
     .get_size = blkdev_get_size,
@@ -244,7 +402,7 @@ static mx_status_t block_driver_bind(void* ctx, mx_device_t* dev, void** cookie)
     if ((bdev = calloc(1, sizeof(blkdev_t))) == NULL) {
         return MX_ERR_NO_MEMORY;
     }
-    bdev->threadcount = 0;
+    list_initialize(&bdev->queues);
     mtx_init(&bdev->lock, mtx_plain);
     bdev->parent = dev;
 
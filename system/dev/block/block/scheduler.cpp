@@ -0,0 +1,176 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <magenta/syscalls.h>
+#include <mxtl/algorithm.h>
+#include <mxtl/auto_lock.h>
+
+#include "scheduler.h"
+
+IoScheduler::IoScheduler() : proto_(nullptr), max_transfer_(0), count_(0) {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+IoScheduler::~IoScheduler() {
+    MX_DEBUG_ASSERT(count_ == 0);
+}
+
+void IoScheduler::SetProtocol(block_protocol_t* proto) {
+    proto_ = proto;
+    block_info_t info;
+    memset(&info, 0, sizeof(info));
+    block_get_info(proto_, &info);
+    max_transfer_ = info.max_transfer_size;
+}
+
+bool IoScheduler::Conflicts(const block_fifo_request_t& request) const {
+    bool is_write = (request.opcode & BLOCKIO_OP_MASK) == BLOCKIO_WRITE;
+    uint64_t start = request.dev_offset;
+    uint64_t end = request.dev_offset + request.length;
+    for (size_t i = 0; i < count_; i++) {
+        const Op& op = ops_[i];
+        if (!is_write && op.opcode != BLOCKIO_WRITE) {
+            continue;
+        }
+        if ((start < op.dev_offset + op.length) && (op.dev_offset < end)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void IoScheduler::Queue(const block_fifo_request_t& request, mx_handle_t vmo,
+                        block_msg_t* msg) {
+    MX_DEBUG_ASSERT(proto_ != nullptr);
+    if ((count_ == mxtl::count_of(ops_)) || Conflicts(request)) {
+        Flush();
+    }
+
+    Op* op = &ops_[count_++];
+    op->opcode = static_cast<uint16_t>(request.opcode & BLOCKIO_OP_MASK);
+    op->vmoid = request.vmoid;
+    op->vmo = vmo;
+    op->length = request.length;
+    op->vmo_offset = request.vmo_offset;
+    op->dev_offset = request.dev_offset;
+    op->head = msg;
+    op->tail = msg;
+    MX_DEBUG_ASSERT(msg->next == nullptr);
+
+    mxtl::AutoLock lock(&stats_lock_);
+    if (op->opcode == BLOCKIO_READ) {
+        stats_.reads++;
+        stats_.bytes_read += op->length;
+    } else {
+        stats_.writes++;
+        stats_.bytes_written += op->length;
+    }
+}
+
+// Reads sort ahead of writes; otherwise, ops are sorted by device offset.
+int IoScheduler::CompareOps(const void* a, const void* b) {
+    const Op* op_a = static_cast<const Op*>(a);
+    const Op* op_b = static_cast<const Op*>(b);
+    if (op_a->opcode != op_b->opcode) {
+        return (op_a->opcode == BLOCKIO_READ) ? -1 : 1;
+    }
+    if (op_a->dev_offset != op_b->dev_offset) {
+        return (op_a->dev_offset < op_b->dev_offset) ? -1 : 1;
+    }
+    return 0;
+}
+
+void IoScheduler::Flush() {
+    if (count_ == 0) {
+        return;
+    }
+    qsort(ops_, count_, sizeof(Op), CompareOps);
+
+    // Merge each op into its predecessor where possible, compacting the
+    // array in place.
+    size_t issued = 0;
+    for (size_t i = 1; i < count_; i++) {
+        Op* prev = &ops_[issued];
+        Op* op = &ops_[i];
+        if ((op->opcode == prev->opcode) && (op->vmoid == prev->vmoid) &&
+            (prev->dev_offset + prev->length == op->dev_offset) &&
+            (prev->vmo_offset + prev->length == op->vmo_offset) &&
+            ((max_transfer_ == 0) || (prev->length + op->length <= max_transfer_))) {
+            prev->length += op->length;
+            prev->tail->next = op->head;
+            prev->tail = op->tail;
+        } else {
+            ops_[++issued] = *op;
+        }
+    }
+    issued++;
+
+    mx_time_t now = mx_time_get(MX_CLOCK_MONOTONIC);
+    {
+        mxtl::AutoLock lock(&stats_lock_);
+        stats_.device_ops += issued;
+        stats_.merged += count_ - issued;
+        stats_.queue_depth += static_cast<uint32_t>(issued);
+        if (stats_.queue_depth > stats_.max_queue_depth) {
+            stats_.max_queue_depth = stats_.queue_depth;
+        }
+    }
+    count_ = 0;
+
+    for (size_t i = 0; i < issued; i++) {
+        Op* op = &ops_[i];
+        op->head->sched = mxtl::WrapRefPtr(this);
+        op->head->start = now;
+        if (op->opcode == BLOCKIO_READ) {
+            block_read(proto_, op->vmo, op->length, op->vmo_offset, op->dev_offset, op->head);
+        } else {
+            block_write(proto_, op->vmo, op->length, op->vmo_offset, op->dev_offset, op->head);
+        }
+    }
+}
+
+void IoScheduler::Complete(block_msg_t* msg, mx_status_t status) {
+    mxtl::RefPtr<IoScheduler> sched = mxtl::move(msg->sched);
+    mx_time_t start = msg->start;
+    while (msg != nullptr) {
+        // Once completed, the message may be reused by the server, so
+        // find its successor first.
+        block_msg_t* next = msg->next;
+        msg->next = nullptr;
+        // Since iobuf is a RefPtr, it lives at least as long as the txn,
+        // and is not discarded underneath the block device driver.
+        MX_DEBUG_ASSERT(msg->iobuf != nullptr);
+        MX_DEBUG_ASSERT(msg->txn != nullptr);
+        // Hold an extra copy of the 'txn' refptr; if we don't, and 'msg->txn' is
+        // the last copy, then when we nullify 'msg->txn' in Complete we end up
+        // trying to unlock a lock in a deleted BlockTxn.
+        auto txn = msg->txn;
+        // Pass msg to complete so 'msg->txn' can be nullified while protected
+        // by the BlockTransaction's lock.
+        txn->Complete(msg, status);
+        msg = next;
+    }
+    if (sched != nullptr) {
+        sched->RecordCompletion(start);
+    }
+}
+
+void IoScheduler::RecordCompletion(mx_time_t start) {
+    mx_time_t latency = mx_time_get(MX_CLOCK_MONOTONIC) - start;
+    mxtl::AutoLock lock(&stats_lock_);
+    MX_DEBUG_ASSERT(stats_.queue_depth > 0);
+    stats_.queue_depth--;
+    stats_.total_latency += latency;
+    if (latency > stats_.max_latency) {
+        stats_.max_latency = latency;
+    }
+}
+
+void IoScheduler::GetStats(block_stats_t* out) {
+    mxtl::AutoLock lock(&stats_lock_);
+    *out = stats_;
+}
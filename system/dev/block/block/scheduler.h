@@ -0,0 +1,78 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <ddk/protocol/block.h>
+#include <magenta/device/block.h>
+#include <magenta/thread_annotations.h>
+#include <magenta/types.h>
+#include <mxtl/mutex.h>
+#include <mxtl/ref_counted.h>
+#include <mxtl/ref_ptr.h>
+
+#include "server.h"
+
+// Sits between the block fifo and the device, deciding the order in which
+// reads and writes are issued.
+//
+// Requests are queued as they are read from the fifo, and issued together
+// when the fifo has been drained: reads ahead of writes (so that a client
+// waiting on a read is not stuck behind writeback), each in ascending device
+// order. Requests which are contiguous both on the device and within the same
+// VMO are merged into a single device operation, up to the device's maximum
+// transfer size.
+//
+// A request which overlaps a queued request, where either one of them is a
+// write, flushes the queue before being queued itself. Reordering is therefore
+// never visible to clients.
+class IoScheduler : public mxtl::RefCounted<IoScheduler> {
+public:
+    IoScheduler();
+    ~IoScheduler();
+
+    // Must be called before any requests are queued.
+    void SetProtocol(block_protocol_t* proto);
+
+    // Queues a read or write for 'msg'. 'vmo' must remain valid until the
+    // operation completes.
+    void Queue(const block_fifo_request_t& request, mx_handle_t vmo, block_msg_t* msg);
+
+    // Issues every queued request to the device.
+    void Flush();
+
+    // Completes every message serviced by the device operation 'msg'.
+    static void Complete(block_msg_t* msg, mx_status_t status);
+
+    void GetStats(block_stats_t* out);
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(IoScheduler);
+
+    struct Op {
+        uint16_t opcode;
+        vmoid_t vmoid;
+        mx_handle_t vmo;
+        uint64_t length;
+        uint64_t vmo_offset;
+        uint64_t dev_offset;
+        // The messages completed by this operation.
+        block_msg_t* head;
+        block_msg_t* tail;
+    };
+
+    static int CompareOps(const void* a, const void* b);
+    bool Conflicts(const block_fifo_request_t& request) const;
+    void RecordCompletion(mx_time_t start);
+
+    block_protocol_t* proto_;
+    uint64_t max_transfer_;
+
+    // Only accessed by the thread serving the fifo.
+    Op ops_[BLOCK_FIFO_MAX_DEPTH];
+    size_t count_;
+
+    mxtl::Mutex stats_lock_;
+    block_stats_t stats_ TA_GUARDED(stats_lock_);
+};
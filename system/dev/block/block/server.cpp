@@ -17,6 +17,7 @@
 #include <mxtl/limits.h>
 #include <mxtl/ref_ptr.h>
 
+#include "scheduler.h"
 #include "server.h"
 
 // This signal is set on the FIFO when the server should be instructed
@@ -189,6 +190,10 @@ mx_status_t BlockServer::AllocateTxn(txnid_t* out) {
     return MX_ERR_NO_RESOURCES;
 }
 
+void BlockServer::GetStats(block_stats_t* out) {
+    sched_->GetStats(out);
+}
+
 void BlockServer::FreeTxn(txnid_t txnid) {
     mxtl::AutoLock server_lock(&server_lock_);
     if (txnid >= mxtl::count_of(txns_)) {
@@ -205,6 +210,12 @@ mx_status_t BlockServer::Create(mx::fifo* fifo_out, BlockServer** out) {
         return MX_ERR_NO_MEMORY;
     }
 
+    bs->sched_ = mxtl::AdoptRef(new (&ac) IoScheduler());
+    if (!ac.check()) {
+        delete bs;
+        return MX_ERR_NO_MEMORY;
+    }
+
     mx_status_t status;
     if ((status = mx::fifo::create(BLOCK_FIFO_MAX_DEPTH, BLOCK_FIFO_ESIZE, 0,
                                    fifo_out, &bs->fifo_)) != MX_OK) {
@@ -217,18 +228,7 @@ mx_status_t BlockServer::Create(mx::fifo* fifo_out, BlockServer** out) {
 }
 
 void blockserver_fifo_complete(void* cookie, mx_status_t status) {
-    block_msg_t* msg = static_cast<block_msg_t*>(cookie);
-    // Since iobuf is a RefPtr, it lives at least as long as the txn,
-    // and is not discarded underneath the block device driver.
-    MX_DEBUG_ASSERT(msg->iobuf != nullptr);
-    MX_DEBUG_ASSERT(msg->txn != nullptr);
-    // Hold an extra copy of the 'txn' refptr; if we don't, and 'msg->txn' is
-    // the last copy, then when we nullify 'msg->txn' in Complete we end up
-    // trying to unlock a lock in a deleted BlockTxn.
-    auto txn = msg->txn;
-    // Pass msg to complete so 'msg->txn' can be nullified while protected
-    // by the BlockTransaction's lock.
-    txn->Complete(msg, status);
+    IoScheduler::Complete(static_cast<block_msg_t*>(cookie), status);
 }
 
 static block_callbacks_t cb = {
@@ -237,12 +237,13 @@ static block_callbacks_t cb = {
 
 mx_status_t BlockServer::Serve(block_protocol_t* proto) {
     block_set_callbacks(proto, &cb);
+    sched_->SetProtocol(proto);
 
     mx_status_t status;
     block_fifo_request_t requests[BLOCK_FIFO_MAX_DEPTH];
     uint32_t count;
     while (true) {
-        if ((status = Read(requests, &count) != MX_OK)) {
+        if ((status = Read(requests, &count)) != MX_OK) {
             return status;
         }
 
@@ -290,16 +291,11 @@ mx_status_t BlockServer::Serve(block_protocol_t* proto) {
                     break;
                 }
 
-                if ((requests[i].opcode & BLOCKIO_OP_MASK) == BLOCKIO_READ) {
-                    block_read(proto, iobuf->io_vmo_.get(), requests[i].length,
-                                     requests[i].vmo_offset, requests[i].dev_offset, msg);
-                } else {
-                    block_write(proto, iobuf->io_vmo_.get(), requests[i].length,
-                                      requests[i].vmo_offset, requests[i].dev_offset, msg);
-                }
+                sched_->Queue(requests[i], iobuf->io_vmo_.get(), msg);
                 break;
             }
             case BLOCKIO_SYNC: {
+                sched_->Flush();
                 // TODO(smklein): It might be more useful to have this on a per-vmo basis
                 fprintf(stderr, "Warning: BLOCKIO_SYNC is currently unimplemented\n");
                 break;
@@ -317,6 +313,9 @@ mx_status_t BlockServer::Serve(block_protocol_t* proto) {
             }
             }
         }
+
+        // The fifo has been drained; issue everything read from it.
+        sched_->Flush();
     }
 }
 
@@ -357,3 +356,6 @@ mx_status_t blockserver_allocate_txn(BlockServer* bs, txnid_t* out) {
 void blockserver_free_txn(BlockServer* bs, txnid_t txnid) {
     return bs->FreeTxn(txnid);
 }
+void blockserver_get_stats(BlockServer* bs, block_stats_t* out) {
+    bs->GetStats(out);
+}
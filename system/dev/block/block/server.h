@@ -49,11 +49,20 @@ private:
 constexpr uint32_t kTxnFlagRespond = 0x00000001; // Should a reponse be sent when we hit goal?
 
 class BlockTransaction;
+class IoScheduler;
 
-typedef struct {
+typedef struct block_msg block_msg_t;
+struct block_msg {
     mxtl::RefPtr<BlockTransaction> txn;
     mxtl::RefPtr<IoBuffer> iobuf;
-} block_msg_t;
+    // The following message serviced by the same device operation, if the
+    // scheduler merged several requests together.
+    block_msg_t* next = nullptr;
+    // Set on the first message of each device operation issued by the
+    // scheduler, to account for its completion.
+    mxtl::RefPtr<IoScheduler> sched;
+    mx_time_t start = 0;
+};
 
 class BlockTransaction : public mxtl::RefCounted<BlockTransaction> {
 public:
@@ -90,6 +99,7 @@ public:
     mx_status_t AttachVmo(mx::vmo vmo, vmoid_t* out);
     mx_status_t AllocateTxn(txnid_t* out);
     void FreeTxn(txnid_t txnid);
+    void GetStats(block_stats_t* out);
 
     void ShutDown();
 
@@ -102,6 +112,7 @@ private:
     mx_status_t FindVmoIDLocked(vmoid_t* out) TA_REQ(server_lock_);
 
     mx::fifo fifo_;
+    mxtl::RefPtr<IoScheduler> sched_;
 
     mxtl::Mutex server_lock_;
     mxtl::WAVLTree<vmoid_t, mxtl::RefPtr<IoBuffer>> tree_ TA_GUARDED(server_lock_);
@@ -137,4 +148,7 @@ mx_status_t blockserver_attach_vmo(BlockServer* bs, mx_handle_t vmo, vmoid_t* ou
 mx_status_t blockserver_allocate_txn(BlockServer* bs, txnid_t* out);
 void blockserver_free_txn(BlockServer* bs, txnid_t txnid);
 
+// Get the I/O statistics of the blockserver
+void blockserver_get_stats(BlockServer* bs, block_stats_t* out);
+
 __END_CDECLS
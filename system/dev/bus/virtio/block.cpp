@@ -7,6 +7,8 @@
 #include <ddk/protocol/block.h>
 #include <inttypes.h>
 #include <magenta/compiler.h>
+#include <magenta/syscalls.h>
+#include <mxalloc/new.h>
 #include <mxtl/algorithm.h>
 #include <mxtl/auto_lock.h>
 #include <pretty/hexdump.h>
@@ -14,6 +16,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
+#include <threads.h>
 
 #include "trace.h"
 #include "utils.h"
@@ -60,7 +63,7 @@ void BlockDevice::GetInfo(block_info_t* info) {
     memset(info, 0, sizeof(*info));
     info->block_size = GetBlockSize();
     info->block_count = GetSize() / GetBlockSize();
-    info->max_transfer_size = (uint32_t)(PAGE_SIZE * (ring_size - 2));
+    info->max_transfer_size = (uint32_t)(PAGE_SIZE * max_segments);
 }
 
 mx_status_t BlockDevice::virtio_block_ioctl(void* ctx, uint32_t op, const void* in_buf, size_t in_len,
@@ -156,6 +159,40 @@ void BlockDevice::virtio_block_write(void* ctx, mx_handle_t vmo,
     block_do_txn((BlockDevice*)ctx, IOTXN_OP_WRITE, vmo, length, vmo_offset, dev_offset, cookie);
 }
 
+mx_status_t BlockDevice::InitQueue(Queue* queue, uint16_t index) {
+    // allocate the vring
+    auto err = queue->vring.Init(index, ring_size);
+    if (err < 0) {
+        VIRTIO_ERROR("failed to allocate vring %u\n", index);
+        return err;
+    }
+
+    // allocate the block requests, each with an indirect descriptor table
+    // large enough for the biggest transfer
+    const size_t table_size = sizeof(vring_desc) * (max_segments + 2);
+    size_t size = (table_size + sizeof(virtio_blk_req_t) + sizeof(uint8_t)) * blk_req_count;
+
+    mx_status_t r = map_contiguous_memory(size, &queue->va, &queue->pa);
+    if (r < 0) {
+        VIRTIO_ERROR("cannot alloc blk_req buffers %d\n", r);
+        return r;
+    }
+
+    queue->indirect = reinterpret_cast<vring_desc*>(queue->va);
+    queue->blk_req = reinterpret_cast<virtio_blk_req_t*>(queue->va + table_size * blk_req_count);
+    queue->blk_res = reinterpret_cast<uint8_t*>(queue->blk_req + blk_req_count);
+
+    LTRACEF("queue %u: allocated blk requests at %p, physical address %#" PRIxPTR "\n",
+            index, queue->blk_req, queue->pa);
+
+    // descriptors within an indirect table are always chained in order
+    for (size_t i = 0; i < blk_req_count * (max_segments + 2); i++) {
+        queue->indirect[i].next = (uint16_t)((i + 1) % (max_segments + 2));
+    }
+
+    return MX_OK;
+}
+
 mx_status_t BlockDevice::Init() {
     LTRACE_ENTRY;
 
@@ -173,32 +210,34 @@ mx_status_t BlockDevice::Init() {
     // ack and set the driver status bit
     StatusAcknowledgeDriver();
 
-    // XXX check features bits and ack/nak them
-
-    // allocate the main vring
-    auto err = vring_.Init(0, ring_size);
-    if (err < 0) {
-        VIRTIO_ERROR("failed to allocate vring\n");
-        return err;
+    // negotiate the features we know how to use
+    uint32_t features = DeviceFeatures() & (VIRTIO_BLK_F_MQ |
+                                            (1u << VIRTIO_RING_F_INDIRECT_DESC) |
+                                            (1u << VIRTIO_RING_F_EVENT_IDX));
+    DriverFeaturesAck(features);
+    indirect_ = DriverFeatureEnabled(1u << VIRTIO_RING_F_INDIRECT_DESC);
+
+    // one virtqueue per cpu, up to as many as the device supports
+    queue_count_ = 1;
+    if (DriverFeatureEnabled(VIRTIO_BLK_F_MQ) && config_.num_queues > 1) {
+        uint32_t cpus = mx_system_get_num_cpus();
+        queue_count_ = (uint16_t)mxtl::min<uint32_t>(mxtl::min<uint32_t>(config_.num_queues, cpus),
+                                                      max_queues);
     }
+    LTRACEF("features %#x, %u queues\n", features, queue_count_);
 
-    // allocate a queue of block requests
-    size_t size = sizeof(virtio_blk_req_t) * blk_req_count + sizeof(uint8_t) * blk_req_count;
-
-    mx_status_t r = map_contiguous_memory(size, (uintptr_t*)&blk_req_, &blk_req_pa_);
-    if (r < 0) {
-        VIRTIO_ERROR("cannot alloc blk_req buffers %d\n", r);
-        return r;
+    for (uint16_t i = 0; i < queue_count_; i++) {
+        AllocChecker ac;
+        queues_[i].reset(new (&ac) Queue(this));
+        if (!ac.check()) {
+            return MX_ERR_NO_MEMORY;
+        }
+        auto err = InitQueue(queues_[i].get(), i);
+        if (err < 0) {
+            return err;
+        }
     }
 
-    LTRACEF("allocated blk request at %p, physical address %#" PRIxPTR "\n", blk_req_, blk_req_pa_);
-
-    // responses are 32 words at the end of the allocated block
-    blk_res_pa_ = blk_req_pa_ + sizeof(virtio_blk_req_t) * blk_req_count;
-    blk_res_ = (uint8_t*)((uintptr_t)blk_req_ + sizeof(virtio_blk_req_t) * blk_req_count);
-
-    LTRACEF("allocated blk responses at %p, physical address %#" PRIxPTR "\n", blk_res_, blk_res_pa_);
-
     // start the interrupt thread
     StartIrqThread();
 
@@ -236,48 +275,69 @@ mx_status_t BlockDevice::Init() {
 void BlockDevice::IrqRingUpdate() {
     LTRACE_ENTRY;
 
-    // parse our descriptor chain, add back to the free queue
-    auto free_chain = [this](vring_used_elem* used_elem) {
-        uint32_t i = (uint16_t)used_elem->id;
-        struct vring_desc* desc = vring_.DescFromIndex((uint16_t)i);
-        auto head_desc = desc; // save the first element
-        for (;;) {
-            int next;
+    for (uint16_t q = 0; q < queue_count_; q++) {
+        Queue* queue = queues_[q].get();
+
+        // txns are completed once the queue lock is dropped, since their
+        // completion callbacks may queue more
+        list_node done = LIST_INITIAL_VALUE(done);
+
+        // parse our descriptor chain, add back to the free queue
+        auto free_chain = [queue, &done](vring_used_elem* used_elem) {
+            uint16_t head = (uint16_t)used_elem->id;
+            uint16_t i = head;
+            struct vring_desc* desc = queue->vring.DescFromIndex(i);
+            for (;;) {
+                int next;
 
 #if LOCAL_TRACE > 0
-            virtio_dump_desc(desc);
+                virtio_dump_desc(desc);
 #endif
 
-            if (desc->flags & VRING_DESC_F_NEXT) {
-                next = desc->next;
-            } else {
-                /* end of chain */
-                next = -1;
+                if (desc->flags & VRING_DESC_F_NEXT) {
+                    next = desc->next;
+                } else {
+                    /* end of chain */
+                    next = -1;
+                }
+
+                queue->vring.FreeDesc(i);
+
+                if (next < 0)
+                    break;
+                i = (uint16_t)next;
+                desc = queue->vring.DescFromIndex(i);
             }
 
-            vring_.FreeDesc((uint16_t)i);
+            iotxn_t* txn = queue->txns[head];
+            queue->txns[head] = nullptr;
+            if (txn == nullptr) {
+                TRACEF("no txn for descriptor %u\n", head);
+                return;
+            }
+            LTRACEF("completes txn %p\n", txn);
+
+            size_t index = (size_t)txn->extra[1];
+            txn->status = (queue->blk_res[index] == VIRTIO_BLK_S_OK) ? MX_OK : MX_ERR_IO;
+            queue->free_blk_req(index);
+            list_add_tail(&done, &txn->node);
+        };
 
-            if (next < 0)
-                break;
-            i = next;
-            desc = vring_.DescFromIndex((uint16_t)i);
+        {
+            mxtl::AutoLock lock(&queue->lock);
+
+            // tell the ring to find free chains and hand it back to our lambda
+            queue->vring.IrqRingUpdate(free_chain);
+
+            // requests have been freed up, so start anything that was waiting
+            SubmitPendingLocked(queue);
         }
 
-        // search our pending txn list to see if this completes it
         iotxn_t* txn;
-        list_for_every_entry (&iotxn_list, txn, iotxn_t, node) {
-            if (txn->context == head_desc) {
-                LTRACEF("completes txn %p\n", txn);
-                free_blk_req((unsigned int)txn->extra[1]);
-                list_delete(&txn->node);
-                iotxn_complete(txn, MX_OK, txn->length);
-                break;
-            }
+        while ((txn = list_remove_head_type(&done, iotxn_t, node)) != nullptr) {
+            iotxn_complete(txn, txn->status, (txn->status == MX_OK) ? txn->length : 0);
         }
-    };
-
-    // tell the ring to find free chains and hand it back to our lambda
-    vring_.IrqRingUpdate(free_chain);
+    }
 }
 
 void BlockDevice::IrqConfigChange() {
@@ -323,10 +383,6 @@ static void ScatterGatherHelper(const iotxn_t *txn, callback callback_new_run) {
 void BlockDevice::QueueReadWriteTxn(iotxn_t* txn) {
     LTRACEF("txn %p, pflags %#x\n", txn, txn->pflags);
 
-    mxtl::AutoLock lock(&lock_);
-
-    bool write = (txn->opcode == IOTXN_OP_WRITE);
-
     // offset must be aligned to block size
     if (txn->offset % config_.blk_size) {
         LTRACEF("offset %#" PRIx64 " is not aligned to sector size %u!\n", txn->offset, config_.blk_size);
@@ -346,27 +402,13 @@ void BlockDevice::QueueReadWriteTxn(iotxn_t* txn) {
         return;
     }
 
-    // allocate and start filling out a block request
-    auto index = alloc_blk_req();
-    if (index >= blk_req_count) {
-        TRACEF("too many block requests queued (%zu)!\n", index);
-        iotxn_complete(txn, MX_ERR_NO_RESOURCES, 0);
-        return;
-    }
-
-    auto req = &blk_req_[index];
-    req->type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
-    req->ioprio = 0;
-    req->sector = txn->offset / 512;
-    LTRACEF("blk_req type %u ioprio %u sector %" PRIu64 "\n",
-            req->type, req->ioprio, req->sector);
-
-    // save the req index into the txn->extra[1] slot so we can free it when we complete the transfer
-    txn->extra[1] = index;
-
     // get the physical map for the transfer
     auto status = iotxn_physmap(txn);
     LTRACEF("status %d, pflags %#x\n", status, txn->pflags);
+    if (status != MX_OK) {
+        iotxn_complete(txn, status, 0);
+        return;
+    }
 #if LOCAL_TRACE
     LTRACEF("phys %p, phys_count %#lx\n", txn->phys, txn->phys_count);
     for (uint64_t i = 0; i < txn->phys_count; i++) {
@@ -389,42 +431,119 @@ void BlockDevice::QueueReadWriteTxn(iotxn_t* txn) {
     LTRACEF("run count %lu\n", run_count);
     assert(run_count > 0);
 
-    /* put together a transfer */
-    uint16_t i;
-    auto desc = vring_.AllocDescChain((uint16_t)(2u + run_count), &i);
-    if (!desc) {
-        TRACEF("failed to allocate descriptor chain of length %zu\n", 2u + run_count);
-        // TODO: handle this scenario by requeing the transfer in smaller runs
+    if (run_count > max_segments) {
+        TRACEF("transfer of %zu runs is too large\n", run_count);
         iotxn_complete(txn, MX_ERR_NO_RESOURCES, 0);
         return;
     }
+    txn->extra[2] = run_count;
+
+    // Pick the queue by submitting thread. Drivers cannot tell which cpu
+    // they are running on, but each thread is pinned to one queue, so its
+    // requests stay in order and threads on different cpus mostly take
+    // different queue locks.
+    uint64_t self = reinterpret_cast<uintptr_t>(thrd_current());
+    Queue* queue = queues_[((self * 0x9e3779b97f4a7c15ull) >> 32) % queue_count_].get();
+
+    mxtl::AutoLock lock(&queue->lock);
+
+    list_add_tail(&queue->pending, &txn->node);
+    SubmitPendingLocked(queue);
+}
+
+void BlockDevice::SubmitPendingLocked(Queue* queue) {
+    bool submitted = false;
+
+    iotxn_t* txn;
+    while ((txn = list_peek_head_type(&queue->pending, iotxn_t, node)) != nullptr) {
+        if (!SubmitLocked(queue, txn))
+            break;
+        list_delete(&txn->node);
+        submitted = true;
+    }
+
+    /* kick off everything we submitted at once */
+    if (submitted)
+        queue->vring.Kick();
+}
+
+bool BlockDevice::SubmitLocked(Queue* queue, iotxn_t* txn) {
+    bool write = (txn->opcode == IOTXN_OP_WRITE);
+    size_t run_count = (size_t)txn->extra[2];
+
+    // allocate and start filling out a block request
+    auto index = queue->alloc_blk_req();
+    if (index >= blk_req_count) {
+        LTRACEF("no free block requests, txn %p waits\n", txn);
+        return false;
+    }
+
+    // with indirect descriptors the request takes a single ring entry,
+    // pointing at a table of its own
+    uint16_t i;
+    struct vring_desc* head;
+    struct vring_desc* desc;
+    if (indirect_) {
+        i = queue->vring.AllocDesc();
+        if (i == 0xffff) {
+            queue->free_blk_req(index);
+            return false;
+        }
+        const size_t table_len = max_segments + 2;
+        desc = &queue->indirect[index * table_len];
+
+        head = queue->vring.DescFromIndex(i);
+        head->addr = queue->pa + index * table_len * sizeof(vring_desc);
+        head->len = (uint32_t)((2u + run_count) * sizeof(vring_desc));
+        head->flags = VRING_DESC_F_INDIRECT;
+        head->next = 0;
+    } else {
+        head = queue->vring.AllocDescChain((uint16_t)(2u + run_count), &i);
+        if (!head) {
+            LTRACEF("no descriptor chain of length %zu, txn %p waits\n", 2u + run_count, txn);
+            queue->free_blk_req(index);
+            return false;
+        }
+        desc = head;
+    }
 
     LTRACEF("after alloc chain desc %p, i %u\n", desc, i);
 
-    /* point the iotxn at this head descriptor */
-    txn->context = desc;
+    auto next_desc = [this, queue](vring_desc* desc) {
+        return indirect_ ? desc + 1 : queue->vring.DescFromIndex(desc->next);
+    };
+
+    auto req = &queue->blk_req[index];
+    req->type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    req->ioprio = 0;
+    req->sector = txn->offset / 512;
+    LTRACEF("blk_req type %u ioprio %u sector %" PRIu64 "\n",
+            req->type, req->ioprio, req->sector);
+
+    // save the req index into the txn->extra[1] slot so we can free it when we complete the transfer
+    txn->extra[1] = index;
 
     /* set up the descriptor pointing to the head */
-    desc->addr = blk_req_pa_ + index * sizeof(virtio_blk_req_t);
+    desc->addr = queue->pa + ((uintptr_t)req - queue->va);
     desc->len = sizeof(virtio_blk_req_t);
-    desc->flags |= VRING_DESC_F_NEXT;
+    desc->flags = VRING_DESC_F_NEXT;
 
 #if LOCAL_TRACE > 0
     virtio_dump_desc(desc);
 #endif
 
     {
-        auto new_run_callback = [this, write, &desc](uint64_t start, uint64_t len) {
+        auto new_run_callback = [write, &desc, &next_desc](uint64_t start, uint64_t len) {
             /* set up the descriptor pointing to the buffer */
-            desc = vring_.DescFromIndex(desc->next);
+            desc = next_desc(desc);
 
             desc->addr = start;
             desc->len = (uint32_t)len;
             LTRACEF("pa %#lx, len %#x\n", desc->addr, desc->len);
 
+            desc->flags = VRING_DESC_F_NEXT;
             if (!write)
                 desc->flags |= VRING_DESC_F_WRITE; /* mark buffer as write-only if its a block read */
-            desc->flags |= VRING_DESC_F_NEXT;
         };
 
         ScatterGatherHelper(txn, new_run_callback);
@@ -435,8 +554,8 @@ void BlockDevice::QueueReadWriteTxn(iotxn_t* txn) {
 #endif
 
     /* set up the descriptor pointing to the response */
-    desc = vring_.DescFromIndex(desc->next);
-    desc->addr = blk_res_pa_ + index;
+    desc = next_desc(desc);
+    desc->addr = queue->pa + ((uintptr_t)&queue->blk_res[index] - queue->va);
     desc->len = 1;
     desc->flags = VRING_DESC_F_WRITE;
 
@@ -444,14 +563,13 @@ void BlockDevice::QueueReadWriteTxn(iotxn_t* txn) {
     virtio_dump_desc(desc);
 #endif
 
-    // save the iotxn in a list
-    list_add_tail(&iotxn_list, &txn->node);
+    // remember which txn this chain completes
+    queue->txns[i] = txn;
 
     /* submit the transfer */
-    vring_.SubmitChain(i);
+    queue->vring.SubmitChain(i);
 
-    /* kick it off */
-    vring_.Kick();
+    return true;
 }
 
 } // namespace virtio
@@ -7,6 +7,8 @@
 #include "ring.h"
 
 #include <magenta/compiler.h>
+#include <mxtl/mutex.h>
+#include <mxtl/unique_ptr.h>
 #include <stdlib.h>
 
 #include <ddk/protocol/block.h>
@@ -54,44 +56,74 @@ private:
 
     void QueueReadWriteTxn(iotxn_t* txn);
 
-    // the main virtio ring
-    Ring vring_ = {this};
-
     static const uint16_t ring_size = 128; // 128 matches legacy pci
 
-    // saved block device configuration out of the pci config BAR
-    virtio_blk_config_t config_ = {};
+    // a transfer is at most a header, ring_size - 2 runs of data, and a status byte
+    static const size_t max_segments = ring_size - 2;
+
+    // the most virtqueues we will use, when the device supports VIRTIO_BLK_F_MQ
+    static const uint16_t max_queues = 8;
+
+    // the number of block requests which may be in flight on each virtqueue
+    static const size_t blk_req_count = 64;
+
+    // a virtqueue and the block requests in flight on it
+    struct Queue {
+        Queue(Device* device) : vring(device) {}
+
+        mxtl::Mutex lock;
+        Ring vring;
+
+        // physically contiguous memory holding, for each block request, its
+        // indirect descriptor table, header, and status byte
+        mx_paddr_t pa = 0;
+        uintptr_t va = 0;
+        vring_desc* indirect = nullptr;
+        virtio_blk_req_t* blk_req = nullptr;
+        uint8_t* blk_res = nullptr;
 
-    // a queue of block request/responses
-    static const size_t blk_req_count = 32;
+        uint64_t blk_req_bitmap = 0;
+        static_assert(blk_req_count <= sizeof(blk_req_bitmap) * CHAR_BIT, "");
 
-    mx_paddr_t blk_req_pa_ = 0;
-    virtio_blk_req_t* blk_req_ = nullptr;
+        // the txn submitted with each head descriptor
+        iotxn_t* txns[ring_size] = {};
 
-    mx_paddr_t blk_res_pa_ = 0;
-    uint8_t* blk_res_ = nullptr;
+        // txns waiting for a block request or descriptors
+        list_node pending = LIST_INITIAL_VALUE(pending);
 
-    uint32_t blk_req_bitmap_ = 0;
-    static_assert(blk_req_count <= sizeof(blk_req_bitmap_) * CHAR_BIT, "");
+        size_t alloc_blk_req() {
+            if (blk_req_bitmap == UINT64_MAX)
+                return blk_req_count;
+            size_t i = __builtin_ctzll(~blk_req_bitmap);
+            if (i < blk_req_count)
+                blk_req_bitmap |= (1ull << i);
+            return i;
+        }
 
-    size_t alloc_blk_req() {
-        size_t i = 0;
-        if (blk_req_bitmap_ != 0)
-            i = sizeof(blk_req_bitmap_) * CHAR_BIT - __builtin_clz(blk_req_bitmap_);
-        blk_req_bitmap_ |= (1 << i);
-        return i;
-    }
+        void free_blk_req(size_t i) {
+            blk_req_bitmap &= ~(1ull << i);
+        }
+    };
 
-    void free_blk_req(size_t i) {
-        blk_req_bitmap_ &= ~(1 << i);
-    }
+    mx_status_t InitQueue(Queue* queue, uint16_t index);
+
+    // try to submit every pending txn on the queue, in order
+    void SubmitPendingLocked(Queue* queue);
+    bool SubmitLocked(Queue* queue, iotxn_t* txn);
+
+    // the virtqueues, one per cpu when the device supports it
+    mxtl::unique_ptr<Queue> queues_[max_queues];
+    uint16_t queue_count_ = 0;
+
+    // use indirect descriptors, so that each request takes a single ring entry
+    bool indirect_ = false;
+
+    // saved block device configuration out of the pci config BAR
+    virtio_blk_config_t config_ = {};
 
     // Callbacks for PROTOCOL_BLOCK
     block_callbacks_t* callbacks_;
     block_protocol_ops_t device_block_ops_;
-
-    // pending iotxns
-    list_node iotxn_list = LIST_INITIAL_VALUE(iotxn_list);
 };
 
 } // namespace virtio
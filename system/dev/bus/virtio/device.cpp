@@ -329,6 +329,57 @@ mx_status_t Device::CopyDeviceConfig(void* _buf, size_t len) {
     return MX_OK;
 }
 
+uint32_t Device::DeviceFeatures() {
+    if (!mmio_regs_.common_config) {
+        return ReadConfigBar<uint32_t>(VIRTIO_PCI_DEVICE_FEATURES);
+    } else {
+        mmio_regs_.common_config->device_feature_select = 0;
+        return mmio_regs_.common_config->device_feature;
+    }
+}
+
+void Device::DriverFeaturesAck(uint32_t features) {
+    LTRACEF("features %#x\n", features);
+
+    driver_features_ = features;
+    if (!mmio_regs_.common_config) {
+        WriteConfigBar<uint32_t>(VIRTIO_PCI_DRIVER_FEATURES, features);
+        return;
+    }
+
+    // The modern transport requires the driver to set FEATURES_OK once it has
+    // written the features it wants, and then to check that the device kept the
+    // bit set; if it didn't, the device can't operate with that subset.
+    if (WriteFeaturesModern(features)) {
+        return;
+    }
+
+    printf("virtio: device rejected features %#x, falling back to none\n", features);
+    driver_features_ = 0;
+    Reset();
+    StatusAcknowledgeDriver();
+    if (!WriteFeaturesModern(0)) {
+        printf("virtio: device rejected feature negotiation\n");
+        mmio_regs_.common_config->device_status |= VIRTIO_STATUS_FAILED;
+    }
+}
+
+bool Device::WriteFeaturesModern(uint32_t features) {
+    volatile virtio_pci_common_cfg* cfg = mmio_regs_.common_config;
+
+    cfg->driver_feature_select = 0;
+    cfg->driver_feature = features;
+
+    // VIRTIO_F_VERSION_1 (feature bit 32) must be accepted whenever it is offered
+    cfg->device_feature_select = 1;
+    uint32_t high = cfg->device_feature & 1u;
+    cfg->driver_feature_select = 1;
+    cfg->driver_feature = high;
+
+    cfg->device_status |= VIRTIO_STATUS_FEATURES_OK;
+    return (cfg->device_status & VIRTIO_STATUS_FEATURES_OK) != 0;
+}
+
 uint16_t Device::GetRingSize(uint16_t index) {
     if (!mmio_regs_.common_config) {
         if (bar0_pio_base_) {
@@ -55,6 +55,11 @@ public:
     virtual void IrqRingUpdate() {}
     virtual void IrqConfigChange() {}
 
+    // feature negotiation, limited to the first 32 feature bits
+    uint32_t DeviceFeatures();
+    void DriverFeaturesAck(uint32_t features);
+    bool DriverFeatureEnabled(uint32_t feature) const { return (driver_features_ & feature) != 0; }
+
     // used by Ring class to manipulate config registers
     void SetRing(uint16_t index, uint16_t count, mx_paddr_t pa_desc, mx_paddr_t pa_avail, mx_paddr_t pa_used);
     uint16_t GetRingSize(uint16_t index);
@@ -75,6 +80,10 @@ protected:
 
     mx_status_t MapBar(uint8_t bar);
 
+    // writes the driver features on the modern transport and sets FEATURES_OK,
+    // returning whether the device accepted them
+    bool WriteFeaturesModern(uint32_t features);
+
     // members
     mx_device_t* bus_device_ = nullptr;
     mxtl::Mutex lock_;
@@ -102,6 +111,9 @@ protected:
         volatile void* device_config;
     } mmio_regs_ = {};
 
+    // features accepted by the driver
+    uint32_t driver_features_ = 0;
+
     // irq thread object
     thrd_t irq_thread_ = {};
 
@@ -41,6 +41,7 @@ mx_status_t Ring::Init(uint16_t index, uint16_t count) {
     // XXX check that count is a power of 2
 
     index_ = index;
+    event_idx_ = device_->DriverFeatureEnabled(1u << VIRTIO_RING_F_EVENT_IDX);
 
     // make sure the count is available in this ring
     uint16_t max_ring_size = device_->GetRingSize(index);
@@ -156,14 +157,27 @@ void Ring::SubmitChain(uint16_t desc_index) {
     struct vring_avail* avail = ring_.avail;
 
     avail->ring[avail->idx & ring_.num_mask] = desc_index;
-    //mb();
-    avail->idx++;
+    __atomic_store_n(&avail->idx, (uint16_t)(avail->idx + 1), __ATOMIC_RELEASE);
 }
 
 void Ring::Kick() {
     LTRACE_ENTRY;
 
-    device_->RingKick(index_);
+    uint16_t new_idx = ring_.avail->idx;
+    uint16_t old_idx = kicked_idx_;
+    kicked_idx_ = new_idx;
+
+    // the new avail index must be visible before we look at whether the device wants a kick
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    bool kick;
+    if (event_idx_) {
+        kick = vring_need_event(vring_avail_event(&ring_), new_idx, old_idx);
+    } else {
+        kick = !(ring_.used->flags & VRING_USED_F_NO_NOTIFY);
+    }
+    if (kick)
+        device_->RingKick(index_);
 }
 
 } // namespace virtio
@@ -24,6 +24,9 @@ public:
     uint16_t AllocDesc();
     struct vring_desc* AllocDescChain(uint16_t count, uint16_t* start_index);
     void SubmitChain(uint16_t desc_index);
+
+    // notify the device of every chain submitted since the last kick, unless
+    // the device has told us it does not need to be notified
     void Kick();
 
     struct vring_desc* DescFromIndex(uint16_t index) {
@@ -42,6 +45,12 @@ private:
 
     uint16_t index_ = 0;
 
+    // VIRTIO_RING_F_EVENT_IDX was negotiated
+    bool event_idx_ = false;
+
+    // the avail index at the time of the last Kick()
+    uint16_t kicked_idx_ = 0;
+
     vring ring_ = {};
 };
 
@@ -51,18 +60,28 @@ inline void Ring::IrqRingUpdate(T free_chain) {
     // TRACEF("used flags %#x idx %#x last_used %u\n",
     //         ring_.used->flags, ring_.used->idx, ring_.last_used);
 
-    // find a new free chain of descriptors
-    unsigned int cur_idx = ring_.used->idx;
-    for (unsigned int i = ring_.last_used; i != (cur_idx & ring_.num_mask); i = (i + 1) & ring_.num_mask) {
-        // TRACEF("looking at idx %u\n", i);
+    for (;;) {
+        // find new free chains of descriptors
+        uint16_t cur_idx = __atomic_load_n(&ring_.used->idx, __ATOMIC_ACQUIRE);
+        for (; ring_.last_used != cur_idx; ring_.last_used++) {
+            // TRACEF("looking at idx %u\n", ring_.last_used);
+
+            struct vring_used_elem* used_elem = &ring_.used->ring[ring_.last_used & ring_.num_mask];
+            // TRACEF("used chain id %u, len %u\n", used_elem->id, used_elem->len);
 
-        struct vring_used_elem* used_elem = &ring_.used->ring[i];
-        // TRACEF("used chain id %u, len %u\n", used_elem->id, used_elem->len);
+            // free the chain
+            free_chain(used_elem);
+        }
 
-        // free the chain
-        free_chain(used_elem);
+        if (!event_idx_)
+            break;
 
-        ring_.last_used = ((ring_.last_used + 1) & ring_.num_mask) & 0xffff;
+        // ask for an interrupt when the next chain is used, then pick up any
+        // chains which were used before the device could have seen the request
+        vring_used_event(&ring_) = ring_.last_used;
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring_.used->idx, __ATOMIC_ACQUIRE) == ring_.last_used)
+            break;
     }
 }
 
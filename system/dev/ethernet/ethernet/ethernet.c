@@ -35,6 +35,10 @@
 // This is used for signaling that eth_tx_thread() should exit.
 static const mx_signals_t kSignalFifoTerminate = MX_USER_SIGNAL_0;
 
+// This is used for signaling eth_tx_thread() that filled rx buffers are
+// waiting for space in the rx fifo.
+static const mx_signals_t kSignalRxPending = MX_USER_SIGNAL_1;
+
 // ensure that we will not exceed fifo capacity
 static_assert((FIFO_DEPTH * FIFO_ESIZE) <= 4096, "");
 
@@ -101,6 +105,15 @@ typedef struct ethdev {
 
     mx_device_t* mxdev;
 
+    // rx buffers read from the rx fifo, not yet filled
+    eth_fifo_entry_t rx_free[FIFO_DEPTH];
+    uint32_t rx_free_next;
+    uint32_t rx_free_count;
+
+    // filled rx buffers, not yet written back to the rx fifo
+    eth_fifo_entry_t rx_done[FIFO_DEPTH];
+    uint32_t rx_done_count;
+
     uint32_t fail_rx_read;
     uint32_t fail_rx_write;
     uint32_t fail_tx_write;
@@ -108,50 +121,96 @@ typedef struct ethdev {
 
 #define FAIL_REPORT_RATE 50
 
-static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t extra) {
-    eth_fifo_entry_t e;
+// Returns filled rx buffers to the client. Any which do not fit in the
+// fifo are kept, and the tx thread is asked to try again as soon as the
+// client makes room, so that they are not stranded if no more packets
+// arrive.
+static void eth_flush_rx(ethdev_t* edev) {
+    if (edev->rx_done_count == 0) {
+        return;
+    }
+
     mx_status_t status;
     uint32_t count;
-
-    // TODO: read multiple and cache locally to reduce syscalls
-    if ((status = mx_fifo_read(edev->rx_fifo, &e, sizeof(e), &count)) < 0) {
+    if ((status = mx_fifo_write(edev->rx_fifo, edev->rx_done,
+                                sizeof(eth_fifo_entry_t) * edev->rx_done_count, &count)) < 0) {
         if (status == MX_ERR_SHOULD_WAIT) {
-            if ((edev->fail_rx_read++ % FAIL_REPORT_RATE) == 0) {
-                printf("eth [%s]: no rx buffers available (%u times)\n",
-                       edev->name, edev->fail_rx_read);
+            if ((edev->fail_rx_write++ % FAIL_REPORT_RATE) == 0) {
+                printf("eth [%s]: no rx_fifo space available (%u times)\n",
+                       edev->name, edev->fail_rx_write);
             }
+            mx_object_signal(edev->tx_fifo, 0, kSignalRxPending);
         } else {
             // Fatal, should force teardown
-            printf("eth [%s]: rx fifo read failed %d\n", edev->name, status);
+            printf("eth [%s]: rx_fifo write failed %d\n", edev->name, status);
+            edev->rx_done_count = 0;
         }
         return;
     }
 
-    if ((e.offset >= edev->io_size) || ((e.length > (edev->io_size - e.offset)))) {
+    edev->rx_done_count -= count;
+    if (edev->rx_done_count > 0) {
+        memmove(edev->rx_done, edev->rx_done + count,
+                sizeof(eth_fifo_entry_t) * edev->rx_done_count);
+    }
+}
+
+// Delivers a packet to a client. Unless 'more' is set, every packet
+// delivered so far is returned to the client.
+static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t extra,
+                          bool more) {
+    mx_status_t status;
+    uint32_t count;
+
+    // if the client has not taken the packets we already have, there is
+    // nowhere to put this one
+    if (edev->rx_done_count == FIFO_DEPTH) {
+        eth_flush_rx(edev);
+        if (edev->rx_done_count == FIFO_DEPTH) {
+            return;
+        }
+    }
+
+    // read as many free buffers as are available at once, rather than one per packet
+    if (edev->rx_free_count == 0) {
+        if ((status = mx_fifo_read(edev->rx_fifo, edev->rx_free, sizeof(edev->rx_free),
+                                   &count)) < 0) {
+            if (status == MX_ERR_SHOULD_WAIT) {
+                if ((edev->fail_rx_read++ % FAIL_REPORT_RATE) == 0) {
+                    printf("eth [%s]: no rx buffers available (%u times)\n",
+                           edev->name, edev->fail_rx_read);
+                }
+            } else {
+                // Fatal, should force teardown
+                printf("eth [%s]: rx fifo read failed %d\n", edev->name, status);
+            }
+            eth_flush_rx(edev);
+            return;
+        }
+        edev->rx_free_next = 0;
+        edev->rx_free_count = count;
+    }
+
+    eth_fifo_entry_t* e = &edev->rx_done[edev->rx_done_count++];
+    *e = edev->rx_free[edev->rx_free_next++];
+    edev->rx_free_count--;
+
+    if ((e->offset >= edev->io_size) || ((e->length > (edev->io_size - e->offset)))) {
         // invalid offset/length. report error. drop packet
-        e.length = 0;
-        e.flags = ETH_FIFO_INVALID;
-    } else if (len > e.length) {
-        e.length = 0;
-        e.flags = ETH_FIFO_INVALID;
+        e->length = 0;
+        e->flags = ETH_FIFO_INVALID;
+    } else if (len > e->length) {
+        e->length = 0;
+        e->flags = ETH_FIFO_INVALID;
     } else {
         // packet fits. deliver it
-        memcpy(edev->io_buf + e.offset, data, len);
-        e.length = len;
-        e.flags = ETH_FIFO_RX_OK | extra;
+        memcpy(edev->io_buf + e->offset, data, len);
+        e->length = len;
+        e->flags = ETH_FIFO_RX_OK | extra;
     }
 
-    if ((status = mx_fifo_write(edev->rx_fifo, &e, sizeof(e), &count)) < 0) {
-        if (status == MX_ERR_SHOULD_WAIT) {
-            if ((edev->fail_rx_write++ % FAIL_REPORT_RATE) == 0) {
-                printf("eth [%s]: no rx_fifo space available (%u times)\n",
-                       edev->name, edev->fail_rx_write);
-            }
-        } else {
-            // Fatal, should force teardown
-            printf("eth [%s]: rx_fifo write failed %d\n", edev->name, status);
-        }
-        return;
+    if (!more) {
+        eth_flush_rx(edev);
     }
 }
 
@@ -177,7 +236,7 @@ static void eth0_recv(void* cookie, void* data, size_t len, uint32_t flags) {
     ethdev_t* edev;
     mtx_lock(&edev0->lock);
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
-        eth_handle_rx(edev, data, len, 0);
+        eth_handle_rx(edev, data, len, 0, flags & ETHMAC_RX_OPT_MORE);
     }
     mtx_unlock(&edev0->lock);
 }
@@ -192,7 +251,19 @@ static void eth_tx_echo(ethdev0_t* edev0, const void* data, size_t len) {
     mtx_lock(&edev0->lock);
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
         if (edev->state & ETHDEV_TX_LISTEN) {
-            eth_handle_rx(edev, data, len, ETH_FIFO_RX_TX);
+            eth_handle_rx(edev, data, len, ETH_FIFO_RX_TX, true);
+        }
+    }
+    mtx_unlock(&edev0->lock);
+}
+
+// returns the packets echoed by a batch of eth_tx_echo() calls to the listeners
+static void eth_tx_echo_flush(ethdev0_t* edev0) {
+    ethdev_t* edev;
+    mtx_lock(&edev0->lock);
+    list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
+        if (edev->state & ETHDEV_TX_LISTEN) {
+            eth_flush_rx(edev);
         }
     }
     mtx_unlock(&edev0->lock);
@@ -231,25 +302,49 @@ static mx_status_t eth_tx_listen_locked(ethdev_t* edev, bool yes) {
 static int eth_tx_thread(void* arg) {
     ethdev_t* edev = (ethdev_t*)arg;
     ethdev0_t* edev0 = edev->edev0;
-    eth_fifo_entry_t entries[FIFO_DEPTH / 2];
+    eth_fifo_entry_t entries[FIFO_DEPTH];
     mx_status_t status;
     uint32_t count;
+    // filled rx buffers are waiting for room in the rx fifo
+    bool rx_pending = false;
 
     for (;;) {
         if ((status = mx_fifo_read(edev->tx_fifo, entries, sizeof(entries), &count)) < 0) {
             if (status == MX_ERR_SHOULD_WAIT) {
-                mx_signals_t observed;
-                if ((status = mx_object_wait_one(edev->tx_fifo,
-                                                 MX_FIFO_READABLE |
-                                                 MX_FIFO_PEER_CLOSED |
-                                                 kSignalFifoTerminate,
-                                                 MX_TIME_INFINITE,
-                                                 &observed)) < 0) {
+                mx_wait_item_t items[2] = {
+                    {
+                        .handle = edev->tx_fifo,
+                        .waitfor = MX_FIFO_READABLE | MX_FIFO_PEER_CLOSED |
+                                   kSignalFifoTerminate | kSignalRxPending,
+                    },
+                    {
+                        .handle = edev->rx_fifo,
+                        .waitfor = MX_FIFO_WRITABLE,
+                    },
+                };
+                if ((status = mx_object_wait_many(items, rx_pending ? 2 : 1,
+                                                  MX_TIME_INFINITE)) < 0) {
                     printf("eth [%s]: tx_fifo: error waiting: %d\n", edev->name, status);
                     break;
                 }
-                if (observed & kSignalFifoTerminate)
+                if (items[0].pending & kSignalFifoTerminate)
                     break;
+                if (items[0].pending & kSignalRxPending) {
+                    mx_object_signal(edev->tx_fifo, kSignalRxPending, 0);
+                    rx_pending = true;
+                    continue;
+                }
+                if (rx_pending && (items[1].pending & MX_FIFO_WRITABLE)) {
+                    // teardown holds the lock while waiting for this thread
+                    // to exit, so don't block on it
+                    if (mtx_trylock(&edev0->lock) != thrd_success) {
+                        thrd_yield();
+                        continue;
+                    }
+                    eth_flush_rx(edev);
+                    rx_pending = (edev->rx_done_count > 0);
+                    mtx_unlock(&edev0->lock);
+                }
                 continue;
             } else {
                 printf("eth [%s]: tx_fifo: cannot read: %d\n", edev->name, status);
@@ -274,6 +369,9 @@ static int eth_tx_thread(void* arg) {
             }
             count--;
         }
+        if (edev->state & ETHDEV_TX_LOOPBACK) {
+            eth_tx_echo_flush(edev0);
+        }
 
         if ((status = mx_fifo_write(edev->tx_fifo, entries, sizeof(eth_fifo_entry_t) * n, &count)) < 0) {
             if (status == MX_ERR_SHOULD_WAIT) {
@@ -415,6 +513,20 @@ static mx_status_t eth_stop_locked(ethdev_t* edev) {
     ethdev0_t* edev0 = edev->edev0;
 
     if (edev->state & ETHDEV_RUNNING) {
+        // hand back the rx buffers we hold, filled or not, so the client
+        // does not lose track of them
+        while ((edev->rx_free_count > 0) && (edev->rx_done_count < FIFO_DEPTH)) {
+            eth_fifo_entry_t* e = &edev->rx_done[edev->rx_done_count++];
+            *e = edev->rx_free[edev->rx_free_next++];
+            edev->rx_free_count--;
+            e->length = 0;
+            e->flags = ETH_FIFO_INVALID;
+        }
+        eth_flush_rx(edev);
+        // whatever did not fit is dropped; nothing carries over to the next start
+        edev->rx_done_count = 0;
+        edev->rx_free_count = 0;
+        edev->rx_free_next = 0;
         edev->state &= (~ETHDEV_RUNNING);
         list_delete(&edev->node);
         list_add_tail(&edev0->list_idle, &edev->node);
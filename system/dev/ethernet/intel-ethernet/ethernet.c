@@ -38,6 +38,27 @@ typedef struct ethernet_device {
     void* cookie;
 } ethernet_device_t;
 
+// the most rx packets handled in one pass over the ring
+#define RX_POLL_BUDGET (ETH_RXBUF_COUNT / 2)
+
+// hands up to 'budget' received packets to the ethernet layer, and returns
+// how many were handled
+static size_t eth_poll_rx(ethernet_device_t* edev, size_t budget) {
+    size_t count = 0;
+    void* data;
+    size_t len;
+
+    while ((count < budget) && (eth_rx(&edev->eth, &data, &len) == MX_OK)) {
+        if (edev->ifc) {
+            uint32_t flags = eth_rx_more(&edev->eth) ? ETHMAC_RX_OPT_MORE : 0;
+            edev->ifc->recv(edev->cookie, data, len, flags);
+        }
+        eth_rx_ack(&edev->eth);
+        count++;
+    }
+    return count;
+}
+
 static int irq_thread(void* arg) {
     ethernet_device_t* edev = arg;
     for (;;) {
@@ -54,15 +75,23 @@ static int irq_thread(void* arg) {
         mtx_lock(&edev->lock);
         unsigned irq = eth_handle_irq(&edev->eth);
         if (irq & ETH_IRQ_RX) {
-            void* data;
-            size_t len;
-
-            while (eth_rx(&edev->eth, &data, &len) == MX_OK) {
-                if (edev->ifc) {
-                    edev->ifc->recv(edev->cookie, data, len, 0);
+            // Poll the rx ring with the rx interrupt masked for as long as
+            // each pass fills its budget. The lock is dropped between passes
+            // so that start/stop are not held off under heavy traffic.
+            eth_enable_rx_irq(&edev->eth, false);
+            size_t total = 0;
+            size_t count;
+            do {
+                count = eth_poll_rx(edev, RX_POLL_BUDGET);
+                total += count;
+                if (count == RX_POLL_BUDGET) {
+                    mtx_unlock(&edev->lock);
+                    thrd_yield();
+                    mtx_lock(&edev->lock);
                 }
-                eth_rx_ack(&edev->eth);
-            }
+            } while (count == RX_POLL_BUDGET);
+            eth_enable_rx_irq(&edev->eth, true);
+            eth_update_itr(&edev->eth, total);
         }
         if (irq & ETH_IRQ_LSC) {
             bool was_online = edev->online;
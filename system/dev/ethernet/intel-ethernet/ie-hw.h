@@ -15,6 +15,7 @@
 #define IE_TXCW      0x0178 // TX Config Word
 #define IE_RXCW      0x0180 // RX Config Word
 #define IE_ICR       0x00C0 // Interrupt Cause Read
+#define IE_ITR       0x00C4 // Interrupt Throttling Rate
 #define IE_ICS       0x00C8 // Interrupt Cause Set
 #define IE_IMS       0x00D0 // Interrupt Mask Set / Read
 #define IE_IMC       0x00D8 // Interrupt Mask Clear
@@ -45,6 +45,33 @@ unsigned eth_handle_irq(ethdev_t* eth) {
     return readl(IE_ICR);
 }
 
+void eth_enable_rx_irq(ethdev_t* eth, bool enable) {
+    writel(IE_INT_RXT0, enable ? IE_IMS : IE_IMC);
+}
+
+static void eth_set_itr(ethdev_t* eth, uint32_t rate) {
+    // ITR is the minimum interval between interrupts, in units of 256ns
+    eth->itr = rate;
+    writel(1000000000 / (rate * 256), IE_ITR);
+}
+
+void eth_update_itr(ethdev_t* eth, size_t packets) {
+    // a few packets per interrupt means light traffic, where latency
+    // matters; many means the ring is busy, and interrupts can be spaced
+    // out so that each one does more work
+    uint32_t rate;
+    if (packets <= 2) {
+        rate = ETH_ITR_LOWEST_LATENCY;
+    } else if (packets <= ETH_RXBUF_COUNT / 2) {
+        rate = ETH_ITR_LOW_LATENCY;
+    } else {
+        rate = ETH_ITR_BULK;
+    }
+    if (rate != eth->itr) {
+        eth_set_itr(eth, rate);
+    }
+}
+
 bool eth_status_online(ethdev_t* eth) {
     return readl(IE_STATUS) & IE_STATUS_LU;
 }
@@ -76,6 +103,11 @@ void eth_rx_ack(ethdev_t* eth) {
     eth->rx_rd_ptr = n;
 }
 
+bool eth_rx_more(ethdev_t* eth) {
+    uint32_t n = (eth->rx_rd_ptr + 1) & (ETH_RXBUF_COUNT - 1);
+    return (eth->rxd[n].info & IE_RXD_DONE) != 0;
+}
+
 status_t eth_tx(ethdev_t* eth, const void* data, size_t len) {
     if ((len < 60) || (len > ETH_TXBUF_DSIZE)) {
         return MX_ERR_INVALID_ARGS;
@@ -174,6 +206,9 @@ void eth_init_hw(ethdev_t* eth) {
     writel(ETH_TXBUF_COUNT * 16, IE_TDLEN);
     writel(IE_TCTL_CT(15) | IE_TCTL_COLD_FD | IE_TCTL_EN, IE_TCTL);
 
+    // start out favouring latency
+    eth_set_itr(eth, ETH_ITR_LOW_LATENCY);
+
     // disable all irqs (write to "clear" mask)
     writel(0xFFFF, IE_IMC);
     // enable rx irq (write to "set" mask)
@@ -42,6 +42,9 @@ struct ethdev {
 
     uint8_t mac[6];
 
+    // interrupt throttling rate currently programmed, in interrupts per second
+    uint32_t itr;
+
     mtx_t send_lock;
 };
 
@@ -67,6 +70,8 @@ void eth_dump_regs(ethdev_t* eth);
 
 status_t eth_rx(ethdev_t* eth, void** data, size_t* len);
 void eth_rx_ack(ethdev_t* eth);
+// true if the packet after the one returned by eth_rx() has also been received
+bool eth_rx_more(ethdev_t* eth);
 
 status_t eth_tx(ethdev_t* eth, const void* data, size_t len);
 
@@ -75,3 +80,15 @@ bool eth_status_online(ethdev_t* eth);
 #define ETH_IRQ_RX IE_INT_RXT0
 #define ETH_IRQ_LSC IE_INT_LSC
 unsigned eth_handle_irq(ethdev_t* eth);
+
+// mask or unmask the rx interrupt, while the rx ring is being polled
+void eth_enable_rx_irq(ethdev_t* eth, bool enable);
+
+// interrupt throttling rates, in interrupts per second
+#define ETH_ITR_LOWEST_LATENCY 70000
+#define ETH_ITR_LOW_LATENCY    20000
+#define ETH_ITR_BULK           4000
+
+// pick an interrupt throttling rate from the number of packets
+// handled by the last interrupt
+void eth_update_itr(ethdev_t* eth, size_t packets);
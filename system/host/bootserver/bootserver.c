@@ -27,6 +27,11 @@
 
 char* appname;
 int64_t us_between_packets = DEFAULT_US_BETWEEN_PACKETS;
+// The number of compressed streams to use with the current target, or 0 to
+// send files uncompressed.
+int netboot_streams;
+
+static int max_streams = NB_LZ4_MAX_STREAMS;
 
 static bool use_tftp = false;
 static size_t total_file_size;
@@ -112,14 +117,18 @@ void usage(void) {
             "  -1         only boot once, then exit\n"
             "  -a         only boot device with this IPv6 address\n"
             "  -b <sz>    tftp block size (default=%d, ignored with --netboot)\n"
+            "             the target may answer with a smaller size\n"
             "  -i <NN>    number of microseconds between packets\n"
             "             set between 50-500 to deal with poor bootloader network stacks (default=%d)\n"
             "             (ignored with --tftp)\n"
             "  -n         only boot device with this nodename\n"
+            "  -s <n>     number of parallel streams for compressed netboot\n"
+            "             (default=%d, 0 to send uncompressed, ignored with --tftp)\n"
             "  -w <sz>    tftp window size (default=%d, ignored with --netboot)\n"
             "  --netboot  use the netboot protocol (default)\n"
             "  --tftp     use the tftp protocol\n",
-            appname, DEFAULT_TFTP_BLOCK_SZ, DEFAULT_US_BETWEEN_PACKETS, DEFAULT_TFTP_WIN_SZ);
+            appname, DEFAULT_TFTP_BLOCK_SZ, DEFAULT_US_BETWEEN_PACKETS, NB_LZ4_MAX_STREAMS,
+            DEFAULT_TFTP_WIN_SZ);
     exit(1);
 }
 
@@ -199,7 +208,7 @@ int main(int argc, char** argv) {
             }
             errno = 0;
             tftp_block_size = strtoll(argv[2], NULL, 10);
-            if (errno != 0 || tftp_block_size <= 0) {
+            if (errno != 0 || tftp_block_size <= 0 || tftp_block_size > 65464) {
                 fprintf(stderr, "invalid arg for -b: %s\n", argv[2]);
                 return -1;
             }
@@ -232,6 +241,19 @@ int main(int argc, char** argv) {
             fprintf(stderr, "packet spacing set to %" PRId64 " microseconds\n", us_between_packets);
             argc--;
             argv++;
+        } else if (!strcmp(argv[1], "-s")) {
+            if (argc <= 1) {
+                fprintf(stderr, "'-s' option requires an argument (number of streams)\n");
+                return -1;
+            }
+            errno = 0;
+            max_streams = strtol(argv[2], NULL, 10);
+            if (errno != 0 || max_streams < 0 || max_streams > NB_LZ4_MAX_STREAMS) {
+                fprintf(stderr, "invalid arg for -s: %s\n", argv[2]);
+                return -1;
+            }
+            argc--;
+            argv++;
         } else if (!strcmp(argv[1], "-a")) {
             if (argc <= 1) {
                 fprintf(stderr, "'-a' option requires a valid ipv6 address\n");
@@ -375,6 +397,7 @@ int main(int argc, char** argv) {
         char* save = NULL;
         char* adv_nodename = NULL;
         char* adv_version = "unknown";
+        int adv_streams = 0;
         for (char* var = strtok_r((char*)msg->data, ";", &save);
              var;
              var = strtok_r(NULL, ";", &save)) {
@@ -382,6 +405,8 @@ int main(int argc, char** argv) {
                 adv_nodename = var + 9;
             } else if(!strncmp(var, "version=", 8)) {
                 adv_version = var + 8;
+            } else if (!strncmp(var, "lz4streams=", 11)) {
+                adv_streams = atoi(var + 11);
             }
         }
 
@@ -404,6 +429,9 @@ int main(int argc, char** argv) {
                     appname, appname, adv_version, BOOTLOADER_VERSION, appname);
         }
 
+        // Older bootloaders only accept uncompressed files.
+        netboot_streams = adv_streams < max_streams ? adv_streams : max_streams;
+
         if (cmdline[0]) {
             status = xfer(&ra, "(cmdline)", cmdline);
         } else {
@@ -9,7 +9,14 @@ void update_status(size_t bytes_so_far);
 int tftp_xfer(struct sockaddr_in6* addr, const char* fn, const char* name);
 int netboot_xfer(struct sockaddr_in6* addr, const char* fn, const char* name);
 
-#define DEFAULT_TFTP_BLOCK_SZ 1024
+// Compresses |data| for NB_SEND_FILE_LZ4. The file is compressed chunk by
+// chunk, and the chunks are dealt out in turn to |count| streams. bufs[i] is
+// set to a malloc()ed buffer holding the data for stream i, and lens[i] to
+// its length; the caller frees the buffers, even on failure.
+int netboot_compress(const uint8_t* data, size_t sz, size_t count, char** bufs, size_t* lens);
+
+// The largest block which fits in a 1500 byte MTU over UDP/IPv6
+#define DEFAULT_TFTP_BLOCK_SZ 1448
 #define DEFAULT_TFTP_WIN_SZ 8
 #define DEFAULT_US_BETWEEN_PACKETS 20
 
@@ -17,4 +24,5 @@ extern char* appname;
 extern int64_t us_between_packets;
 extern size_t tftp_block_size;
 extern uint16_t tftp_window_size;
+extern int netboot_streams;
 
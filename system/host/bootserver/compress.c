@@ -0,0 +1,63 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <netinet/in.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <magenta/boot/netboot.h>
+
+#include <lz4frame.h>
+
+#include "bootserver.h"
+
+static const LZ4F_preferences_t lz4_prefs = {
+    .frameInfo = {
+        // Keep the target's buffers for partial blocks small.
+        .blockSizeID = LZ4F_max64KB,
+        .blockMode = LZ4F_blockIndependent,
+    },
+};
+
+int netboot_compress(const uint8_t* data, size_t sz, size_t count, char** bufs, size_t* lens) {
+    size_t chunks = (sz + NB_LZ4_CHUNK_SIZE - 1) / NB_LZ4_CHUNK_SIZE;
+    size_t bound = sizeof(nblz4chunk) + LZ4F_compressFrameBound(NB_LZ4_CHUNK_SIZE, &lz4_prefs);
+    for (size_t i = 0; i < count; i++) {
+        bufs[i] = NULL;
+        lens[i] = 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        size_t share = (chunks - i + count - 1) / count;
+        if ((bufs[i] = malloc(share * bound)) == NULL) {
+            fprintf(stderr, "%s: error: Unable to allocate memory\n", appname);
+            return -1;
+        }
+    }
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        size_t i = chunk % count;
+        char* dst = bufs[i] + lens[i];
+        nblz4chunk hdr;
+
+        size_t offset = chunk * NB_LZ4_CHUNK_SIZE;
+        size_t len = sz - offset;
+        if (len > NB_LZ4_CHUNK_SIZE) {
+            len = NB_LZ4_CHUNK_SIZE;
+        }
+        size_t r = LZ4F_compressFrame(dst + sizeof(hdr), bound - sizeof(hdr),
+                                      data + offset, len, &lz4_prefs);
+        if (LZ4F_isError(r)) {
+            fprintf(stderr, "%s: error: Compression failed: %s\n", appname,
+                    LZ4F_getErrorName(r));
+            return -1;
+        }
+        hdr.index = chunk;
+        hdr.size = r;
+        memcpy(dst, &hdr, sizeof(hdr));
+        lens[i] += sizeof(hdr) + r;
+    }
+    return 0;
+}
@@ -0,0 +1,185 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Round trip of a compressed, multi-stream netboot transfer: bootserver's
+// compression against netsvc's reassembly, with packets lost on the way.
+
+#include <netinet/in.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <magenta/boot/netboot.h>
+
+#include "bootserver.h"
+#include "../../core/netsvc/netboot_lz4.h"
+
+#define PAYLOAD_SIZE 1280
+
+char* appname = "bootserver-lz4-test";
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t pos;
+    bool done;
+    size_t packets;     // packets sent, including lost and repeated ones
+} sender_t;
+
+// Decides which packets the network loses. The first packet of stream 1 is
+// always lost, so that the target sees that stream start part way through.
+typedef bool (*drop_fn)(size_t stream, const sender_t* s);
+
+static bool drop_none(size_t stream, const sender_t* s) {
+    return false;
+}
+
+static bool drop_some(size_t stream, const sender_t* s) {
+    if (s->pos + PAYLOAD_SIZE >= s->len) {
+        // A lost NB_LAST_DATA is only recovered by the host timing out.
+        return false;
+    }
+    if (stream == 1 && s->packets == 0) {
+        return true;
+    }
+    return (s->packets * 7 + stream) % 23 == 0;
+}
+
+static void fill(uint8_t* data, size_t sz) {
+    uint32_t x = 12345;
+    for (size_t i = 0; i < sz; i++) {
+        x = x * 1103515245 + 12345;
+        // Mostly runs, so that it compresses, with some noise.
+        data[i] = (i % 4096 < 3072) ? (uint8_t)(i / 512) : (uint8_t)(x >> 16);
+    }
+}
+
+// Sends |sz| bytes over |count| streams, and checks that the target ends up
+// with a copy of them in a file of |file_size| bytes.
+static bool round_trip(size_t sz, size_t count, size_t file_size, drop_fn drop) {
+    bool ok = false;
+    uint8_t* data = malloc(sz);
+    uint8_t* out = calloc(1, file_size);
+    char* bufs[NB_LZ4_MAX_STREAMS] = { NULL };
+    size_t lens[NB_LZ4_MAX_STREAMS];
+    sender_t senders[NB_LZ4_MAX_STREAMS];
+    if (data == NULL || out == NULL) {
+        fprintf(stderr, "out of memory\n");
+        goto done;
+    }
+    fill(data, sz);
+    if (netboot_compress(data, sz, count, bufs, lens)) {
+        goto done;
+    }
+    memset(senders, 0, sizeof(senders));
+    for (size_t i = 0; i < count; i++) {
+        senders[i].data = bufs[i];
+        senders[i].len = lens[i];
+    }
+
+    nbfile file = { .data = out, .size = file_size, .offset = 0 };
+    nb_lz4_reset();
+
+    // Deal packets out from each stream in turn, as the streams' threads
+    // would, and act on the target's replies as stream_send() does.
+    uint8_t buf[sizeof(nbmsg) + PAYLOAD_SIZE];
+    nbmsg* msg = (void*)buf;
+    size_t remaining = count;
+    for (size_t round = 0; remaining > 0; round++) {
+        if (round > 1000000) {
+            fprintf(stderr, "transfer is not making progress\n");
+            goto done;
+        }
+        for (size_t i = 0; i < count; i++) {
+            sender_t* s = &senders[i];
+            if (s->done) {
+                continue;
+            }
+            size_t len = s->len - s->pos;
+            if (len > PAYLOAD_SIZE) {
+                len = PAYLOAD_SIZE;
+            }
+            msg->magic = NB_MAGIC;
+            msg->cmd = (s->pos + len >= s->len) ? NB_LAST_DATA : NB_DATA;
+            msg->arg = s->pos;
+            memcpy(msg->data, s->data + s->pos, len);
+            bool lost = drop(i, s);
+            s->packets++;
+            if (lost) {
+                s->pos += len;
+                continue;
+            }
+
+            nbmsg ack;
+            if (!nb_lz4_recv(&file, msg, len, (uint16_t)(33000 + i), &ack)) {
+                s->pos += len;
+                continue;
+            }
+            if (ack.cmd == NB_ACK) {
+                s->pos = ack.arg;
+            } else if (ack.cmd == NB_FILE_RECEIVED) {
+                s->done = true;
+                remaining--;
+            } else {
+                fprintf(stderr, "stream %zu: error 0x%08x at %u\n", i, ack.cmd, ack.arg);
+                goto done;
+            }
+        }
+    }
+
+    if (!nb_lz4_done()) {
+        fprintf(stderr, "target is still waiting for a stream\n");
+        goto done;
+    }
+    if (file.offset != sz) {
+        fprintf(stderr, "target received %zu of %zu bytes\n", file.offset, sz);
+        goto done;
+    }
+    if (memcmp(out, data, sz)) {
+        fprintf(stderr, "target received different data\n");
+        goto done;
+    }
+    ok = true;
+
+done:
+    for (size_t i = 0; i < count; i++) {
+        free(bufs[i]);
+    }
+    free(out);
+    free(data);
+    return ok;
+}
+
+#define CHUNK NB_LZ4_CHUNK_SIZE
+
+int main(void) {
+    struct {
+        const char* name;
+        size_t sz;
+        size_t count;
+        size_t file_size;
+        drop_fn drop;
+    } tests[] = {
+        { "one stream", CHUNK / 2 + 17, 1, CHUNK / 2 + 17, drop_none },
+        { "many streams", 5 * CHUNK + 4321, NB_LZ4_MAX_STREAMS, 5 * CHUNK + 4321, drop_none },
+        { "lost packets", 5 * CHUNK + 4321, NB_LZ4_MAX_STREAMS, 5 * CHUNK + 4321, drop_some },
+        { "fewer chunks than streams", CHUNK + 1, 2, CHUNK + 1, drop_some },
+        // The host sent less than it announced: the streams still finish.
+        { "short file", 2 * CHUNK, 2, 3 * CHUNK, drop_some },
+    };
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        bool ok = round_trip(tests[i].sz, tests[i].count, tests[i].file_size, tests[i].drop);
+        printf("%s: %s\n", tests[i].name, ok ? "PASSED" : "FAILED");
+        if (!ok) {
+            failed++;
+        }
+    }
+    nb_lz4_reset();
+    return failed ? 1 : 0;
+}
@@ -10,6 +10,8 @@
 
 #include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,7 +28,8 @@
 
 #define DEFAULT_US_BETWEEN_PACKETS 20
 
-static uint32_t cookie = 1;
+// Shared by all streams, so that the target never sees a cookie twice.
+static atomic_uint cookie = 1;
 static const int MAX_READ_RETRIES = 10;
 static const int MAX_SEND_RETRIES = 10000;
 
@@ -123,7 +126,7 @@ static int io_send(int s, nbmsg* msg, size_t len) {
 }
 
 static int io(int s, nbmsg* msg, size_t len, nbmsg* ack, bool wait_reply) {
-    int r, n;
+    int r = 0, n;
     struct timeval tv;
     fd_set reads, writes;
     fd_set* ws = NULL;
@@ -142,7 +145,7 @@ static int io(int s, nbmsg* msg, size_t len, nbmsg* ack, bool wait_reply) {
     FD_ZERO(&writes);
     if (msg && len > 0) {
         msg->magic = NB_MAGIC;
-        msg->cookie = cookie++;
+        msg->cookie = atomic_fetch_add(&cookie, 1);
 
         FD_SET(s, &writes);
         ws = &writes;
@@ -231,50 +234,39 @@ static int xseek(xferdata* xd, off_t off) {
 // 1280 is friendlier
 #define PAYLOAD_SIZE 1280
 
-int netboot_xfer(struct sockaddr_in6* addr, const char* fn, const char* name) {
+// One stream of a transfer: a whole file, or a share of the compressed
+// chunks of one.
+typedef struct {
+    int s;
     xferdata xd;
-    char msgbuf[2048];
-    char ackbuf[2048];
-    char tmp[INET6_ADDRSTRLEN];
-    struct timeval tv;
-    nbmsg* msg = (void*)msgbuf;
-    nbmsg* ack = (void*)ackbuf;
-    int s, r;
-    int status = -1;
-    size_t current_pos = 0;
-    long sz = 0;
-
-    if (!strcmp(fn, "(cmdline)")) {
-        xd.fp = NULL;
-        xd.data = name;
-        xd.datalen = strlen(name) + 1;
-        xd.ptr = xd.data;
-        xd.avail = xd.datalen;
-        name = "cmdline";
-        sz = xd.datalen;
-    } else {
-        if ((xd.fp = fopen(fn, "rb")) == NULL) {
-            fprintf(stderr, "%s: error: Could not open file %s\n", appname, fn);
-            return -1;
-        }
-        if (fseek(xd.fp, 0L, SEEK_END)) {
-            fprintf(stderr, "%s: error: Could not determine size of %s\n", appname, fn);
-        } else if ((sz = ftell(xd.fp)) < 0) {
-            fprintf(stderr, "%s: error: Could not determine size of %s\n", appname, fn);
-            sz = 0;
-        } else if (fseek(xd.fp, 0L, SEEK_SET)) {
-            fprintf(stderr, "%s: error: Failed to rewind %s\n", appname, fn);
-            return -1;
-        }
-    }
-
-    if (sz > 0) {
-        initialize_status(xd.data, sz);
+    size_t sz;
+    size_t sent;        // guarded by status_lock
+    pthread_t thread;
+    int status;
+} nbstream;
+
+static pthread_mutex_t status_lock = PTHREAD_MUTEX_INITIALIZER;
+static nbstream* streams;
+static size_t stream_count;
+
+static void stream_status(nbstream* st, size_t pos) {
+    pthread_mutex_lock(&status_lock);
+    st->sent = pos;
+    size_t total = 0;
+    for (size_t i = 0; i < stream_count; i++) {
+        total += streams[i].sent;
     }
+    update_status(total);
+    pthread_mutex_unlock(&status_lock);
+}
 
+static int stream_connect(struct sockaddr_in6* addr) {
+    char tmp[INET6_ADDRSTRLEN];
+    struct timeval tv;
+    int s;
     if ((s = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP)) < 0) {
         fprintf(stderr, "%s: error: Cannot create socket %d\n", appname, errno);
-        goto done;
+        return -1;
     }
     tv.tv_sec = 0;
     tv.tv_usec = 250 * 1000;
@@ -283,16 +275,21 @@ int netboot_xfer(struct sockaddr_in6* addr, const char* fn, const char* name) {
         fprintf(stderr, "%s: error: Cannot connect to [%s]%d\n", appname,
                 inet_ntop(AF_INET6, &addr->sin6_addr, tmp, sizeof(tmp)),
                 ntohs(addr->sin6_port));
-        goto done;
+        close(s);
+        return -1;
     }
+    return s;
+}
 
-    msg->cmd = NB_SEND_FILE;
-    msg->arg = sz;
-    strcpy((void*)msg->data, name);
-    if (io(s, msg, sizeof(nbmsg) + strlen(name) + 1, ack, true)) {
-        fprintf(stderr, "%s: error: Failed to start transfer\n", appname);
-        goto done;
-    }
+// Sends the stream's data with NB_DATA, ending with NB_LAST_DATA, and waits
+// for the target to confirm that it has all been received.
+static int stream_send(nbstream* st) {
+    char msgbuf[2048];
+    char ackbuf[2048];
+    nbmsg* msg = (void*)msgbuf;
+    nbmsg* ack = (void*)ackbuf;
+    size_t current_pos = 0;
+    int r;
 
     msg->cmd = NB_DATA;
     msg->arg = 0;
@@ -302,29 +299,29 @@ int netboot_xfer(struct sockaddr_in6* addr, const char* fn, const char* name) {
         struct timeval packet_start_time;
         gettimeofday(&packet_start_time, NULL);
 
-        r = xread(&xd, msg->data, PAYLOAD_SIZE);
+        r = xread(&st->xd, msg->data, PAYLOAD_SIZE);
         if (r < 0) {
-            fprintf(stderr, "\n%s: error: Reading '%s'\n", appname, fn);
-            goto done;
+            fprintf(stderr, "\n%s: error: Reading data\n", appname);
+            return -1;
         }
 
-        update_status(msg->arg);
+        stream_status(st, msg->arg);
 
         if (r == 0) {
             fprintf(stderr, "\n%s: Reached end of file, waiting for confirmation.\n", appname);
             // Do not send anything, but keep waiting on incoming messages
-            if (io(s, NULL, 0, ack, true)) {
-                goto done;
+            if (io(st->s, NULL, 0, ack, true)) {
+                return -1;
             }
         } else {
-            if (current_pos + r >= sz) {
+            if (current_pos + r >= st->sz) {
                 msg->cmd = NB_LAST_DATA;
             } else {
                 msg->cmd = NB_DATA;
             }
 
-            if (io(s, msg, sizeof(nbmsg) + r, ack, false)) {
-                goto done;
+            if (io(st->s, msg, sizeof(nbmsg) + r, ack, false)) {
+                return -1;
             }
 
             // Some UEFI netstacks can lose back-to-back packets at max speed
@@ -348,10 +345,10 @@ int netboot_xfer(struct sockaddr_in6* addr, const char* fn, const char* name) {
             fprintf(stderr, "\n%s: need to rewind to %d from %zu\n",
                     appname, ack->arg, current_pos);
             current_pos = ack->arg;
-            if (xseek(&xd, current_pos)) {
-                fprintf(stderr, "\n%s: error: Failed to rewind '%s' to %zu\n",
-                        appname, fn, current_pos);
-                goto done;
+            if (xseek(&st->xd, current_pos)) {
+                fprintf(stderr, "\n%s: error: Failed to rewind to %zu\n",
+                        appname, current_pos);
+                return -1;
             }
         } else if (ack->cmd == NB_FILE_RECEIVED) {
             completed = true;
@@ -362,13 +359,187 @@ int netboot_xfer(struct sockaddr_in6* addr, const char* fn, const char* name) {
         msg->arg = current_pos;
     } while (!completed);
 
-    status = 0;
+    return 0;
+}
+
+static void* stream_thread(void* arg) {
+    nbstream* st = arg;
+    st->status = stream_send(st);
+    return NULL;
+}
+
+// Opens a transfer of |name|, |sz| bytes, with NB_SEND_FILE or
+// NB_SEND_FILE_LZ4.
+static int send_file_cmd(int s, uint32_t cmd, const char* name, size_t sz) {
+    char msgbuf[2048];
+    char ackbuf[2048];
+    nbmsg* msg = (void*)msgbuf;
+    nbmsg* ack = (void*)ackbuf;
+
+    msg->cmd = cmd;
+    msg->arg = sz;
+    strcpy((void*)msg->data, name);
+    if (io(s, msg, sizeof(nbmsg) + strlen(name) + 1, ack, true)) {
+        fprintf(stderr, "%s: error: Failed to start transfer\n", appname);
+        return -1;
+    }
+    return 0;
+}
+
+// Compresses the file for |count| streams, each with a share of its chunks.
+static int compress_chunks(const uint8_t* data, size_t sz, nbstream* st, size_t count) {
+    char* bufs[NB_LZ4_MAX_STREAMS];
+    size_t lens[NB_LZ4_MAX_STREAMS];
+    int r = netboot_compress(data, sz, count, bufs, lens);
+    for (size_t i = 0; i < count; i++) {
+        st[i].xd.fp = NULL;
+        st[i].xd.data = bufs[i];
+        st[i].xd.datalen = lens[i];
+        st[i].xd.ptr = st[i].xd.data;
+        st[i].xd.avail = st[i].xd.datalen;
+        st[i].sz = st[i].xd.datalen;
+    }
+    return r;
+}
+
+// Sends the file compressed, over several streams at once. The target
+// decompresses each chunk as it arrives, so this is limited only by the
+// link, rather than by one stream waiting on the target's ACKs.
+static int netboot_xfer_lz4(struct sockaddr_in6* addr, const char* fn, const char* name,
+                            FILE* fp, size_t sz) {
+    int status = -1;
+    size_t count = 0;
+    nbstream st[NB_LZ4_MAX_STREAMS];
+    memset(st, 0, sizeof(st));
+    int s = -1;
+
+    uint8_t* data = malloc(sz);
+    if (data == NULL) {
+        fprintf(stderr, "%s: error: Unable to allocate memory\n", appname);
+        return -1;
+    }
+    if (fread(data, 1, sz, fp) != sz) {
+        fprintf(stderr, "%s: error: Could not read %s\n", appname, fn);
+        goto done;
+    }
+
+    count = (sz + NB_LZ4_CHUNK_SIZE - 1) / NB_LZ4_CHUNK_SIZE;
+    if (count > (size_t)netboot_streams) {
+        count = netboot_streams;
+    }
+    if (compress_chunks(data, sz, st, count)) {
+        goto done;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += st[i].sz;
+    }
+    fprintf(stderr, "%s: compressed %s from %zu to %zu bytes, in %zu streams\n",
+            appname, fn, sz, total, count);
+    initialize_status(fn, total);
+
+    if ((s = stream_connect(addr)) < 0) {
+        goto done;
+    }
+    if (send_file_cmd(s, NB_SEND_FILE_LZ4, name, sz)) {
+        goto done;
+    }
+
+    streams = st;
+    stream_count = count;
+    size_t started = 0;
+    for (; started < count; started++) {
+        if ((st[started].s = stream_connect(addr)) < 0) {
+            break;
+        }
+        if (pthread_create(&st[started].thread, NULL, stream_thread, &st[started])) {
+            fprintf(stderr, "%s: error: Cannot create thread\n", appname);
+            close(st[started].s);
+            break;
+        }
+    }
+    status = (started == count) ? 0 : -1;
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(st[i].thread, NULL);
+        close(st[i].s);
+        if (st[i].status) {
+            status = -1;
+        }
+    }
+
 done:
+    streams = NULL;
+    stream_count = 0;
     if (s >= 0) {
         close(s);
     }
-    if (xd.fp != NULL) {
-        fclose(xd.fp);
+    for (size_t i = 0; i < count; i++) {
+        free((void*)st[i].xd.data);
+    }
+    free(data);
+    return status;
+}
+
+int netboot_xfer(struct sockaddr_in6* addr, const char* fn, const char* name) {
+    nbstream st;
+    int status = -1;
+    long sz = 0;
+
+    memset(&st, 0, sizeof(st));
+    st.s = -1;
+    if (!strcmp(fn, "(cmdline)")) {
+        st.xd.fp = NULL;
+        st.xd.data = name;
+        st.xd.datalen = strlen(name) + 1;
+        st.xd.ptr = st.xd.data;
+        st.xd.avail = st.xd.datalen;
+        name = "cmdline";
+        sz = st.xd.datalen;
+    } else {
+        if ((st.xd.fp = fopen(fn, "rb")) == NULL) {
+            fprintf(stderr, "%s: error: Could not open file %s\n", appname, fn);
+            return -1;
+        }
+        if (fseek(st.xd.fp, 0L, SEEK_END)) {
+            fprintf(stderr, "%s: error: Could not determine size of %s\n", appname, fn);
+        } else if ((sz = ftell(st.xd.fp)) < 0) {
+            fprintf(stderr, "%s: error: Could not determine size of %s\n", appname, fn);
+            sz = 0;
+        } else if (fseek(st.xd.fp, 0L, SEEK_SET)) {
+            fprintf(stderr, "%s: error: Failed to rewind %s\n", appname, fn);
+            return -1;
+        }
+
+        if (netboot_streams > 0 && sz > 0) {
+            status = netboot_xfer_lz4(addr, fn, name, st.xd.fp, sz);
+            goto done;
+        }
+    }
+    st.sz = sz;
+
+    if (sz > 0) {
+        initialize_status(st.xd.data, sz);
+    }
+
+    if ((st.s = stream_connect(addr)) < 0) {
+        goto done;
+    }
+    if (send_file_cmd(st.s, NB_SEND_FILE, name, sz)) {
+        goto done;
+    }
+
+    streams = &st;
+    stream_count = 1;
+    status = stream_send(&st);
+    streams = NULL;
+    stream_count = 0;
+
+done:
+    if (st.s >= 0) {
+        close(st.s);
+    }
+    if (st.xd.fp != NULL) {
+        fclose(st.xd.fp);
     }
     return status;
 }
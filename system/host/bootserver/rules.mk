@@ -4,14 +4,43 @@
 
 LOCAL_DIR := $(GET_LOCAL_DIR)
 
+LZ4_DIR := third_party/ulib/lz4
+
 MODULE := $(LOCAL_DIR)
 
 MODULE_TYPE := hostapp
 
 MODULE_SRCS += $(LOCAL_DIR)/bootserver.c
+MODULE_SRCS += $(LOCAL_DIR)/compress.c
 MODULE_SRCS += $(LOCAL_DIR)/netboot.c
 MODULE_SRCS += $(LOCAL_DIR)/tftp.c
+MODULE_SRCS += $(LZ4_DIR)/lz4.c
+MODULE_SRCS += $(LZ4_DIR)/lz4frame.c
+MODULE_SRCS += $(LZ4_DIR)/lz4hc.c
+MODULE_SRCS += $(LZ4_DIR)/xxhash.c
+
+MODULE_CFLAGS := -I$(LZ4_DIR)/include/lz4
+
+MODULE_HOST_SYSLIBS := -lpthread
 
 MODULE_HOST_LIBS := system/ulib/tftp
 
 include make/module.mk
+
+MODULE := $(LOCAL_DIR).lz4-test
+
+MODULE_NAME := bootserver-lz4-test
+
+MODULE_TYPE := hostapp
+
+MODULE_SRCS := $(LOCAL_DIR)/lz4-test.c
+MODULE_SRCS += $(LOCAL_DIR)/compress.c
+MODULE_SRCS += system/core/netsvc/netboot_lz4.c
+MODULE_SRCS += $(LZ4_DIR)/lz4.c
+MODULE_SRCS += $(LZ4_DIR)/lz4frame.c
+MODULE_SRCS += $(LZ4_DIR)/lz4hc.c
+MODULE_SRCS += $(LZ4_DIR)/xxhash.c
+
+MODULE_CFLAGS := -I$(LZ4_DIR)/include -I$(LZ4_DIR)/include/lz4
+
+include make/module.mk
@@ -209,10 +209,12 @@ int tftp_xfer(struct sockaddr_in6* addr, const char* fn, const char* name) {
 
     tftp_session* session = NULL;
     size_t session_data_sz = tftp_sizeof_session();
+    // Room for a DATA message (4 byte header) of the requested block size
+    size_t buf_sz = tftp_block_size + 4 > TFTP_BUF_SZ ? tftp_block_size + 4 : TFTP_BUF_SZ;
 
     if (!(session_data = calloc(session_data_sz, 1))  ||
-        !(inbuf = malloc(TFTP_BUF_SZ)) ||
-        !(outbuf = malloc(TFTP_BUF_SZ))) {
+        !(inbuf = malloc(buf_sz)) ||
+        !(outbuf = malloc(buf_sz))) {
         fprintf(stderr, "%s: error: Unable to allocate memory\n", appname);
         goto done;
     }
@@ -235,9 +237,9 @@ int tftp_xfer(struct sockaddr_in6* addr, const char* fn, const char* name) {
 
     char err_msg[128];
     tftp_request_opts opts = {0};
-    opts.inbuf_sz = TFTP_BUF_SZ;
+    opts.inbuf_sz = buf_sz;
     opts.inbuf = inbuf;
-    opts.outbuf_sz = TFTP_BUF_SZ;
+    opts.outbuf_sz = buf_sz;
     opts.outbuf = outbuf;
     opts.err_msg = err_msg;
     opts.err_msg_sz = sizeof(err_msg);
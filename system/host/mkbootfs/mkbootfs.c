@@ -21,6 +21,7 @@
 #include <lz4frame.h>
 
 #include <magenta/boot/bootdata.h>
+#include <magenta/driver/manifest.h>
 
 #define MAXBUFFER (1024*1024)
 
@@ -36,6 +37,7 @@ int verbose = 0;
 //   namedata   (namelength bytes, includes \0)
 //
 // - fileoffsets must be page aligned (multiple of 4096)
+// - records are sorted by name (BOOTDATA_BOOTFS_FLAG_SORTED)
 
 #define FSENTRYSZ 12
 
@@ -50,6 +52,8 @@ struct fsentry {
     uint32_t length;
 
     char* srcpath;
+    // if non-NULL, the file contents, in place of srcpath
+    void* data;
 };
 
 #define ITEM_BOOTDATA 0
@@ -170,6 +174,278 @@ void add_entry(item_t* fs, fsentry_t* e) {
     fs->hdrsize += e->namelen + FSENTRYSZ;
 }
 
+typedef struct {
+    fsentry_t* e;
+    size_t n;
+} sortentry_t;
+
+static int sortentry_cmp(const void* _a, const void* _b) {
+    const sortentry_t* a = _a;
+    const sortentry_t* b = _b;
+    int r = strcmp(a->e->name, b->e->name);
+    if (r == 0) {
+        // keep duplicates in their original order, so that
+        // the first one listed is still the one found
+        r = (a->n < b->n) ? -1 : 1;
+    }
+    return r;
+}
+
+// Sorts the entries of a bootfs item by name, so that the directory may
+// be binary searched (see BOOTDATA_BOOTFS_FLAG_SORTED).
+static int sort_entries(item_t* item) {
+    size_t count = 0;
+    for (fsentry_t* e = item->first; e != NULL; e = e->next) {
+        count++;
+    }
+    if (count < 2) {
+        return 0;
+    }
+    sortentry_t* list = malloc(count * sizeof(sortentry_t));
+    if (list == NULL) {
+        return -1;
+    }
+    size_t n = 0;
+    for (fsentry_t* e = item->first; e != NULL; e = e->next) {
+        list[n].e = e;
+        list[n].n = n;
+        n++;
+    }
+    qsort(list, count, sizeof(sortentry_t), sortentry_cmp);
+    item->first = list[0].e;
+    for (n = 1; n < count; n++) {
+        list[n - 1].e->next = list[n].e;
+    }
+    item->last = list[count - 1].e;
+    item->last->next = NULL;
+    free(list);
+    return 0;
+}
+
+// Driver manifests
+//
+// For every bootfs directory containing drivers, a driver manifest (see
+// <magenta/driver/manifest.h>) is generated from the drivers' ELF notes
+// and added to the directory, so devmgr need not open each driver at boot.
+//
+// ELF structures are declared locally, as <elf.h> is not available on
+// every host.
+
+typedef struct {
+    uint8_t e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint64_t e_entry;
+    uint64_t e_phoff;
+    uint64_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} elf64_ehdr_t;
+
+typedef struct {
+    uint32_t p_type;
+    uint32_t p_flags;
+    uint64_t p_offset;
+    uint64_t p_vaddr;
+    uint64_t p_paddr;
+    uint64_t p_filesz;
+    uint64_t p_memsz;
+    uint64_t p_align;
+} elf64_phdr_t;
+
+typedef struct {
+    uint32_t n_namesz;
+    uint32_t n_descsz;
+    uint32_t n_type;
+} elf_nhdr_t;
+
+#define ELF_PT_NOTE 4
+#define ELF_CLASS64 2
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    uint32_t count;
+} manifest_buf_t;
+
+// Appends a record for the driver note |desc| (of |descsz| bytes) to |m|.
+static int manifest_add(manifest_buf_t* m, const char* filename,
+                        const uint8_t* desc, size_t descsz) {
+    magenta_driver_note_payload_t payload;
+    if (descsz < sizeof(payload)) {
+        return -1;
+    }
+    memcpy(&payload, desc, sizeof(payload));
+    size_t bindlen = (size_t)payload.bindcount * sizeof(mx_bind_inst_t);
+    if (bindlen > descsz - sizeof(payload)) {
+        return -1;
+    }
+    size_t namelen = strlen(filename) + 1;
+    size_t reclen = DRIVER_MANIFEST_ALIGN(sizeof(driver_manifest_record_t) +
+                                          bindlen + namelen);
+    uint8_t* data = realloc(m->data, m->size + reclen);
+    if (data == NULL) {
+        return -1;
+    }
+    m->data = data;
+
+    driver_manifest_record_t rec = {
+        .reclen = reclen,
+        .namelen = namelen,
+        .payload = payload,
+    };
+    uint8_t* p = m->data + m->size;
+    memset(p, 0, reclen);
+    memcpy(p, &rec, sizeof(rec));
+    memcpy(p + sizeof(rec), desc + sizeof(payload), bindlen);
+    memcpy(p + sizeof(rec) + bindlen, filename, namelen);
+    m->size += reclen;
+    m->count++;
+    return 0;
+}
+
+// If the ELF file |fn| carries a driver note, adds it to |m|.
+static int manifest_add_driver(manifest_buf_t* m, const char* fn, const char* filename) {
+    int fd = open(fn, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "error: cannot open '%s'\n", fn);
+        return -1;
+    }
+    elf64_ehdr_t eh;
+    elf64_phdr_t ph[64];
+    if ((pread(fd, &eh, sizeof(eh), 0) != sizeof(eh)) ||
+        memcmp(eh.e_ident, "\x7f" "ELF", 4) ||
+        (eh.e_ident[4] != ELF_CLASS64) ||
+        (eh.e_phentsize != sizeof(elf64_phdr_t)) ||
+        (eh.e_phnum > countof(ph)) ||
+        (pread(fd, ph, eh.e_phnum * sizeof(elf64_phdr_t), eh.e_phoff) !=
+         (ssize_t)(eh.e_phnum * sizeof(elf64_phdr_t)))) {
+        // not a driver
+        close(fd);
+        return 0;
+    }
+
+    static uint8_t notes[4096];
+    for (unsigned i = 0; i < eh.e_phnum; i++) {
+        if ((ph[i].p_type != ELF_PT_NOTE) || (ph[i].p_filesz > sizeof(notes))) {
+            continue;
+        }
+        size_t size = ph[i].p_filesz;
+        if (pread(fd, notes, size, ph[i].p_offset) != (ssize_t)size) {
+            break;
+        }
+        uint8_t* p = notes;
+        while (size >= sizeof(elf_nhdr_t)) {
+            elf_nhdr_t nh;
+            memcpy(&nh, p, sizeof(nh));
+            size_t nsz = (nh.n_namesz + 3) & (~3);
+            size_t dsz = (nh.n_descsz + 3) & (~3);
+            if ((nsz > size - sizeof(nh)) || (dsz > size - sizeof(nh) - nsz)) {
+                break;
+            }
+            if ((nh.n_type == MAGENTA_NOTE_DRIVER) &&
+                (nh.n_namesz == sizeof(MAGENTA_NOTE_NAME)) &&
+                !memcmp(p + sizeof(nh), MAGENTA_NOTE_NAME, sizeof(MAGENTA_NOTE_NAME))) {
+                close(fd);
+                if (manifest_add(m, filename, p + sizeof(nh) + nsz, nh.n_descsz) < 0) {
+                    fprintf(stderr, "error: bad driver note in '%s'\n", fn);
+                    return -1;
+                }
+                return 0;
+            }
+            p += sizeof(nh) + nsz + dsz;
+            size -= sizeof(nh) + nsz + dsz;
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+// Generates a driver manifest for each directory of |item| that has drivers.
+static int add_driver_manifests(item_t* item) {
+    // Only the entries present before any manifest was added are examined.
+    fsentry_t* last = item->last;
+    for (fsentry_t* dir = item->first; dir != NULL; dir = dir->next) {
+        const char* slash = strrchr(dir->name, '/');
+        size_t dirlen = slash ? (size_t)(slash - dir->name) + 1 : 0;
+
+        // Handle each directory once, when its first entry is found.
+        bool seen = false;
+        for (fsentry_t* e = item->first; e != dir; e = e->next) {
+            const char* s = strrchr(e->name, '/');
+            if ((s ? (size_t)(s - e->name) + 1 : 0) == dirlen &&
+                !memcmp(e->name, dir->name, dirlen)) {
+                seen = true;
+                break;
+            }
+        }
+        if (seen) {
+            if (dir == last) {
+                break;
+            }
+            continue;
+        }
+
+        manifest_buf_t m = {
+            .data = calloc(1, sizeof(driver_manifest_header_t)),
+            .size = sizeof(driver_manifest_header_t),
+            .count = 0,
+        };
+        if (m.data == NULL) {
+            return -1;
+        }
+        for (fsentry_t* e = dir; e != NULL; e = e->next) {
+            const char* filename = e->name + dirlen;
+            size_t len = strlen(filename);
+            if ((e->data == NULL) &&
+                !strncmp(e->name, dir->name, dirlen) && !strchr(filename, '/') &&
+                (len > 3) && !strcmp(filename + len - 3, ".so") &&
+                (manifest_add_driver(&m, e->srcpath, filename) < 0)) {
+                free(m.data);
+                return -1;
+            }
+            if (e == last) {
+                break;
+            }
+        }
+        if (m.count == 0) {
+            free(m.data);
+        } else {
+            driver_manifest_header_t hdr = {
+                .magic = DRIVER_MANIFEST_MAGIC,
+                .version = DRIVER_MANIFEST_VERSION,
+                .count = m.count,
+                .reserved = 0,
+            };
+            memcpy(m.data, &hdr, sizeof(hdr));
+
+            fsentry_t* e;
+            if ((e = calloc(1, sizeof(*e))) == NULL) return -1;
+            e->namelen = dirlen + sizeof(DRIVER_MANIFEST_NAME);
+            if ((e->name = malloc(e->namelen)) == NULL) return -1;
+            memcpy(e->name, dir->name, dirlen);
+            memcpy(e->name + dirlen, DRIVER_MANIFEST_NAME, sizeof(DRIVER_MANIFEST_NAME));
+            e->srcpath = e->name;
+            e->data = m.data;
+            e->length = m.size;
+            add_entry(item, e);
+            if (verbose) {
+                fprintf(stderr, "driver manifest '%s': %u drivers\n", e->name, m.count);
+            }
+        }
+        if (dir == last) {
+            break;
+        }
+    }
+    return 0;
+}
+
 int import_manifest(FILE* fp, const char* fn, item_t* fs) {
     int lineno = 0;
     fsentry_t* e;
@@ -594,7 +870,11 @@ fail:
         if (verbose) {
             fprintf(stderr, "%08x %08x %s\n", e->offset, e->length, e->name);
         }
-        CHECK(op->write_file(fd, e->srcpath, e->length, cookie));
+        if (e->data) {
+            CHECK(op->write(fd, e->data, e->length, cookie));
+        } else {
+            CHECK(op->write_file(fd, e->srcpath, e->length, cookie));
+        }
         if ((n = PAGEFILL(e->length))) {
             CHECK(op->write(fd, fill, n, cookie));
         }
@@ -635,7 +915,8 @@ fail:
                 BOOTDATA_BOOTFS_SYSTEM : BOOTDATA_BOOTFS_BOOT,
         .length = wrote,
         .extra = compressed ? item->outsize : wrote,
-        .flags = compressed ? BOOTDATA_BOOTFS_FLAG_COMPRESSED : 0
+        .flags = BOOTDATA_BOOTFS_FLAG_SORTED |
+                 (compressed ? BOOTDATA_BOOTFS_FLAG_COMPRESSED : 0),
     };
     if (writex(fd, &boothdr, sizeof(boothdr)) < 0) {
         return -1;
@@ -844,6 +1125,9 @@ void usage(void) {
     "notes:   Each manifest or directory is imported as a distinct bootfs\n"
     "         section, tagged for unpacking at /boot or /system based on\n"
     "         the most recent --target= directive.\n"
+    "\n"
+    "         A driver manifest (" DRIVER_MANIFEST_NAME ") is added to each\n"
+    "         bootfs directory containing drivers.\n"
     );
 }
 
@@ -960,6 +1244,19 @@ int main(int argc, char **argv) {
         return -1;
     }
 
+    for (item_t* item = first_item; item != NULL; item = item->next) {
+        if ((item->type == ITEM_BOOTFS_BOOT) || (item->type == ITEM_BOOTFS_SYSTEM)) {
+            if (add_driver_manifests(item) < 0) {
+                fprintf(stderr, "error: failed to generate driver manifests\n");
+                return -1;
+            }
+            if (sort_entries(item) < 0) {
+                fprintf(stderr, "error: out of memory\n");
+                return -1;
+            }
+        }
+    }
+
     // preflight calculations for bootfs items
     for (item_t* item = first_item; item != NULL; item = item->next) {
         switch (item->type) {
@@ -42,6 +42,10 @@
 // Flag indicating that the bootfs is compressed.
 #define BOOTDATA_BOOTFS_FLAG_COMPRESSED  (1 << 0)
 
+// Flag indicating that the bootfs directory entries are sorted by
+// name (in strcmp() order), so a file may be found by binary search.
+#define BOOTDATA_BOOTFS_FLAG_SORTED      (1 << 1)
+
 
 // These items are for passing from bootloader to kernel
 
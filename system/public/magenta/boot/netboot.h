@@ -33,6 +33,7 @@
 #define NB_WRITE             9   // arg=blocknum, data=data
 #define NB_CLOSE             10  // arg=0
 #define NB_LAST_DATA         11  // arg=offset, data=data
+#define NB_SEND_FILE_LZ4     12  // arg=size, data=filename
 
 #define NB_ACK                0 // arg=0 or -err, NB_READ: data=data
 #define NB_FILE_RECEIVED      0x70000001 // arg=size
@@ -57,6 +58,24 @@ typedef struct nbmsg_t {
     uint8_t  data[0];
 } nbmsg;
 
+// Compressed transfers (NB_SEND_FILE_LZ4)
+//
+// The file is divided into NB_LZ4_CHUNK_SIZE chunks, each compressed as an
+// independent LZ4 frame. The frames are spread over up to NB_LZ4_MAX_STREAMS
+// streams, each sent from its own host port with NB_DATA and NB_LAST_DATA,
+// exactly as an uncompressed file would be (arg is the offset within the
+// stream). A stream is a sequence of frames, each preceded by an nblz4chunk
+// header. NB_FILE_RECEIVED acknowledges the end of each stream.
+//
+// Targets which accept compressed transfers advertise "lz4streams=<n>".
+#define NB_LZ4_CHUNK_SIZE     (1024 * 1024)
+#define NB_LZ4_MAX_STREAMS    4
+
+typedef struct nblz4chunk_t {
+    uint32_t index; // offset of the chunk in the file / NB_LZ4_CHUNK_SIZE
+    uint32_t size;  // size of the frame which follows
+} nblz4chunk;
+
 typedef struct nbfile_t {
     uint8_t* data;
     size_t size; // max size of buffer
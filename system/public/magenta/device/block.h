@@ -25,23 +25,35 @@
 // Rebind the block device (if supported)
 #define IOCTL_BLOCK_RR_PART \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 5)
-// Set up a FIFO-based server on the block device; acquire the handle to it
+// Set up a FIFO-based server on the block device; acquire the handle to it.
+// Each open connection to the device may run its own server, so several
+// clients may submit I/O to the same device at once.
+//
+// The server belongs to the connection which created it: the FIFO, TXN and
+// VMO ioctls below act on the caller's own server, and the server is shut
+// down when that connection is closed. Fails with MX_ERR_ALREADY_BOUND only
+// if this connection already has a server running; servers on other
+// connections to the same device do not prevent a new one.
 #define IOCTL_BLOCK_GET_FIFOS \
     IOCTL(IOCTL_KIND_GET_HANDLE, IOCTL_FAMILY_BLOCK, 6)
-// Attach a VMO to the currently running FIFO server
+// Attach a VMO to this connection's FIFO server
 #define IOCTL_BLOCK_ATTACH_VMO \
     IOCTL(IOCTL_KIND_SET_HANDLE, IOCTL_FAMILY_BLOCK, 7)
-// Allocate a txn with the currently running FIFO server
+// Allocate a txn with this connection's FIFO server
 #define IOCTL_BLOCK_ALLOC_TXN \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 8)
-// Free a txn from the currently running FIFO server
+// Free a txn from this connection's FIFO server
 #define IOCTL_BLOCK_FREE_TXN \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 9)
-// Shut down the fifo server, waiting for it to be ready to be started again.
-// Only necessary to guarantee availibility to the next fifo server client;
-// otherwise, closing the client fifo is sufficient to shut down the server.
+// Shut down this connection's fifo server, waiting for it to be ready to be
+// started again. Servers on other connections to the device are unaffected.
+// Only necessary to start a new server on the same connection; otherwise,
+// closing the client fifo or the connection is sufficient to shut it down.
 #define IOCTL_BLOCK_FIFO_CLOSE \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 10)
+// Get I/O statistics, summed across every FIFO server running on the device
+#define IOCTL_BLOCK_GET_STATS \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 11)
 
 // Block Core ioctls (specific to each block device):
 
@@ -96,6 +108,22 @@ IOCTL_WRAPPER_IN(ioctl_block_free_txn, IOCTL_BLOCK_FREE_TXN, txnid_t);
 // ssize_t ioctl_block_fifo_close(int fd);
 IOCTL_WRAPPER(ioctl_block_fifo_close, IOCTL_BLOCK_FIFO_CLOSE);
 
+typedef struct {
+    uint64_t reads;           // Read requests received from the fifo
+    uint64_t writes;          // Write requests received from the fifo
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t device_ops;      // Operations issued to the device
+    uint64_t merged;          // Requests merged into an operation with an adjacent request
+    uint32_t queue_depth;     // Operations currently outstanding on the device
+    uint32_t max_queue_depth;
+    uint64_t total_latency;   // Sum of the latencies of completed device operations, in ns
+    uint64_t max_latency;     // In ns
+} block_stats_t;
+
+// ssize_t ioctl_block_get_stats(int fd, block_stats_t* out);
+IOCTL_WRAPPER_OUT(ioctl_block_get_stats, IOCTL_BLOCK_GET_STATS, block_stats_t);
+
 // Multiple Block IO operations may be sent at once before a response is actually sent back.
 // Block IO ops may be sent concurrently to different vmoids, and they also may be sent
 // to different transactions at any point in time. Up to MAX_TXN_COUNT transactions may
@@ -125,6 +153,9 @@ IOCTL_WRAPPER(ioctl_block_fifo_close, IOCTL_BLOCK_FIFO_CLOSE);
 // - The only requests that receive responses are ones which have the BLOCKIO_TXN_END flag
 //   set. This is the case for both successful and erroneous requests. This property allows
 //   the Block IO server to send back a response on the FIFO without waiting.
+// - The server may reorder outstanding reads and writes, and may merge requests which are
+//   contiguous both on the device and within a VMO. Requests which overlap on the device,
+//   where at least one of them is a write, are issued in the order they were received.
 //
 // For example, the following is a valid sequence of transactions:
 //   -> (txnid = 1, vmoid = 1, OP = Write)
@@ -38,6 +38,19 @@ typedef struct {
 #define IOCTL_DMCTL_WATCH_DEVMGR \
     IOCTL(IOCTL_KIND_SET_HANDLE, IOCTL_FAMILY_DMCTL, 3)
 
+// Returns the system loader service's library cache statistics.
+// Fails with MX_ERR_BAD_STATE if the loader service is not running.
+#define IOCTL_DMCTL_GET_LOADER_STATS \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_DMCTL, 4)
+
+typedef struct {
+    // Library loads served from, and added to, the cache.
+    uint64_t hits;
+    uint64_t misses;
+    // The number of libraries currently cached.
+    uint64_t entries;
+} dmctl_loader_stats_t;
+
 typedef struct {
     uint32_t opcode;
     uint32_t flags;
@@ -78,4 +91,8 @@ IOCTL_WRAPPER_IN(ioctl_dmctl_command, IOCTL_DMCTL_COMMAND, dmctl_cmd_t);
 IOCTL_WRAPPER_IN(ioctl_dmctl_open_virtcon, IOCTL_DMCTL_OPEN_VIRTCON, mx_handle_t);
 
 // ssize_t ioctl_dmctl_watch_devmgr(int fd, dmctl_cmd_t* cmd);
-IOCTL_WRAPPER_IN(ioctl_dmctl_watch_devmgr, IOCTL_DMCTL_WATCH_DEVMGR, mx_handle_t);
\ No newline at end of file
+IOCTL_WRAPPER_IN(ioctl_dmctl_watch_devmgr, IOCTL_DMCTL_WATCH_DEVMGR, mx_handle_t);
+
+// ssize_t ioctl_dmctl_get_loader_stats(int fd, dmctl_loader_stats_t* stats);
+IOCTL_WRAPPER_OUT(ioctl_dmctl_get_loader_stats, IOCTL_DMCTL_GET_LOADER_STATS,
+                  dmctl_loader_stats_t);
@@ -63,6 +63,10 @@
 #define IOCTL_VFS_GET_DEVICE_PATH \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_VFS, 9)
 
+// Return statistics about the path lookup cache of the filesystem server.
+#define IOCTL_VFS_GET_DCACHE_STATS \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_VFS, 10)
+
 typedef struct {
     mx_handle_t channel; // Channel to which watch events will be sent
     uint32_t mask;       // Bitmask of desired events (1 << WATCH_EVT_*)
@@ -147,6 +151,19 @@ IOCTL_WRAPPER_IN(ioctl_vfs_watch_dir_v2, IOCTL_VFS_WATCH_DIR_V2, vfs_watch_dir_t
 // ssize_t ioctl_vfs_get_device_path(int fd, char* out, size_t out_len);
 IOCTL_WRAPPER_VAROUT(ioctl_vfs_get_device_path, IOCTL_VFS_GET_DEVICE_PATH, char);
 
+typedef struct vfs_dcache_stats {
+    uint64_t hits;          // Lookups answered with a cached vnode
+    uint64_t negative_hits; // Lookups answered with a cached "not found"
+    uint64_t misses;        // Lookups passed through to the filesystem
+    uint64_t evictions;     // Entries dropped to make room for others
+    uint64_t invalidations; // Entries dropped because a name changed
+    uint64_t entries;       // Entries currently cached
+    uint64_t capacity;      // Maximum number of entries
+} vfs_dcache_stats_t;
+
+// ssize_t ioctl_vfs_get_dcache_stats(int fd, vfs_dcache_stats_t* out);
+IOCTL_WRAPPER_OUT(ioctl_vfs_get_dcache_stats, IOCTL_VFS_GET_DCACHE_STATS, vfs_dcache_stats_t);
+
 typedef struct {
     mx_handle_t vmo;
     char name[]; // Null-terminator required
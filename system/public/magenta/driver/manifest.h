@@ -0,0 +1,43 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <magenta/compiler.h>
+#include <magenta/driver/binding.h>
+#include <stdint.h>
+
+__BEGIN_CDECLS;
+
+// A driver manifest describes the drivers in one directory, so that
+// devmgr can learn their names and bind programs without opening and
+// parsing each one.  mkbootfs generates one, named DRIVER_MANIFEST_NAME,
+// in every bootfs directory which contains drivers.
+//
+// The file is a driver_manifest_header_t followed by |count| records.
+// Each record is a driver_manifest_record_t, then the bind program
+// (payload.bindcount mx_bind_inst_t), then the driver's file name within
+// the directory (namelen bytes, including the '\0').  Records are padded
+// to a multiple of 4 bytes; reclen includes the padding.
+
+#define DRIVER_MANIFEST_NAME ".drivers"
+#define DRIVER_MANIFEST_MAGIC (0x4d565244) // DRVM
+#define DRIVER_MANIFEST_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+} driver_manifest_header_t;
+
+typedef struct {
+    uint32_t reclen;
+    uint32_t namelen;
+    magenta_driver_note_payload_t payload;
+} driver_manifest_record_t;
+
+#define DRIVER_MANIFEST_ALIGN(n) (((n) + 3) & (~3))
+
+__END_CDECLS;
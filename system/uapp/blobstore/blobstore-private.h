@@ -147,6 +147,9 @@ private:
     ssize_t Read(void* data, size_t len, size_t off) final;
     ssize_t Write(const void* data, size_t len, size_t off) final;
     mx_status_t Lookup(mxtl::RefPtr<fs::Vnode>* out, const char* name, size_t len) final;
+    // Blobs are freed (or hold their contents in memory) until the last
+    // reference is dropped, so only the absence of a blob is cached.
+    bool IsCacheable() const final { return false; }
     mx_status_t Getattr(vnattr_t* a) final;
     mx_status_t Create(mxtl::RefPtr<fs::Vnode>* out, const char* name, size_t len,
                        uint32_t mode) final;
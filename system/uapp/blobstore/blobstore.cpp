@@ -13,7 +13,7 @@
 #include <digest/digest.h>
 #include <digest/merkle-tree.h>
 #include <fs/block-txn.h>
-#include <fs/mxio-dispatcher.h>
+#include <fs/vfs-dispatcher.h>
 #include <magenta/process.h>
 #include <magenta/syscalls.h>
 #include <mxalloc/new.h>
@@ -618,7 +618,10 @@ mx_status_t Blobstore::Create(int fd, const blobstore_info_t* info, mxtl::RefPtr
         return status;
     }
 
-    if ((status = fs::MxioDispatcher::Create(&blobstore_global_dispatcher)) != MX_OK) {
+    // Blobstore is not thread-safe: it has no threads of its own, and all
+    // requests are served by the thread which calls vfs_rpc_server().
+    if ((status = fs::VfsDispatcher::Create(mxrio_handler, 0,
+                                            &blobstore_global_dispatcher)) != MX_OK) {
         return status;
     }
     AllocChecker ac;
@@ -52,6 +52,7 @@ MODULE_SRCS := \
     system/ulib/bitmap/raw-bitmap.cpp \
     system/ulib/digest/digest.cpp \
     system/ulib/digest/merkle-tree.cpp \
+    system/ulib/fs/dentry-cache.cpp \
     system/ulib/fs/vfs.cpp \
     system/ulib/mxalloc/alloc_checker.cpp \
     third_party/ulib/cryptolib/cryptolib.c \
@@ -22,6 +22,7 @@ namespace minfs {
 mx_status_t Bcache::Readblk(uint32_t bno, void* data) {
     off_t off = bno * kMinfsBlockSize;
     FS_TRACE(IO, "readblk() bno=%u off=%#llx\n", bno, (unsigned long long)off);
+    mxtl::AutoLock lock(&lock_);
     if (lseek(fd_, off, SEEK_SET) < 0) {
         FS_TRACE_ERROR("minfs: cannot seek to block %u\n", bno);
         return MX_ERR_IO;
@@ -36,6 +37,7 @@ mx_status_t Bcache::Readblk(uint32_t bno, void* data) {
 mx_status_t Bcache::Writeblk(uint32_t bno, const void* data) {
     off_t off = bno * kMinfsBlockSize;
     FS_TRACE(IO, "writeblk() bno=%u off=%#llx\n", bno, (unsigned long long)off);
+    mxtl::AutoLock lock(&lock_);
     if (lseek(fd_, off, SEEK_SET) < 0) {
         FS_TRACE_ERROR("minfs: cannot seek to block %u\n", bno);
         return MX_ERR_IO;
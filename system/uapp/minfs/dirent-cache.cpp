@@ -0,0 +1,112 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <mxalloc/new.h>
+
+#include "dirent-cache.h"
+#include "minfs.h"
+#include "misc.h"
+
+namespace minfs {
+
+void DirentCache::Reset() {
+    // The name index does not own its records; unlink them first.
+    names_.clear();
+    records_.clear();
+    complete_ = false;
+}
+
+void DirentCache::Update(size_t off, const char* name, size_t len) {
+    if (!complete_) {
+        return;
+    }
+    Record* rec;
+    auto iter = records_.find(static_cast<uint32_t>(off));
+    if (iter.IsValid()) {
+        rec = &*iter;
+        if (rec->name_node_.InContainer()) {
+            names_.erase(*rec);
+        }
+    } else {
+        AllocChecker ac;
+        RecordPtr r(new (&ac) Record(static_cast<uint32_t>(off)));
+        if (!ac.check()) {
+            Reset();
+            return;
+        }
+        rec = r.get();
+        records_.insert(mxtl::move(r));
+    }
+    rec->namelen_ = static_cast<uint8_t>(len);
+    if (len != 0) {
+        rec->hash_ = fnv1a32(name, len);
+        names_.insert(rec);
+    }
+}
+
+void DirentCache::Erase(size_t off) {
+    if (!complete_) {
+        return;
+    }
+    auto iter = records_.find(static_cast<uint32_t>(off));
+    if (!iter.IsValid()) {
+        // The cache no longer matches the directory; stop using it.
+        Reset();
+        return;
+    }
+    if (iter->name_node_.InContainer()) {
+        names_.erase(*iter);
+    }
+    records_.erase(iter);
+}
+
+bool DirentCache::Find(const char* name, size_t len, size_t start, size_t* out) const {
+    if (!complete_) {
+        return false;
+    }
+    uint32_t hash = fnv1a32(name, len);
+    auto iter = names_.lower_bound(MakeKey(hash, start));
+    if (!iter.IsValid() || ((iter->GetNameKey() >> 32) != hash)) {
+        return false;
+    }
+    *out = iter->off_;
+    return true;
+}
+
+bool DirentCache::GetPrev(size_t off, size_t* out) const {
+    if (!complete_) {
+        return false;
+    }
+    auto iter = records_.find(static_cast<uint32_t>(off));
+    if (!iter.IsValid()) {
+        return false;
+    }
+    --iter;
+    *out = iter.IsValid() ? iter->off_ : off;
+    return true;
+}
+
+bool DirentCache::FindSpace(size_t reclen, size_t* out, size_t* out_prev) const {
+    if (!complete_) {
+        return false;
+    }
+    // Record sizes follow from the offset of the next record; the final
+    // record extends to the maximum directory size.
+    size_t prev = 0;
+    for (auto iter = records_.begin(); iter.IsValid();) {
+        size_t off = iter->off_;
+        size_t used = (iter->namelen_ != 0) ? DirentSize(iter->namelen_) : 0;
+        ++iter;
+        size_t end = iter.IsValid() ? iter->off_ : kMinfsMaxDirectorySize;
+        if (end - off >= used + reclen) {
+            *out = off;
+            *out_prev = (off == 0) ? 0 : prev;
+            return true;
+        }
+        prev = off;
+    }
+    return false;
+}
+
+} // namespace minfs
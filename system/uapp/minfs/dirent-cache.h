@@ -0,0 +1,120 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <mxtl/intrusive_wavl_tree.h>
+#include <mxtl/macros.h>
+#include <mxtl/unique_ptr.h>
+
+#include <magenta/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace minfs {
+
+// Directories with fewer entries than this are scanned linearly, rather
+// than being indexed in memory.
+constexpr uint32_t kMinfsDirentCacheMin = 32;
+
+// An in-memory index of the records within a single directory.
+//
+// Every record of the directory, live or free, is tracked by its offset, so
+// that the record preceding any other is known without a scan (and freed
+// entries can be coalesced with their neighbours). Live records are also
+// keyed by a hash of their name. Names are not stored: the caller reads the
+// dirent at a candidate offset and compares the name, so hash collisions are
+// harmless.
+//
+// The cache is either "complete", holding every record of the directory
+// (so a miss is authoritative), or empty. It is populated by one linear scan
+// of the directory, and kept up to date as records are added, filled, freed
+// and merged.
+//
+// This only speeds up access to existing directories: the on-disk format
+// is unchanged, so directories are still limited to kMinfsMaxDirectorySize.
+class DirentCache {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(DirentCache);
+    DirentCache() {}
+    ~DirentCache() { Reset(); }
+
+    bool IsComplete() const { return complete_; }
+
+    // Marks the (empty) cache as complete, so that subsequent updates are
+    // recorded. The caller is expected to add every record of the directory,
+    // in order, immediately afterwards, and to Reset() the cache if that fails.
+    void MarkComplete() { complete_ = true; }
+
+    // Drops all records. The cache is incomplete until it is repopulated.
+    void Reset();
+
+    // Records that the record at offset 'off' holds the dirent for 'name',
+    // or is free if 'len' is zero. The record is added if it is not already
+    // known. If it cannot be recorded, the cache is reset.
+    void Update(size_t off, const char* name, size_t len);
+
+    // Removes the record at offset 'off', which has been merged into the
+    // record preceding it.
+    void Erase(size_t off);
+
+    // Finds the lowest offset at or after 'start' which may hold the dirent
+    // for 'name'. Returns false if there is no such offset.
+    bool Find(const char* name, size_t len, size_t start, size_t* out) const;
+
+    // Returns the offset of the record preceding the one at 'off' (or 'off'
+    // itself, for the first record), as expected in DirectoryOffset.
+    bool GetPrev(size_t off, size_t* out) const;
+
+    // Finds the first record with room for a new dirent of 'reclen' bytes,
+    // either because it is free or because it has space after its own dirent,
+    // in the same order as a linear scan would. Returns the offsets of that
+    // record and of the one preceding it.
+    bool FindSpace(size_t reclen, size_t* out, size_t* out_prev) const;
+
+private:
+    struct Record;
+    using RecordPtr = mxtl::unique_ptr<Record>;
+
+    struct Record {
+        explicit Record(uint32_t off) : off_(off) {}
+        uint32_t GetKey() const { return off_; }
+        uint64_t GetNameKey() const { return MakeKey(hash_, off_); }
+
+        const uint32_t off_;
+        uint32_t hash_ = 0;
+        uint8_t namelen_ = 0;
+        mxtl::WAVLTreeNodeState<RecordPtr> offset_node_;
+        mxtl::WAVLTreeNodeState<Record*> name_node_;
+    };
+
+    struct OffsetNodeTraits {
+        static mxtl::WAVLTreeNodeState<RecordPtr>& node_state(Record& r) {
+            return r.offset_node_;
+        }
+    };
+    struct NameNodeTraits {
+        static mxtl::WAVLTreeNodeState<Record*>& node_state(Record& r) { return r.name_node_; }
+    };
+    struct NameKeyTraits {
+        static uint64_t GetKey(const Record& r) { return r.GetNameKey(); }
+        static bool LessThan(uint64_t k1, uint64_t k2) { return k1 < k2; }
+        static bool EqualTo(uint64_t k1, uint64_t k2) { return k1 == k2; }
+    };
+
+    static uint64_t MakeKey(uint32_t hash, size_t off) {
+        return (static_cast<uint64_t>(hash) << 32) | static_cast<uint32_t>(off);
+    }
+
+    // Owns every record, live or free.
+    mxtl::WAVLTree<uint32_t, RecordPtr,
+                   mxtl::DefaultKeyedObjectTraits<uint32_t, Record>,
+                   OffsetNodeTraits> records_;
+    // Live records only.
+    mxtl::WAVLTree<uint64_t, Record*, NameKeyTraits, NameNodeTraits> names_;
+    bool complete_ = false;
+};
+
+} // namespace minfs
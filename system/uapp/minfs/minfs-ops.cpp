@@ -12,6 +12,7 @@
 #include <sys/stat.h>
 
 #include <fs/block-txn.h>
+#include <fs/vfs.h>
 #include <mxtl/algorithm.h>
 #include <magenta/device/vfs.h>
 
@@ -257,13 +258,52 @@ mx_status_t VnodeMinfs::InitVmo() {
 }
 #endif
 
+uint32_t VnodeMinfs::AllocHint(uint32_t n) {
+    if (n == 0) {
+        return 0;
+    }
+    n--;
+
+    uint32_t bno = 0;
+    if (n < kMinfsDirect) {
+        bno = inode_.dnum[n];
+    } else {
+        n -= kMinfsDirect;
+        uint32_t i = static_cast<uint32_t>(n / (kMinfsBlockSize / sizeof(uint32_t)));
+        uint32_t j = n % (kMinfsBlockSize / sizeof(uint32_t));
+        if ((i >= kMinfsIndirect) || (inode_.inum[i] == 0)) {
+            return 0;
+        }
+#ifdef __Fuchsia__
+        if (vmo_indirect_ == nullptr) {
+            return 0;
+        }
+        uintptr_t iaddr = reinterpret_cast<uintptr_t>(vmo_indirect_->GetData());
+        uint32_t* ientry = reinterpret_cast<uint32_t*>(iaddr + kMinfsBlockSize * i);
+#else
+        uint8_t idata[kMinfsBlockSize];
+        if (fs_->bc_->Readblk(inode_.inum[i], idata) != MX_OK) {
+            return 0;
+        }
+        uint32_t* ientry = reinterpret_cast<uint32_t*>(idata);
+#endif
+        bno = ientry[j];
+    }
+    return (bno == 0) ? 0 : bno + 1;
+}
+
 // Get the bno corresponding to the nth logical block within the file.
-mx_status_t VnodeMinfs::GetBno(WriteTxn* txn, uint32_t n, uint32_t* bno) {
-    uint32_t hint = 0;
+//
+// Newly allocated blocks are placed directly after the preceding block of
+// the file where possible, so sequential data tends to form contiguous runs
+// which BlockTxn can coalesce into single fifo requests. This is best-effort:
+// on a fragmented volume blocks are still scattered. The placement hint is
+// only looked up when a block actually needs to be allocated.
+mx_status_t VnodeMinfs::GetBno(WriteTxn* txn, uint32_t n, uint32_t run, uint32_t* bno) {
     // direct blocks are simple... is there an entry in dnum[]?
     if (n < kMinfsDirect) {
         if (((*bno = inode_.dnum[n]) == 0) && (txn != nullptr)) {
-            mx_status_t status = fs_->BlockNew(txn, hint, bno);
+            mx_status_t status = fs_->BlockNew(txn, AllocHint(n), run, bno);
             if (status != MX_OK) {
                 return status;
             }
@@ -275,6 +315,7 @@ mx_status_t VnodeMinfs::GetBno(WriteTxn* txn, uint32_t n, uint32_t* bno) {
     }
 
     // for indirect blocks, adjust past the direct blocks
+    const uint32_t nfile = n;
     n -= kMinfsDirect;
 
     // determine indices into the indirect block list and into
@@ -297,6 +338,7 @@ mx_status_t VnodeMinfs::GetBno(WriteTxn* txn, uint32_t n, uint32_t* bno) {
 #endif
 
     uint32_t ibno;
+    uint32_t hint = 0;
     bool dirty = false;
 
     // look up the indirect bno
@@ -305,10 +347,12 @@ mx_status_t VnodeMinfs::GetBno(WriteTxn* txn, uint32_t n, uint32_t* bno) {
             *bno = 0;
             return MX_OK;
         }
-        // allocate a new indirect block
-        if ((status = fs_->BlockNew(txn, hint, &ibno)) != MX_OK) {
+        // allocate a new indirect block, with the data block following it
+        hint = AllocHint(nfile);
+        if ((status = fs_->BlockNew(txn, hint, run + 1, &ibno)) != MX_OK) {
             return status;
         }
+        hint = ibno + 1;
 #ifdef __Fuchsia__
         MX_DEBUG_ASSERT(vmo_indirect_ != nullptr);
         uintptr_t iaddr = reinterpret_cast<uintptr_t>(vmo_indirect_->GetData());
@@ -333,8 +377,16 @@ mx_status_t VnodeMinfs::GetBno(WriteTxn* txn, uint32_t n, uint32_t* bno) {
 #endif
 
     if (((*bno = ientry[j]) == 0) && (txn != nullptr)) {
-        // allocate a new block
-        status = fs_->BlockNew(txn, hint, bno);
+        // allocate a new block; when the preceding block of the file is in
+        // this indirect block, it is already at hand
+        if (hint == 0) {
+            if (j > 0) {
+                hint = (ientry[j - 1] == 0) ? 0 : ientry[j - 1] + 1;
+            } else {
+                hint = AllocHint(nfile);
+            }
+        }
+        status = fs_->BlockNew(txn, hint, run, bno);
         if (status != MX_OK) {
             return status;
         }
@@ -448,6 +500,7 @@ mx_status_t VnodeMinfs::UnlinkChild(WriteTxn* txn,
     size_t off = offs->off;
     size_t off_next = off + MinfsReclen(de, off);
     minfs_dirent_t de_prev, de_next;
+    bool merged_next = false;
     mx_status_t status;
 
     // Read the direntries we're considering merging with.
@@ -466,6 +519,7 @@ mx_status_t VnodeMinfs::UnlinkChild(WriteTxn* txn,
         }
         if (de_next.ino == 0) {
             coalesced_size += MinfsReclen(&de_next, off_next);
+            merged_next = true;
             // If the next entry *was* last, then 'de' is now last.
             de->reclen |= (de_next.reclen & kMinfsReclenLast);
         }
@@ -496,6 +550,14 @@ mx_status_t VnodeMinfs::UnlinkChild(WriteTxn* txn,
     if ((status = WriteExactInternal(txn, de, MINFS_DIRENT_SIZE, off)) != MX_OK) {
         return status;
     }
+    if (merged_next) {
+        dirent_cache_.Erase(off_next);
+    }
+    if (off != offs->off) {
+        dirent_cache_.Erase(offs->off);
+    } else {
+        dirent_cache_.Update(off, nullptr, 0);
+    }
 
     if (de->reclen & kMinfsReclenLast) {
         // Truncating the directory merely removed unused space; if it fails,
@@ -644,6 +706,7 @@ static mx_status_t add_dirent(mxtl::RefPtr<VnodeMinfs> vndir,
     if (status != MX_OK) {
         return status;
     }
+    vndir->dirent_cache_.Update(off, args->name, args->len);
     vndir->inode_.dirent_count++;
     if (args->type == kMinfsTypeDir) {
         // Child directory has '..' which will point to parent directory
@@ -734,6 +797,91 @@ mx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func)
     return MX_ERR_NOT_FOUND;
 }
 
+// Records each direntry, live or free, in the directory's dirent cache.
+static mx_status_t cb_dir_cache(mxtl::RefPtr<VnodeMinfs> vndir, minfs_dirent_t* de,
+                                DirArgs* args, DirectoryOffset* offs) {
+    vndir->dirent_cache_.Update(offs->off, de->name, (de->ino != 0) ? de->namelen : 0);
+    return do_next_dirent(de, offs);
+}
+
+mx_status_t VnodeMinfs::PopulateDirentCache() {
+    dirent_cache_.Reset();
+    dirent_cache_.MarkComplete();
+    DirArgs args = DirArgs();
+    mx_status_t status = ForEachDirent(&args, cb_dir_cache);
+    if (status != MX_ERR_NOT_FOUND) {
+        dirent_cache_.Reset();
+        return (status == MX_OK) ? MX_ERR_IO : status;
+    } else if (!dirent_cache_.IsComplete()) {
+        return MX_ERR_NO_MEMORY;
+    }
+    return MX_OK;
+}
+
+mx_status_t VnodeMinfs::ApplyToDirent(DirArgs* args, const DirentCallback func, size_t off,
+                                      size_t off_prev) {
+    char data[kMinfsMaxDirentSize];
+    minfs_dirent_t* de = (minfs_dirent_t*) data;
+    DirectoryOffset offs = {
+        .off = off,
+        .off_prev = off_prev,
+    };
+    size_t r;
+    mx_status_t status = ReadInternal(data, kMinfsMaxDirentSize, offs.off, &r);
+    if (status != MX_OK) {
+        return status;
+    } else if ((status = validate_dirent(de, r, offs.off)) != MX_OK) {
+        return status;
+    }
+
+    switch ((status = func(mxtl::RefPtr<VnodeMinfs>(this), de, args, &offs))) {
+    case DIR_CB_NEXT:
+        return MX_ERR_NOT_FOUND;
+    case DIR_CB_SAVE_SYNC:
+        inode_.seq_num++;
+        InodeSync(args->txn, kMxFsSyncMtime);
+        return MX_OK;
+    case DIR_CB_DONE:
+    default:
+        return status;
+    }
+}
+
+mx_status_t VnodeMinfs::ForNamedDirent(DirArgs* args, const DirentCallback func) {
+    if (!dirent_cache_.IsComplete()) {
+        if ((inode_.dirent_count < kMinfsDirentCacheMin) || (PopulateDirentCache() != MX_OK)) {
+            return ForEachDirent(args, func);
+        }
+    }
+
+    // Each candidate is only a hash match; the callback compares the name,
+    // and moves on if it differs.
+    size_t off = 0;
+    size_t off_prev;
+    while (dirent_cache_.Find(args->name, args->len, off, &off) &&
+           dirent_cache_.GetPrev(off, &off_prev)) {
+        mx_status_t status = ApplyToDirent(args, func, off, off_prev);
+        if (status != MX_ERR_NOT_FOUND) {
+            return status;
+        }
+        off++;
+    }
+    return MX_ERR_NOT_FOUND;
+}
+
+mx_status_t VnodeMinfs::AppendDirent(DirArgs* args) {
+    // The dirent cache knows the size of every record, so the first record
+    // with room can be found without reading the directory.
+    size_t off, off_prev;
+    if (dirent_cache_.FindSpace(args->reclen, &off, &off_prev)) {
+        mx_status_t status = ApplyToDirent(args, cb_dir_append, off, off_prev);
+        if (status != MX_ERR_NOT_FOUND) {
+            return status;
+        }
+    }
+    return ForEachDirent(args, cb_dir_append);
+}
+
 VnodeMinfs::~VnodeMinfs() {
     if (inode_.link_count == 0) {
 #ifdef __Fuchsia__
@@ -851,6 +999,92 @@ ssize_t VnodeMinfs::Write(const void* data, size_t len, size_t off) {
     return actual;
 }
 
+#ifdef __Fuchsia__
+// READ_VMO and WRITE_VMO copy straight between the file's VMO and the
+// client's, rather than through a buffer.
+ssize_t VnodeMinfs::ReadVmo(mx_handle_t vmo, size_t len, size_t off) {
+    FS_TRACE(MINFS, "minfs_read_vmo() vn=%p(#%u) len=%zd off=%zd\n", this, ino_, len, off);
+    if (IsDirectory()) {
+        return MX_ERR_NOT_FILE;
+    }
+    if (off >= inode_.size) {
+        return 0;
+    }
+    if (len > (inode_.size - off)) {
+        len = inode_.size - off;
+    }
+
+    mx_status_t status;
+    size_t actual;
+    if ((status = InitVmo()) != MX_OK) {
+        return status;
+    } else if ((status = fs::vfs_vmo_copy(vmo_.get(), off, vmo, len, true, &actual)) != MX_OK) {
+        return status;
+    }
+    return actual;
+}
+
+ssize_t VnodeMinfs::WriteVmo(mx_handle_t vmo, size_t len, size_t off) {
+    FS_TRACE(MINFS, "minfs_write_vmo() vn=%p(#%u) len=%zd off=%zd\n", this, ino_, len, off);
+    if (IsDirectory()) {
+        return MX_ERR_NOT_FILE;
+    }
+    if (off >= kMinfsMaxFileSize) {
+        return (len == 0) ? 0 : MX_ERR_FILE_BIG;
+    }
+    len = mxtl::min(len, static_cast<size_t>(kMinfsMaxFileSize - off));
+    if (len == 0) {
+        return 0;
+    }
+
+    mx_status_t status;
+    if ((status = InitVmo()) != MX_OK) {
+        return status;
+    }
+    const uint32_t old_size = inode_.size;
+    if ((off + len) > old_size) {
+        if ((status = vmo_.set_size(mxtl::roundup(off + len, kMinfsBlockSize))) != MX_OK) {
+            return status;
+        }
+    }
+
+    // Fill the file's VMO from the client's; WriteInternal() then only has
+    // to allocate blocks and write them back.
+    size_t filled = 0;
+    size_t actual = 0;
+    status = fs::vfs_vmo_copy(vmo_.get(), off, vmo, len, false, &filled);
+    if ((status == MX_OK) && (filled > 0)) {
+        WriteTxn txn(fs_->bc_.get());
+        if ((status = WriteInternal(&txn, nullptr, filled, off, &actual)) == MX_OK) {
+            InodeSync(&txn, kMxFsSyncMtime);  // Successful writes updates mtime
+        }
+    }
+
+    if ((off + len) > old_size && (actual < len)) {
+        // Whatever was not written must not show up if the file is later
+        // extended: zero the rest of the last block, and drop the pages past it.
+        size_t end = mxtl::roundup(inode_.size, kMinfsBlockSize);
+        size_t zero_start = mxtl::max(static_cast<size_t>(inode_.size), off + actual);
+        if (zero_start < end) {
+            static const uint8_t kZeroes[kMinfsBlockSize] = {};
+            VmoWriteExact(kZeroes, zero_start, end - zero_start);
+        }
+        vmo_.set_size(end);
+    }
+    if (status != MX_OK) {
+        return status;
+    }
+    return actual;
+}
+#endif
+
+// Returns the number of blocks touched by a write of 'len' bytes, starting
+// 'adjust' bytes into its first block.
+static uint32_t blocks_remaining(size_t len, size_t adjust) {
+    size_t blocks = (adjust + len + kMinfsBlockSize - 1) / kMinfsBlockSize;
+    return static_cast<uint32_t>(mxtl::min(blocks, static_cast<size_t>(kMinfsMaxFileBlock)));
+}
+
 // Internal write. Usable on directories.
 mx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
                                       size_t len, size_t off, size_t* actual) {
@@ -864,6 +1098,7 @@ mx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
     if ((status = InitVmo()) != MX_OK) {
         return status;
     }
+    const bool in_place = (data == nullptr);
 #endif
     const void* const start = data;
     uint32_t n = static_cast<uint32_t>(off / kMinfsBlockSize);
@@ -881,27 +1116,28 @@ mx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
         size_t xfer_off = n * kMinfsBlockSize + adjust;
         if ((xfer_off + xfer) > inode_.size) {
             size_t new_size = xfer_off + xfer;
-            if ((status = vmo_.set_size(mxtl::roundup(new_size, kMinfsBlockSize))) != MX_OK) {
+            if (!in_place &&
+                (status = vmo_.set_size(mxtl::roundup(new_size, kMinfsBlockSize))) != MX_OK) {
                 goto done;
             }
             inode_.size = static_cast<uint32_t>(new_size);
         }
 
         // Update this block of the in-memory VMO
-        if ((status = VmoWriteExact(data, xfer_off, xfer)) != MX_OK) {
+        if (!in_place && (status = VmoWriteExact(data, xfer_off, xfer)) != MX_OK) {
             return MX_ERR_IO;
         }
 
         // Update this block on-disk
         uint32_t bno;
-        if ((status = GetBno(txn, n, &bno)) != MX_OK) {
+        if ((status = GetBno(txn, n, blocks_remaining(len, adjust), &bno)) != MX_OK) {
             return status;
         }
         assert(bno != 0);
         txn->Enqueue(vmoid_, n, bno, 1);
 #else
         uint32_t bno;
-        if ((status = GetBno(txn, n, &bno)) != MX_OK) {
+        if ((status = GetBno(txn, n, blocks_remaining(len, adjust), &bno)) != MX_OK) {
             goto done;
         }
         assert(bno != 0);
@@ -964,7 +1200,7 @@ mx_status_t VnodeMinfs::LookupInternal(mxtl::RefPtr<fs::Vnode>* out,
     args.name = name;
     args.len = len;
     mx_status_t status;
-    if ((status = ForEachDirent(&args, cb_dir_find)) < 0) {
+    if ((status = ForNamedDirent(&args, cb_dir_find)) < 0) {
         return status;
     }
     mxtl::RefPtr<VnodeMinfs> vn;
@@ -1147,7 +1383,7 @@ mx_status_t VnodeMinfs::Create(mxtl::RefPtr<fs::Vnode>* out, const char* name, s
     args.len = len;
     // ensure file does not exist
     mx_status_t status;
-    if ((status = ForEachDirent(&args, cb_dir_find)) != MX_ERR_NOT_FOUND) {
+    if ((status = ForNamedDirent(&args, cb_dir_find)) != MX_ERR_NOT_FOUND) {
         return MX_ERR_ALREADY_EXISTS;
     }
 
@@ -1178,7 +1414,7 @@ mx_status_t VnodeMinfs::Create(mxtl::RefPtr<fs::Vnode>* out, const char* name, s
     args.type = type;
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(len)));
     args.txn = &txn;
-    if ((status = ForEachDirent(&args, cb_dir_append)) < 0) {
+    if ((status = AppendDirent(&args)) < 0) {
         return status;
     }
 
@@ -1248,7 +1484,7 @@ mx_status_t VnodeMinfs::Unlink(const char* name, size_t len, bool must_be_dir) {
     args.len = len;
     args.type = must_be_dir ? kMinfsTypeDir : 0;
     args.txn = &txn;
-    return ForEachDirent(&args, cb_dir_unlink);
+    return ForNamedDirent(&args, cb_dir_unlink);
 }
 
 mx_status_t VnodeMinfs::Truncate(size_t len) {
@@ -1395,7 +1631,7 @@ mx_status_t VnodeMinfs::Rename(mxtl::RefPtr<fs::Vnode> _newdir, const char* oldn
     DirArgs args = DirArgs();
     args.name = oldname;
     args.len = oldlen;
-    if ((status = ForEachDirent(&args, cb_dir_find)) < 0) {
+    if ((status = ForNamedDirent(&args, cb_dir_find)) < 0) {
         return status;
     } else if ((status = fs_->VnodeGet(&oldvn, args.ino)) < 0) {
         return status;
@@ -1416,11 +1652,11 @@ mx_status_t VnodeMinfs::Rename(mxtl::RefPtr<fs::Vnode> _newdir, const char* oldn
     args.len = newlen;
     args.ino = oldvn->ino_;
     args.type = oldvn->IsDirectory() ? kMinfsTypeDir : kMinfsTypeFile;
-    status = newdir->ForEachDirent(&args, cb_dir_attempt_rename);
+    status = newdir->ForNamedDirent(&args, cb_dir_attempt_rename);
     if (status == MX_ERR_NOT_FOUND) {
         // if 'newname' does not exist, create it
         args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(newlen)));
-        if ((status = newdir->ForEachDirent(&args, cb_dir_append)) < 0) {
+        if ((status = newdir->AppendDirent(&args)) < 0) {
             return status;
         }
     } else if (status != MX_OK) {
@@ -1438,7 +1674,7 @@ mx_status_t VnodeMinfs::Rename(mxtl::RefPtr<fs::Vnode> _newdir, const char* oldn
         args.name = "..";
         args.len = 2;
         args.ino = newdir->ino_;
-        if ((status = vn->ForEachDirent(&args, cb_dir_update_inode)) < 0) {
+        if ((status = vn->ForNamedDirent(&args, cb_dir_update_inode)) < 0) {
             return status;
         }
     }
@@ -1450,7 +1686,7 @@ mx_status_t VnodeMinfs::Rename(mxtl::RefPtr<fs::Vnode> _newdir, const char* oldn
     // finally, remove oldname from its original position
     args.name = oldname;
     args.len = oldlen;
-    return ForEachDirent(&args, cb_dir_force_unlink);
+    return ForNamedDirent(&args, cb_dir_force_unlink);
 }
 
 mx_status_t VnodeMinfs::Link(const char* name, size_t len, mxtl::RefPtr<fs::Vnode> _target) {
@@ -1480,7 +1716,7 @@ mx_status_t VnodeMinfs::Link(const char* name, size_t len, mxtl::RefPtr<fs::Vnod
     args.name = name;
     args.len = len;
     mx_status_t status;
-    if ((status = ForEachDirent(&args, cb_dir_find)) != MX_ERR_NOT_FOUND) {
+    if ((status = ForNamedDirent(&args, cb_dir_find)) != MX_ERR_NOT_FOUND) {
         return (status == MX_OK) ? MX_ERR_ALREADY_EXISTS : status;
     }
 
@@ -1489,7 +1725,7 @@ mx_status_t VnodeMinfs::Link(const char* name, size_t len, mxtl::RefPtr<fs::Vnod
     args.type = kMinfsTypeFile; // We can't hard link directories
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(len)));
     args.txn = &txn;
-    if ((status = ForEachDirent(&args, cb_dir_append)) < 0) {
+    if ((status = AppendDirent(&args)) < 0) {
         return status;
     }
 
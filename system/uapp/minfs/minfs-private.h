@@ -25,6 +25,7 @@
 
 #include <fs/vfs.h>
 
+#include "dirent-cache.h"
 #include "minfs.h"
 #include "misc.h"
 
@@ -70,8 +71,9 @@ public:
     // remove a vnode from the hash map
     void VnodeRelease(VnodeMinfs* vn);
 
-    // Allocate a new data block.
-    mx_status_t BlockNew(WriteTxn* txn, uint32_t hint, uint32_t* out_bno);
+    // Allocate a new data block, preferably at "hint", or at the start of a
+    // free run of "run" contiguous blocks.
+    mx_status_t BlockNew(WriteTxn* txn, uint32_t hint, uint32_t run, uint32_t* out_bno);
 
     // free block in block bitmap
     mx_status_t BlockFree(WriteTxn* txn, uint32_t bno);
@@ -107,13 +109,24 @@ private:
     // Find a free inode, allocate it in the inode bitmap, and write it back to disk
     mx_status_t InoNew(WriteTxn* txn, const minfs_inode_t* inode, uint32_t* ino_out);
 
+    // Frees a block; BlockFree() with alloc_lock_ already held.
+    mx_status_t BlockFreeLocked(WriteTxn* txn, uint32_t bno) __TA_REQUIRES(alloc_lock_);
+
     // Enqueues an update for allocated inode/block counts
-    mx_status_t CountUpdate(WriteTxn* txn);
+    mx_status_t CountUpdate(WriteTxn* txn) __TA_REQUIRES(alloc_lock_);
+
+    // Returns a reference to the live vnode for "ino", if one exists.
+    mxtl::RefPtr<VnodeMinfs> VnodeLookupLocked(uint32_t ino) __TA_REQUIRES(hash_lock_);
 #ifdef __Fuchsia__
     mxtl::unique_ptr<fs::Dispatcher> dispatcher_{nullptr};
 #endif
     uint32_t abmblks_{};
     uint32_t ibmblks_{};
+
+    // Writes to distinct vnodes run concurrently, so the block and inode
+    // bitmaps, and the allocation counts in info_, are guarded by
+    // alloc_lock_.
+    mxtl::Mutex alloc_lock_;
     RawBitmap inode_map_{};
     RawBitmap block_map_{};
 #ifdef __Fuchsia__
@@ -127,8 +140,14 @@ private:
 
     // Vnodes exist in the hash table as long as one or more reference exists;
     // when the Vnode is deleted, it is immediately removed from the map.
+    //
+    // Lookups run concurrently on several dispatcher threads, so the table
+    // is guarded by hash_lock_. A vnode found in the table may have already
+    // dropped its last reference, and be waiting on hash_lock_ to remove
+    // itself; such vnodes are evicted early and replaced, rather than reused.
     using HashTable = mxtl::HashTable<uint32_t, VnodeMinfs*>;
-    HashTable vnode_hash_{};
+    mxtl::Mutex hash_lock_;
+    HashTable vnode_hash_ __TA_GUARDED(hash_lock_);
 };
 
 struct DirArgs {
@@ -176,6 +195,8 @@ public:
     void RemoveInodeLink(WriteTxn* txn);
     mx_status_t ReadInternal(void* data, size_t len, size_t off, size_t* actual);
     mx_status_t ReadExactInternal(void* data, size_t len, size_t off);
+    // On Fuchsia, a null 'data' means the bytes are already in place in
+    // vmo_, which has been sized to hold them (see WriteVmo()).
     mx_status_t WriteInternal(WriteTxn* txn, const void* data, size_t len,
                               size_t off, size_t* actual);
     mx_status_t WriteExactInternal(WriteTxn* txn, const void* data, size_t len,
@@ -190,6 +211,8 @@ public:
     Minfs* fs_{};
     uint32_t ino_{};
     minfs_inode_t inode_{};
+    // Directories only: in-memory index of the directory's entries.
+    DirentCache dirent_cache_{};
 
     ~VnodeMinfs();
 
@@ -203,6 +226,10 @@ private:
     mx_status_t Open(uint32_t flags) final;
     ssize_t Read(void* data, size_t len, size_t off) final;
     ssize_t Write(const void* data, size_t len, size_t off) final;
+#ifdef __Fuchsia__
+    ssize_t ReadVmo(mx_handle_t vmo, size_t len, size_t off) final;
+    ssize_t WriteVmo(mx_handle_t vmo, size_t len, size_t off) final;
+#endif
     mx_status_t Getattr(vnattr_t* a) final;
     mx_status_t Setattr(vnattr_t* a) final;
     mx_status_t Readdir(void* cookie, void* dirents, size_t len) final;
@@ -224,7 +251,17 @@ private:
 
     // Get the disk block 'bno' corresponding to the 'nth' logical block of the file.
     // Allocate the block if requested with a non-null "txn".
-    mx_status_t GetBno(WriteTxn* txn, uint32_t n, uint32_t* bno);
+    mx_status_t GetBno(WriteTxn* txn, uint32_t n, uint32_t* bno) {
+        return GetBno(txn, n, 1, bno);
+    }
+    // As above, but 'run' is the number of consecutive logical blocks, starting
+    // at 'n', which the caller is about to allocate. They are kept contiguous on
+    // disk where possible, so they can be transferred with a single request.
+    mx_status_t GetBno(WriteTxn* txn, uint32_t n, uint32_t run, uint32_t* bno);
+
+    // Returns the disk block immediately following the one backing logical
+    // block 'n - 1', or zero if there is no such block.
+    uint32_t AllocHint(uint32_t n);
 
     // Deletes all blocks (relateive to a file) from "start" (inclusive) to the end
     // of the file. Does not update mtime/atime.
@@ -240,6 +277,23 @@ private:
     // Directories only
     mx_status_t ForEachDirent(DirArgs* args, const DirentCallback func);
 
+    // Like ForEachDirent, but only for callbacks which act upon the dirent
+    // named by 'args->name'. Large directories locate it via the dirent cache,
+    // rather than scanning.
+    mx_status_t ForNamedDirent(DirArgs* args, const DirentCallback func);
+
+    // Adds the dirent described by 'args' to the directory.
+    mx_status_t AppendDirent(DirArgs* args);
+
+    // Invokes 'func' on the dirent at offset 'off', which must be a record
+    // boundary preceded by the record at 'off_prev'. Returns MX_ERR_NOT_FOUND
+    // if the callback moves on.
+    mx_status_t ApplyToDirent(DirArgs* args, const DirentCallback func, size_t off,
+                              size_t off_prev);
+
+    // Indexes every record of the directory in the dirent cache.
+    mx_status_t PopulateDirentCache();
+
 #ifdef __Fuchsia__
     fs::Dispatcher* GetDispatcher() final;
 
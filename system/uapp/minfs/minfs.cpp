@@ -94,6 +94,7 @@ Minfs::Minfs(mxtl::unique_ptr<Bcache> bc, const minfs_info_t* info) : bc_(mxtl::
 }
 
 Minfs::~Minfs() {
+    mxtl::AutoLock lock(&hash_lock_);
     vnode_hash_.clear();
 }
 
@@ -104,6 +105,7 @@ mx_status_t Minfs::InoFree(
     const minfs_inode_t& inode, uint32_t ino) {
     // We're going to be updating block bitmaps repeatedly.
     WriteTxn txn(bc_.get());
+    mxtl::AutoLock lock(&alloc_lock_);
 #ifdef __Fuchsia__
     auto ibm_id = inode_map_vmoid_;
 #else
@@ -125,7 +127,7 @@ mx_status_t Minfs::InoFree(
         }
         ValidateBno(inode.dnum[n]);
         block_count--;
-        BlockFree(&txn, inode.dnum[n]);
+        BlockFreeLocked(&txn, inode.dnum[n]);
     }
 
     // release all indirect blocks
@@ -147,11 +149,11 @@ mx_status_t Minfs::InoFree(
                 continue;
             }
             block_count--;
-            BlockFree(&txn, entry[m]);
+            BlockFreeLocked(&txn, entry[m]);
         }
         // release the direct block itself
         block_count--;
-        BlockFree(&txn, inode.inum[n]);
+        BlockFreeLocked(&txn, inode.inum[n]);
     }
 
     CountUpdate(&txn);
@@ -160,6 +162,7 @@ mx_status_t Minfs::InoFree(
 }
 
 mx_status_t Minfs::InoNew(WriteTxn* txn, const minfs_inode_t* inode, uint32_t* ino_out) {
+    mxtl::AutoLock lock(&alloc_lock_);
     size_t bitoff_start;
     mx_status_t status = inode_map_.Find(false, 0, inode_map_.size(), 1, &bitoff_start);
     if (status != MX_OK) {
@@ -219,48 +222,78 @@ mx_status_t Minfs::VnodeNew(WriteTxn* txn, mxtl::RefPtr<VnodeMinfs>* out, uint32
         return status;
     }
 
-    vnode_hash_.insert(vn.get());
+    {
+        mxtl::AutoLock lock(&hash_lock_);
+        vnode_hash_.insert(vn.get());
+    }
 
     *out = mxtl::move(vn);
     return 0;
 }
 
 void Minfs::VnodeRelease(VnodeMinfs* vn) {
-    vnode_hash_.erase(*vn);
+    mxtl::AutoLock lock(&hash_lock_);
+    // The vnode may have already been evicted by VnodeGet.
+    if (vn->InContainer()) {
+        vnode_hash_.erase(*vn);
+    }
 }
 
 mx_status_t Minfs::VnodeGet(mxtl::RefPtr<VnodeMinfs>* out, uint32_t ino) {
     if ((ino < 1) || (ino >= info_.inode_count)) {
         return MX_ERR_OUT_OF_RANGE;
     }
-    mxtl::RefPtr<VnodeMinfs> vn = mxtl::RefPtr<VnodeMinfs>(vnode_hash_.find(ino).CopyPointer());
-    if (vn != nullptr) {
-        *out = mxtl::move(vn);
-        return MX_OK;
-    }
-    mx_status_t status;
-    if ((status = VnodeMinfs::AllocateHollow(this, &vn)) != MX_OK) {
-        return MX_ERR_NO_MEMORY;
-    }
+    mxtl::RefPtr<VnodeMinfs> vn;
+    {
+        mxtl::AutoLock lock(&hash_lock_);
+        if ((vn = VnodeLookupLocked(ino)) == nullptr) {
+            mx_status_t status;
+            if ((status = VnodeMinfs::AllocateHollow(this, &vn)) != MX_OK) {
+                return MX_ERR_NO_MEMORY;
+            }
 
-    // obtain the block of the inode table we need
-    uint32_t off_of_ino = (ino % kMinfsInodesPerBlock) * kMinfsInodeSize;
+            // obtain the block of the inode table we need
+            uint32_t off_of_ino = (ino % kMinfsInodesPerBlock) * kMinfsInodeSize;
 #ifdef __Fuchsia__
-    void* inodata = (void*)((uintptr_t)(inode_table_->GetData()) +
-                            (uintptr_t)((ino / kMinfsInodesPerBlock) * kMinfsBlockSize));
+            void* inodata = (void*)((uintptr_t)(inode_table_->GetData()) +
+                                    (uintptr_t)((ino / kMinfsInodesPerBlock) * kMinfsBlockSize));
 #else
-    uint8_t inodata[kMinfsBlockSize];
-    bc_->Readblk(info_.ino_block + (ino / kMinfsInodesPerBlock), inodata);
+            uint8_t inodata[kMinfsBlockSize];
+            bc_->Readblk(info_.ino_block + (ino / kMinfsInodesPerBlock), inodata);
 #endif
-    memcpy(&vn->inode_, (void*)((uintptr_t)inodata + off_of_ino), kMinfsInodeSize);
-    vn->ino_ = ino;
-    vnode_hash_.insert(vn.get());
+            memcpy(&vn->inode_, (void*)((uintptr_t)inodata + off_of_ino), kMinfsInodeSize);
+            vn->ino_ = ino;
+            vnode_hash_.insert(vn.get());
+        }
+    }
 
+    // Assigned outside of hash_lock_: this may release the last reference
+    // to a vnode previously held in 'out'.
     *out = mxtl::move(vn);
     return MX_OK;
 }
 
+mxtl::RefPtr<VnodeMinfs> Minfs::VnodeLookupLocked(uint32_t ino) {
+    auto iter = vnode_hash_.find(ino);
+    if (!iter.IsValid()) {
+        return nullptr;
+    }
+    mxtl::RefPtr<VnodeMinfs> vn = mxtl::MakeRefPtrUpgradeFromRaw(iter.CopyPointer());
+    if (vn == nullptr) {
+        // The vnode has dropped its last reference, and is waiting on
+        // hash_lock_ to remove itself. Its inode has already been written
+        // back, so evict it now and let the caller load a fresh copy.
+        vnode_hash_.erase(iter);
+    }
+    return vn;
+}
+
 mx_status_t Minfs::BlockFree(WriteTxn* txn, uint32_t bno) {
+    mxtl::AutoLock lock(&alloc_lock_);
+    return BlockFreeLocked(txn, bno);
+}
+
+mx_status_t Minfs::BlockFreeLocked(WriteTxn* txn, uint32_t bno) {
     ValidateBno(bno);
 
 #ifdef __Fuchsia__
@@ -279,13 +312,27 @@ mx_status_t Minfs::BlockFree(WriteTxn* txn, uint32_t bno) {
 // Allocate a new data block from the block bitmap.
 //
 // If hint is nonzero it indicates which block number to start the search for
-// free blocks from.
-mx_status_t Minfs::BlockNew(WriteTxn* txn, uint32_t hint, uint32_t* out_bno) {
+// free blocks from. A free hint block is taken as-is, so a file which is being
+// extended stays contiguous on disk.
+//
+// Otherwise, the block is placed at the start of a free run of "run" blocks
+// (if one exists), leaving room for the rest of a multi-block write to follow
+// it. Falls back to any free block when no such run can be found.
+mx_status_t Minfs::BlockNew(WriteTxn* txn, uint32_t hint, uint32_t run, uint32_t* out_bno) {
+    mxtl::AutoLock lock(&alloc_lock_);
     size_t bitoff_start;
     mx_status_t status;
-    if ((status = block_map_.Find(false, hint, block_map_.size(), 1, &bitoff_start)) != MX_OK) {
-        if ((status = block_map_.Find(false, 0, hint, 1, &bitoff_start)) != MX_OK) {
-            return MX_ERR_NO_SPACE;
+    if (run == 0) {
+        run = 1;
+    }
+    if ((hint != 0) && (hint < block_map_.size()) && !block_map_.Get(hint, hint + 1)) {
+        bitoff_start = hint;
+    } else if ((block_map_.Find(false, hint, block_map_.size(), run, &bitoff_start) != MX_OK) &&
+               (block_map_.Find(false, 0, hint, run, &bitoff_start) != MX_OK)) {
+        if ((status = block_map_.Find(false, hint, block_map_.size(), 1, &bitoff_start)) != MX_OK) {
+            if ((status = block_map_.Find(false, 0, hint, 1, &bitoff_start)) != MX_OK) {
+                return MX_ERR_NO_SPACE;
+            }
         }
     }
 
@@ -353,7 +400,7 @@ void minfs_dir_init(void* bdata, uint32_t ino_self, uint32_t ino_parent) {
 }
 
 #ifdef __Fuchsia__
-static const unsigned kPoolSize = 4;
+static const unsigned kPoolSize = 8;
 #endif
 
 mx_status_t Minfs::Create(Minfs** out, mxtl::unique_ptr<Bcache> bc, const minfs_info_t* info) {
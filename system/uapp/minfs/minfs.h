@@ -8,7 +8,9 @@
 #include <bitmap/storage.h>
 #include <mxtl/intrusive_double_list.h>
 #include <mxtl/intrusive_hash_table.h>
+#include <mxtl/auto_lock.h>
 #include <mxtl/macros.h>
+#include <mxtl/mutex.h>
 #include <mxtl/ref_counted.h>
 #include <mxtl/ref_ptr.h>
 #include <mxtl/type_support.h>
@@ -182,6 +184,7 @@ public:
     ssize_t GetDevicePath(char* out, size_t out_len);
     mx_status_t AttachVmo(mx_handle_t vmo, vmoid_t* out);
     mx_status_t Txn(block_fifo_request_t* requests, size_t count) {
+        mxtl::AutoLock lock(&lock_);
         return block_fifo_txn(fifo_client_, requests, count);
     }
     txnid_t TxnId() const { return txnid_; }
@@ -194,6 +197,10 @@ public:
 private:
     Bcache(int fd, uint32_t blockmax);
 
+    // Requests may be issued from several dispatcher threads at once.
+    // Block reads and writes share the file offset of fd_, and fifo
+    // transactions share a single txnid, so both are serialized.
+    mxtl::Mutex lock_;
 #ifdef __Fuchsia__
     fifo_client_t* fifo_client_{}; // Fast path to interact with block device
     txnid_t txnid_{}; // TODO(smklein): One per thread
@@ -18,6 +18,7 @@ MODULE_SRCS += \
 
 # minfs implementation
 MODULE_SRCS += \
+    $(LOCAL_DIR)/dirent-cache.cpp \
     $(LOCAL_DIR)/minfs.cpp \
     $(LOCAL_DIR)/minfs-ops.cpp \
     $(LOCAL_DIR)/minfs-check.cpp \
@@ -54,8 +55,10 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/test.cpp \
     $(LOCAL_DIR)/host.cpp \
     $(LOCAL_DIR)/bcache.cpp \
+    $(LOCAL_DIR)/dirent-cache.cpp \
     $(LOCAL_DIR)/minfs.cpp \
     $(LOCAL_DIR)/minfs-ops.cpp \
+    system/ulib/fs/dentry-cache.cpp \
     system/ulib/fs/vfs.cpp \
     system/ulib/mxalloc/alloc_checker.cpp \
     system/ulib/bitmap/raw-bitmap.cpp \
@@ -305,6 +305,81 @@ int test_rename() {
     return 0;
 }
 
+int test_bigdir() {
+    // Enough entries for the directory to be indexed by the dirent cache.
+    const int kEntries = 512;
+    char path[64];
+    TRY(emu_mkdir("::bigdir", 0755));
+    for (int i = 0; i < kEntries; i++) {
+        snprintf(path, sizeof(path), "::bigdir/file%04d", i);
+        int fd = TRY(emu_open(path, O_RDWR | O_CREAT | O_EXCL, 0644));
+        emu_close(fd);
+    }
+    struct stat s;
+    for (int i = 0; i < kEntries; i++) {
+        snprintf(path, sizeof(path), "::bigdir/file%04d", i);
+        TRY(emu_stat(path, &s));
+        EXPECT_FAIL(emu_open(path, O_RDWR | O_CREAT | O_EXCL, 0644));
+    }
+    EXPECT_FAIL(emu_stat("::bigdir/missing", &s));
+    // Punch holes in the directory, then refill them.
+    for (int i = 0; i < kEntries; i += 2) {
+        snprintf(path, sizeof(path), "::bigdir/file%04d", i);
+        TRY(emu_unlink(path));
+        EXPECT_FAIL(emu_stat(path, &s));
+    }
+    for (int i = 0; i < kEntries; i += 2) {
+        snprintf(path, sizeof(path), "::bigdir/file%04d", i);
+        int fd = TRY(emu_open(path, O_RDWR | O_CREAT | O_EXCL, 0644));
+        emu_close(fd);
+    }
+    // Neighbouring entries freed one after another are merged, and the space
+    // is reused for a name which needs all of it, without growing the directory.
+    TRY(emu_stat("::bigdir", &s));
+    off_t size = s.st_size;
+    for (int i = 100; i < 104; i++) {
+        snprintf(path, sizeof(path), "::bigdir/file%04d", i);
+        TRY(emu_unlink(path));
+    }
+    const char* kLongName = "::bigdir/a-name-which-only-fits-in-four-coalesced-entries-xyz";
+    int fd = TRY(emu_open(kLongName, O_RDWR | O_CREAT | O_EXCL, 0644));
+    emu_close(fd);
+    TRY(emu_stat("::bigdir", &s));
+    if (s.st_size != size) {
+        fprintf(stderr, "bigdir: grew from %lld to %lld bytes\n",
+                (long long)size, (long long)s.st_size);
+        return -1;
+    }
+    TRY(emu_unlink(kLongName));
+    for (int i = 100; i < 104; i++) {
+        snprintf(path, sizeof(path), "::bigdir/file%04d", i);
+        fd = TRY(emu_open(path, O_RDWR | O_CREAT | O_EXCL, 0644));
+        emu_close(fd);
+    }
+    DIR* dir = emu_opendir("::bigdir");
+    if (dir == nullptr) {
+        return -1;
+    }
+    int count = 0;
+    struct dirent* de;
+    while ((de = emu_readdir(dir)) != nullptr) {
+        if (strcmp(de->d_name, ".") && strcmp(de->d_name, "..")) {
+            count++;
+        }
+    }
+    emu_closedir(dir);
+    if (count != kEntries) {
+        fprintf(stderr, "bigdir: found %d entries, expected %d\n", count, kEntries);
+        return -1;
+    }
+    for (int i = 0; i < kEntries; i++) {
+        snprintf(path, sizeof(path), "::bigdir/file%04d", i);
+        TRY(emu_unlink(path));
+    }
+    TRY(emu_unlink("::bigdir"));
+    return 0;
+}
+
 int run_fs_tests(int argc, char** argv) {
     fprintf(stderr, "--- fs tests ---\n");
     if (argc > 0) {
@@ -320,6 +395,9 @@ int run_fs_tests(int argc, char** argv) {
         if (!strcmp(argv[0], "rename")) {
             return test_rename();
         }
+        if (!strcmp(argv[0], "bigdir")) {
+            return test_bigdir();
+        }
         fprintf(stderr, "unknown test: %s\n", argv[0]);
         return -1;
     }
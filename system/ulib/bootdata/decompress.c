@@ -5,11 +5,13 @@
 #include <bootdata/decompress.h>
 
 #include <limits.h>
+#include <stdatomic.h>
 #include <string.h>
 
 #include <magenta/boot/bootdata.h>
 #include <magenta/compiler.h>
 #include <magenta/syscalls.h>
+#include <runtime/thread.h>
 
 #include <lz4/lz4.h>
 
@@ -85,7 +87,197 @@ static mx_status_t check_lz4_frame(const lz4_frame_desc* fd,
     return MX_OK;
 }
 
-static mx_status_t decompress_bootfs_vmo(mx_handle_t vmar,
+// Decompresses the blocks starting at |data| into |dst|, one after the
+// other.  On success, |*used| is the number of bytes written.
+static mx_status_t decompress_sequential(const uint8_t* data, uint8_t* dst,
+                                         size_t remaining, size_t* used,
+                                         const char** err) {
+    size_t start = remaining;
+
+    // Read each LZ4 block and decompress it. Block sizes are 32 bits.
+    uint32_t blocksize = *(const uint32_t*)data;
+    data += sizeof(uint32_t);
+    while (blocksize) {
+        // If the data is uncompressed, the high bit is 1.
+        if (blocksize >> 31) {
+            uint32_t actual = blocksize & 0x7fffffff;
+            if (actual > remaining) {
+                *err = "bootdata outsize too small for lz4 decompression";
+                return MX_ERR_INVALID_ARGS;
+            }
+            memcpy(dst, data, actual);
+            dst += actual;
+            data += actual;
+            remaining -= actual;
+        } else {
+            int dcmp = LZ4_decompress_safe((const char*)data, (char*)dst, blocksize, remaining);
+            if (dcmp < 0) {
+                *err = "lz4 decompression failed";
+                return MX_ERR_BAD_STATE;
+            }
+            dst += dcmp;
+            data += blocksize;
+            if (remaining - dcmp > remaining) {
+                // Remaining wrapped around (would be negative if signed)
+                *err = "bootdata outsize too small for lz4 decompression";
+                return MX_ERR_INVALID_ARGS;
+            }
+            remaining -= dcmp;
+        }
+
+        blocksize = *(uint32_t*)data;
+        data += sizeof(uint32_t);
+    }
+    *used = start - remaining;
+    return MX_OK;
+}
+
+// Parallel decompression.
+//
+// Blocks are independent, and mkbootfs fills every block but the last,
+// so block i decompresses to offset i * 64k of the output.  A list of
+// the blocks is made in one quick pass over their headers, and the
+// blocks are then decompressed by a few threads at once.  Should some
+// block other than the last turn out to be short, the frame was laid
+// out some other way, and it is decompressed sequentially instead.
+//
+// The threads are bare libruntime threads, with no thread pointer, so
+// this is only done for callers built without safe-stack (userboot).
+
+#define LZ4_BLOCK_SIZE 65536
+#define LZ4_MAX_THREADS 8
+#define LZ4_STACK_SIZE (8 * PAGE_SIZE)
+
+typedef struct {
+    const uint8_t** blocks;
+    size_t count;
+    uint8_t* dst;
+    size_t dst_size;
+    atomic_size_t next;
+    atomic_bool failed;
+    // number of bytes in the last block
+    size_t last;
+} lz4_work_t;
+
+static void decompress_blocks(void* arg) {
+    lz4_work_t* work = arg;
+    for (;;) {
+        size_t i = atomic_fetch_add(&work->next, 1);
+        if ((i >= work->count) || atomic_load(&work->failed)) {
+            return;
+        }
+        const uint8_t* data = work->blocks[i];
+        uint32_t blocksize = *(const uint32_t*)data;
+        data += sizeof(uint32_t);
+
+        size_t off = i * LZ4_BLOCK_SIZE;
+        size_t room = work->dst_size - off;
+        if (room > LZ4_BLOCK_SIZE) {
+            room = LZ4_BLOCK_SIZE;
+        }
+        int len;
+        if (blocksize >> 31) {
+            len = blocksize & 0x7fffffff;
+            if ((size_t)len > room) {
+                len = -1;
+            } else {
+                memcpy(work->dst + off, data, len);
+            }
+        } else {
+            len = LZ4_decompress_safe((const char*)data, (char*)work->dst + off,
+                                      blocksize, room);
+        }
+        if (i == work->count - 1) {
+            work->last = len;
+        }
+        if ((len < 0) || ((i < work->count - 1) && (len != LZ4_BLOCK_SIZE))) {
+            atomic_store(&work->failed, true);
+        }
+    }
+}
+
+// Returns MX_ERR_NOT_SUPPORTED if the frame should be decompressed
+// sequentially instead.
+static mx_status_t decompress_parallel(mx_handle_t vmar, mx_handle_t proc,
+                                       const uint8_t* data, uint8_t* dst,
+                                       size_t remaining, size_t* used,
+                                       const char** err) {
+    size_t count = 0;
+    for (const uint8_t* p = data; ; count++) {
+        uint32_t blocksize = *(const uint32_t*)p;
+        if (blocksize == 0) {
+            break;
+        }
+        p += sizeof(uint32_t) + (blocksize & 0x7fffffff);
+    }
+    uint32_t nthreads = mx_system_get_num_cpus();
+    if (nthreads > LZ4_MAX_THREADS) {
+        nthreads = LZ4_MAX_THREADS;
+    }
+    if (nthreads > count) {
+        nthreads = count;
+    }
+    if ((nthreads < 2) || ((count - 1) > (remaining / LZ4_BLOCK_SIZE))) {
+        return MX_ERR_NOT_SUPPORTED;
+    }
+
+    // Stacks for the helper threads, then the block list.
+    size_t stacks = (nthreads - 1) * LZ4_STACK_SIZE;
+    size_t size = (stacks + count * sizeof(uint8_t*) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    mx_handle_t vmo;
+    if (mx_vmo_create(size, 0, &vmo) < 0) {
+        return MX_ERR_NOT_SUPPORTED;
+    }
+    uintptr_t addr = 0;
+    mx_status_t status = mx_vmar_map(vmar, 0, vmo, 0, size,
+                                     MX_VM_FLAG_PERM_READ|MX_VM_FLAG_PERM_WRITE, &addr);
+    mx_handle_close(vmo);
+    if (status < 0) {
+        return MX_ERR_NOT_SUPPORTED;
+    }
+
+    lz4_work_t work = {
+        .blocks = (const uint8_t**)(addr + stacks),
+        .count = count,
+        .dst = dst,
+        .dst_size = remaining,
+        .last = 0,
+    };
+    atomic_init(&work.next, 0);
+    atomic_init(&work.failed, false);
+    for (size_t i = 0; i < count; i++) {
+        work.blocks[i] = data;
+        data += sizeof(uint32_t) + (*(const uint32_t*)data & 0x7fffffff);
+    }
+
+    mxr_thread_t threads[LZ4_MAX_THREADS - 1];
+    uint32_t started = 0;
+    for (uint32_t i = 0; i < nthreads - 1; i++) {
+        if (mxr_thread_create(proc, "bootfs-lz4", false, &threads[started]) < 0) {
+            break;
+        }
+        if (mxr_thread_start(&threads[started], addr + i * LZ4_STACK_SIZE,
+                             LZ4_STACK_SIZE, decompress_blocks, &work) < 0) {
+            mxr_thread_destroy(&threads[started]);
+            break;
+        }
+        started++;
+    }
+    decompress_blocks(&work);
+    for (uint32_t i = 0; i < started; i++) {
+        mxr_thread_join(&threads[i]);
+    }
+    mx_vmar_unmap(vmar, addr, size);
+
+    if (atomic_load(&work.failed)) {
+        // Bad data, or blocks not laid out as expected.
+        return MX_ERR_NOT_SUPPORTED;
+    }
+    *used = (count - 1) * LZ4_BLOCK_SIZE + work.last;
+    return MX_OK;
+}
+
+static mx_status_t decompress_bootfs_vmo(mx_handle_t vmar, mx_handle_t proc,
                                          const uint8_t* data, mx_handle_t* out,
                                          const char** err) {
     const bootdata_t* hdr = (bootdata_t*)data;
@@ -136,41 +328,18 @@ static mx_status_t decompress_bootfs_vmo(mx_handle_t vmar,
     dst += sizeof(bootdata_t);
     remaining -= sizeof(bootdata_t);
 
-    // Read each LZ4 block and decompress it. Block sizes are 32 bits.
-    uint32_t blocksize = *(const uint32_t*)data;
-    data += sizeof(uint32_t);
-    while (blocksize) {
-        // If the data is uncompressed, the high bit is 1.
-        if (blocksize >> 31) {
-            uint32_t actual = blocksize & 0x7fffffff;
-            memcpy(dst, data, actual);
-            dst += actual;
-            data += actual;
-            if (remaining - actual > remaining) {
-                // Remaining wrapped around (would be negative if signed)
-                *err = "bootdata outsize too small for lz4 decompression";
-                return MX_ERR_INVALID_ARGS;
-            }
-            remaining -= actual;
-        } else {
-            int dcmp = LZ4_decompress_safe((const char*)data, (char*)dst, blocksize, remaining);
-            if (dcmp < 0) {
-                *err = "lz4 decompression failed";
-                return MX_ERR_BAD_STATE;
-            }
-            dst += dcmp;
-            data += blocksize;
-            if (remaining - dcmp > remaining) {
-                // Remaining wrapped around (would be negative if signed)
-                *err = "bootdata outsize too small for lz4 decompression";
-                return MX_ERR_INVALID_ARGS;
-            }
-            remaining -= dcmp;
-        }
-
-        blocksize = *(uint32_t*)data;
-        data += sizeof(uint32_t);
+    size_t used = 0;
+    status = MX_ERR_NOT_SUPPORTED;
+    if (proc != MX_HANDLE_INVALID) {
+        status = decompress_parallel(vmar, proc, data, dst, remaining, &used, err);
+    }
+    if (status == MX_ERR_NOT_SUPPORTED) {
+        status = decompress_sequential(data, dst, remaining, &used, err);
+    }
+    if (status < 0) {
+        return status;
     }
+    remaining -= used;
 
     // Sanity check: verify that we didn't have more than one page leftover.
     // The bootdata header should have specified the exact outsize needed, which
@@ -189,7 +358,7 @@ static mx_status_t decompress_bootfs_vmo(mx_handle_t vmar,
     return MX_OK;
 }
 
-mx_status_t decompress_bootdata(mx_handle_t vmar, mx_handle_t vmo,
+mx_status_t decompress_bootdata(mx_handle_t vmar, mx_handle_t proc, mx_handle_t vmo,
                                 size_t offset, size_t length,
                                 mx_handle_t* out, const char** err) {
     *err = "none";
@@ -215,7 +384,7 @@ mx_status_t decompress_bootdata(mx_handle_t vmar, mx_handle_t vmo,
     case BOOTDATA_BOOTFS_BOOT:
     case BOOTDATA_BOOTFS_SYSTEM:
         if (hdr->flags & BOOTDATA_BOOTFS_FLAG_COMPRESSED) {
-            status = decompress_bootfs_vmo(vmar, (const uint8_t*)bootdata_addr, out, err);
+            status = decompress_bootfs_vmo(vmar, proc, (const uint8_t*)bootdata_addr, out, err);
         }
         break;
     default:
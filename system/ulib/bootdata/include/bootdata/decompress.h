@@ -12,7 +12,12 @@
 // Decompress bootdata at offset of total size length into a new VMO
 // On failure, errmsg is a human readable error description to provide
 // more precise debug information.
-mx_status_t decompress_bootdata(mx_handle_t vmar, mx_handle_t vmo,
+//
+// If proc is valid, the data is decompressed by several threads created
+// in proc (which must be the calling process).  These are bare libruntime
+// threads, so only callers built without safe-stack may pass a process;
+// others should pass MX_HANDLE_INVALID.
+mx_status_t decompress_bootdata(mx_handle_t vmar, mx_handle_t proc, mx_handle_t vmo,
                                 size_t offset, size_t length,
                                 mx_handle_t* out, const char** errmsg);
 
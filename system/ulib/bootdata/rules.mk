@@ -10,6 +10,8 @@ MODULE_TYPE := userlib
 
 MODULE_SRCS += $(LOCAL_DIR)/decompress.c
 
+MODULE_STATIC_LIBS := system/ulib/runtime
+
 MODULE_LIBS := \
     third_party/ulib/lz4 \
     system/ulib/magenta \
@@ -134,6 +134,8 @@ struct iotxn {
     // May be used by iotxn_physmap() to store the physical pages list
     // instead of allocating additional memory.
     mx_paddr_t phys_inline[3];
+
+    void* free_cache;     // private, do not set
 };
 
 static_assert(offsetof(iotxn_t, phys) == 64, "phys should be at 64");
@@ -53,6 +53,11 @@ typedef struct ethmac_ifc_virt {
 // driver to batch tx to hardware if possible.
 #define ETHMAC_TX_OPT_MORE (1u)
 
+// Passed in the flags to recv() to indicate that more packets will be received before the ethmac
+// driver returns from handling the current interrupt. Allows the ethernet layer to batch rx
+// completions to clients. The last packet of a batch must not have this flag set.
+#define ETHMAC_RX_OPT_MORE (1u)
+
 // The ethernet midlayer will never call ethermac_protocol
 // methods from multiple threads simultaneously, but it
 // can call send() methods at the same time as non-send
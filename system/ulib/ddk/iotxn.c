@@ -26,7 +26,7 @@
     } while (0)
 #endif
 
-// Warn if free list length exceeds a multiple of FREE_LIST_MONITOR_LIMIT
+// Warn if the number of pooled iotxns exceeds a multiple of FREE_LIST_MONITOR_LIMIT
 #define FREE_LIST_MONITOR_LIMIT 100
 
 #define IOTXN_PFLAG_CONTIGUOUS (1 << 0)   // the vmo is contiguous
@@ -38,11 +38,45 @@
 
 #define IOTXN_STATE_MASK       (IOTXN_PFLAG_FREE | IOTXN_PFLAG_QUEUED)
 
-static list_node_t free_list = LIST_INITIAL_VALUE(free_list);
-static mtx_t free_list_mutex = MTX_INIT;
+// Pooled iotxns are kept in buckets by size class. Bucket 0 holds iotxns
+// with no buffer of their own (clones, and those allocated with
+// iotxn_alloc_vmo()); the rest hold buffers rounded up to a power of two
+// pages, with contiguous buffers in buckets of their own.
+#define IOTXN_SIZE_CLASSES 8
+#define IOTXN_BUCKET_COUNT (1 + 2 * IOTXN_SIZE_CLASSES)
+
+typedef struct {
+    mtx_t lock;
+    list_node_t txns;
+} iotxn_bucket_t;
+
+static iotxn_bucket_t free_buckets[IOTXN_BUCKET_COUNT];
+
+// Each thread also keeps a cache of the pool iotxns it allocated, so that a
+// thread which allocates iotxns repeatedly rarely touches the buckets. An
+// iotxn released on the thread which allocated it goes straight into that
+// thread's list; one released on another thread (typically an interrupt or
+// completion thread) is pushed onto the owner's lock-free return stack,
+// which the owner drains when its list has no match. A cache holds at most
+// IOTXN_CACHE_MAX_BYTES of iotxns and buffers; past that, iotxns go to the
+// buckets.
+#define IOTXN_CACHE_MAX_BYTES (1024 * 1024)
+
+typedef struct {
+    list_node_t txns;               // only touched by the owning thread
+    _Atomic(list_node_t*) returned; // iotxns released by other threads
+    atomic_size_t bytes;            // held in txns and returned
+    atomic_size_t refs;             // the owning thread, plus each iotxn handed out
+    atomic_bool dead;               // the owning thread has exited
+} iotxn_cache_t;
+
+static tss_t free_cache_key;
+static bool free_cache_valid;
+static once_flag free_init_once = ONCE_FLAG_INIT;
+
 #if FREE_LIST_MONITOR_LIMIT
-static size_t free_list_length = 0;
-static size_t free_list_monitor_warned = 0;
+static atomic_size_t free_list_length = ATOMIC_VAR_INIT(0);
+static atomic_size_t free_list_monitor_warned = ATOMIC_VAR_INIT(0);
 #endif
 
 // This assert will fail if we attempt to access the buffer of a cloned txn after it has been completed
@@ -60,31 +94,197 @@ static bool do_free_phys(uint32_t pflags) {
     return (pflags & IOTXN_PFLAG_PHYSMAP);
 }
 
+static size_t free_bucket_index(uint32_t pflags, uint64_t data_size) {
+    if (data_size == 0) {
+        return 0;
+    }
+    uint64_t pages = (data_size + PAGE_SIZE - 1) / PAGE_SIZE;
+    size_t size_class = (pages > 1) ? (size_t)(64 - __builtin_clzll(pages - 1)) : 0;
+    if (size_class >= IOTXN_SIZE_CLASSES) {
+        size_class = IOTXN_SIZE_CLASSES - 1;
+    }
+    size_t index = 1 + size_class;
+    if (pflags & IOTXN_PFLAG_CONTIGUOUS) {
+        index += IOTXN_SIZE_CLASSES;
+    }
+    return index;
+}
+
+static bool free_txn_matches(iotxn_t* txn, uint32_t pflags, uint64_t data_size) {
+    // txn->pflags has IOTXN_PFLAG_CONTIGUOUS set if the txn has a contiguous VMO we allocated,
+    // or zero otherwise. And the pflags passed into this function is either zero or
+    // IOTXN_PFLAG_CONTIGUOUS. So here we mask txn->pflags with IOTXN_PFLAG_CONTIGUOUS
+    // to compare just this bit and not get confused by IOTXN_PFLAG_FREE or other flags.
+    return (txn->vmo_length == data_size) &&
+           (((txn->pflags & IOTXN_PFLAG_CONTIGUOUS) == pflags) || data_size == 0);
+}
+
+static void free_bucket_add(iotxn_t* txn) {
+    iotxn_bucket_t* bucket = &free_buckets[free_bucket_index(txn->pflags, txn->vmo_length)];
+    mtx_lock(&bucket->lock);
+    list_add_head(&bucket->txns, &txn->node);
+    mtx_unlock(&bucket->lock);
+}
+
+static size_t free_cache_cost(iotxn_t* txn) {
+    return sizeof(iotxn_t) + txn->vmo_length;
+}
+
+// moves every iotxn other threads have returned to the cache to |list|
+static void free_cache_take_returned(iotxn_cache_t* cache, list_node_t* list) {
+    list_node_t* node = atomic_exchange_explicit(&cache->returned, NULL, memory_order_acquire);
+    while (node != NULL) {
+        list_node_t* next = node->next;
+        list_add_head(list, node);
+        node = next;
+    }
+}
+
+// returns every iotxn held by the cache to the buckets
+static void free_cache_flush(iotxn_cache_t* cache) {
+    free_cache_take_returned(cache, &cache->txns);
+    iotxn_t* txn;
+    while ((txn = list_remove_head_type(&cache->txns, iotxn_t, node)) != NULL) {
+        atomic_fetch_sub(&cache->bytes, free_cache_cost(txn));
+        free_bucket_add(txn);
+    }
+}
+
+static void free_cache_release(iotxn_cache_t* cache) {
+    if (atomic_fetch_sub_explicit(&cache->refs, 1, memory_order_acq_rel) == 1) {
+        // the owner has exited and every iotxn it handed out is back; pick up
+        // any which were returned after it flushed the cache
+        free_cache_flush(cache);
+        free(cache);
+    }
+}
+
+// called when a thread exits; the cache itself lives on until every iotxn
+// which will be returned to it has been released
+static void free_cache_destroy(void* arg) {
+    iotxn_cache_t* cache = arg;
+    atomic_store(&cache->dead, true);
+    free_cache_flush(cache);
+    free_cache_release(cache);
+}
+
+static void free_init(void) {
+    for (size_t i = 0; i < IOTXN_BUCKET_COUNT; i++) {
+        mtx_init(&free_buckets[i].lock, mtx_plain);
+        list_initialize(&free_buckets[i].txns);
+    }
+    free_cache_valid = (tss_create(&free_cache_key, free_cache_destroy) == thrd_success);
+}
+
+static iotxn_cache_t* free_cache_get(void) {
+    call_once(&free_init_once, free_init);
+    if (!free_cache_valid) {
+        return NULL;
+    }
+    iotxn_cache_t* cache = tss_get(free_cache_key);
+    if (cache == NULL) {
+        cache = malloc(sizeof(iotxn_cache_t));
+        if (cache == NULL) {
+            return NULL;
+        }
+        list_initialize(&cache->txns);
+        atomic_init(&cache->returned, NULL);
+        atomic_init(&cache->bytes, 0);
+        atomic_init(&cache->refs, 1);
+        atomic_init(&cache->dead, false);
+        if (tss_set(free_cache_key, cache) != thrd_success) {
+            free(cache);
+            return NULL;
+        }
+    }
+    return cache;
+}
+
+// makes the calling thread's cache the one a pool iotxn returns to
+static void free_cache_adopt(iotxn_t* txn) {
+    iotxn_cache_t* cache = free_cache_get();
+    if (cache != NULL) {
+        atomic_fetch_add_explicit(&cache->refs, 1, memory_order_relaxed);
+    }
+    txn->free_cache = cache;
+}
+
+// puts a released iotxn in the cache of the thread which allocated it, if
+// it has room, and drops the iotxn's reference to that cache
+static bool free_cache_put(iotxn_cache_t* cache, iotxn_t* txn) {
+    bool cached = false;
+    if (!atomic_load(&cache->dead)) {
+        size_t cost = free_cache_cost(txn);
+        if (atomic_fetch_add(&cache->bytes, cost) + cost <= IOTXN_CACHE_MAX_BYTES) {
+            if (free_cache_valid && tss_get(free_cache_key) == cache) {
+                list_add_head(&cache->txns, &txn->node);
+            } else {
+                list_node_t* head = atomic_load_explicit(&cache->returned, memory_order_relaxed);
+                do {
+                    txn->node.next = head;
+                } while (!atomic_compare_exchange_weak_explicit(&cache->returned, &head, &txn->node,
+                                                                memory_order_release,
+                                                                memory_order_relaxed));
+            }
+            cached = true;
+        } else {
+            atomic_fetch_sub(&cache->bytes, cost);
+        }
+    }
+    free_cache_release(cache);
+    return cached;
+}
+
+static iotxn_t* free_cache_find(iotxn_cache_t* cache, uint32_t pflags, uint64_t data_size) {
+    iotxn_t* entry;
+    list_for_every_entry (&cache->txns, entry, iotxn_t, node) {
+        if (free_txn_matches(entry, pflags, data_size)) {
+            list_delete(&entry->node);
+            atomic_fetch_sub(&cache->bytes, free_cache_cost(entry));
+            return entry;
+        }
+    }
+    return NULL;
+}
+
 static iotxn_t* find_in_free_list(uint32_t pflags, uint64_t data_size) {
-    bool found = false;
-    iotxn_t* txn = NULL;
     //xprintf("find_in_free_list pflags 0x%x data_size 0x%" PRIx64 "\n", pflags, data_size);
-    mtx_lock(&free_list_mutex);
-    list_for_every_entry (&free_list, txn, iotxn_t, node) {
-        // txn->pflags has IOTXN_ALLOC_CONTIGUOUS set if the txn has a contiguous VMO we allocated,
-        // or zero otherwise. And the pflags passed into this function is either zero or
-        // IOTXN_ALLOC_CONTIGUOUS. So here we mask txn->pflags with IOTXN_ALLOC_CONTIGUOUS
-        // to compare just this bit and not get confused by IOTXN_PFLAG_FREE or other flags.
-        if ((txn->vmo_length == data_size) && (((txn->pflags & IOTXN_ALLOC_CONTIGUOUS) == pflags) || data_size == 0)) {
-            found = true;
-            break;
+
+    // try this thread's cache first, which needs no locking
+    iotxn_t* txn = NULL;
+    iotxn_cache_t* cache = free_cache_get();
+    if (cache != NULL) {
+        txn = free_cache_find(cache, pflags, data_size);
+        if (txn == NULL && atomic_load_explicit(&cache->returned, memory_order_relaxed) != NULL) {
+            free_cache_take_returned(cache, &cache->txns);
+            txn = free_cache_find(cache, pflags, data_size);
         }
     }
-    if (found) {
+
+    if (txn == NULL) {
+        iotxn_bucket_t* bucket = &free_buckets[free_bucket_index(pflags, data_size)];
+        iotxn_t* entry;
+        mtx_lock(&bucket->lock);
+        list_for_every_entry (&bucket->txns, entry, iotxn_t, node) {
+            if (free_txn_matches(entry, pflags, data_size)) {
+                txn = entry;
+                break;
+            }
+        }
+        if (txn != NULL) {
+            list_delete(&txn->node);
+        }
+        mtx_unlock(&bucket->lock);
+    }
+
+    if (txn != NULL) {
         txn->pflags &= ~IOTXN_PFLAG_FREE;
-        list_delete(&txn->node);
 #if FREE_LIST_MONITOR_LIMIT
-        free_list_length--;
+        atomic_fetch_sub(&free_list_length, 1);
 #endif
     }
-    mtx_unlock(&free_list_mutex);
-    //xprintf("find_in_free_list found %d txn %p\n", found, txn);
-    return found ? txn : NULL;
+    //xprintf("find_in_free_list found txn %p\n", txn);
+    return txn;
 }
 
 // return the iotxn into the free list
@@ -96,6 +296,7 @@ static void iotxn_release_free_list(iotxn_t* txn) {
     mx_paddr_t* phys = txn->phys;
     uint64_t phys_count = txn->phys_count;
     uint32_t pflags = txn->pflags;
+    iotxn_cache_t* cache = txn->free_cache;
     mx_paddr_t phys_inline[3];
     memcpy(phys_inline, txn->phys_inline, sizeof(txn->phys_inline));
 
@@ -128,17 +329,18 @@ static void iotxn_release_free_list(iotxn_t* txn) {
     txn->pflags |= IOTXN_PFLAG_FREE;
     txn->release_cb = iotxn_release_free_list;
 
-    mtx_lock(&free_list_mutex);
-    list_add_head(&free_list, &txn->node);
+    call_once(&free_init_once, free_init);
+    if ((cache == NULL) || !free_cache_put(cache, txn)) {
+        free_bucket_add(txn);
+    }
 #if FREE_LIST_MONITOR_LIMIT
-    free_list_length++;
-    if (free_list_length % FREE_LIST_MONITOR_LIMIT == 0
-        && free_list_length > free_list_monitor_warned) {
-        printf("WARNING: iotxn free_list_length is %zu\n", free_list_length);
-        free_list_monitor_warned = free_list_length;
+    size_t length = atomic_fetch_add(&free_list_length, 1) + 1;
+    size_t warned = atomic_load(&free_list_monitor_warned);
+    if (length % FREE_LIST_MONITOR_LIMIT == 0 && length > warned &&
+        atomic_compare_exchange_strong(&free_list_monitor_warned, &warned, length)) {
+        printf("WARNING: iotxn free_list_length is %zu\n", length);
     }
 #endif
-    mtx_unlock(&free_list_mutex);
 
     xprintf("iotxn_release_free_list released txn %p\n", txn);
 }
@@ -309,8 +511,10 @@ mx_status_t iotxn_mmap(iotxn_t* txn, void** data) {
 mx_status_t iotxn_clone(iotxn_t* txn, iotxn_t** out) {
     xprintf("iotxn_clone txn %p\n", txn);
     iotxn_t* clone = NULL;
+    void* free_cache;
     if (*out != NULL) {
         clone = *out;
+        free_cache = clone->free_cache;
     } else {
         clone = find_in_free_list(0, 0);
         if (clone == NULL) {
@@ -319,9 +523,12 @@ mx_status_t iotxn_clone(iotxn_t* txn, iotxn_t** out) {
                 return MX_ERR_NO_MEMORY;
             }
         }
+        free_cache_adopt(clone);
+        free_cache = clone->free_cache;
     }
 
     memcpy(clone, txn, sizeof(iotxn_t));
+    clone->free_cache = free_cache;
     // the only relevant pflag for a clone is the contiguous bit
     clone->pflags = txn->pflags & IOTXN_PFLAG_CONTIGUOUS;
     clone->complete_cb = NULL;
@@ -432,6 +639,7 @@ out:
     MX_DEBUG_ASSERT(!(txn->pflags & IOTXN_PFLAG_FREE));
     if (alloc_flags & IOTXN_ALLOC_POOL) {
         txn->release_cb = iotxn_release_free_list;
+        free_cache_adopt(txn);
     } else {
         txn->release_cb = iotxn_release_free;
     }
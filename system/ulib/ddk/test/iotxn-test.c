@@ -14,6 +14,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <threads.h>
+
+#include <sync/completion.h>
 
 static bool test_physmap_simple(void) {
     BEGIN_TEST;
@@ -421,6 +424,116 @@ static bool test_phys_iter_tiny_unaligned(void) {
     END_TEST;
 }
 
+// Released pool iotxns are reused, keeping their buffer and page list.
+static bool test_pool_reuse(void) {
+    BEGIN_TEST;
+    iotxn_t* txn;
+    ASSERT_EQ(iotxn_alloc(&txn, IOTXN_ALLOC_POOL, PAGE_SIZE * 5), MX_OK, "");
+    ASSERT_EQ(iotxn_physmap(txn), MX_OK, "");
+    ASSERT_EQ(txn->phys_count, 5u, "unexpected phys_count");
+    iotxn_t* first = txn;
+    mx_paddr_t* phys = txn->phys;
+    iotxn_release(txn);
+
+    ASSERT_EQ(iotxn_alloc(&txn, IOTXN_ALLOC_POOL, PAGE_SIZE * 5), MX_OK, "");
+    ASSERT_EQ(txn, first, "expected the released iotxn to be reused");
+    ASSERT_EQ(txn->vmo_length, PAGE_SIZE * 5u, "");
+    ASSERT_EQ(txn->phys, phys, "expected the page list to be kept");
+    ASSERT_EQ(txn->phys_count, 5u, "unexpected phys_count");
+
+    // a different size, or contiguity, does not match
+    iotxn_t* other;
+    ASSERT_EQ(iotxn_alloc(&other, IOTXN_ALLOC_POOL | IOTXN_ALLOC_CONTIGUOUS, PAGE_SIZE * 5), MX_OK, "");
+    ASSERT_NEQ(other, first, "");
+    ASSERT_EQ(other->vmo_length, PAGE_SIZE * 5u, "");
+    iotxn_release(other);
+    iotxn_release(txn);
+    END_TEST;
+}
+
+#define POOL_THREADS 4
+#define POOL_ITERATIONS 1000
+
+static int pool_thread(void* arg) {
+    for (int i = 0; i < POOL_ITERATIONS; i++) {
+        iotxn_t* txns[4];
+        for (int j = 0; j < 4; j++) {
+            uint64_t size = PAGE_SIZE * (1 + ((i + j) % 3));
+            if (iotxn_alloc(&txns[j], IOTXN_ALLOC_POOL, size) != MX_OK) {
+                return -1;
+            }
+            if (txns[j]->vmo_length != size) {
+                return -1;
+            }
+        }
+        for (int j = 0; j < 4; j++) {
+            iotxn_release(txns[j]);
+        }
+    }
+    return 0;
+}
+
+// Many threads allocating and releasing pool iotxns at once, and iotxns
+// cached by threads which have exited being handed out again.
+static bool test_pool_threads(void) {
+    BEGIN_TEST;
+    thrd_t threads[POOL_THREADS];
+    for (int i = 0; i < POOL_THREADS; i++) {
+        ASSERT_EQ(thrd_create(&threads[i], pool_thread, NULL), thrd_success, "");
+    }
+    for (int i = 0; i < POOL_THREADS; i++) {
+        int ret;
+        ASSERT_EQ(thrd_join(threads[i], &ret), thrd_success, "");
+        ASSERT_EQ(ret, 0, "");
+    }
+
+    iotxn_t* txn;
+    ASSERT_EQ(iotxn_alloc(&txn, IOTXN_ALLOC_POOL, PAGE_SIZE * 3), MX_OK, "");
+    ASSERT_EQ(txn->vmo_length, PAGE_SIZE * 3u, "");
+    iotxn_release(txn);
+    END_TEST;
+}
+
+typedef struct {
+    iotxn_t* txn;
+    completion_t released;
+    completion_t done;
+} pool_release_args_t;
+
+static int pool_release_thread(void* arg) {
+    pool_release_args_t* args = arg;
+    iotxn_release(args->txn);
+    completion_signal(&args->released);
+    completion_wait(&args->done, MX_TIME_INFINITE);
+    return 0;
+}
+
+// An iotxn released on another thread goes back to the thread which
+// allocated it, even while the releasing thread is still running.
+static bool test_pool_release_other_thread(void) {
+    BEGIN_TEST;
+    pool_release_args_t args = {
+        .released = COMPLETION_INIT,
+        .done = COMPLETION_INIT,
+    };
+    ASSERT_EQ(iotxn_alloc(&args.txn, IOTXN_ALLOC_POOL, PAGE_SIZE * 7), MX_OK, "");
+    iotxn_t* first = args.txn;
+
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, pool_release_thread, &args), thrd_success, "");
+    completion_wait(&args.released, MX_TIME_INFINITE);
+
+    iotxn_t* txn;
+    ASSERT_EQ(iotxn_alloc(&txn, IOTXN_ALLOC_POOL, PAGE_SIZE * 7), MX_OK, "");
+    EXPECT_EQ(txn, first, "expected the iotxn to come back to this thread");
+
+    completion_signal(&args.done);
+    int ret;
+    ASSERT_EQ(thrd_join(thread, &ret), thrd_success, "");
+    iotxn_release(txn);
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(iotxn_tests)
 RUN_TEST(test_physmap_simple)
 RUN_TEST(test_physmap_contiguous)
@@ -434,6 +547,9 @@ RUN_TEST(test_phys_iter_unaligned_contig)
 RUN_TEST(test_phys_iter_unaligned_noncontig)
 RUN_TEST(test_phys_iter_tiny_aligned)
 RUN_TEST(test_phys_iter_tiny_unaligned)
+RUN_TEST(test_pool_reuse)
+RUN_TEST(test_pool_threads)
+RUN_TEST(test_pool_release_other_thread)
 END_TEST_CASE(iotxn_tests)
 
 static void iotxn_test_output_func(const char* line, int len, void* arg) {
@@ -12,6 +12,7 @@
 #include <unistd.h>
 
 #include <magenta/driver/binding.h>
+#include <magenta/driver/manifest.h>
 #include <magenta/types.h>
 
 typedef Elf64_Ehdr elfhdr;
@@ -129,6 +130,57 @@ mx_status_t di_read_driver_info(int fd, void *cookie,
                          data, sizeof(data), callback, &ctx);
 }
 
+mx_status_t di_read_driver_manifest(void* data, size_t size, void* cookie,
+                                    void (*func)(
+                                        const char* filename,
+                                        magenta_driver_note_payload_t* note,
+                                        const mx_bind_inst_t* binding,
+                                        void* cookie)) {
+    const driver_manifest_header_t* hdr = data;
+    if ((size < sizeof(*hdr)) ||
+        (hdr->magic != DRIVER_MANIFEST_MAGIC) ||
+        (hdr->version != DRIVER_MANIFEST_VERSION)) {
+        return MX_ERR_NOT_SUPPORTED;
+    }
+    uint32_t count = hdr->count;
+    data += sizeof(*hdr);
+    size -= sizeof(*hdr);
+
+    // Validate every record before reporting any.
+    void* start = data;
+    size_t start_size = size;
+    for (uint32_t i = 0; i < count; i++) {
+        driver_manifest_record_t* rec = data;
+        if ((size < sizeof(*rec)) ||
+            (rec->reclen < sizeof(*rec)) || (rec->reclen > size) ||
+            (rec->reclen & 3) || (rec->namelen == 0)) {
+            return MX_ERR_IO_DATA_INTEGRITY;
+        }
+        size_t max = rec->reclen - sizeof(*rec);
+        size_t bindlen = (size_t)rec->payload.bindcount * sizeof(mx_bind_inst_t);
+        if ((bindlen > max) || (rec->namelen > max - bindlen)) {
+            return MX_ERR_IO_DATA_INTEGRITY;
+        }
+        char* filename = (char*)(rec + 1) + bindlen;
+        if (filename[rec->namelen - 1] != 0) {
+            return MX_ERR_IO_DATA_INTEGRITY;
+        }
+        data += rec->reclen;
+        size -= rec->reclen;
+    }
+
+    data = start;
+    size = start_size;
+    for (uint32_t i = 0; i < count; i++) {
+        driver_manifest_record_t* rec = data;
+        const mx_bind_inst_t* binding = (const void*)(rec + 1);
+        const char* filename = (const char*)(binding + rec->payload.bindcount);
+        func(filename, &rec->payload, binding, cookie);
+        data += rec->reclen;
+    }
+    return MX_OK;
+}
+
 const char* di_bind_param_name(uint32_t param_num) {
     switch (param_num) {
     case BIND_FLAGS:                  return "Flags";
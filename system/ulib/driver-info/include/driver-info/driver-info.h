@@ -16,6 +16,16 @@ mx_status_t di_read_driver_info(int fd, void *cookie,
                                     const mx_bind_inst_t* binding,
                                     void *cookie));
 
+// Parse a driver manifest (see <magenta/driver/manifest.h>) which has been
+// read into memory, calling |func| for each driver it describes.  Nothing
+// is reported unless the whole manifest is well formed.
+mx_status_t di_read_driver_manifest(void* data, size_t size, void* cookie,
+                                    void (*func)(
+                                        const char* filename,
+                                        magenta_driver_note_payload_t* note,
+                                        const mx_bind_inst_t* binding,
+                                        void* cookie));
+
 // Lookup the human readable name of a bind program parameter, or return NULL if
 // the name is not known.  Used by debug code to do things like dump the
 // published parameters of a device, or dump the bind program of a driver.
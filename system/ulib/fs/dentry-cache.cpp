@@ -0,0 +1,201 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <fs/dentry-cache.h>
+#include <fs/fnv1a.h>
+#include <fs/vfs.h>
+#include <mxalloc/new.h>
+#include <mxtl/auto_lock.h>
+
+namespace fs {
+
+// The cache is a global variable, but it only uses constexpr constructors
+// and has no destructor: its entries are allocated on first use. As a
+// consequence, the .init_array section of the compiled dentry-cache object
+// file is empty.
+//
+// This comment serves as a warning: If this variable ends up using
+// non-constexpr ctors, it should no longer be a static global variable.
+DentryCache vfs_dcache(kDentryCacheSize);
+
+DentryCache::Entry::Entry(Key key, const char* name, size_t len, Vnode* vn)
+    : key(key), vnode(vn), namelen(static_cast<uint8_t>(len)) {
+    memcpy(this->name, name, len);
+}
+
+DentryCache::ChildKey DentryCache::Entry::GetChildKey() const {
+    return ChildKey{reinterpret_cast<uintptr_t>(vnode), reinterpret_cast<uintptr_t>(this)};
+}
+
+bool DentryCache::Entry::NameMatch(const char* name, size_t len) const {
+    return (namelen == len) && (memcmp(this->name, name, len) == 0);
+}
+
+bool DentryCache::IsCacheableName(const char* name, size_t len) {
+    if ((len == 0) || (len > kDentryNameMax)) {
+        return false;
+    }
+    if ((name[0] == '.') && ((len == 1) || ((len == 2) && (name[1] == '.')))) {
+        return false;
+    }
+    return true;
+}
+
+DentryCache::Key DentryCache::MakeKey(Vnode* parent, const char* name, size_t len) {
+    return Key{reinterpret_cast<uintptr_t>(parent), fnv1a32(name, len)};
+}
+
+DentryCache::State* DentryCache::GetState(bool create) {
+    uintptr_t state = state_.load(mxtl::memory_order_acquire);
+    if ((state != 0) || !create) {
+        return reinterpret_cast<State*>(state);
+    }
+
+    AllocChecker ac;
+    mxtl::unique_ptr<State> fresh(new (&ac) State());
+    if (!ac.check()) {
+        return nullptr;
+    }
+    if (state_.compare_exchange_strong(&state, reinterpret_cast<uintptr_t>(fresh.get()),
+                                       mxtl::memory_order_acq_rel, mxtl::memory_order_acquire)) {
+        return fresh.release();
+    }
+    // Another thread got there first.
+    return reinterpret_cast<State*>(state);
+}
+
+void DentryCache::RemoveLocked(State* state, Entry* entry) {
+    state->lru.erase(*entry);
+    if (entry->vnode != nullptr) {
+        state->children.erase(*entry);
+    }
+    state->entries.erase(*entry);
+}
+
+bool DentryCache::Lookup(Vnode* parent, const char* name, size_t len,
+                         mxtl::RefPtr<Vnode>* out) {
+    State* state;
+    if (!IsCacheableName(name, len) || ((state = GetState(false)) == nullptr)) {
+        return false;
+    }
+
+    mxtl::AutoLock lock(&state->lock);
+    auto iter = state->entries.find(MakeKey(parent, name, len));
+    if (!iter.IsValid() || !iter->NameMatch(name, len)) {
+        state->stats.misses++;
+        return false;
+    }
+
+    Entry* entry = &(*iter);
+    mxtl::RefPtr<Vnode> vn;
+    if (entry->vnode != nullptr) {
+        // The child may be in the middle of being destroyed, in which case
+        // its destructor is waiting to purge this entry.
+        if ((vn = mxtl::MakeRefPtrUpgradeFromRaw(entry->vnode)) == nullptr) {
+            state->stats.misses++;
+            return false;
+        }
+        state->stats.hits++;
+    } else {
+        state->stats.negative_hits++;
+    }
+    state->lru.erase(*entry);
+    state->lru.push_front(entry);
+    *out = mxtl::move(vn);
+    return true;
+}
+
+void DentryCache::Insert(Vnode* parent, const char* name, size_t len,
+                         mxtl::RefPtr<Vnode> vn) {
+    State* state;
+    if (!IsCacheableName(name, len) || ((state = GetState(true)) == nullptr)) {
+        return;
+    }
+
+    mxtl::AutoLock lock(&state->lock);
+    Key key = MakeKey(parent, name, len);
+    auto iter = state->entries.find(key);
+    if (iter.IsValid()) {
+        RemoveLocked(state, &(*iter));
+    }
+    if ((vn != nullptr) && !vn->IsCacheable()) {
+        return;
+    }
+    if (state->entries.size() >= capacity_) {
+        if (state->lru.is_empty()) {
+            return;
+        }
+        RemoveLocked(state, &state->lru.back());
+        state->stats.evictions++;
+    }
+
+    AllocChecker ac;
+    mxtl::unique_ptr<Entry> entry(new (&ac) Entry(key, name, len, vn.get()));
+    if (!ac.check()) {
+        return;
+    }
+    state->lru.push_front(entry.get());
+    if (vn != nullptr) {
+        state->children.insert(entry.get());
+    }
+    state->entries.insert(mxtl::move(entry));
+}
+
+void DentryCache::Invalidate(Vnode* parent, const char* name, size_t len) {
+    State* state;
+    if (!IsCacheableName(name, len) || ((state = GetState(false)) == nullptr)) {
+        return;
+    }
+
+    mxtl::AutoLock lock(&state->lock);
+    auto iter = state->entries.find(MakeKey(parent, name, len));
+    if (iter.IsValid()) {
+        RemoveLocked(state, &(*iter));
+        state->stats.invalidations++;
+    }
+}
+
+void DentryCache::Purge(Vnode* vn) {
+    State* state = GetState(false);
+    if (state == nullptr) {
+        return;
+    }
+
+    mxtl::AutoLock lock(&state->lock);
+    uintptr_t key = reinterpret_cast<uintptr_t>(vn);
+    auto iter = state->entries.lower_bound(Key{key, 0});
+    while (iter.IsValid() && (iter->key.parent == key)) {
+        Entry* entry = &(*iter);
+        ++iter;
+        RemoveLocked(state, entry);
+        state->stats.invalidations++;
+    }
+    // Entries naming 'vn' as a child would otherwise be left pointing at
+    // freed memory.
+    auto child = state->children.lower_bound(ChildKey{key, 0});
+    while (child.IsValid() && (child->vnode == vn)) {
+        Entry* entry = &(*child);
+        ++child;
+        RemoveLocked(state, entry);
+        state->stats.invalidations++;
+    }
+}
+
+void DentryCache::GetStats(vfs_dcache_stats_t* out) {
+    State* state = GetState(false);
+    if (state == nullptr) {
+        *out = {};
+        out->capacity = capacity_;
+        return;
+    }
+
+    mxtl::AutoLock lock(&state->lock);
+    *out = state->stats;
+    out->entries = state->entries.size();
+    out->capacity = capacity_;
+}
+
+} // namespace fs
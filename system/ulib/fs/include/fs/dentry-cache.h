@@ -0,0 +1,155 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <magenta/compiler.h>
+#include <magenta/device/vfs.h>
+#include <magenta/types.h>
+#include <mxtl/atomic.h>
+#include <mxtl/intrusive_double_list.h>
+#include <mxtl/intrusive_wavl_tree.h>
+#include <mxtl/macros.h>
+#include <mxtl/mutex.h>
+#include <mxtl/ref_ptr.h>
+#include <mxtl/unique_ptr.h>
+
+namespace fs {
+
+class Vnode;
+
+// Default number of entries held by the process-wide cache.
+constexpr size_t kDentryCacheSize = 1024;
+
+// Names longer than this are never cached.
+constexpr size_t kDentryNameMax = 64;
+
+// A bounded cache of the results of Vnode::Lookup, keyed by the parent
+// vnode and the name which was looked up.
+//
+// A "positive" entry records the child vnode, without holding a reference
+// to it: the cache never keeps a vnode alive, and a child which has been
+// released is simply a miss. A "negative" entry records that the name did
+// not exist. The least recently used entry is evicted to make room for new
+// ones.
+//
+// Callers are responsible for invalidating entries whenever a name is
+// added to or removed from a directory. Entries which refer to a vnode,
+// either as parent or child, are purged when that vnode is destroyed, so
+// vnodes may safely be identified by their addresses. "." and ".." are
+// never cached, since the latter changes when a directory is renamed.
+//
+// The cache is constructed at compile time, and allocates its entries on
+// first use, so that it may be a global variable.
+class DentryCache {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(DentryCache);
+    constexpr explicit DentryCache(size_t capacity) : capacity_(capacity), state_(0) {}
+
+    // Returns true if the result of looking up 'name' in 'parent' is cached.
+    // On success, 'out' is set to the cached child, or to nullptr if the
+    // name is known not to exist.
+    bool Lookup(Vnode* parent, const char* name, size_t len, mxtl::RefPtr<Vnode>* out);
+
+    // Records the result of looking up 'name' in 'parent', replacing any
+    // previous result. 'vn' is nullptr if the name does not exist.
+    void Insert(Vnode* parent, const char* name, size_t len, mxtl::RefPtr<Vnode> vn);
+
+    // Drops any cached result for 'name' in 'parent'.
+    void Invalidate(Vnode* parent, const char* name, size_t len);
+
+    // Drops every cached result for names within 'vn', and every cached
+    // result which refers to 'vn'.
+    void Purge(Vnode* vn);
+
+    void GetStats(vfs_dcache_stats_t* out);
+
+private:
+    struct Key {
+        uintptr_t parent;
+        uint32_t hash;
+
+        bool operator<(const Key& other) const {
+            return (parent < other.parent) || ((parent == other.parent) && (hash < other.hash));
+        }
+        bool operator==(const Key& other) const {
+            return (parent == other.parent) && (hash == other.hash);
+        }
+    };
+
+    // Positive entries are also indexed by their child, and by the entry's
+    // own address, since a child may be cached under several names.
+    struct ChildKey {
+        uintptr_t child;
+        uintptr_t entry;
+
+        bool operator<(const ChildKey& other) const {
+            return (child < other.child) || ((child == other.child) && (entry < other.entry));
+        }
+        bool operator==(const ChildKey& other) const {
+            return (child == other.child) && (entry == other.entry);
+        }
+    };
+
+    struct Entry : public mxtl::WAVLTreeContainable<mxtl::unique_ptr<Entry>>,
+                   public mxtl::DoublyLinkedListable<Entry*> {
+        Entry(Key key, const char* name, size_t len, Vnode* vn);
+
+        Key GetKey() const { return key; }
+        ChildKey GetChildKey() const;
+        bool NameMatch(const char* name, size_t len) const;
+
+        const Key key;
+        // Not a reference; see Purge().
+        Vnode* const vnode;
+        mxtl::WAVLTreeNodeState<Entry*> child_node;
+        uint8_t namelen;
+        char name[kDentryNameMax];
+    };
+
+    struct ChildNodeTraits {
+        static mxtl::WAVLTreeNodeState<Entry*>& node_state(Entry& e) { return e.child_node; }
+    };
+    struct ChildKeyTraits {
+        static ChildKey GetKey(const Entry& e) { return e.GetChildKey(); }
+        static bool LessThan(const ChildKey& k1, const ChildKey& k2) { return k1 < k2; }
+        static bool EqualTo(const ChildKey& k1, const ChildKey& k2) { return k1 == k2; }
+    };
+
+    using EntryTree = mxtl::WAVLTree<Key, mxtl::unique_ptr<Entry>>;
+    using ChildTree = mxtl::WAVLTree<ChildKey, Entry*, ChildKeyTraits, ChildNodeTraits>;
+
+    // Everything but the capacity, allocated on first use and never freed,
+    // since vnodes in static storage may still purge their entries while
+    // the process exits.
+    struct State {
+        mxtl::Mutex lock;
+        EntryTree entries __TA_GUARDED(lock);
+        ChildTree children __TA_GUARDED(lock);
+        // Most recently used entries are at the front.
+        mxtl::DoublyLinkedList<Entry*> lru __TA_GUARDED(lock);
+        vfs_dcache_stats_t stats __TA_GUARDED(lock) = {};
+    };
+
+    static bool IsCacheableName(const char* name, size_t len);
+    static Key MakeKey(Vnode* parent, const char* name, size_t len);
+
+    // Returns the cache's state, allocating it if 'create' is set and it does
+    // not exist yet. Returns nullptr if there is none.
+    State* GetState(bool create);
+
+    static void RemoveLocked(State* state, Entry* entry) __TA_REQUIRES(state->lock);
+
+    const size_t capacity_;
+    // A State*, once allocated.
+    mxtl::atomic<uintptr_t> state_;
+};
+
+// The cache shared by every filesystem served by this process.
+extern DentryCache vfs_dcache;
+
+} // namespace fs
@@ -28,6 +28,10 @@ public:
     // The dispatcher will read from 'h', and pass the
     // message to the dispatcher callback 'cb'.
     virtual mx_status_t AddVFSHandler(mx_handle_t h, vfs_dispatcher_cb_t cb, void* iostate) = 0;
+
+    // Serve requests on the calling thread, alongside any threads of
+    // the dispatcher's own, until the dispatcher shuts down.
+    virtual mx_status_t Run() = 0;
 };
 
 } // namespace fs
@@ -0,0 +1,67 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+#include <threads.h>
+
+#include <magenta/compiler.h>
+#include <mxtl/macros.h>
+
+namespace fs {
+
+// SharedMutex is a reader/writer lock: it may be held "shared" by any number
+// of threads at once, or "exclusively" by a single thread.
+//
+// Threads waiting for exclusive access take priority over new shared
+// acquirers, so a steady stream of readers cannot starve a writer.
+class __TA_CAPABILITY("mutex") SharedMutex {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(SharedMutex);
+    constexpr SharedMutex() : lock_(MTX_INIT), shared_cvar_(CND_INIT),
+                              exclusive_cvar_(CND_INIT) {}
+
+    void Acquire() __TA_ACQUIRE();
+    void Release() __TA_RELEASE();
+    void AcquireShared() __THREAD_ANNOTATION(acquire_shared_capability());
+    void ReleaseShared() __THREAD_ANNOTATION(release_shared_capability());
+
+private:
+    mtx_t lock_;
+    cnd_t shared_cvar_;
+    cnd_t exclusive_cvar_;
+    uint32_t readers_ = 0;
+    uint32_t writers_waiting_ = 0;
+    bool writer_ = false;
+};
+
+// Holds a SharedMutex exclusively for the lifetime of the object.
+class __TA_SCOPED_CAPABILITY ExclusiveLock {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ExclusiveLock);
+    explicit ExclusiveLock(SharedMutex* mutex) __TA_ACQUIRE(mutex) : mutex_(mutex) {
+        mutex_->Acquire();
+    }
+    ~ExclusiveLock() __TA_RELEASE() { mutex_->Release(); }
+
+private:
+    SharedMutex* mutex_;
+};
+
+// Holds a SharedMutex shared for the lifetime of the object.
+class __TA_SCOPED_CAPABILITY SharedLock {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(SharedLock);
+    explicit SharedLock(SharedMutex* mutex)
+        __THREAD_ANNOTATION(acquire_shared_capability(mutex)) : mutex_(mutex) {
+        mutex_->AcquireShared();
+    }
+    ~SharedLock() __TA_RELEASE() { mutex_->ReleaseShared(); }
+
+private:
+    SharedMutex* mutex_;
+};
+
+} // namespace fs
@@ -53,7 +53,8 @@ private:
 };
 
 // VfsDispatcher is a dispatcher which uses a pool of threads to distribute
-// requests to an underlying handlers concurrently.
+// requests to an underlying handlers concurrently. A pool of zero threads
+// serves requests only on threads which call Run().
 class VfsDispatcher final : public fs::Dispatcher {
 public:
     ~VfsDispatcher();
@@ -62,6 +63,7 @@ public:
                               mxtl::unique_ptr<fs::Dispatcher>* out);
     void DisconnectHandler(Handler*, bool);
     int Loop();
+    mx_status_t Run() final;
 private:
     VfsDispatcher(mxio_dispatcher_cb_t cb, uint32_t pool_size);
     mx_status_t AddVFSHandler(mx_handle_t h, vfs_dispatcher_cb_t cb, void* iostate) final;
@@ -34,7 +34,9 @@
 // clang-format on
 
 __BEGIN_CDECLS
-// A lock which should be used to protect lookup and walk operations
+// A lock which protects the table of remote filesystems mounted within
+// this filesystem. Other vnode operations are ordered by
+// fs::vfs_namespace_lock and the per-vnode lock; see below.
 #ifdef __Fuchsia__
 extern mtx_t vfs_lock;
 #endif
@@ -47,10 +49,12 @@ __END_CDECLS
 
 #ifdef __Fuchsia__
 #include <fs/dispatcher.h>
+#include <fs/shared-mutex.h>
 #include <mx/channel.h>
-#include <mxtl/mutex.h>
 #endif  // __Fuchsia__
 
+#include <mxtl/mutex.h>
+
 #include <mxtl/intrusive_double_list.h>
 #include <mxtl/macros.h>
 #include <mxtl/ref_counted.h>
@@ -61,6 +65,27 @@ namespace fs {
 
 class Vnode;
 
+#ifdef __Fuchsia__
+// Requests for a filesystem may be dispatched on several threads at once.
+// They are ordered by two levels of locking:
+//
+// - vfs_namespace_lock is held exclusively by operations which modify
+//   the namespace (creating, unlinking, renaming, linking, truncating, and
+//   all ioctls, which may mount or unmount filesystems), and shared by all
+//   other operations, including reads, writes, setattr, sync and close.
+// - Operations which hold vfs_namespace_lock shared also hold the lock of
+//   each vnode they act upon (see Vnode::lock()), one vnode at a time.
+//
+// Consequently, a filesystem may assume that namespace changes are never
+// concurrent with any other operation, while reads and writes of distinct
+// vnodes proceed in parallel. State shared between vnodes which is touched
+// by those concurrent operations (such as a table of open vnodes, block
+// allocation bitmaps, or a block device connection) must be protected by
+// the filesystem itself. The last reference to a vnode may be dropped, and
+// the vnode destroyed, while the namespace lock is only held shared.
+extern SharedMutex vfs_namespace_lock;
+#endif
+
 // RemoteContainer adds support for mounting remote handles on nodes.
 class RemoteContainer {
 public:
@@ -185,6 +210,19 @@ public:
         return MX_ERR_NOT_SUPPORTED;
     }
 
+#ifdef __Fuchsia__
+    // Read up to len bytes from vn at offset into the start of vmo
+    // (MXRIO_READ_VMO). The default implementation bounces the data
+    // through Read(); vnodes whose data lives in a VMO may copy it
+    // straight across (see vfs_vmo_copy()).
+    virtual ssize_t ReadVmo(mx_handle_t vmo, size_t len, size_t off);
+
+    // Write up to len bytes from the start of vmo to vn at offset
+    // (MXRIO_WRITE_VMO). The default implementation bounces the data
+    // through Write().
+    virtual ssize_t WriteVmo(mx_handle_t vmo, size_t len, size_t off);
+#endif
+
     // Attempt to find child of vn, child returned on success.
     // Name is len bytes long, and does not include a null terminator.
     virtual mx_status_t Lookup(mxtl::RefPtr<Vnode>* out, const char* name, size_t len) {
@@ -264,7 +302,12 @@ public:
         return MX_ERR_NOT_SUPPORTED;
     }
 
-    virtual ~Vnode() {};
+    // Returns true if the VFS may remember this vnode in its lookup cache
+    // (see fs::DentryCache). Vnodes which must always be looked up through
+    // the filesystem should return false.
+    virtual bool IsCacheable() const { return true; }
+
+    virtual ~Vnode();
 
 #ifdef __Fuchsia__
     virtual Dispatcher* GetDispatcher() = 0;
@@ -295,13 +338,30 @@ public:
         flags_ |= V_FLAG_DEVICE_DETACHED;
     }
     bool IsDetachedDevice() const { return (flags_ & V_FLAG_DEVICE_DETACHED); }
+
+    // Serializes operations on this vnode which run while the namespace
+    // lock is only held shared.
+    mxtl::Mutex* lock() __TA_RETURN_CAPABILITY(lock_) { return &lock_; }
 protected:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Vnode);
     Vnode() : flags_(0) {};
 
     uint32_t flags_;
+
+private:
+    mxtl::Mutex lock_;
 };
 
+#ifdef __Fuchsia__
+// Copies len bytes between data_vmo at offset and the start of client_vmo,
+// into client_vmo if to_client is set and out of it otherwise, without an
+// intermediate buffer. Only data_vmo, which belongs to the filesystem, is
+// mapped; it must already cover the range, and must not be resized while
+// the copy is in progress. 'actual' is set to the number of bytes copied.
+mx_status_t vfs_vmo_copy(mx_handle_t data_vmo, size_t offset, mx_handle_t client_vmo,
+                         size_t len, bool to_client, size_t* actual);
+#endif
+
 struct Vfs {
     // Walk from vn --> out until either only one path segment remains or we
     // encounter a remote filesystem.
@@ -331,7 +391,9 @@ struct Vfs {
 
 } // namespace fs
 
-// vfs dispatch  (NOTE: only used for mounted roots)
+// Serves the root of a mounted filesystem on 'h', through the dispatcher of
+// 'vn'. The calling thread joins that dispatcher, and only returns once it
+// shuts down.
 mx_handle_t vfs_rpc_server(mx_handle_t h, mxtl::RefPtr<fs::Vnode> vn);
 
 using Vnode = fs::Vnode;
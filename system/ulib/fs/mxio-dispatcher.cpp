@@ -33,6 +33,12 @@ mx_status_t MxioDispatcher::AddVFSHandler(mx_handle_t h, vfs_dispatcher_cb_t cb,
     return mxio_dispatcher_add(dispatcher_, h, (void*) cb, iostate);
 }
 
+mx_status_t MxioDispatcher::Run() {
+    // An mxio dispatcher is served by exactly one thread, which was
+    // started by Create().
+    return MX_ERR_NOT_SUPPORTED;
+}
+
 MxioDispatcher::MxioDispatcher() {}
 
 } // namespace fs
@@ -9,8 +9,10 @@ MODULE := $(LOCAL_DIR)
 MODULE_TYPE := userlib
 
 MODULE_SRCS += \
+    $(LOCAL_DIR)/dentry-cache.cpp \
     $(LOCAL_DIR)/mapped-vmo.cpp \
     $(LOCAL_DIR)/mxio-dispatcher.cpp \
+    $(LOCAL_DIR)/shared-mutex.cpp \
     $(LOCAL_DIR)/vfs.cpp \
     $(LOCAL_DIR)/vfs-mount.cpp \
     $(LOCAL_DIR)/vfs-unmount.cpp \
@@ -0,0 +1,48 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fs/shared-mutex.h>
+
+namespace fs {
+
+void SharedMutex::Acquire() {
+    mtx_lock(&lock_);
+    writers_waiting_++;
+    while (writer_ || (readers_ > 0)) {
+        cnd_wait(&exclusive_cvar_, &lock_);
+    }
+    writers_waiting_--;
+    writer_ = true;
+    mtx_unlock(&lock_);
+}
+
+void SharedMutex::Release() {
+    mtx_lock(&lock_);
+    writer_ = false;
+    if (writers_waiting_ > 0) {
+        cnd_signal(&exclusive_cvar_);
+    } else {
+        cnd_broadcast(&shared_cvar_);
+    }
+    mtx_unlock(&lock_);
+}
+
+void SharedMutex::AcquireShared() {
+    mtx_lock(&lock_);
+    while (writer_ || (writers_waiting_ > 0)) {
+        cnd_wait(&shared_cvar_, &lock_);
+    }
+    readers_++;
+    mtx_unlock(&lock_);
+}
+
+void SharedMutex::ReleaseShared() {
+    mtx_lock(&lock_);
+    if ((--readers_ == 0) && (writers_waiting_ > 0)) {
+        cnd_signal(&exclusive_cvar_);
+    }
+    mtx_unlock(&lock_);
+}
+
+} // namespace fs
@@ -23,12 +23,18 @@
 
 #define MXDEBUG 0
 
-// ** NOTE -- this prototype multithreaded dispatcher is only used by
-// ** minfs as part of ongoing multithread development. Not yet safe
-// ** for general consumption
+// Each handler waits on the port with MX_WAIT_ASYNC_ONCE, and is only re-armed
+// once the thread which received its packet is done with it. Messages on a
+// single channel are therefore processed one at a time, in order, while
+// messages on different channels are processed concurrently by the pool.
+// The VFS layer is responsible for locking between channels; see
+// "vfs_namespace_lock" in <fs/vfs.h>.
 
 namespace fs {
 
+// Port key of the shutdown event. Handler keys are never null.
+constexpr uint64_t kShutdownKey = 0;
+
 Handler::~Handler() {
     Close();
 }
@@ -117,9 +123,9 @@ int VfsDispatcher::Loop() {
 
         xprintf("port_wait: thread %s \n", tname);
 
-        if ((packet.signal.observed & MX_EVENT_SIGNALED) != 0) {
+        if (packet.key == kShutdownKey) {
             // reset for the next thread
-            r = shutdown_event_.wait_async(port_, 0u, MX_EVENT_SIGNALED,
+            r = shutdown_event_.wait_async(port_, kShutdownKey, MX_EVENT_SIGNALED,
                                            MX_WAIT_ASYNC_ONCE);
             if (r != MX_OK) {
                 FS_TRACE_ERROR("vfs-dispatcher: error, couldn't reset thread event\n");
@@ -184,7 +190,7 @@ mx_status_t VfsDispatcher::Create(mxio_dispatcher_cb_t cb, uint32_t pool_size,
     if ((status = mx::event::create(0u, &dispatcher->shutdown_event_)) != MX_OK) {
         return status;
     }
-    status = dispatcher->shutdown_event_.wait_async(dispatcher->port_, 0u,
+    status = dispatcher->shutdown_event_.wait_async(dispatcher->port_, kShutdownKey,
                                                     MX_EVENT_SIGNALED,
                                                     MX_WAIT_ASYNC_ONCE);
     if (status != MX_OK) {
@@ -234,6 +240,10 @@ mx_status_t VfsDispatcher::Start(const char* name) {
     return MX_OK;
 }
 
+mx_status_t VfsDispatcher::Run() {
+    return Loop();
+}
+
 mx_status_t VfsDispatcher::AddVFSHandler(mx_handle_t h, vfs_dispatcher_cb_t cb, void* cookie) {
     AllocChecker ac;
     mxtl::unique_ptr<Handler> handler(new (&ac) Handler(h, cb, cookie));
@@ -15,9 +15,11 @@
 #include <mxio/io.h>
 #include <mxio/remoteio.h>
 #include <mxio/vfs.h>
+#include <mxalloc/new.h>
 #include <mxtl/auto_call.h>
 #include <mxtl/auto_lock.h>
 #include <mxtl/ref_ptr.h>
+#include <mxtl/unique_ptr.h>
 
 #include "vfs-internal.h"
 
@@ -45,6 +47,100 @@ static bool readable(uint32_t flags) {
 namespace fs {
 namespace {
 
+// Size of the buffer through which READ_VMO and WRITE_VMO move data.
+// The client's VMO is accessed with mx_vmo_read / mx_vmo_write rather than
+// being mapped, so that a client which resizes it cannot fault the server.
+constexpr size_t kVmoXferChunk = 64 * 1024;
+
+// Moves up to 'len' bytes between 'vn' at 'off' and the start of 'vmo',
+// through a buffer; the default for Vnode::ReadVmo() and WriteVmo().
+ssize_t vfs_xfer_vmo(Vnode* vn, mx_handle_t vmo, bool is_read, size_t len, size_t off) {
+    size_t bufsize = (len > kVmoXferChunk) ? kVmoXferChunk : len;
+    AllocChecker ac;
+    mxtl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[bufsize]);
+    if (!ac.check()) {
+        return MX_ERR_NO_MEMORY;
+    }
+
+    size_t count = 0;
+    while (count < len) {
+        size_t xfer = ((len - count) > bufsize) ? bufsize : (len - count);
+        size_t actual;
+        ssize_t r;
+        mx_status_t status;
+        if (is_read) {
+            if ((r = vn->Read(buf.get(), xfer, off + count)) < 0) {
+                return count ? static_cast<ssize_t>(count) : r;
+            }
+            if ((status = mx_vmo_write(vmo, buf.get(), count, r, &actual)) < 0) {
+                return count ? static_cast<ssize_t>(count) : status;
+            }
+            // only what reached the client's VMO counts as read
+            count += actual;
+            if ((actual < static_cast<size_t>(r)) || (static_cast<size_t>(r) < xfer)) {
+                break;
+            }
+        } else {
+            if ((status = mx_vmo_read(vmo, buf.get(), count, xfer, &actual)) < 0) {
+                return count ? static_cast<ssize_t>(count) : status;
+            }
+            // the client's VMO may be shorter than it claimed; never write
+            // more than was actually read out of it
+            if (actual == 0) {
+                break;
+            }
+            if ((r = vn->Write(buf.get(), actual, off + count)) < 0) {
+                return count ? static_cast<ssize_t>(count) : r;
+            }
+            count += r;
+            if ((static_cast<size_t>(r) < actual) || (actual < xfer)) {
+                break;
+            }
+        }
+    }
+    return static_cast<ssize_t>(count);
+}
+
+} // namespace anonymous
+
+ssize_t Vnode::ReadVmo(mx_handle_t vmo, size_t len, size_t off) {
+    return vfs_xfer_vmo(this, vmo, true, len, off);
+}
+
+ssize_t Vnode::WriteVmo(mx_handle_t vmo, size_t len, size_t off) {
+    return vfs_xfer_vmo(this, vmo, false, len, off);
+}
+
+mx_status_t vfs_vmo_copy(mx_handle_t data_vmo, size_t offset, mx_handle_t client_vmo,
+                         size_t len, bool to_client, size_t* actual) {
+    if (len == 0) {
+        *actual = 0;
+        return MX_OK;
+    }
+    size_t start = offset & ~(PAGE_SIZE - 1);
+    size_t map_len = ((offset + len + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1)) - start;
+    uint32_t flags = MX_VM_FLAG_PERM_READ | MX_VM_FLAG_MAP_RANGE;
+    if (!to_client) {
+        flags |= MX_VM_FLAG_PERM_WRITE;
+    }
+    uintptr_t addr;
+    mx_status_t status;
+    if ((status = mx_vmar_map(mx_vmar_root_self(), 0, data_vmo, start, map_len,
+                              flags, &addr)) != MX_OK) {
+        return status;
+    }
+    void* data = reinterpret_cast<void*>(addr + (offset - start));
+    if (to_client) {
+        status = mx_vmo_write(client_vmo, data, 0, len, actual);
+    } else {
+        status = mx_vmo_read(client_vmo, data, 0, len, actual);
+    }
+    mx_vmar_unmap(mx_vmar_root_self(), addr, map_len);
+    return status;
+}
+
+namespace {
+
 static void txn_handoff_open(mx_handle_t srv, mx_handle_t rh,
                              const char* path, uint32_t flags, uint32_t mode) {
     mxrio_msg_t msg;
@@ -69,10 +165,7 @@ void vfs_rpc_open(mxrio_msg_t* msg, mx_handle_t rh, mxtl::RefPtr<Vnode> vn, cons
     bool pipeline = flags & O_PIPELINE;
     uint32_t open_flags = flags & (~O_PIPELINE);
 
-    {
-        mxtl::AutoLock lock(&vfs_lock);
-        r = Vfs::Open(mxtl::move(vn), &vn, path, &path, open_flags, mode);
-    }
+    r = Vfs::Open(mxtl::move(vn), &vn, path, &path, open_flags, mode);
 
     mxrio_object_t obj;
     memset(&obj, 0, sizeof(obj));
@@ -86,7 +179,11 @@ void vfs_rpc_open(mxrio_msg_t* msg, mx_handle_t rh, mxtl::RefPtr<Vnode> vn, cons
     }
 
     // Acquire the handles to the VFS object
-    if ((r = vn->GetHandles(flags, obj.handle, &obj.type, obj.extra, &obj.esize)) < 0) {
+    {
+        mxtl::AutoLock lock(vn->lock());
+        r = vn->GetHandles(flags, obj.handle, &obj.type, obj.extra, &obj.esize);
+    }
+    if (r < 0) {
         vn->Close();
         goto done;
     }
@@ -158,7 +255,6 @@ mx_status_t Vnode::Serve(mx_handle_t h, uint32_t flags) {
 #define TOKEN_RIGHTS (MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER)
 
 static mx_status_t iostate_get_token(uint64_t vnode_cookie, vfs_iostate* ios, mx_handle_t* out) {
-    mxtl::AutoLock lock(&vfs_lock);
     mx_status_t r;
 
     if (ios->token != MX_HANDLE_INVALID) {
@@ -211,22 +307,19 @@ mx_status_t vfs_handler_vn(mxrio_msg_t* msg, mxtl::RefPtr<Vnode> vn, vfs_iostate
         return ERR_DISPATCHER_INDIRECT;
     }
     case MXRIO_CLOSE: {
-        {
-            mxtl::AutoLock lock(&vfs_lock);
-            if (ios->token != MX_HANDLE_INVALID) {
-                // The token is nullified here to prevent the following race condition:
-                // 1) Open
-                // 2) GetToken
-                // 3) Close + Release Vnode
-                // 4) Use token handle to access defunct vnode (or a different vnode,
-                //    if the memory for it is reallocated).
-                //
-                // By nullifying the token cookie, any remaining handles to the event will
-                // be ignored by the filesystem server.
-                mx_object_set_cookie(ios->token, mx_process_self(), 0);
-                mx_handle_close(ios->token);
-                ios->token = MX_HANDLE_INVALID;
-            }
+        if (ios->token != MX_HANDLE_INVALID) {
+            // The token is nullified here to prevent the following race condition:
+            // 1) Open
+            // 2) GetToken
+            // 3) Close + Release Vnode
+            // 4) Use token handle to access defunct vnode (or a different vnode,
+            //    if the memory for it is reallocated).
+            //
+            // By nullifying the token cookie, any remaining handles to the event will
+            // be ignored by the filesystem server.
+            mx_object_set_cookie(ios->token, mx_process_self(), 0);
+            mx_handle_close(ios->token);
+            ios->token = MX_HANDLE_INVALID;
         }
 
         // this will drop the ref on the vn
@@ -293,6 +386,36 @@ mx_status_t vfs_handler_vn(mxrio_msg_t* msg, mxtl::RefPtr<Vnode> vn, vfs_iostate
         ssize_t r = vn->Write(msg->data, len, msg->arg2.off);
         return static_cast<mx_status_t>(r);
     }
+    case MXRIO_READ_VMO:
+    case MXRIO_WRITE_VMO: {
+        // Regardless of success or failure, we'll close the client-provided VMO.
+        mx_handle_t vmo = msg->handle[0];
+        auto ac = mxtl::MakeAutoCall([vmo](){ mx_handle_close(vmo); });
+
+        bool is_read = (MXRIO_OP(msg->op) == MXRIO_READ_VMO);
+        if (is_read ? !readable(ios->io_flags) : !writable(ios->io_flags)) {
+            return MX_ERR_BAD_HANDLE;
+        }
+        if (arg < 0) {
+            return MX_ERR_INVALID_ARGS;
+        }
+        bool at = (msg->arg2.off >= 0);
+        if (!at && !is_read && (ios->io_flags & O_APPEND)) {
+            vnattr_t attr;
+            mx_status_t r;
+            if ((r = vn->Getattr(&attr)) < 0) {
+                return r;
+            }
+            ios->io_off = attr.size;
+        }
+        size_t off = at ? msg->arg2.off : ios->io_off;
+        ssize_t r = is_read ? vn->ReadVmo(vmo, arg, off) : vn->WriteVmo(vmo, arg, off);
+        if ((r >= 0) && !at) {
+            ios->io_off += r;
+            msg->arg2.off = ios->io_off;
+        }
+        return static_cast<mx_status_t>(r);
+    }
     case MXRIO_SEEK: {
         vnattr_t attr;
         mx_status_t r;
@@ -385,11 +508,7 @@ mx_status_t vfs_handler_vn(mxrio_msg_t* msg, mxtl::RefPtr<Vnode> vn, vfs_iostate
         if (msg->arg2.off == READDIR_CMD_RESET) {
             memset(&ios->dircookie, 0, sizeof(ios->dircookie));
         }
-        mx_status_t r;
-        {
-            mxtl::AutoLock lock(&vfs_lock);
-            r = vn->Readdir(&ios->dircookie, msg->data, arg);
-        }
+        mx_status_t r = vn->Readdir(&ios->dircookie, msg->data, arg);
         if (r >= 0) {
             msg->datalen = r;
         }
@@ -520,7 +639,8 @@ mx_status_t vfs_handler_vn(mxrio_msg_t* msg, mxtl::RefPtr<Vnode> vn, vfs_iostate
         mx_status_t r;
         uint64_t vcookie;
 
-        mxtl::AutoLock lock(&vfs_lock);
+        // Tokens are only nullified by MXRIO_CLOSE, which cannot run
+        // concurrently with this request; see vfs_op_is_exclusive.
         if ((r = mx_object_get_cookie(msg->handle[0], mx_process_self(), &vcookie)) < 0) {
             // TODO(smklein): Return a more specific error code for "token not from this server"
             return MX_ERR_INVALID_ARGS;
@@ -575,46 +695,62 @@ mx_status_t vfs_handler_vn(mxrio_msg_t* msg, mxtl::RefPtr<Vnode> vn, vfs_iostate
     }
 }
 
-// TODO(orr): temporary; prevent multithread weirdness while we
-// make locking more fine grained
-static mtx_t vfs_big_lock = MTX_INIT;
+// Returns true if the request changes the namespace, and so must hold the
+// namespace lock exclusively. Everything else, including close and data
+// writes, holds it shared along with the lock of the vnode it acts on, and
+// may run concurrently with requests for other vnodes.
+static bool vfs_op_is_exclusive(const mxrio_msg_t* msg) {
+    switch (MXRIO_OP(msg->op)) {
+    case MXRIO_OPEN:
+        return (msg->arg & (O_CREAT | O_TRUNC)) != 0;
+    case MXRIO_UNLINK:
+    case MXRIO_RENAME:
+    case MXRIO_LINK:
+    case MXRIO_TRUNCATE:
+    // Ioctls may mount and unmount filesystems, or create files.
+    case MXRIO_IOCTL:
+    case MXRIO_IOCTL_1H:
+        return true;
+    default:
+        return false;
+    }
+}
 
 mx_status_t vfs_handler(mxrio_msg_t* msg, void* cookie) {
     vfs_iostate_t* ios = static_cast<vfs_iostate_t*>(cookie);
 
-    mxtl::AutoLock lock(&vfs_big_lock);
+    if (vfs_op_is_exclusive(msg)) {
+        fs::ExclusiveLock lock(&fs::vfs_namespace_lock);
+        return vfs_handler_vn(msg, ios->vn, ios);
+    }
+
+    fs::SharedLock lock(&fs::vfs_namespace_lock);
+    if (MXRIO_OP(msg->op) == MXRIO_OPEN) {
+        // Vfs::Open acquires the lock of each vnode along the path.
+        return vfs_handler_vn(msg, ios->vn, ios);
+    }
     mxtl::RefPtr<Vnode> vn = ios->vn;
-    mx_status_t status = vfs_handler_vn(msg, mxtl::move(vn), ios);
-    return status;
+    mxtl::AutoLock vn_lock(vn->lock());
+    return vfs_handler_vn(msg, vn, ios);
 }
 
 mx_handle_t vfs_rpc_server(mx_handle_t h, mxtl::RefPtr<Vnode> vn) {
-    vfs_iostate_t* ios;
     mx_status_t r;
 
-    if ((ios = (vfs_iostate_t*)calloc(1, sizeof(vfs_iostate_t))) == NULL)
-        return MX_ERR_NO_MEMORY;
-    ios->vn = mxtl::move(vn);  // reference passed in by caller
-    ios->io_flags = O_ADMIN;
-
-    mxio_dispatcher_t* vfs_dispatcher;
-    if ((r = mxio_dispatcher_create(&vfs_dispatcher, mxrio_handler)) < 0) {
-        free(ios);
-        return r;
-    }
-
     // Tell the calling process that we've mounted
     if ((r = mx_object_signal_peer(h, 0, MX_USER_SIGNAL_0)) != MX_OK) {
-        free(ios);
+        mx_handle_close(h);
         return r;
     }
 
-    if ((r = mxio_dispatcher_add(vfs_dispatcher, h, (void*) vfs_handler, ios)) < 0) {
-        free(ios);
+    // The root is served by the filesystem's own dispatcher, like every other
+    // connection, so that all requests are subject to the same threading.
+    fs::Dispatcher* dispatcher = vn->GetDispatcher();
+    if ((r = vn->Serve(h, O_ADMIN)) != MX_OK) {
         return r;
     }
 
-    // calling thread blocks
-    mxio_dispatcher_run(vfs_dispatcher);
-    return MX_OK;
+    // calling thread joins the dispatcher, and serves requests until it
+    // shuts down
+    return dispatcher->Run();
 }
@@ -100,7 +100,7 @@ mx_status_t WatcherContainer::WatchDirV2(Vnode* vn, const vfs_watch_dir_t* cmd)
         WatchBuffer wb;
         {
             // Send "VFS_WATCH_EVT_EXISTING" for all entries in readdir
-            mxtl::AutoLock lock(&vfs_lock);
+            mxtl::AutoLock lock(vn->lock());
             while (true) {
                 mx_status_t status = vn->Readdir(&dircookie, &readdir_buf, sizeof(readdir_buf));
                 if (status <= 0) {
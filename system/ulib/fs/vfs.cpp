@@ -9,13 +9,14 @@
 #include <unistd.h>
 #include <mxio/remoteio.h>
 #include <mxio/watcher.h>
+#include <fs/dentry-cache.h>
 #include <mxtl/auto_call.h>
+#include <mxtl/auto_lock.h>
 
 #ifdef __Fuchsia__
 #include <threads.h>
 #include <magenta/assert.h>
 #include <magenta/syscalls.h>
-#include <mxtl/auto_lock.h>
 #endif
 
 #include "vfs-internal.h"
@@ -27,6 +28,11 @@ mtx_t vfs_lock = MTX_INIT;
 #endif
 
 namespace fs {
+
+#ifdef __Fuchsia__
+SharedMutex vfs_namespace_lock;
+#endif
+
 namespace {
 
 // Trim a name before sending it to internal filesystem functions.
@@ -50,6 +56,26 @@ mx_status_t vfs_name_trim(const char* name, size_t len, size_t* len_out, bool* d
     return MX_OK;
 }
 
+// Look up 'name' within 'vn', consulting the lookup cache first.
+mx_status_t vfs_lookup(Vnode* vn, mxtl::RefPtr<Vnode>* out, const char* name, size_t len) {
+    mxtl::RefPtr<Vnode> cached;
+    if (vfs_dcache.Lookup(vn, name, len, &cached)) {
+        if (cached == nullptr) {
+            return MX_ERR_NOT_FOUND;
+        }
+        *out = mxtl::move(cached);
+        return MX_OK;
+    }
+
+    mx_status_t r = vn->Lookup(out, name, len);
+    if (r == MX_OK) {
+        vfs_dcache.Insert(vn, name, len, *out);
+    } else if (r == MX_ERR_NOT_FOUND) {
+        vfs_dcache.Insert(vn, name, len, nullptr);
+    }
+    return r;
+}
+
 } // namespace anonymous
 
 bool RemoteContainer::IsRemote() const {
@@ -120,7 +146,11 @@ mx_status_t Vfs::Open(mxtl::RefPtr<Vnode> vndir, mxtl::RefPtr<Vnode>* out, const
         if (must_be_dir && !S_ISDIR(mode)) {
             return MX_ERR_INVALID_ARGS;
         }
-        if ((r = vndir->Create(&vn, path, len, mode)) < 0) {
+        {
+            mxtl::AutoLock lock(vndir->lock());
+            r = vndir->Create(&vn, path, len, mode);
+        }
+        if (r < 0) {
             if ((r == MX_ERR_ALREADY_EXISTS) && (!(flags & O_EXCL))) {
                 goto try_open;
             }
@@ -131,13 +161,18 @@ mx_status_t Vfs::Open(mxtl::RefPtr<Vnode> vndir, mxtl::RefPtr<Vnode>* out, const
             }
             return r;
         }
+        vfs_dcache.Insert(vndir.get(), path, len, vn);
         vndir->Notify(path, len, VFS_WATCH_EVT_ADDED);
     } else {
     try_open:
-        r = vndir->Lookup(&vn, path, len);
+        {
+            mxtl::AutoLock lock(vndir->lock());
+            r = vfs_lookup(vndir.get(), &vn, path, len);
+        }
         if (r < 0) {
             return r;
         }
+        mxtl::AutoLock lock(vn->lock());
         if (!(flags & O_NOREMOTE) && vn->IsRemote() && !vn->IsDevice()) {
             // Opening a mount point: Traverse across remote.
             // Devices are different, even though they also have remotes.  Ignore them.
@@ -173,7 +208,11 @@ mx_status_t Vfs::Unlink(mxtl::RefPtr<Vnode> vndir, const char* path, size_t len)
     if ((r = vfs_name_trim(path, len, &len, &must_be_dir)) != MX_OK) {
         return r;
     }
-    return vndir->Unlink(path, len, must_be_dir);
+    if ((r = vndir->Unlink(path, len, must_be_dir)) != MX_OK) {
+        return r;
+    }
+    vfs_dcache.Invalidate(vndir.get(), path, len);
+    return MX_OK;
 }
 
 mx_status_t Vfs::Link(mxtl::RefPtr<Vnode> oldparent, mxtl::RefPtr<Vnode> newparent,
@@ -198,13 +237,14 @@ mx_status_t Vfs::Link(mxtl::RefPtr<Vnode> oldparent, mxtl::RefPtr<Vnode> newpare
 
     // Look up the target vnode
     mxtl::RefPtr<Vnode> target;
-    if ((r = oldparent->Lookup(&target, oldname, oldlen)) < 0) {
+    if ((r = vfs_lookup(oldparent.get(), &target, oldname, oldlen)) < 0) {
         return r;
     }
     r = newparent->Link(newname, newlen, target);
     if (r != MX_OK) {
         return r;
     }
+    vfs_dcache.Invalidate(newparent.get(), newname, newlen);
     newparent->Notify(newname, newlen, VFS_WATCH_EVT_ADDED);
     return MX_OK;
 }
@@ -228,6 +268,8 @@ mx_status_t Vfs::Rename(mxtl::RefPtr<Vnode> oldparent, mxtl::RefPtr<Vnode> newpa
     if (r != MX_OK) {
         return r;
     }
+    vfs_dcache.Invalidate(oldparent.get(), oldname, oldlen);
+    vfs_dcache.Invalidate(newparent.get(), newname, newlen);
     newparent->Notify(newname, newlen, VFS_WATCH_EVT_ADDED);
     return MX_OK;
 }
@@ -309,6 +351,13 @@ ssize_t Vfs::Ioctl(mxtl::RefPtr<Vnode> vn, uint32_t op, const void* in_buf, size
         mx_handle_t* h = (mx_handle_t*)out_buf;
         return Vfs::UninstallRemote(vn, h);
     }
+    case IOCTL_VFS_GET_DCACHE_STATS: {
+        if ((in_len != 0) || (out_len != sizeof(vfs_dcache_stats_t))) {
+            return MX_ERR_INVALID_ARGS;
+        }
+        vfs_dcache.GetStats(reinterpret_cast<vfs_dcache_stats_t*>(out_buf));
+        return sizeof(vfs_dcache_stats_t);
+    }
     case IOCTL_VFS_UNMOUNT_FS: {
         vfs_uninstall_all(MX_TIME_INFINITE);
         vn->Ioctl(op, in_buf, in_len, out_buf, out_len);
@@ -320,6 +369,10 @@ ssize_t Vfs::Ioctl(mxtl::RefPtr<Vnode> vn, uint32_t op, const void* in_buf, size
     }
 }
 
+Vnode::~Vnode() {
+    vfs_dcache.Purge(this);
+}
+
 mx_status_t Vnode::Close() {
     return MX_OK;
 }
@@ -365,6 +418,9 @@ mx_status_t Vfs::Walk(mxtl::RefPtr<Vnode> vn, mxtl::RefPtr<Vnode>* out,
             // convert empty initial path of final path segment to "."
             path = ".";
         }
+
+        // Only one vnode is locked at a time as we walk down the path.
+        mxtl::AutoLock lock(vn->lock());
         if (vn->IsRemote() && !vn->IsDevice()) {
             // remote filesystem mount, caller must resolve
             // devices are different, so ignore them even though they can have vn->remote
@@ -393,11 +449,14 @@ mx_status_t Vfs::Walk(mxtl::RefPtr<Vnode> vn, mxtl::RefPtr<Vnode>* out,
             // traverse to the next segment
             size_t len = nextpath - path;
             nextpath++;
-            r = vn->Lookup(&vn, path, len);
+            mxtl::RefPtr<Vnode> next;
+            r = vfs_lookup(vn.get(), &next, path, len);
             assert(r <= 0);
             if (r < 0) {
                 return r;
             }
+            lock.release();
+            vn = mxtl::move(next);
             path = nextpath;
         } else {
             // final path segment, we're done here
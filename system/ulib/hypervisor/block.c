@@ -24,6 +24,11 @@ typedef mx_status_t (* virtio_req_fn_t)(void* ctx, void* req, void* addr, uint32
 mx_status_t handle_virtio_block_read(guest_state_t* guest_state, uint16_t port,
                                      uint8_t access_size, io_packet_t* io_packet) {
     switch (port) {
+    case VIRTIO_PCI_DEVICE_FEATURES:
+        if (access_size != 4)
+            return MX_ERR_IO_DATA_INTEGRITY;
+        io_packet->u32 = 0;
+        return MX_OK;
     case VIRTIO_PCI_QUEUE_SIZE:
         if (access_size != 2)
             return MX_ERR_IO_DATA_INTEGRITY;
@@ -70,6 +75,13 @@ mx_status_t handle_virtio_block_write(vcpu_context_t* vcpu_context, uint16_t por
     int block_fd = vcpu_context->guest_state->block_fd;
     virtio_queue_t* queue = &vcpu_context->guest_state->block_queue;
     switch (port) {
+    case VIRTIO_PCI_DRIVER_FEATURES:
+        if (io->access_size != 4)
+            return MX_ERR_IO_DATA_INTEGRITY;
+        // We offer no features, so the driver may not accept any.
+        if (io->u32 != 0)
+            return MX_ERR_INVALID_ARGS;
+        return MX_OK;
     case VIRTIO_PCI_DEVICE_STATUS:
         if (io->access_size != 1)
             return MX_ERR_IO_DATA_INTEGRITY;
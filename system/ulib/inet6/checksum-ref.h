@@ -0,0 +1,32 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// The straightforward 16-bits-at-a-time ones-complement sum, against
+// which ip6_checksum_partial() is tested and benchmarked.
+static inline uint16_t checksum_ref(const void* _data, size_t len, uint16_t _sum) {
+    uint32_t sum = _sum;
+    const uint8_t* data = _data;
+    while (len > 1) {
+        uint16_t w;
+        memcpy(&w, data, sizeof(w));
+        sum += w;
+        data += 2;
+        len -= 2;
+    }
+    if (len) {
+        uint16_t w = 0;
+        memcpy(&w, data, 1);
+        sum += w;
+    }
+    while (sum > 0xFFFF) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return sum;
+}
@@ -0,0 +1,73 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inet6/inet6.h>
+#include <unittest/unittest.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "checksum-ref.h"
+
+#define BUFSZ 4096
+
+static uint8_t buf[BUFSZ + 16];
+
+static void fill_random(uint8_t* p, size_t len, unsigned* seed) {
+    for (size_t i = 0; i < len; i++) {
+        p[i] = rand_r(seed);
+    }
+}
+
+static bool test_checksum_known(void) {
+    BEGIN_TEST;
+
+    // RFC 1071, section 3: 00 01 f2 03 f4 f5 f6 f7 sums to ddf2
+    const uint8_t data[] = {0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7};
+    uint16_t sum = ip6_checksum_partial(data, sizeof(data), 0);
+    EXPECT_EQ(ntohs(sum), 0xddf2, "");
+
+    EXPECT_EQ(ip6_checksum_partial(data, 0, 0), 0, "empty buffer");
+    EXPECT_EQ(ip6_checksum_partial(data, 0, 0x1234), 0x1234, "sum passes through");
+
+    memset(buf, 0xFF, 64);
+    EXPECT_EQ(ip6_checksum_partial(buf, 64, 0), 0xFFFF, "all ones");
+
+    END_TEST;
+}
+
+static bool test_checksum_random(void) {
+    BEGIN_TEST;
+
+    unsigned seed = 0x1d5f;
+    fill_random(buf, sizeof(buf), &seed);
+    for (int i = 0; i < 2000; i++) {
+        // every alignment and length, including odd ones
+        size_t off = rand_r(&seed) % 16;
+        size_t len = rand_r(&seed) % (BUFSZ + 1);
+        uint16_t sum = rand_r(&seed);
+        uint16_t expected = checksum_ref(buf + off, len, sum);
+        uint16_t actual = ip6_checksum_partial(buf + off, len, sum);
+        ASSERT_EQ(actual, expected, "");
+    }
+
+    // sums of consecutive pieces match the sum of the whole
+    size_t split = 1000;
+    uint16_t whole = ip6_checksum_partial(buf, BUFSZ, 0);
+    uint16_t parts = ip6_checksum_partial(buf, split, 0);
+    parts = ip6_checksum_partial(buf + split, BUFSZ - split, parts);
+    EXPECT_EQ(parts, whole, "");
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(inet6_checksum)
+RUN_TEST(test_checksum_known)
+RUN_TEST(test_checksum_random)
+END_TEST_CASE(inet6_checksum)
+
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
@@ -0,0 +1,61 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <inet6/inet6.h>
+
+static uint16_t fold(uint64_t sum) {
+    while (sum > 0xFFFF) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return sum;
+}
+
+// The ones-complement sum does not depend on byte order or on the width of
+// the words being added, as long as carries out of the top are folded back
+// in. So rather than adding 16 bits at a time, add 32-bit words into 64-bit
+// accumulators (which cannot overflow for any buffer that fits in memory),
+// and fold once at the end.
+//
+// The four independent accumulators keep the adds from serializing on one
+// register, and leave a loop simple enough for the compiler to vectorize
+// with whatever the target offers (SSE2, AVX2, NEON).
+uint16_t ip6_checksum_partial(const void* _data, size_t len, uint16_t sum) {
+    const uint8_t* data = _data;
+    uint64_t s0 = sum, s1 = 0, s2 = 0, s3 = 0;
+    while (len >= 16) {
+        uint32_t w[4];
+        memcpy(w, data, sizeof(w));
+        s0 += w[0];
+        s1 += w[1];
+        s2 += w[2];
+        s3 += w[3];
+        data += 16;
+        len -= 16;
+    }
+    s0 = fold(s0) + fold(s1) + fold(s2) + fold(s3);
+    while (len >= 4) {
+        uint32_t w;
+        memcpy(&w, data, sizeof(w));
+        s0 += w;
+        data += 4;
+        len -= 4;
+    }
+    if (len >= 2) {
+        uint16_t w;
+        memcpy(&w, data, sizeof(w));
+        s0 += w;
+        data += 2;
+        len -= 2;
+    }
+    if (len) {
+        // an odd trailing byte is padded with zero
+        uint16_t w = 0;
+        memcpy(&w, data, 1);
+        s0 += w;
+    }
+    return fold(s0);
+}
@@ -83,6 +83,46 @@ mx_status_t eth_queue_tx(eth_client_t* eth, void* cookie,
     return mx_fifo_write(eth->tx_fifo, &e, sizeof(e), &actual);
 }
 
+mx_status_t eth_stage_tx(eth_client_t* eth, void* cookie,
+                         void* data, size_t len, uint32_t options) {
+    if (eth->tx_pending_count == ETH_TX_BATCH) {
+        mx_status_t status = eth_flush_tx(eth);
+        if (status < 0) {
+            return status;
+        }
+        if (eth->tx_pending_count == ETH_TX_BATCH) {
+            return MX_ERR_SHOULD_WAIT;
+        }
+    }
+    eth_fifo_entry_t* e = &eth->tx_pending[eth->tx_pending_count++];
+    e->offset = data - eth->iobuf;
+    e->length = len;
+    e->flags = options;
+    e->cookie = cookie;
+    IORING_TRACE("eth:tx+ c=%p o=%u l=%u f=%u (staged)\n",
+                 e->cookie, e->offset, e->length, e->flags);
+    return MX_OK;
+}
+
+mx_status_t eth_flush_tx(eth_client_t* eth) {
+    if (eth->tx_pending_count == 0) {
+        return MX_OK;
+    }
+    uint32_t actual;
+    mx_status_t status = mx_fifo_write(eth->tx_fifo, eth->tx_pending,
+                                       eth->tx_pending_count * sizeof(eth_fifo_entry_t),
+                                       &actual);
+    if (status == MX_ERR_SHOULD_WAIT) {
+        return MX_OK;
+    } else if (status < 0) {
+        return status;
+    }
+    eth->tx_pending_count -= actual;
+    memmove(eth->tx_pending, eth->tx_pending + actual,
+            eth->tx_pending_count * sizeof(eth_fifo_entry_t));
+    return MX_OK;
+}
+
 mx_status_t eth_queue_rx(eth_client_t* eth, void* cookie,
                          void* data, size_t len, uint32_t options) {
     eth_fifo_entry_t e = {
@@ -10,12 +10,18 @@
 
 __BEGIN_CDECLS;
 
+// Maximum number of tx packets staged by eth_stage_tx().
+#define ETH_TX_BATCH 32
+
 typedef struct eth_client {
     mx_handle_t tx_fifo;
     mx_handle_t rx_fifo;
     uint32_t tx_size;
     uint32_t rx_size;
     void* iobuf;
+    // packets staged for transmit but not yet written to tx_fifo
+    eth_fifo_entry_t tx_pending[ETH_TX_BATCH];
+    uint32_t tx_pending_count;
 } eth_client_t;
 
 mx_status_t eth_create(int fd, mx_handle_t io_vmo, void* io_mem, eth_client_t** out);
@@ -26,6 +32,16 @@ void eth_destroy(eth_client_t* eth);
 mx_status_t eth_queue_tx(eth_client_t* eth, void* cookie,
                          void* data, size_t len, uint32_t options);
 
+// Stage a packet for transmit. Staged packets are written to the tx fifo
+// together by eth_flush_tx(), in the order they were staged. Returns
+// MX_ERR_SHOULD_WAIT if the staging area is full and cannot be flushed.
+mx_status_t eth_stage_tx(eth_client_t* eth, void* cookie,
+                         void* data, size_t len, uint32_t options);
+
+// Write as many staged packets as the tx fifo has room for. Any that do
+// not fit remain staged for the next flush.
+mx_status_t eth_flush_tx(eth_client_t* eth);
+
 // Process all transmitted buffers
 mx_status_t eth_complete_tx(eth_client_t* eth, void* ctx,
                             void (*func)(void* ctx, void* cookie));
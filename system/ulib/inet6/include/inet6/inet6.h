@@ -29,6 +29,8 @@ typedef struct ndp_n_hdr ndp_n_hdr_t;
 
 #define UDP_HDR_LEN 8
 
+#define UDP6_MAX_PAYLOAD (ETH_MTU - ETH_HDR_LEN - IP6_HDR_LEN - UDP_HDR_LEN)
+
 struct mac_addr {
     uint8_t x[ETH_ADDR_LEN];
 } __attribute__((packed));
@@ -141,6 +143,11 @@ void eth_put_buffer(eth_buffer_t* ethbuf);
 
 int eth_send(eth_buffer_t* ethbuf, size_t skip, size_t len);
 
+// Like eth_send(), but the packet may be held back until eth_flush()
+// so that several packets are handed to the interface together.
+int eth_send_more(eth_buffer_t* ethbuf, size_t skip, size_t len);
+void eth_flush(void);
+
 int eth_add_mcast_filter(const mac_addr_t* addr);
 
 // call to transmit a UDP packet
@@ -148,6 +155,13 @@ int udp6_send(const void* data, size_t len,
               const ip6_addr_t* daddr, uint16_t dport,
               uint16_t sport);
 
+// call to transmit a UDP packet as part of a burst: the packet may
+// not be sent until udp6_flush() is called
+int udp6_send_more(const void* data, size_t len,
+                   const ip6_addr_t* daddr, uint16_t dport,
+                   uint16_t sport);
+void udp6_flush(void);
+
 // implement to recive UDP packets
 void udp6_recv(void* data, size_t len,
                const ip6_addr_t* daddr, uint16_t dport,
@@ -155,6 +169,11 @@ void udp6_recv(void* data, size_t len,
 
 unsigned ip6_checksum(ip6_hdr_t* ip, unsigned type, size_t length);
 
+// Adds 'len' bytes at 'data' to the partial ones-complement sum 'sum',
+// returning the new partial sum (not yet complemented). Words are
+// summed in memory order, so the result is in network byte order.
+uint16_t ip6_checksum_partial(const void* data, size_t len, uint16_t sum);
+
 // NOTES
 //
 // This is an extremely minimal IPv6 stack, supporting just enough
@@ -180,5 +199,6 @@ unsigned ip6_checksum(ip6_hdr_t* ip, unsigned type, size_t length);
 // and free functionality.  It will allocate a single transmit buffer
 // from udp6_send() or icmp6_send() to fill out and either pass to the
 // network stack via eth_send() or, in the event of an error, release
-// via eth_put_buffer().
+// via eth_put_buffer(). udp6_send_more() passes its buffer on via
+// eth_send_more() instead, and udp6_flush() calls eth_flush().
 //
@@ -142,22 +142,6 @@ static int resolve_ip6(mac_addr_t* _mac, const ip6_addr_t* _ip) {
     return -1;
 }
 
-static uint16_t checksum(const void* _data, size_t len, uint16_t _sum) {
-    uint32_t sum = _sum;
-    const uint16_t* data = _data;
-    while (len > 1) {
-        sum += *data++;
-        len -= 2;
-    }
-    if (len) {
-        sum += (*data & 0xFF);
-    }
-    while (sum > 0xFFFF) {
-        sum = (sum & 0xFFFF) + (sum >> 16);
-    }
-    return sum;
-}
-
 typedef struct {
     uint8_t eth[16];
     ip6_hdr_t ip6;
@@ -175,9 +159,9 @@ unsigned ip6_checksum(ip6_hdr_t* ip, unsigned type, size_t length) {
     uint16_t sum;
 
     // length and protocol field for pseudo-header
-    sum = checksum(&ip->length, 2, htons(type));
+    sum = ip6_checksum_partial(&ip->length, 2, htons(type));
     // src/dst for pseudo-header + payload
-    sum = checksum(&ip->src, 32 + length, sum);
+    sum = ip6_checksum_partial(&ip->src, 32 + length, sum);
 
     // 0 is illegal, so 0xffff remains 0xffff
     if (sum != 0xffff) {
@@ -210,9 +194,8 @@ static int ip6_setup(ip6_pkt_t* p, const ip6_addr_t* daddr, size_t length, uint8
     return 0;
 }
 
-#define UDP6_MAX_PAYLOAD (ETH_MTU - ETH_HDR_LEN - IP6_HDR_LEN - UDP_HDR_LEN)
-
-int udp6_send(const void* data, size_t dlen, const ip6_addr_t* daddr, uint16_t dport, uint16_t sport) {
+static int udp6_build(const void* data, size_t dlen, const ip6_addr_t* daddr,
+                      uint16_t dport, uint16_t sport, eth_buffer_t** out, size_t* out_len) {
     if (dlen > UDP6_MAX_PAYLOAD)
         return -1;
     size_t length = dlen + UDP_HDR_LEN;
@@ -231,13 +214,35 @@ int udp6_send(const void* data, size_t dlen, const ip6_addr_t* daddr, uint16_t d
 
     memcpy(p->data, data, dlen);
     p->udp.checksum = ip6_checksum(&p->ip6, HDR_UDP, length);
-    return eth_send(ethbuf, 2, ETH_HDR_LEN + IP6_HDR_LEN + length);
+    *out = ethbuf;
+    *out_len = ETH_HDR_LEN + IP6_HDR_LEN + length;
+    return 0;
 
 fail:
     eth_put_buffer(ethbuf);
     return -1;
 }
 
+int udp6_send(const void* data, size_t dlen, const ip6_addr_t* daddr, uint16_t dport, uint16_t sport) {
+    eth_buffer_t* ethbuf;
+    size_t len;
+    if (udp6_build(data, dlen, daddr, dport, sport, &ethbuf, &len))
+        return -1;
+    return eth_send(ethbuf, 2, len);
+}
+
+int udp6_send_more(const void* data, size_t dlen, const ip6_addr_t* daddr, uint16_t dport, uint16_t sport) {
+    eth_buffer_t* ethbuf;
+    size_t len;
+    if (udp6_build(data, dlen, daddr, dport, sport, &ethbuf, &len))
+        return -1;
+    return eth_send_more(ethbuf, 2, len);
+}
+
+void udp6_flush(void) {
+    eth_flush();
+}
+
 #define ICMP6_MAX_PAYLOAD (ETH_MTU - ETH_HDR_LEN - IP6_HDR_LEN)
 
 static int icmp6_send(const void* data, size_t length, const ip6_addr_t* daddr) {
@@ -273,8 +278,8 @@ void _udp6_recv(ip6_hdr_t* ip, void* _data, size_t len) {
     if (udp->checksum == 0xFFFF)
         udp->checksum = 0;
 
-    sum = checksum(&ip->length, 2, htons(HDR_UDP));
-    sum = checksum(&ip->src, 32 + len, sum);
+    sum = ip6_checksum_partial(&ip->length, 2, htons(HDR_UDP));
+    sum = ip6_checksum_partial(&ip->src, 32 + len, sum);
     if (sum != 0xFFFF)
         BAD("Checksum Incorrect");
 
@@ -299,8 +304,8 @@ void icmp6_recv(ip6_hdr_t* ip, void* _data, size_t len) {
     if (icmp->checksum == 0xFFFF)
         icmp->checksum = 0;
 
-    sum = checksum(&ip->length, 2, htons(HDR_ICMP6));
-    sum = checksum(&ip->src, 32 + len, sum);
+    sum = ip6_checksum_partial(&ip->length, 2, htons(HDR_ICMP6));
+    sum = ip6_checksum_partial(&ip->src, 32 + len, sum);
     if (sum != 0xFFFF)
         BAD("Checksum Incorrect");
 
@@ -163,9 +163,7 @@ static void tx_complete(void* ctx, void* cookie) {
     eth_put_buffer_locked(cookie, ETH_BUFFER_TX);
 }
 
-int eth_send(eth_buffer_t* ethbuf, size_t skip, size_t len) {
-    mtx_lock(&eth_lock);
-
+static int eth_send_locked(eth_buffer_t* ethbuf, size_t skip, size_t len) {
     check_ethbuf(ethbuf, ETH_BUFFER_CLIENT);
 
 #if DROP_PACKETS
@@ -173,32 +171,62 @@ int eth_send(eth_buffer_t* ethbuf, size_t skip, size_t len) {
     if ((random() % DROP_PACKETS) == 0) {
         printf("tx drop %d\n", txc);
         eth_put_buffer_locked(ethbuf, ETH_BUFFER_CLIENT);
-        goto fail;
+        return -1;
     }
 #endif
 
     if (eth == NULL) {
         printf("eth_fifo_send: not connected\n");
         eth_put_buffer_locked(ethbuf, ETH_BUFFER_CLIENT);
-        goto fail;
+        return -1;
     }
 
     eth_complete_tx(eth, NULL, tx_complete);
 
     ethbuf->state = ETH_BUFFER_TX;
-    mx_status_t status = eth_queue_tx(eth, ethbuf, ethbuf->data + skip, len, 0);
+    mx_status_t status = eth_stage_tx(eth, ethbuf, ethbuf->data + skip, len, 0);
     if (status < 0) {
         printf("eth_fifo_send: queue tx failed: %d\n", status);
         eth_put_buffer_locked(ethbuf, ETH_BUFFER_TX);
-        goto fail;
+        return -1;
     }
+    return 0;
+}
 
-    mtx_unlock(&eth_lock);
+static int eth_flush_locked(void) {
+    if (eth == NULL) {
+        return -1;
+    }
+    mx_status_t status = eth_flush_tx(eth);
+    if (status < 0) {
+        // staged buffers are reclaimed by netifc_close()
+        printf("eth_fifo_send: flush tx failed: %d\n", status);
+        return -1;
+    }
     return 0;
+}
+
+int eth_send(eth_buffer_t* ethbuf, size_t skip, size_t len) {
+    mtx_lock(&eth_lock);
+    int r = eth_send_locked(ethbuf, skip, len);
+    if (r == 0) {
+        r = eth_flush_locked();
+    }
+    mtx_unlock(&eth_lock);
+    return r;
+}
 
-fail:
+int eth_send_more(eth_buffer_t* ethbuf, size_t skip, size_t len) {
+    mtx_lock(&eth_lock);
+    int r = eth_send_locked(ethbuf, skip, len);
+    mtx_unlock(&eth_lock);
+    return r;
+}
+
+void eth_flush(void) {
+    mtx_lock(&eth_lock);
+    eth_flush_locked();
     mtx_unlock(&eth_lock);
-    return -1;
 }
 
 //TODO: expose ethbuf to netifc clients, avoid a copy here
@@ -395,6 +423,12 @@ int netifc_poll(void) {
             printf("netifc: eth rx failed: %d\n", status);
             return -1;
         }
+        // anything the rx handlers queued with eth_send_more() (or that
+        // did not fit in the tx fifo earlier) goes out before we sleep
+        mtx_lock(&eth_lock);
+        eth_complete_tx(eth, NULL, tx_complete);
+        eth_flush_locked();
+        mtx_unlock(&eth_lock);
         if (net_timer) {
             mx_time_t now = mx_time_get(MX_CLOCK_MONOTONIC);
             if (now > net_timer) {
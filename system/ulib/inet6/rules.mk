@@ -9,6 +9,7 @@ MODULE := $(LOCAL_DIR)
 MODULE_TYPE := userlib
 
 MODULE_SRCS += \
+    $(LOCAL_DIR)/checksum.c \
     $(LOCAL_DIR)/inet6.c \
     $(LOCAL_DIR)/netifc.c \
     $(LOCAL_DIR)/eth-client.c \
@@ -16,3 +17,27 @@ MODULE_SRCS += \
 MODULE_LIBS += system/ulib/mxio system/ulib/magenta system/ulib/c
 
 include make/module.mk
+
+MODULE := $(LOCAL_DIR).test
+
+MODULE_TYPE := usertest
+
+MODULE_SRCS := $(LOCAL_DIR)/checksum.c $(LOCAL_DIR)/checksum-test.c
+
+MODULE_NAME := inet6-test
+
+MODULE_LIBS := system/ulib/unittest system/ulib/mxio system/ulib/c
+
+include make/module.mk
+
+MODULE := $(LOCAL_DIR).checksum-bench
+
+MODULE_TYPE := hostapp
+
+MODULE_SRCS := $(LOCAL_DIR)/checksum.c $(LOCAL_DIR)/checksum-bench.c
+
+MODULE_NAME := inet6-checksum-bench
+
+MODULE_COMPILEFLAGS += -I$(LOCAL_DIR)/include -std=c11
+
+include make/module.mk
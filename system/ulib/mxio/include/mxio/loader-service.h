@@ -57,4 +57,16 @@ mx_status_t mxio_multiloader_create(const char* name,
 // Returns a new dl_set_loader_service-compatible loader service channel.
 mx_status_t mxio_multiloader_new_service(mxio_multiloader_t* ml, mx_handle_t* out);
 
+typedef struct mxio_multiloader_stats {
+    // Library loads served from, and added to, the multiloader's cache.
+    uint64_t hits;
+    uint64_t misses;
+    // The number of libraries currently cached.
+    uint64_t entries;
+} mxio_multiloader_stats_t;
+
+// Returns the multiloader's library cache statistics.
+mx_status_t mxio_multiloader_get_stats(mxio_multiloader_t* ml,
+                                       mxio_multiloader_stats_t* stats);
+
 __END_CDECLS
@@ -51,7 +51,9 @@ __BEGIN_CDECLS
 #define MXRIO_LINK        (0x0000001a | MXRIO_ONE_HANDLE)
 #define MXRIO_MMAP         0x0000001b
 #define MXRIO_FCNTL        0x0000001c
-#define MXRIO_NUM_OPS      29
+#define MXRIO_READ_VMO    (0x0000001d | MXRIO_ONE_HANDLE)
+#define MXRIO_WRITE_VMO   (0x0000001e | MXRIO_ONE_HANDLE)
+#define MXRIO_NUM_OPS      31
 
 #define MXRIO_OP(n)        ((n) & 0x3FF) // opcode
 #define MXRIO_HC(n)        (((n) >> 8) & 3) // handle count
@@ -64,7 +66,8 @@ __BEGIN_CDECLS
     "read_at", "write_at", "truncate", "rename", \
     "connect", "bind", "listen", "getsockname", \
     "getpeername", "getsockopt", "setsockopt", "getaddrinfo", \
-    "setattr", "sync", "link", "mmap", "fcntl" }
+    "setattr", "sync", "link", "mmap", \
+    "fcntl", "read_vmo", "write_vmo" }
 
 const char* mxio_opname(uint32_t op);
 
@@ -193,6 +196,12 @@ static_assert(MXIO_CHUNK_SIZE >= PATH_MAX, "MXIO_CHUNK_SIZE must be large enough
 // LINK        0          0        <name1>0<name2>0  0           -               -
 // MMAP        maxreply   0        mmap_data_msg     0           mmap_data_msg   vmohandle
 // FCNTL       cmd        flags    0                 flags       -               -
+// READ_VMO    maxread    offset   -                 newoffset   -               -
+// WRITE_VMO   len        offset   -                 newoffset   -               -
+//
+// READ_VMO and WRITE_VMO carry a VMO in handle[0], which is consumed by the
+// server. Bytes are transferred between the file and the start of the VMO.
+// An offset of -1 selects (and advances) the current seek offset.
 //
 // proposed:
 //
@@ -47,6 +47,27 @@ static void __PRINTFLIKE(2, 3) log_printf(mx_handle_t log,
     mx_log_write(log, len, buf, 0u);
 }
 
+// The number of library VMOs kept by each multiloader.
+#define LOADER_CACHE_MAX 64
+
+// The rights handed out with a library VMO, matching mxio_get_vmo().
+#define LOADER_VMO_RIGHTS (MX_RIGHT_READ | MX_RIGHT_EXECUTE | MX_RIGHT_MAP | \
+                           MX_RIGHT_TRANSFER | MX_RIGHT_DUPLICATE |          \
+                           MX_RIGHT_GET_PROPERTY | MX_RIGHT_SET_PROPERTY)
+
+// A cached library is identified by the path it was loaded from, and is
+// only reused while the file at that path still has the same inode, size
+// and modification time. Otherwise it is replaced on the next request.
+typedef struct loader_cache_entry loader_cache_entry_t;
+struct loader_cache_entry {
+    loader_cache_entry_t* next;
+    mx_handle_t vmo;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    char path[];
+};
+
 struct mxio_multiloader {
     char name[MX_MAX_NAME_LEN];
     mtx_t dispatcher_lock;
@@ -55,6 +76,14 @@ struct mxio_multiloader {
 
     char config_prefix[32];
     bool config_exclusive;
+
+    // Library VMOs which have already been loaded, most recently used
+    // first. Requests for the same file are served with COW clones.
+    mtx_t cache_lock;
+    loader_cache_entry_t* cache;
+    size_t cache_count;
+    uint64_t cache_hits;
+    uint64_t cache_misses;
 };
 
 static const char* const libpaths[] = {
@@ -71,6 +100,106 @@ static mx_handle_t load_object_fd(int fd, const char* fn, mx_handle_t* out) {
     return status;
 }
 
+// Returns a read-only COW clone of a cached library VMO.
+static mx_status_t clone_cached_vmo(mx_handle_t vmo, mx_handle_t* out) {
+    uint64_t size;
+    mx_status_t status = mx_vmo_get_size(vmo, &size);
+    if (status != MX_OK)
+        return status;
+    mx_handle_t clone;
+    status = mx_vmo_clone(vmo, MX_VMO_CLONE_COPY_ON_WRITE, 0, size, &clone);
+    if (status != MX_OK)
+        return status;
+    // The clone is writable; hand it out with the rights of the original.
+    return mx_handle_replace(clone, LOADER_VMO_RIGHTS, out);
+}
+
+static bool cache_entry_matches(const loader_cache_entry_t* entry,
+                                const struct stat* st) {
+    return entry->ino == st->st_ino && entry->size == st->st_size &&
+           entry->mtime.tv_sec == st->st_mtim.tv_sec &&
+           entry->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static void cache_entry_free(loader_cache_entry_t* entry) {
+    mx_handle_close(entry->vmo);
+    free(entry);
+}
+
+// Like load_object_fd(), but serves the library from the multiloader's
+// cache when the file at |path| has not changed since it was last loaded.
+// Always consumes the fd.
+static mx_status_t load_object_cached(mxio_multiloader_t* ml, int fd,
+                                      const char* path, const char* fn,
+                                      mx_handle_t* out) {
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+        return load_object_fd(fd, fn, out);
+
+    mtx_lock(&ml->cache_lock);
+
+    // Unlink any existing entry for this path; it goes back at the head
+    // of the list if it is still current.
+    loader_cache_entry_t** link = &ml->cache;
+    loader_cache_entry_t* entry;
+    while ((entry = *link) != NULL && strcmp(entry->path, path) != 0)
+        link = &entry->next;
+    if (entry != NULL) {
+        *link = entry->next;
+        ml->cache_count--;
+        if (!cache_entry_matches(entry, &st) ||
+            clone_cached_vmo(entry->vmo, out) != MX_OK) {
+            cache_entry_free(entry);
+            entry = NULL;
+        } else {
+            ml->cache_hits++;
+            close(fd);
+        }
+    }
+
+    mx_status_t status = MX_OK;
+    if (entry == NULL) {
+        ml->cache_misses++;
+        mx_handle_t vmo;
+        status = mxio_get_vmo(fd, &vmo);
+        close(fd);
+        if (status != MX_OK)
+            goto done;
+        size_t len = strlen(path) + 1;
+        if ((entry = malloc(sizeof(*entry) + len)) == NULL ||
+            clone_cached_vmo(vmo, out) != MX_OK) {
+            // Hand out the original without caching it.
+            free(entry);
+            entry = NULL;
+            *out = vmo;
+            goto done;
+        }
+        entry->vmo = vmo;
+        entry->ino = st.st_ino;
+        entry->size = st.st_size;
+        entry->mtime = st.st_mtim;
+        memcpy(entry->path, path, len);
+    }
+
+    entry->next = ml->cache;
+    ml->cache = entry;
+    if (++ml->cache_count > LOADER_CACHE_MAX) {
+        // Evict the least recently used library.
+        link = &ml->cache;
+        while ((*link)->next != NULL)
+            link = &(*link)->next;
+        cache_entry_free(*link);
+        *link = NULL;
+        ml->cache_count--;
+    }
+
+done:
+    mtx_unlock(&ml->cache_lock);
+    if (status == MX_OK)
+        mx_object_set_property(*out, MX_PROP_NAME, fn, strlen(fn));
+    return status;
+}
+
 // For now, just publish data-sink VMOs as files under /tmp/<sink-name>/.
 // The individual file is named by its VMO's name.
 static mx_status_t publish_data_sink(mx_handle_t vmo, const char* sink_name) {
@@ -138,11 +267,11 @@ static mx_status_t publish_data_sink(mx_handle_t vmo, const char* sink_name) {
 }
 
 // When loading a library object, search in the hard-coded locations.
-static int open_from_libpath(const char* prefix, const char* fn) {
+// The path which was opened is written to |path|, of size PATH_MAX.
+static int open_from_libpath(const char* prefix, const char* fn, char* path) {
     int fd = -1;
     for (size_t n = 0; fd < 0 && n < countof(libpaths); ++n) {
-        char path[PATH_MAX];
-        snprintf(path, sizeof(path), "%s/%s%s", libpaths[n], prefix, fn);
+        snprintf(path, PATH_MAX, "%s/%s%s", libpaths[n], prefix, fn);
         fd = open(path, O_RDONLY);
     }
     return fd;
@@ -180,13 +309,14 @@ static mx_handle_t default_load_object(void* cookie,
         return MX_OK;
     }
     case LOADER_SVC_OP_LOAD_OBJECT: {
+        char path[PATH_MAX];
         int fd = -1;
         if (ml->config_prefix[0] != '\0')
-            fd = open_from_libpath(ml->config_prefix, fn);
+            fd = open_from_libpath(ml->config_prefix, fn, path);
         if (fd < 0 && !ml->config_exclusive)
-            fd = open_from_libpath("", fn);
+            fd = open_from_libpath("", fn, path);
         if (fd >= 0)
-            return load_object_fd(fd, fn, out);
+            return load_object_cached(ml, fd, path, fn, out);
         break;
     }
     case LOADER_SVC_OP_LOAD_SCRIPT_INTERP:
@@ -347,6 +477,19 @@ static mx_status_t multiloader_cb(mx_handle_t h, void* cb, void* cookie) {
     return handle_loader_rpc(h, default_load_object, ml, ml->dispatcher_log);
 }
 
+mx_status_t mxio_multiloader_get_stats(mxio_multiloader_t* ml,
+                                       mxio_multiloader_stats_t* stats) {
+    if (ml == NULL || stats == NULL) {
+        return MX_ERR_INVALID_ARGS;
+    }
+    mtx_lock(&ml->cache_lock);
+    stats->hits = ml->cache_hits;
+    stats->misses = ml->cache_misses;
+    stats->entries = ml->cache_count;
+    mtx_unlock(&ml->cache_lock);
+    return MX_OK;
+}
+
 // TODO(dbort): Provide a name/id for the process that this handle will
 // be used for, to make error messages more useful? Would need to pass
 // the same through IOCTL_DMCTL_GET_LOADER_SERVICE_CHANNEL.
@@ -19,6 +19,13 @@ struct mxrio {
 
     // transaction id used for synchronous remoteio calls
     _Atomic mx_txid_t txid;
+
+    // set once the server has rejected READ_VMO / WRITE_VMO
+    atomic_bool no_vmo_xfer;
+
+    // VMO of MXIO_VMO_XFER_MAX bytes, reused by READ_VMO / WRITE_VMO, or
+    // MX_HANDLE_INVALID. A transfer takes it while in use.
+    _Atomic mx_handle_t xfer_vmo;
 };
 
 // These are for the benefit of namespace.c
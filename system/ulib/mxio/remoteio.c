@@ -36,6 +36,12 @@
 #define POLL_SHIFT  24
 #define POLL_MASK   0x1F
 
+// Reads and writes of at least MXIO_VMO_XFER_MIN bytes are made through a
+// VMO (see READ_VMO and WRITE_VMO), rather than in MXIO_CHUNK_SIZE pieces
+// over the channel. Each such transaction moves at most MXIO_VMO_XFER_MAX.
+#define MXIO_VMO_XFER_MIN (4 * MXIO_CHUNK_SIZE)
+#define MXIO_VMO_XFER_MAX (4 * 1024 * 1024)
+
 static_assert(MX_USER_SIGNAL_0 == (1 << POLL_SHIFT), "");
 static_assert((POLLIN << POLL_SHIFT) == DEVICE_SIGNAL_READABLE, "");
 static_assert((POLLPRI << POLL_SHIFT) == DEVICE_SIGNAL_OOB, "");
@@ -334,6 +340,70 @@ ssize_t mxrio_ioctl(mxio_t* io, uint32_t op, const void* in_buf,
     return r;
 }
 
+// Moves 'len' bytes between 'data' and the remote file through a VMO.
+// Returns MX_ERR_NOT_SUPPORTED, having moved nothing, if the server does not
+// implement READ_VMO / WRITE_VMO.
+static ssize_t vmo_xfer_common(bool is_read, bool at, mxrio_t* rio, uint8_t* data,
+                               size_t len, off_t offset) {
+    size_t vmo_size = MXIO_VMO_XFER_MAX;
+    mx_status_t r;
+    // Reuse the fd's VMO, unless another transfer is using it. Its pages
+    // stay committed between transfers, and are freed when the fd closes.
+    mx_handle_t vmo = atomic_exchange(&rio->xfer_vmo, MX_HANDLE_INVALID);
+    if ((vmo == MX_HANDLE_INVALID) && ((r = mx_vmo_create(vmo_size, 0, &vmo)) < 0)) {
+        return r;
+    }
+
+    ssize_t count = 0;
+    mxrio_msg_t msg;
+    while (len > 0) {
+        size_t xfer = (len > vmo_size) ? vmo_size : len;
+        size_t actual;
+        if (!is_read && ((r = mx_vmo_write(vmo, data, 0, xfer, &actual)) < 0)) {
+            break;
+        }
+
+        memset(&msg, 0, MXRIO_HDR_SZ);
+        msg.op = is_read ? MXRIO_READ_VMO : MXRIO_WRITE_VMO;
+        msg.arg = xfer;
+        msg.arg2.off = at ? offset : -1;
+        if ((r = mx_handle_duplicate(vmo, MX_RIGHT_SAME_RIGHTS, &msg.handle[0])) < 0) {
+            break;
+        }
+        msg.hcount = 1;
+
+        if ((r = mxrio_txn(rio, &msg)) < 0) {
+            break;
+        }
+        discard_handles(msg.handle, msg.hcount);
+
+        if ((size_t)r > xfer) {
+            r = MX_ERR_IO;
+            break;
+        }
+        if (is_read && (r > 0)) {
+            mx_status_t status;
+            if ((status = mx_vmo_read(vmo, data, 0, r, &actual)) < 0) {
+                r = status;
+                break;
+            }
+        }
+        count += r;
+        data += r;
+        len -= r;
+        offset += r;
+        // stop at short read or write
+        if ((size_t)r < xfer) {
+            break;
+        }
+    }
+    mx_handle_t none = MX_HANDLE_INVALID;
+    if (!atomic_compare_exchange_strong(&rio->xfer_vmo, &none, vmo)) {
+        mx_handle_close(vmo);
+    }
+    return count ? count : r;
+}
+
 static ssize_t write_common(uint32_t op, mxio_t* io, const void* _data, size_t len, off_t offset) {
     mxrio_t* rio = (mxrio_t*)io;
     const uint8_t* data = _data;
@@ -342,6 +412,14 @@ static ssize_t write_common(uint32_t op, mxio_t* io, const void* _data, size_t l
     mxrio_msg_t msg;
     ssize_t xfer;
 
+    if ((len >= MXIO_VMO_XFER_MIN) && !atomic_load(&rio->no_vmo_xfer)) {
+        r = vmo_xfer_common(false, op == MXRIO_WRITE_AT, rio, (uint8_t*)data, len, offset);
+        if (r != MX_ERR_NOT_SUPPORTED) {
+            return r;
+        }
+        atomic_store(&rio->no_vmo_xfer, true);
+    }
+
     while (len > 0) {
         xfer = (len > MXIO_CHUNK_SIZE) ? MXIO_CHUNK_SIZE : len;
 
@@ -390,6 +468,14 @@ static ssize_t read_common(uint32_t op, mxio_t* io, void* _data, size_t len, off
     mxrio_msg_t msg;
     ssize_t xfer;
 
+    if ((len >= MXIO_VMO_XFER_MIN) && !atomic_load(&rio->no_vmo_xfer)) {
+        r = vmo_xfer_common(true, op == MXRIO_READ_AT, rio, data, len, offset);
+        if (r != MX_ERR_NOT_SUPPORTED) {
+            return r;
+        }
+        atomic_store(&rio->no_vmo_xfer, true);
+    }
+
     while (len > 0) {
         xfer = (len > MXIO_CHUNK_SIZE) ? MXIO_CHUNK_SIZE : len;
 
@@ -469,6 +555,9 @@ mx_status_t mxrio_close(mxio_t* io) {
         rio->h2 = 0;
         mx_handle_close(h);
     }
+    if ((h = atomic_exchange(&rio->xfer_vmo, MX_HANDLE_INVALID)) != MX_HANDLE_INVALID) {
+        mx_handle_close(h);
+    }
 
     return r;
 }
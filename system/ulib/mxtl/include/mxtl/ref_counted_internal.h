@@ -59,6 +59,27 @@ protected:
         adoption_validator_.Adopt();
     }
 
+    // Acquires a reference, unless the count has already dropped to zero
+    // (i.e. the object is being, or is about to be, destroyed). Returns true
+    // if a reference was acquired.
+    //
+    // This is only useful for objects which are reachable through a raw
+    // pointer held outside of any RefPtr, such as a cache which the object's
+    // destructor removes it from, and only while holding whatever lock keeps
+    // that pointer valid.
+    bool AddRefMaybeInDestructor() __WARN_UNUSED_RESULT {
+        adoption_validator_.ValidateAddRef();
+        int old = ref_count_.load(memory_order_acquire);
+        do {
+            if (old <= 0) {
+                return false;
+            }
+        } while (!ref_count_.compare_exchange_weak(&old, old + 1,
+                                                   memory_order_acq_rel,
+                                                   memory_order_acquire));
+        return true;
+    }
+
     // Current ref count. Only to be used for debugging purposes.
     int ref_count_debug() const {
         return ref_count_.load(memory_order_relaxed);
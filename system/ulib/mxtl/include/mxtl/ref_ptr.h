@@ -20,6 +20,9 @@ RefPtr<T> AdoptRef(T* ptr);
 template <typename T>
 RefPtr<T> WrapRefPtr(T* ptr);
 
+template <typename T>
+RefPtr<T> MakeRefPtrUpgradeFromRaw(T* ptr);
+
 namespace internal {
 template <typename T>
 RefPtr<T> MakeRefPtrNoAdopt(T* ptr);
@@ -189,6 +192,7 @@ private:
     template <typename U>
     friend class RefPtr;
     friend RefPtr<T> AdoptRef<T>(T*);
+    friend RefPtr<T> MakeRefPtrUpgradeFromRaw<T>(T*);
     friend RefPtr<T> internal::MakeRefPtrNoAdopt<T>(T*);
 
     enum AdoptTag { ADOPT };
@@ -244,6 +248,20 @@ inline RefPtr<T> WrapRefPtr(T* ptr) {
     return RefPtr<T>(ptr);
 }
 
+// Constructs a RefPtr from a raw pointer to an object which may already be
+// in the process of being destroyed, such as an entry in a cache which the
+// object's destructor removes it from. The caller must hold the lock which
+// protects that cache, so that the memory backing 'ptr' remains valid.
+//
+// Returns nullptr if the object's reference count has already reached zero.
+template <typename T>
+inline RefPtr<T> MakeRefPtrUpgradeFromRaw(T* ptr) {
+    if (ptr == nullptr || !ptr->AddRefMaybeInDestructor()) {
+        return nullptr;
+    }
+    return RefPtr<T>(ptr, RefPtr<T>::NO_ADOPT);
+}
+
 namespace internal {
 // Constructs a RefPtr from a T* without attempt to either AddRef or Adopt the
 // pointer.  Used by the internals of some intrusive container classes to store
@@ -18,6 +18,12 @@
  * larger than 65536 * block size bytes. This is purported to be a common
  * extension of the TFTP protocol.
  *
+ * When sending, the window slides: blocks continue to be sent while the ACK
+ * for the previous window is in flight, by as much as the receiver is seen to
+ * keep up with. A lost block is detected from the receiver's ACKs, without
+ * waiting for a timeout, and sending resumes from the block after the last
+ * one acknowledged.
+ *
  * This library does not deal with the transport of the protocol itself and
  * should be able to be plugged into an existing client or server program.
  *
@@ -196,6 +202,12 @@ tftp_status tftp_session_set_file_interface(tftp_session* session,
 tftp_status tftp_session_set_transport_interface(tftp_session* session,
                                                  tftp_transport_interface* callbacks);
 
+// Limits the block size this side will accept when the remote host requests
+// a transfer. Larger requests are answered with |max_block_size| in the OACK,
+// as RFC 2348 permits.
+tftp_status tftp_session_set_max_block_size(tftp_session* session,
+                                            size_t max_block_size);
+
 // Request to send the file |local_filename| across an existing session
 // to |remote_filename| on the target. If |options| is NULL, all values are
 // set to some (semi-)reasonable defaults. Otherwise, all non-NULL members of
@@ -38,6 +38,8 @@ typedef struct tftp_data_msg_t {
 #define WINDOWSIZE_OPTION 0x08 // RFC 7440
 
 #define DEFAULT_BLOCKSIZE 512
+#define MIN_BLOCKSIZE 8      // RFC 2348
+#define MAX_BLOCKSIZE 65464  // RFC 2348
 #define DEFAULT_TIMEOUT 1
 #define DEFAULT_FILESIZE 0
 #define DEFAULT_WINDOWSIZE 1
@@ -91,15 +93,37 @@ typedef enum {
     COMPLETED,
 } tftp_state;
 
+// Consecutive timeouts, without hearing from the remote host, after which a
+// transfer in progress is abandoned.
+#define MAX_TIMEOUTS 10
+
 // TODO add a state so time out can be handled properly as well as unexpected traffic
 struct tftp_session_t {
     tftp_options options;
     tftp_state state;
     size_t offset;
+    bool is_sender;
 
+    // When sending: the last block acknowledged by the receiver, and the
+    // number of blocks sent beyond it.
+    // When receiving: the last block received in order, and the number of
+    // blocks received since the last ACK.
     uint32_t block_number;
     uint32_t window_index;
 
+    // When sending, the receiver acknowledges every |window_size| blocks.
+    // Rather than stall on each of those ACKs, up to |window_extra| further
+    // blocks are kept in flight. This grows by one for each window
+    // acknowledged cleanly (up to another |window_size|), and is cut back
+    // when a block is lost.
+    uint16_t window_extra;
+    // When receiving, the block number of the previous DATA message.
+    uint16_t last_received;
+    uint32_t timeouts;
+
+    // Largest block size accepted in a request from the remote host.
+    uint16_t max_block_size;
+
     // "Negotiated" values
     size_t file_size;
     tftp_mode mode;
@@ -114,8 +138,8 @@ struct tftp_session_t {
 
 // tftp_session_has_pending returns true if the tftp_session has more data to
 // send before waiting for an ack. It is recommended that the caller do a
-// non-blocking read to see if an out-of-order ACK was sent by the remote host
-// before sending additional data packets.
+// non-blocking read to see if an ACK was sent by the remote host before
+// sending additional data packets, so that the window keeps sliding.
 bool tftp_session_has_pending(tftp_session* session);
 
 // Generates a write request to send to a tftp server. |filename| is the name
@@ -9,6 +9,7 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 // This test simulates a tftp file transfer by running two threads. Both the
@@ -18,6 +19,8 @@ struct test_params {
     uint32_t filesz;
     uint16_t winsz;
     uint16_t blksz;
+    // If non-zero, the sender drops every |drop_every|th message it sends.
+    uint32_t drop_every;
 };
 
 uint8_t *src_file;
@@ -128,6 +131,9 @@ fake_socket_t server_out_socket = { .size = FAKE_SOCK_BUF_SZ };
 typedef struct {
     fake_socket_t* in_sock;
     fake_socket_t* out_sock;
+    uint32_t timeout_ms;
+    uint32_t drop_every;
+    uint32_t send_count;
 } transport_info_t;
 
 void clear_sockets(void) {
@@ -139,6 +145,9 @@ void clear_sockets(void) {
 
 // Initialize "sockets" for either client or server.
 void transport_init(transport_info_t* transport_info, bool is_server) {
+    transport_info->timeout_ms = 0;
+    transport_info->drop_every = 0;
+    transport_info->send_count = 0;
     if (is_server) {
         transport_info->in_sock = &client_out_socket;
         transport_info->out_sock = &server_out_socket;
@@ -169,6 +178,13 @@ void write_to_buf(fake_socket_t* sock, void* data, size_t size) {
 int transport_send(void* data, size_t len, void* transport_cookie) {
     transport_info_t* transport_info = transport_cookie;
     fake_socket_t* sock = transport_info->out_sock;
+    // Simulate a lossy network. The first message (the request) always
+    // gets through.
+    transport_info->send_count++;
+    if (transport_info->drop_every &&
+        (transport_info->send_count % transport_info->drop_every) == 0) {
+        return 0;
+    }
     while ((sock->write_ndx + sizeof(len) + len - sock->read_ndx)
            > sock->size) {
         // Wait for the other thread to catch up
@@ -199,13 +215,24 @@ void read_from_buf(fake_socket_t* sock, void* data, size_t size,
     }
 }
 
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 // Receive a message. Note that the buffer's read_ndx and write_ndx don't
 // wrap, which makes it easier to recognize underflow.
 int transport_recv(void* data, size_t len, bool block, void* transport_cookie) {
     transport_info_t* transport_info = transport_cookie;
     if (block) {
+        // A timeout of zero waits forever.
+        uint64_t deadline = now_ms() + transport_info->timeout_ms;
         while ((transport_info->in_sock->read_ndx + sizeof(size_t)) >=
                transport_info->in_sock->write_ndx) {
+            if (transport_info->timeout_ms && now_ms() >= deadline) {
+                return TFTP_ERR_TIMED_OUT;
+            }
             usleep(10);
         }
     } else if ((transport_info->in_sock->read_ndx + sizeof(size_t)) >=
@@ -224,6 +251,8 @@ int transport_recv(void* data, size_t len, bool block, void* transport_cookie) {
 }
 
 int transport_timeout_set(uint32_t timeout_ms, void* transport_cookie) {
+    transport_info_t* transport_info = transport_cookie;
+    transport_info->timeout_ms = timeout_ms;
     return 0;
 }
 
@@ -255,6 +284,7 @@ bool run_send_test(struct test_params* tp) {
     // Configure transport interface
     transport_info_t transport_info;
     transport_init(&transport_info, false);
+    transport_info.drop_every = tp->drop_every;
 
     tftp_transport_interface transport_callbacks = { transport_send,
                                                      transport_recv,
@@ -370,15 +400,21 @@ bool run_one_send_test(struct test_params *tp) {
 
     clear_sockets();
 
+    uint64_t start = now_ms();
     pthread_t send_thread, recv_thread;
     pthread_create(&send_thread, NULL, tftp_send_main, tp);
     pthread_create(&recv_thread, NULL, tftp_recv_main, tp);
 
     pthread_join(send_thread, NULL);
     pthread_join(recv_thread, NULL);
+    uint64_t elapsed = now_ms() - start;
 
     int compare_result = compare_files(tp->filesz);
     EXPECT_EQ(compare_result, 0, "output file mismatch");
+    unittest_printf("%u bytes, block %u, window %u, drop 1/%u: %llu ms (%llu KB/s)\n",
+                    tp->filesz, tp->blksz, tp->winsz, tp->drop_every,
+                    (unsigned long long)elapsed,
+                    (unsigned long long)(tp->filesz / (elapsed ? elapsed : 1)));
     END_TEST;
 }
 
@@ -399,9 +435,26 @@ bool test_tftp_send_file_lg_window(void) {
     return run_one_send_test(&tp);
 }
 
+bool test_tftp_send_file_lossy(void) {
+    // Lost blocks are detected from the receiver's ACKs
+    struct test_params tp = {.filesz = 1000000, .winsz = 16, .blksz = 1024,
+                             .drop_every = 97};
+    return run_one_send_test(&tp);
+}
+
+bool test_tftp_send_file_lossy_tail(void) {
+    // With a window larger than the file, the last block lost is only
+    // recovered by timing out
+    struct test_params tp = {.filesz = 20000, .winsz = 64, .blksz = 1000,
+                             .drop_every = 21};
+    return run_one_send_test(&tp);
+}
+
 BEGIN_TEST_CASE(tftp_send_file)
 RUN_TEST(test_tftp_send_file)
 RUN_TEST(test_tftp_send_file_wrapping_block_count)
 RUN_TEST(test_tftp_send_file_lg_window)
+RUN_TEST(test_tftp_send_file_lossy)
+RUN_TEST(test_tftp_send_file_lossy_tail)
 END_TEST_CASE(tftp_send_file)
 
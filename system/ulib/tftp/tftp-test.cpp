@@ -386,6 +386,36 @@ static bool test_tftp_receive_write_request_windowsize(void) {
     END_TEST;
 }
 
+static bool test_tftp_receive_write_request_max_blocksize(void) {
+    constexpr size_t kMaxBlocksize = 1024;
+
+    BEGIN_TEST;
+
+    test_state ts;
+    ts.reset(1024, 1024, 1500);
+    tftp_file_interface ifc = {NULL, dummy_open_write, NULL, NULL, NULL};
+    tftp_session_set_file_interface(ts.session, &ifc);
+    auto status = tftp_session_set_max_block_size(ts.session, kMaxBlocksize);
+    ASSERT_EQ(TFTP_NO_ERROR, status, "could not set max block size");
+
+    uint8_t buf[] = {
+        0x00, 0x02,                                   // Opcode (WRQ)
+        'f', 'i', 'l', 'e', 'n', 'a', 'm', 'e', 0x00, // Filename
+        'O', 'C', 'T', 'E', 'T', 0x00,                // Mode
+        'T', 'S', 'I', 'Z', 'E', 0x00,                // Option
+        '1', '0', '2', '4', 0x00,                     // TSIZE value
+        'B', 'L', 'K', 'S', 'I', 'Z', 'E', 0x00,      // Option
+        '8', '1', '9', '2', 0x00,                     // BLKSIZE value
+    };
+    status = tftp_process_msg(ts.session, buf, sizeof(buf), ts.out, &ts.outlen, &ts.timeout, nullptr);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "receive write request failed");
+    // The OACK answers with the largest block size we can receive
+    EXPECT_EQ(kMaxBlocksize, ts.session->block_size, "bad session: block size");
+    EXPECT_TRUE(verify_response_opcode(ts, OPCODE_OACK), "bad response");
+
+    END_TEST;
+}
+
 struct tx_test_data {
     struct {
         uint16_t block;
@@ -1010,6 +1040,66 @@ static bool test_tftp_receive_data_block_wrapping(void) {
     END_TEST;
 }
 
+static bool test_tftp_receive_data_skipped_run(void) {
+    BEGIN_TEST;
+
+    test_state ts;
+    ts.reset(1024, 2048, 1500);
+    tftp_file_interface ifc = {NULL, dummy_open_write, NULL, mock_write, NULL};
+    tftp_session_set_file_interface(ts.session, &ifc);
+
+    uint8_t req_buf[] = {
+        0x00, 0x02,                                   // Opcode (WRQ)
+        'f', 'i', 'l', 'e', 'n', 'a', 'm', 'e', 0x00, // Filename
+        'O', 'C', 'T', 'E', 'T', 0x00,                // Mode
+        'T', 'S', 'I', 'Z', 'E', 0x00,                // Option
+        '4', '0', '9', '6', 0x00,                     // TSIZE value
+        'W', 'I', 'N', 'D', 'O', 'W', 'S', 'I', 'Z', 'E', 0x00,      // Option
+        '4', 0x00,                                              // WINDOWSIZE value
+    };
+    auto status = tftp_process_msg(ts.session, req_buf, sizeof(req_buf), ts.out, &ts.outlen, &ts.timeout, nullptr);
+    ASSERT_EQ(TFTP_NO_ERROR, status, "receive write request failed");
+
+    uint8_t data_buf[516] = {
+        0x00, 0x03,  // Opcode (DATA)
+        0x01, 0x00,  // Block
+    };
+    tx_test_data td;
+    ts.outlen = ts.out_size;
+    status = tftp_process_msg(ts.session, data_buf, sizeof(data_buf), ts.out, &ts.outlen, &ts.timeout, &td);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "receive data failed");
+    EXPECT_EQ(0, ts.outlen, "no ack expected within a window");
+
+    // Block 2 is lost: the first block after the gap is acked
+    data_buf[2] = 3u;
+    ts.outlen = ts.out_size;
+    status = tftp_process_msg(ts.session, data_buf, sizeof(data_buf), ts.out, &ts.outlen, &ts.timeout, &td);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "receive data failed");
+    ASSERT_GT(ts.outlen, 0, "outlen must not be zero");
+    auto msg = reinterpret_cast<tftp_data_msg*>(ts.out);
+    EXPECT_EQ(msg->opcode, htons(OPCODE_ACK), "bad opcode");
+    EXPECT_EQ(msg->block, 1, "bad block number");
+
+    // ...but the rest of the run, already in flight, is not
+    data_buf[2] = 4u;
+    ts.outlen = ts.out_size;
+    status = tftp_process_msg(ts.session, data_buf, sizeof(data_buf), ts.out, &ts.outlen, &ts.timeout, &td);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "receive data failed");
+    EXPECT_EQ(0, ts.outlen, "repeated ack for the same gap");
+    EXPECT_EQ(1, ts.session->block_number, "tftp session block number mismatch");
+
+    // The sender goes back to block 2
+    data_buf[2] = 2u;
+    td.expected.offset = DEFAULT_BLOCKSIZE;
+    ts.outlen = ts.out_size;
+    status = tftp_process_msg(ts.session, data_buf, sizeof(data_buf), ts.out, &ts.outlen, &ts.timeout, &td);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "receive data failed");
+    EXPECT_TRUE(verify_write_data(data_buf + 4, td), "bad write data");
+    EXPECT_EQ(2, ts.session->block_number, "tftp session block number mismatch");
+
+    END_TEST;
+}
+
 static bool test_tftp_send_data_receive_ack(void) {
     BEGIN_TEST;
 
@@ -1047,7 +1137,8 @@ static bool test_tftp_send_data_receive_ack(void) {
     status = tftp_process_msg(ts.session, ack_buf, sizeof(ack_buf), ts.out, &ts.outlen, &ts.timeout, &td);
     EXPECT_EQ(TFTP_NO_ERROR, status, "receive error");
     EXPECT_EQ(TRANSMITTING, ts.session->state, "session should be TRANSMITTING");
-    EXPECT_EQ(2, ts.session->block_number, "tftp session block number mismatch");
+    EXPECT_EQ(1, ts.session->block_number, "tftp session block number mismatch");
+    EXPECT_EQ(1, ts.session->window_index, "tftp session window index mismatch");
     EXPECT_EQ(ts.outlen, sizeof(tftp_data_msg) + DEFAULT_BLOCKSIZE, "bad outlen");
     EXPECT_TRUE(verify_read_data(ts, td), "bad test data");
 
@@ -1137,7 +1228,8 @@ static bool test_tftp_send_data_receive_ack_skipped_block(void) {
     status = tftp_process_msg(ts.session, ack_buf, sizeof(ack_buf), ts.out, &ts.outlen, &ts.timeout, &td2);
     EXPECT_EQ(TFTP_NO_ERROR, status, "receive error");
     EXPECT_EQ(TRANSMITTING, ts.session->state, "session should be TRANSMITTING");
-    EXPECT_EQ(1, ts.session->block_number, "tftp session block number mismatch");
+    EXPECT_EQ(0, ts.session->block_number, "tftp session block number mismatch");
+    EXPECT_EQ(1, ts.session->window_index, "tftp session window index mismatch");
     EXPECT_EQ(ts.outlen, sizeof(tftp_data_msg) + DEFAULT_BLOCKSIZE, "bad outlen");
     EXPECT_TRUE(verify_read_data(ts, td2), "bad test data");
 
@@ -1181,8 +1273,8 @@ static bool test_tftp_send_data_receive_ack_window_size(void) {
     td.expected.data[0]++;
     status = tftp_prepare_data(ts.session, ts.out, &ts.outlen, &ts.timeout, &td);
     ASSERT_EQ(TFTP_NO_ERROR, status, "receive error");
-    ASSERT_EQ(2, ts.session->block_number, "tftp session block number mismatch");
-    ASSERT_EQ(0, ts.session->window_index, "tftp session window index mismatch");
+    ASSERT_EQ(0, ts.session->block_number, "tftp session block number mismatch");
+    ASSERT_EQ(2, ts.session->window_index, "tftp session window index mismatch");
     ASSERT_EQ(ts.outlen, sizeof(tftp_data_msg) + DEFAULT_BLOCKSIZE, "bad outlen");
     ASSERT_TRUE(verify_read_data(ts, td), "bad test data");
     ASSERT_FALSE(tftp_session_has_pending(ts.session), "expected to wait for ack");
@@ -1203,6 +1295,8 @@ static bool test_tftp_send_data_receive_ack_window_size(void) {
     EXPECT_EQ(ts.outlen, sizeof(tftp_data_msg) + DEFAULT_BLOCKSIZE, "bad outlen");
     EXPECT_TRUE(verify_read_data(ts, td), "bad test data");
     EXPECT_TRUE(tftp_session_has_pending(ts.session), "expected pending data to transmit");
+    // A window acked cleanly lets one more block be sent ahead of the next ACK
+    EXPECT_EQ(1, ts.session->window_extra, "window should have grown");
 
     END_TEST;
 }
@@ -1247,6 +1341,7 @@ static bool test_tftp_send_data_receive_ack_block_wrapping(void) {
 
     // Artificially advance the session to a point where wrapping will occur
     ts.session->block_number = kWrapAt;
+    ts.session->window_index = 0;
 
     uint8_t data_buf[4 + kBlockSize];
     size_t data_buf_len = sizeof(data_buf);
@@ -1312,8 +1407,10 @@ static bool test_tftp_send_data_receive_ack_skip_block_wrap(void) {
     ASSERT_EQ(TFTP_NO_ERROR, status, "failure to process OACK");
     EXPECT_EQ(1, reads_performed, "failed to call read function");
 
-    // Artificially advance the session so we can test wrapping
-    ts.session->block_number = kLastBlockSent;
+    // Artificially advance the session so we can test wrapping: blocks up to
+    // kLastBlockSent have been sent, but only up to kAckBlock acknowledged.
+    ts.session->block_number = kAckBlock;
+    ts.session->window_index = kLastBlockSent - kAckBlock;
 
     // Create a DATA packet for block kLastBlockSent + 1
     uint8_t data_buf[4 + kBlockSize] = {0};
@@ -1336,7 +1433,7 @@ static bool test_tftp_send_data_receive_ack_skip_block_wrap(void) {
     uint16_t offset = msg->block;
     EXPECT_EQ((kLastBlockSent + 1) & 0xffff, offset, "incorrect DATA packet block");
 
-    // Simulate an ACK response that is before our last block wrap
+    // Simulate a repeated ACK, for a block before our last block wrap
     tftp_data_msg ack_msg;
     ack_msg.opcode = htons(OPCODE_ACK);
     ack_msg.block = kAckBlock & 0xffff;
@@ -1356,7 +1453,153 @@ static bool test_tftp_send_data_receive_ack_skip_block_wrap(void) {
     msg = reinterpret_cast<tftp_data_msg*>(ts.out);
     EXPECT_EQ(OPCODE_DATA, htons(msg->opcode), "incorrect DATA packet opcode");
     EXPECT_EQ((kAckBlock + 1) & 0xffff, msg->block, "incorrect DATA packet block");
-    EXPECT_EQ(ts.session->block_number, kAckBlock + 1, "session offset not rewound correctly");
+    EXPECT_EQ(ts.session->block_number, kAckBlock, "session offset not rewound correctly");
+    EXPECT_EQ(ts.session->window_index, 1, "session offset not rewound correctly");
+
+    END_TEST;
+}
+
+// Sets up a sender which has sent the first |sent| blocks of a 4096 byte file,
+// with a window size of 4.
+static bool setup_sender(test_state* ts, tx_test_data* td, uint32_t sent) {
+    BEGIN_HELPER;
+    ts->reset(1024, 4096, 1500);
+
+    auto status = tftp_generate_write_request(ts->session, kFilename, MODE_OCTET,
+        ts->msg_size, 0, 0, 4, ts->out, &ts->outlen, &ts->timeout);
+    ASSERT_EQ(TFTP_NO_ERROR, status, "error generating write request");
+
+    uint8_t oack_buf[] = {
+        0x00, 0x06,                     // Opcode (OACK)
+        'T', 'S', 'I', 'Z', 'E', 0x00,  // Option
+        '4', '0', '9', '6', 0x00,       // TSIZE value
+        'W', 'I', 'N', 'D', 'O', 'W', 'S', 'I', 'Z', 'E', 0x00,      // Option
+        '4', 0x00,                                              // WINDOWSIZE value
+    };
+    tftp_file_interface ifc = {NULL, NULL, mock_read, NULL, NULL};
+    tftp_session_set_file_interface(ts->session, &ifc);
+
+    ts->outlen = ts->out_size;
+    status = tftp_process_msg(ts->session, oack_buf, sizeof(oack_buf), ts->out, &ts->outlen,
+                              &ts->timeout, td);
+    ASSERT_EQ(TFTP_NO_ERROR, status, "receive error");
+    for (uint32_t i = 1; i < sent; i++) {
+        ts->outlen = ts->out_size;
+        status = tftp_prepare_data(ts->session, ts->out, &ts->outlen, &ts->timeout, td);
+        ASSERT_EQ(TFTP_NO_ERROR, status, "prepare data error");
+    }
+    ASSERT_EQ(0, ts->session->block_number, "tftp session block number mismatch");
+    ASSERT_EQ(sent, ts->session->window_index, "tftp session window index mismatch");
+    END_HELPER;
+}
+
+static bool test_tftp_send_data_receive_ack_go_back(void) {
+    BEGIN_TEST;
+
+    test_state ts;
+    tx_test_data td;
+    ASSERT_TRUE(setup_sender(&ts, &td, 4), "could not set up sender");
+
+    // An ACK in the middle of the window means block 2 was lost
+    uint8_t ack_buf[] = {
+        0x00, 0x04,  // Opcode (ACK)
+        0x01, 0x00,  // Block
+    };
+    td.expected.block = 2;
+    td.expected.offset = DEFAULT_BLOCKSIZE;
+    ts.outlen = ts.out_size;
+    auto status = tftp_process_msg(ts.session, ack_buf, sizeof(ack_buf), ts.out, &ts.outlen,
+                                   &ts.timeout, &td);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "receive error");
+    EXPECT_EQ(1, ts.session->block_number, "tftp session block number mismatch");
+    EXPECT_EQ(1, ts.session->window_index, "tftp session window index mismatch");
+    EXPECT_EQ(ts.outlen, sizeof(tftp_data_msg) + DEFAULT_BLOCKSIZE, "bad outlen");
+    EXPECT_TRUE(verify_read_data(ts, td), "bad test data");
+
+    // An ACK older than the last one is ignored
+    ack_buf[2] = 0;
+    ts.outlen = ts.out_size;
+    status = tftp_process_msg(ts.session, ack_buf, sizeof(ack_buf), ts.out, &ts.outlen,
+                              &ts.timeout, &td);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "receive error");
+    EXPECT_EQ(0, ts.outlen, "stale ack should be ignored");
+    EXPECT_EQ(1, ts.session->block_number, "tftp session block number mismatch");
+    EXPECT_EQ(1, ts.session->window_index, "tftp session window index mismatch");
+
+    END_TEST;
+}
+
+static bool test_tftp_timeout_sender(void) {
+    BEGIN_TEST;
+
+    test_state ts;
+    tx_test_data td;
+    ASSERT_TRUE(setup_sender(&ts, &td, 3), "could not set up sender");
+
+    // The sender goes back to the first block not acknowledged
+    td.expected.block = 1;
+    td.expected.offset = 0;
+    ts.outlen = ts.out_size;
+    auto status = tftp_timeout(ts.session, ts.out, &ts.outlen, &ts.timeout, &td);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "timeout error");
+    EXPECT_EQ(0, ts.session->block_number, "tftp session block number mismatch");
+    EXPECT_EQ(1, ts.session->window_index, "tftp session window index mismatch");
+    EXPECT_EQ(ts.outlen, sizeof(tftp_data_msg) + DEFAULT_BLOCKSIZE, "bad outlen");
+    EXPECT_TRUE(verify_read_data(ts, td), "bad test data");
+
+    // Until it gives up
+    for (int i = 1; i < MAX_TIMEOUTS; i++) {
+        ts.outlen = ts.out_size;
+        status = tftp_timeout(ts.session, ts.out, &ts.outlen, &ts.timeout, &td);
+        ASSERT_EQ(TFTP_NO_ERROR, status, "timeout error");
+    }
+    ts.outlen = ts.out_size;
+    status = tftp_timeout(ts.session, ts.out, &ts.outlen, &ts.timeout, &td);
+    EXPECT_EQ(TFTP_ERR_TIMED_OUT, status, "transfer should be abandoned");
+    EXPECT_EQ(ERROR, ts.session->state, "session should be in ERROR");
+
+    END_TEST;
+}
+
+static bool test_tftp_timeout_receiver(void) {
+    BEGIN_TEST;
+
+    test_state ts;
+    ts.reset(1024, 2048, 1500);
+    tftp_file_interface ifc = {NULL, dummy_open_write, NULL, mock_write, NULL};
+    tftp_session_set_file_interface(ts.session, &ifc);
+
+    uint8_t req_buf[] = {
+        0x00, 0x02,                                   // Opcode (WRQ)
+        'f', 'i', 'l', 'e', 'n', 'a', 'm', 'e', 0x00, // Filename
+        'O', 'C', 'T', 'E', 'T', 0x00,                // Mode
+        'T', 'S', 'I', 'Z', 'E', 0x00,                // Option
+        '2', '0', '4', '8', 0x00,                     // TSIZE value
+        'W', 'I', 'N', 'D', 'O', 'W', 'S', 'I', 'Z', 'E', 0x00,      // Option
+        '4', 0x00,                                              // WINDOWSIZE value
+    };
+    auto status = tftp_process_msg(ts.session, req_buf, sizeof(req_buf), ts.out, &ts.outlen, &ts.timeout, nullptr);
+    ASSERT_EQ(TFTP_NO_ERROR, status, "receive write request failed");
+
+    uint8_t data_buf[516] = {
+        0x00, 0x03,  // Opcode (DATA)
+        0x01, 0x00,  // Block
+    };
+    tx_test_data td;
+    ts.outlen = ts.out_size;
+    status = tftp_process_msg(ts.session, data_buf, sizeof(data_buf), ts.out, &ts.outlen, &ts.timeout, &td);
+    ASSERT_EQ(TFTP_NO_ERROR, status, "receive data failed");
+    ASSERT_EQ(0, ts.outlen, "no ack expected within a window");
+
+    // The rest of the window was lost: ack what has arrived
+    ts.outlen = ts.out_size;
+    status = tftp_timeout(ts.session, ts.out, &ts.outlen, &ts.timeout, &td);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "timeout error");
+    ASSERT_EQ(sizeof(tftp_data_msg), ts.outlen, "bad outlen");
+    auto msg = reinterpret_cast<tftp_data_msg*>(ts.out);
+    EXPECT_EQ(msg->opcode, htons(OPCODE_ACK), "bad opcode");
+    EXPECT_EQ(msg->block, 1, "bad block number");
+    EXPECT_EQ(0, ts.session->window_index, "tftp session window index mismatch");
 
     END_TEST;
 }
@@ -1381,6 +1624,7 @@ RUN_TEST(test_tftp_receive_write_request_send_oack)
 RUN_TEST(test_tftp_receive_write_request_blocksize)
 RUN_TEST(test_tftp_receive_write_request_timeout)
 RUN_TEST(test_tftp_receive_write_request_windowsize)
+RUN_TEST(test_tftp_receive_write_request_max_blocksize)
 END_TEST_CASE(tftp_receive_write_request)
 
 BEGIN_TEST_CASE(tftp_receive_oack)
@@ -1398,6 +1642,7 @@ RUN_TEST(test_tftp_receive_data_windowsize)
 RUN_TEST(test_tftp_receive_data_skipped_block)
 RUN_TEST(test_tftp_receive_data_windowsize_skipped_block)
 RUN_TEST(test_tftp_receive_data_block_wrapping)
+RUN_TEST(test_tftp_receive_data_skipped_run)
 END_TEST_CASE(tftp_receive_data)
 
 BEGIN_TEST_CASE(tftp_send_data)
@@ -1407,8 +1652,14 @@ RUN_TEST(test_tftp_send_data_receive_ack_skipped_block)
 RUN_TEST(test_tftp_send_data_receive_ack_window_size)
 RUN_TEST(test_tftp_send_data_receive_ack_block_wrapping)
 RUN_TEST(test_tftp_send_data_receive_ack_skip_block_wrap)
+RUN_TEST(test_tftp_send_data_receive_ack_go_back)
 END_TEST_CASE(tftp_send_data)
 
+BEGIN_TEST_CASE(tftp_timeout)
+RUN_TEST(test_tftp_timeout_sender)
+RUN_TEST(test_tftp_timeout_receiver)
+END_TEST_CASE(tftp_timeout)
+
 int main(int argc, char* argv[]) {
     return unittest_run_all_tests(argc, argv) ? 0 : -1;
 }
@@ -141,9 +141,10 @@ tftp_status tx_data(tftp_session* session, tftp_data_msg* resp, size_t* outlen,
         OPCODE(resp, OPCODE_DATA);
         resp->block = session->block_number + session->window_index;
         size_t len = MIN(session->file_size - session->offset, session->block_size);
-        xprintf(" -> Copying block #%d (size:%zu/%d) from %zu/%zu [%d/%d]\n",
+        xprintf(" -> Copying block #%d (size:%zu/%d) from %zu/%zu [%d/%d+%d]\n",
                 session->block_number + session->window_index, len, session->block_size,
-                session->offset, session->file_size, session->window_index, session->window_size);
+                session->offset, session->file_size, session->window_index, session->window_size,
+                session->window_extra);
         // TODO(tkilbourn): assert that these function pointers are set
         tftp_status s = session->file_interface.read(resp->data, &len, session->offset, cookie);
         if (s < 0) {
@@ -151,15 +152,6 @@ tftp_status tx_data(tftp_session* session, tftp_data_msg* resp, size_t* outlen,
             return s;
         }
         *outlen = sizeof(*resp) + len;
-
-        if (session->window_index < session->window_size) {
-            xprintf(" -> TRANSMIT_MORE(%d < %d)\n", session->window_index, session->window_size);
-        } else {
-            xprintf(" -> TRANSMIT_WAIT_ON_ACK(%d >= %d)\n", session->window_index,
-                    session->window_size);
-            session->block_number += session->window_size;
-            session->window_index = 0;
-        }
     } else {
         xprintf(" -> TRANSMIT_WAIT_ON_ACK(completed)\n");
     }
@@ -187,6 +179,7 @@ int tftp_init(tftp_session** session, void* buffer, size_t size) {
     s->block_size = s->options.block_size = DEFAULT_BLOCKSIZE;
     s->timeout = s->options.timeout = DEFAULT_TIMEOUT;
     s->mode = s->options.mode = DEFAULT_MODE;
+    s->max_block_size = MAX_BLOCKSIZE;
 
     return TFTP_NO_ERROR;
 }
@@ -210,8 +203,19 @@ tftp_status tftp_session_set_transport_interface(tftp_session* session,
     return TFTP_NO_ERROR;
 }
 
+tftp_status tftp_session_set_max_block_size(tftp_session* session, size_t max_block_size) {
+    if (session == NULL || max_block_size < MIN_BLOCKSIZE) {
+        return TFTP_ERR_INVALID_ARGS;
+    }
+    session->max_block_size = MIN(max_block_size, MAX_BLOCKSIZE);
+    return TFTP_NO_ERROR;
+}
+
 bool tftp_session_has_pending(tftp_session* session) {
-    return session->window_index > 0 && session->window_index < session->window_size;
+    return session->window_index > 0 &&
+           session->window_index < (uint32_t)session->window_size + session->window_extra &&
+           (session->block_number + session->window_index) * session->block_size <
+               session->file_size;
 }
 
 tftp_status tftp_generate_write_request(tftp_session* session,
@@ -295,6 +299,7 @@ tftp_status tftp_generate_write_request(tftp_session* session,
     *timeout_ms = 1000 * session->timeout;
 
     session->state = WRITE_REQUESTED;
+    session->is_sender = true;
     xprintf("Generated write request, len=%zu\n", *outlen);
     return TFTP_NO_ERROR;
 }
@@ -373,13 +378,14 @@ tftp_status tftp_handle_wrq(tftp_session* session,
         if (!strncmp(option, kBlkSize, strlen(kBlkSize))) { // RFC 2348
             // Valid values range between "8" and "65464" octets, inclusive
             long val = atol(value);
-            if (val < 8 || val > 65464) {
+            if (val < MIN_BLOCKSIZE || val > MAX_BLOCKSIZE) {
                 xprintf("invalid block size\n");
                 set_error(session, OPCODE_OERROR, resp, resp_len);
                 return TFTP_ERR_INTERNAL;
             }
-            // TODO(tkilbourn): with an MTU of 1500, shouldn't be more than 1428
-            session->options.block_size = val;
+            // The OACK may answer with a smaller size than was requested,
+            // if the request will not fit in what we can receive.
+            session->options.block_size = MIN(val, session->max_block_size);
             session->options.requested |= BLOCKSIZE_OPTION;
         } else if (!strncmp(option, kTimeout, strlen(kTimeout))) { // RFC 2349
             // Valid values range between "1" and "255" seconds inclusive.
@@ -504,6 +510,7 @@ tftp_status tftp_handle_data(tftp_session* session,
     // (> 65535 * blocksize bytes), we allow the block number to wrap. We use signed modulo
     // math to determine the relative location of the block to our current position.
     int16_t block_delta = data->block - (uint16_t)session->block_number;
+    bool send_ack = false;
     if (block_delta == 1) {
         xprintf("Advancing normally + 1\n");
         size_t wr = msg_len - sizeof(tftp_data_msg);
@@ -516,21 +523,30 @@ tftp_status tftp_handle_data(tftp_session* session,
         }
         session->block_number++;
         session->window_index++;
-    } else {
-        // Force sending a ACK with the last block_number we received
+        send_ack = (session->window_index >= session->window_size);
+    } else if (data->block != (uint16_t)(session->last_received + 1)) {
+        // Send an ACK with the last block_number we received, so that the sender
+        // goes back to the block after it. Do this only for the first block of
+        // each run which is out of sequence: the rest of that run was already in
+        // flight behind it, and acknowledging each of those would have the
+        // sender go back over and over.
         xprintf("Skipped: got %d, expected %d\n", session->block_number + block_delta,
                 session->block_number + 1);
-        session->window_index = session->window_size;
+        send_ack = true;
+    } else {
+        xprintf("Skipped: got %d, expected %d (already acked)\n",
+                session->block_number + block_delta, session->block_number + 1);
     }
+    session->last_received = data->block;
 
-    if (session->window_index == session->window_size ||
-            session->block_number * session->block_size >= session->file_size) {
+    bool completed = session->block_number * session->block_size >= session->file_size;
+    if (send_ack || completed) {
         xprintf(" -> Ack %d\n", session->block_number);
         session->window_index = 0;
         OPCODE(ack_data, OPCODE_ACK);
         ack_data->block = session->block_number & 0xffff;
         *resp_len = sizeof(*ack_data);
-        if (session->block_number * session->block_size >= session->file_size) {
+        if (completed) {
             return TFTP_TRANSFER_COMPLETED;
         }
     } else {
@@ -540,6 +556,15 @@ tftp_status tftp_handle_data(tftp_session* session,
     return TFTP_NO_ERROR;
 }
 
+static void tftp_window_grow(tftp_session* session) {
+    // Keep the outstanding blocks well within the 16-bit block number space,
+    // so that ACKs can be placed unambiguously.
+    if (session->window_extra < session->window_size &&
+        (uint32_t)session->window_size + session->window_extra < 0x4000) {
+        session->window_extra++;
+    }
+}
+
 tftp_status tftp_handle_ack(tftp_session* session,
                             tftp_msg* ack,
                             size_t ack_len,
@@ -569,15 +594,45 @@ tftp_status tftp_handle_ack(tftp_session* session,
     // Since we track blocks in 32 bits, but the packets only support 16 bits, calculate the
     // signed 16 bit offset to determine the adjustment to the current position.
     int16_t block_offset = ack_data->block - (uint16_t)session->block_number;
-    session->block_number += block_offset;
-    session->window_index = 0;
+    if (block_offset < 0) {
+        // Older than an ACK we have already seen, so there is nothing to learn
+        // from it.
+        xprintf("Stale ack %d (last %d)\n", ack_data->block, session->block_number);
+        *resp_len = 0;
+        return TFTP_NO_ERROR;
+    }
+    uint32_t acked = block_offset;
+    session->block_number += acked;
+
+    if (acked >= session->window_index) {
+        // Everything in flight has arrived (or, after a timeout, the receiver
+        // already had the blocks we were going back over).
+        session->window_index = 0;
+        if (acked > 0 && (acked % session->window_size) == 0) {
+            tftp_window_grow(session);
+        }
+    } else if (acked == 0 || (acked % session->window_size) != 0) {
+        // The receiver only ACKs in the middle of a window, or repeats an
+        // ACK, when it sees a gap. Go back to the block after the one acked.
+        xprintf(" -> Go back to %d\n", session->block_number + 1);
+        session->window_index = 0;
+        session->window_extra /= 2;
+    } else {
+        // A window has been received, and the blocks sent after it are still
+        // in flight.
+        session->window_index -= acked;
+        tftp_window_grow(session);
+    }
 
-    if (((session->block_number + session->window_index) * session->block_size) >=
-        session->file_size) {
+    if (session->block_number * session->block_size >= session->file_size) {
         *resp_len = 0;
         return TFTP_TRANSFER_COMPLETED;
     }
 
+    if (session->window_index > 0 && !tftp_session_has_pending(session)) {
+        *resp_len = 0;
+        return TFTP_NO_ERROR;
+    }
     tftp_status ret = tx_data(session, resp_data, resp_len, cookie);
     if (ret < 0) {
         set_error(session, OPCODE_ERROR, resp, resp_len);
@@ -649,12 +704,11 @@ tftp_status tftp_handle_oack(tftp_session* session,
             }
             // Valid values range between "8" and "65464" octets, inclusive
             long val = atol(value);
-            if (val < 8 || val > 65464) {
+            if (val < MIN_BLOCKSIZE || val > session->options.block_size) {
                 xprintf("invalid block size\n");
                 set_error(session, OPCODE_OERROR, resp, resp_len);
                 return TFTP_ERR_INTERNAL;
             }
-            // TODO(tkilbourn): with an MTU of 1500, shouldn't be more than 1428
             session->block_size = val;
         } else if (!strncmp(option, kTimeout, strlen(kTimeout))) { // RFC 2349
             if (!(session->options.requested & TIMEOUT_OPTION)) {
@@ -739,6 +793,7 @@ tftp_status tftp_process_msg(tftp_session* session,
 
     // Set default timeout
     *timeout_ms = 1000 * session->timeout;
+    session->timeouts = 0;
 
     switch (opcode) {
     case OPCODE_RRQ:
@@ -786,8 +841,41 @@ tftp_status tftp_timeout(tftp_session* session,
                          size_t* outlen,
                          uint32_t* timeout_ms,
                          void* cookie) {
-    // TODO: really handle timeouts
-    return TFTP_NO_ERROR;
+    *timeout_ms = 1000 * session->timeout;
+    if (session->state != TRANSMITTING) {
+        // TODO: retransmit requests
+        *outlen = 0;
+        return TFTP_NO_ERROR;
+    }
+    if (++session->timeouts > MAX_TIMEOUTS) {
+        xprintf("Too many timeouts\n");
+        *outlen = 0;
+        session->state = ERROR;
+        return TFTP_ERR_TIMED_OUT;
+    }
+
+    if (!session->is_sender) {
+        // Our last ACK may have been lost: repeat it.
+        tftp_data_msg* ack_data = outgoing;
+        xprintf(" -> Timeout, ack %d\n", session->block_number);
+        session->window_index = 0;
+        OPCODE(ack_data, OPCODE_ACK);
+        ack_data->block = session->block_number & 0xffff;
+        *outlen = sizeof(*ack_data);
+        return TFTP_NO_ERROR;
+    }
+
+    // Either the blocks in flight or the receiver's ACK were lost. Go back to
+    // the first block not acknowledged, and stop sending ahead of the
+    // receiver's window until it is shown to be keeping up.
+    xprintf(" -> Timeout, go back to %d\n", session->block_number + 1);
+    session->window_index = 0;
+    session->window_extra = 0;
+    tftp_status ret = tx_data(session, outgoing, outlen, cookie);
+    if (ret < 0) {
+        set_error(session, OPCODE_ERROR, outgoing, outlen);
+    }
+    return ret;
 }
 
 #define REPORT_ERR(opts,...)                                     \
@@ -883,11 +971,12 @@ tftp_status tftp_push_file(tftp_session* session,
                 continue;
             }
             if (n == TFTP_ERR_TIMED_OUT) {
+                out_sz = out_buf_sz;
                 ret = tftp_timeout(session,
                                    outgoing,
                                    &out_sz,
                                    &timeout_ms,
-                                   transport_cookie);
+                                   file_cookie);
                 if (out_sz) {
                     n = session->transport_interface.send(outgoing, out_sz, transport_cookie);
                     if (n < 0) {
@@ -899,6 +988,7 @@ tftp_status tftp_push_file(tftp_session* session,
                     REPORT_ERR(opts, "failed during timeout processing");
                     return ret;
                 }
+                pending = tftp_session_has_pending(session);
                 continue;
             }
             REPORT_ERR(opts, "failed during transport recv callback");
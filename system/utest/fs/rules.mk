@@ -21,6 +21,8 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/test-attr.c \
     $(LOCAL_DIR)/test-append.c \
     $(LOCAL_DIR)/test-basic.c \
+    $(LOCAL_DIR)/test-bulk-io.cpp \
+    $(LOCAL_DIR)/test-dcache.cpp \
     $(LOCAL_DIR)/test-directory.c \
     $(LOCAL_DIR)/test-dot-dot.c \
     $(LOCAL_DIR)/test-link.c \
@@ -35,6 +37,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/test-random-op.c \
     $(LOCAL_DIR)/test-sparse.cpp \
     $(LOCAL_DIR)/test-sync.c \
+    $(LOCAL_DIR)/test-threading.cpp \
     $(LOCAL_DIR)/test-truncate.cpp \
     $(LOCAL_DIR)/test-unlink.cpp \
     $(LOCAL_DIR)/test-vmo.cpp \
@@ -0,0 +1,207 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <magenta/compiler.h>
+#include <magenta/syscalls.h>
+#include <mxalloc/new.h>
+#include <mxio/remoteio.h>
+#include <mxio/util.h>
+#include <mxtl/unique_ptr.h>
+
+#include "filesystems.h"
+
+namespace {
+
+// Large enough to be transferred through a VMO, and to span several VMOs.
+constexpr size_t kBulkSize = (5 * 1024 * 1024) + 4321;
+
+void fill_buffer(uint8_t* buf, size_t len, unsigned seed) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = static_cast<uint8_t>(rand_r(&seed));
+    }
+}
+
+// Large reads and writes, both at the seek offset and at explicit offsets.
+bool test_bulk_read_write(void) {
+    BEGIN_TEST;
+
+    AllocChecker ac;
+    mxtl::unique_ptr<uint8_t[]> expected(new (&ac) uint8_t[kBulkSize]);
+    ASSERT_TRUE(ac.check(), "");
+    mxtl::unique_ptr<uint8_t[]> actual(new (&ac) uint8_t[kBulkSize]);
+    ASSERT_TRUE(ac.check(), "");
+    fill_buffer(expected.get(), kBulkSize, 1);
+
+    int fd = open("::bulk", O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GT(fd, 0, "");
+    ASSERT_EQ(write(fd, expected.get(), kBulkSize), (ssize_t)kBulkSize, "");
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), (off_t)kBulkSize, "");
+
+    ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0, "");
+    ASSERT_EQ(read(fd, actual.get(), kBulkSize), (ssize_t)kBulkSize, "");
+    ASSERT_EQ(memcmp(expected.get(), actual.get(), kBulkSize), 0, "");
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), (off_t)kBulkSize, "");
+
+    // A read which runs past the end of the file is short.
+    const size_t off = kBulkSize / 3;
+    memset(actual.get(), 0, kBulkSize);
+    ASSERT_EQ(pread(fd, actual.get(), kBulkSize, off), (ssize_t)(kBulkSize - off), "");
+    ASSERT_EQ(memcmp(expected.get() + off, actual.get(), kBulkSize - off), 0, "");
+
+    // Overwrite the middle of the file.
+    fill_buffer(expected.get() + off, off, 2);
+    ASSERT_EQ(pwrite(fd, expected.get() + off, off, off), (ssize_t)off, "");
+    ASSERT_EQ(pread(fd, actual.get(), kBulkSize, 0), (ssize_t)kBulkSize, "");
+    ASSERT_EQ(memcmp(expected.get(), actual.get(), kBulkSize), 0, "");
+
+    ASSERT_EQ(close(fd), 0, "");
+    ASSERT_EQ(unlink("::bulk"), 0, "");
+    END_TEST;
+}
+
+// Large writes to a file opened with O_APPEND land at the end of the file.
+bool test_bulk_append(void) {
+    BEGIN_TEST;
+
+    const size_t len = kBulkSize / 4;
+    AllocChecker ac;
+    mxtl::unique_ptr<uint8_t[]> expected(new (&ac) uint8_t[len * 2]);
+    ASSERT_TRUE(ac.check(), "");
+    mxtl::unique_ptr<uint8_t[]> actual(new (&ac) uint8_t[len * 2]);
+    ASSERT_TRUE(ac.check(), "");
+    fill_buffer(expected.get(), len * 2, 3);
+
+    int fd = open("::bulk", O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GT(fd, 0, "");
+    ASSERT_EQ(write(fd, expected.get(), len), (ssize_t)len, "");
+    ASSERT_EQ(close(fd), 0, "");
+
+    fd = open("::bulk", O_RDWR | O_APPEND);
+    ASSERT_GT(fd, 0, "");
+    ASSERT_EQ(write(fd, expected.get() + len, len), (ssize_t)len, "");
+    ASSERT_EQ(pread(fd, actual.get(), len * 2, 0), (ssize_t)(len * 2), "");
+    ASSERT_EQ(memcmp(expected.get(), actual.get(), len * 2), 0, "");
+
+    ASSERT_EQ(close(fd), 0, "");
+    ASSERT_EQ(unlink("::bulk"), 0, "");
+    END_TEST;
+}
+
+// Sends a READ_VMO or WRITE_VMO of 'len' bytes at offset 0 straight down a
+// clone of the file's channel. Unlike mxio, which always sizes the VMO to
+// the transfer, this lets the caller pass a VMO which is too small.
+ssize_t vmo_xfer_raw(int fd, uint32_t op, mx_handle_t vmo, size_t len) {
+    mx_handle_t handles[MXIO_MAX_HANDLES];
+    uint32_t types[MXIO_MAX_HANDLES];
+    mx_status_t r = mxio_clone_fd(fd, 0, handles, types);
+    if (r <= 0) {
+        return (r < 0) ? r : MX_ERR_BAD_STATE;
+    }
+    for (int i = 1; i < r; i++) {
+        mx_handle_close(handles[i]);
+    }
+
+    mxrio_msg_t msg;
+    memset(&msg, 0, MXRIO_HDR_SZ);
+    msg.op = op;
+    msg.arg = static_cast<int32_t>(len);
+    msg.arg2.off = 0;
+    msg.hcount = 1;
+    if ((r = mx_handle_duplicate(vmo, MX_RIGHT_SAME_RIGHTS, &msg.handle[0])) < 0) {
+        mx_handle_close(handles[0]);
+        return r;
+    }
+
+    mx_channel_call_args_t args;
+    args.wr_bytes = &msg;
+    args.wr_handles = msg.handle;
+    args.rd_bytes = &msg;
+    args.rd_handles = msg.handle;
+    args.wr_num_bytes = MXRIO_HDR_SZ;
+    args.wr_num_handles = msg.hcount;
+    args.rd_num_bytes = sizeof(msg);
+    args.rd_num_handles = MXIO_MAX_HANDLES;
+
+    uint32_t dsize;
+    uint32_t hcount;
+    mx_status_t rs;
+    r = mx_channel_call(handles[0], 0, MX_TIME_INFINITE, &args, &dsize, &hcount, &rs);
+    mx_handle_close(handles[0]);
+    if (r < 0) {
+        return (r == MX_ERR_CALL_FAILED) ? rs : r;
+    }
+    for (uint32_t i = 0; i < hcount; i++) {
+        mx_handle_close(msg.handle[i]);
+    }
+    return msg.arg;
+}
+
+// A VMO which is shorter than the length named in the request moves only as
+// many bytes as it holds, in either direction.
+bool test_bulk_short_vmo(void) {
+    BEGIN_TEST;
+
+    const size_t vmo_size = PAGE_SIZE;
+    const size_t len = vmo_size * 3;
+    AllocChecker ac;
+    mxtl::unique_ptr<uint8_t[]> expected(new (&ac) uint8_t[len]);
+    ASSERT_TRUE(ac.check(), "");
+    mxtl::unique_ptr<uint8_t[]> actual(new (&ac) uint8_t[len]);
+    ASSERT_TRUE(ac.check(), "");
+    fill_buffer(expected.get(), len, 4);
+
+    mx_handle_t vmo;
+    ASSERT_EQ(mx_vmo_create(vmo_size, 0, &vmo), MX_OK, "");
+    size_t n;
+    ASSERT_EQ(mx_vmo_write(vmo, expected.get(), 0, vmo_size, &n), MX_OK, "");
+    ASSERT_EQ(n, vmo_size, "");
+
+    int fd = open("::bulk", O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GT(fd, 0, "");
+
+    ssize_t r = vmo_xfer_raw(fd, MXRIO_WRITE_VMO, vmo, len);
+    if (r == MX_ERR_NOT_SUPPORTED) {
+        // the filesystem does not serve bulk I/O at all
+        ASSERT_EQ(mx_handle_close(vmo), MX_OK, "");
+        ASSERT_EQ(close(fd), 0, "");
+        ASSERT_EQ(unlink("::bulk"), 0, "");
+        return true;
+    }
+    ASSERT_EQ(r, (ssize_t)vmo_size, "");
+
+    // Nothing beyond the end of the VMO reached the file.
+    struct stat st;
+    ASSERT_EQ(fstat(fd, &st), 0, "");
+    ASSERT_EQ(st.st_size, (off_t)vmo_size, "");
+    ASSERT_EQ(pread(fd, actual.get(), len, 0), (ssize_t)vmo_size, "");
+    ASSERT_EQ(memcmp(expected.get(), actual.get(), vmo_size), 0, "");
+
+    // Only as much as fits in the VMO is reported as read.
+    ASSERT_EQ(pwrite(fd, expected.get(), len, 0), (ssize_t)len, "");
+    ASSERT_EQ(vmo_xfer_raw(fd, MXRIO_READ_VMO, vmo, len), (ssize_t)vmo_size, "");
+    ASSERT_EQ(mx_vmo_read(vmo, actual.get(), 0, vmo_size, &n), MX_OK, "");
+    ASSERT_EQ(n, vmo_size, "");
+    ASSERT_EQ(memcmp(expected.get(), actual.get(), vmo_size), 0, "");
+
+    ASSERT_EQ(mx_handle_close(vmo), MX_OK, "");
+    ASSERT_EQ(close(fd), 0, "");
+    ASSERT_EQ(unlink("::bulk"), 0, "");
+    END_TEST;
+}
+
+} // namespace
+
+RUN_FOR_ALL_FILESYSTEMS(bulk_io_tests,
+    RUN_TEST_LARGE(test_bulk_read_write)
+    RUN_TEST_LARGE(test_bulk_append)
+    RUN_TEST_MEDIUM(test_bulk_short_vmo)
+)
@@ -0,0 +1,118 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <magenta/compiler.h>
+#include <magenta/device/vfs.h>
+
+#include "filesystems.h"
+
+static bool get_dcache_stats(const char* path, vfs_dcache_stats_t* stats) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY);
+    ASSERT_GT(fd, 0, "");
+    ASSERT_EQ(ioctl_vfs_get_dcache_stats(fd, stats), (ssize_t)sizeof(*stats), "");
+    ASSERT_EQ(close(fd), 0, "");
+    return true;
+}
+
+static bool expect_exists(const char* path, bool exists) {
+    struct stat s;
+    if (exists) {
+        ASSERT_EQ(stat(path, &s), 0, path);
+    } else {
+        ASSERT_EQ(stat(path, &s), -1, path);
+        ASSERT_EQ(errno, ENOENT, path);
+    }
+    return true;
+}
+
+// Cached lookups must observe every change to the namespace.
+bool test_dcache_invalidation(void) {
+    BEGIN_TEST;
+
+    ASSERT_EQ(mkdir("::dcache", 0755), 0, "");
+    ASSERT_TRUE(expect_exists("::dcache/alpha", false), "");
+    ASSERT_TRUE(expect_exists("::dcache/alpha", false), "");
+
+    int fd = open("::dcache/alpha", O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GT(fd, 0, "");
+    ASSERT_EQ(close(fd), 0, "");
+    ASSERT_TRUE(expect_exists("::dcache/alpha", true), "");
+
+    ASSERT_EQ(rename("::dcache/alpha", "::dcache/bravo"), 0, "");
+    ASSERT_TRUE(expect_exists("::dcache/alpha", false), "");
+    ASSERT_TRUE(expect_exists("::dcache/bravo", true), "");
+
+    ASSERT_EQ(unlink("::dcache/bravo"), 0, "");
+    ASSERT_TRUE(expect_exists("::dcache/bravo", false), "");
+
+    // Replace a directory with another of the same name, and ensure that
+    // walks through the name reach the new one.
+    ASSERT_EQ(mkdir("::dcache/sub", 0755), 0, "");
+    fd = open("::dcache/sub/file", O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GT(fd, 0, "");
+    ASSERT_EQ(close(fd), 0, "");
+    ASSERT_TRUE(expect_exists("::dcache/sub/file", true), "");
+    ASSERT_EQ(unlink("::dcache/sub/file"), 0, "");
+    ASSERT_EQ(rmdir("::dcache/sub"), 0, "");
+    ASSERT_TRUE(expect_exists("::dcache/sub/file", false), "");
+    ASSERT_EQ(mkdir("::dcache/sub", 0755), 0, "");
+    ASSERT_TRUE(expect_exists("::dcache/sub/file", false), "");
+    ASSERT_EQ(rmdir("::dcache/sub"), 0, "");
+
+    ASSERT_EQ(rmdir("::dcache"), 0, "");
+    END_TEST;
+}
+
+// Repeated walks of the same path are answered from the cache, for as long
+// as the vnodes along it are alive.
+bool test_dcache_stats(void) {
+    BEGIN_TEST;
+
+    ASSERT_EQ(mkdir("::dcache", 0755), 0, "");
+    ASSERT_EQ(mkdir("::dcache/a", 0755), 0, "");
+    ASSERT_EQ(mkdir("::dcache/a/b", 0755), 0, "");
+
+    // The cache does not keep vnodes alive: hold the directories open.
+    const char* dirs[] = { "::dcache", "::dcache/a", "::dcache/a/b" };
+    int fds[countof(dirs)];
+    for (size_t i = 0; i < countof(dirs); i++) {
+        fds[i] = open(dirs[i], O_RDONLY | O_DIRECTORY);
+        ASSERT_GT(fds[i], 0, dirs[i]);
+    }
+
+    vfs_dcache_stats_t before;
+    ASSERT_TRUE(get_dcache_stats("::dcache", &before), "");
+    ASSERT_GT(before.capacity, 0u, "");
+    ASSERT_LE(before.entries, before.capacity, "");
+
+    for (size_t i = 0; i < 16; i++) {
+        ASSERT_TRUE(expect_exists("::dcache/a/b", true), "");
+        ASSERT_TRUE(expect_exists("::dcache/a/b/missing", false), "");
+    }
+
+    vfs_dcache_stats_t after;
+    ASSERT_TRUE(get_dcache_stats("::dcache", &after), "");
+    ASSERT_GT(after.hits, before.hits, "");
+    ASSERT_GT(after.negative_hits, before.negative_hits, "");
+
+    for (size_t i = 0; i < countof(dirs); i++) {
+        ASSERT_EQ(close(fds[i]), 0, "");
+    }
+    ASSERT_EQ(rmdir("::dcache/a/b"), 0, "");
+    ASSERT_EQ(rmdir("::dcache/a"), 0, "");
+    ASSERT_EQ(rmdir("::dcache"), 0, "");
+    END_TEST;
+}
+
+RUN_FOR_ALL_FILESYSTEMS(dcache_tests,
+    RUN_TEST_MEDIUM(test_dcache_invalidation)
+    RUN_TEST_MEDIUM(test_dcache_stats)
+)
@@ -0,0 +1,153 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <threads.h>
+#include <unistd.h>
+
+#include <magenta/compiler.h>
+#include <mxtl/atomic.h>
+
+#include "filesystems.h"
+
+namespace {
+
+constexpr size_t kNumThreads = 8;
+constexpr size_t kFileSize = 64 * 1024;
+constexpr size_t kIterations = 16;
+
+struct ReaderArgs {
+    char path[32];
+    uint8_t seed;
+    bool ok;
+};
+
+void fill_pattern(uint8_t* buf, size_t len, uint8_t seed) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = static_cast<uint8_t>(seed + i * 7);
+    }
+}
+
+int reader_thread(void* arg) {
+    ReaderArgs* args = static_cast<ReaderArgs*>(arg);
+    uint8_t* expected = static_cast<uint8_t*>(malloc(kFileSize));
+    uint8_t* actual = static_cast<uint8_t*>(malloc(kFileSize));
+    args->ok = (expected != nullptr) && (actual != nullptr);
+    if (args->ok) {
+        fill_pattern(expected, kFileSize, args->seed);
+    }
+    for (size_t i = 0; args->ok && (i < kIterations); i++) {
+        int fd = open(args->path, O_RDONLY);
+        if (fd < 0) {
+            args->ok = false;
+            break;
+        }
+        args->ok = (read(fd, actual, kFileSize) == (ssize_t)kFileSize) &&
+                   (memcmp(expected, actual, kFileSize) == 0);
+        close(fd);
+    }
+    free(expected);
+    free(actual);
+    return 0;
+}
+
+// Many clients reading distinct files at once.
+bool test_concurrent_readers(void) {
+    BEGIN_TEST;
+
+    ReaderArgs args[kNumThreads];
+    uint8_t* buf = static_cast<uint8_t*>(malloc(kFileSize));
+    ASSERT_NONNULL(buf, "");
+    for (size_t i = 0; i < kNumThreads; i++) {
+        snprintf(args[i].path, sizeof(args[i].path), "::reader%zu", i);
+        args[i].seed = static_cast<uint8_t>(i);
+        args[i].ok = false;
+        fill_pattern(buf, kFileSize, args[i].seed);
+        int fd = open(args[i].path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fd, 0, "");
+        ASSERT_EQ(write(fd, buf, kFileSize), (ssize_t)kFileSize, "");
+        ASSERT_EQ(close(fd), 0, "");
+    }
+    free(buf);
+
+    thrd_t threads[kNumThreads];
+    for (size_t i = 0; i < kNumThreads; i++) {
+        ASSERT_EQ(thrd_create(&threads[i], reader_thread, &args[i]), thrd_success, "");
+    }
+    for (size_t i = 0; i < kNumThreads; i++) {
+        int rc;
+        ASSERT_EQ(thrd_join(threads[i], &rc), thrd_success, "");
+        EXPECT_TRUE(args[i].ok, "reader saw unexpected data");
+    }
+
+    for (size_t i = 0; i < kNumThreads; i++) {
+        ASSERT_EQ(unlink(args[i].path), 0, "");
+    }
+    END_TEST;
+}
+
+struct LookupArgs {
+    mxtl::atomic_int* done;
+    bool ok;
+};
+
+int lookup_thread(void* arg) {
+    LookupArgs* args = static_cast<LookupArgs*>(arg);
+    args->ok = true;
+    while (args->ok && !args->done->load()) {
+        struct stat st;
+        args->ok = (stat("::lookup/stable", &st) == 0) && S_ISREG(st.st_mode);
+    }
+    return 0;
+}
+
+// Lookups racing with creation and removal of their neighbours.
+bool test_lookup_during_unlink(void) {
+    BEGIN_TEST;
+
+    ASSERT_EQ(mkdir("::lookup", 0755), 0, "");
+    int fd = open("::lookup/stable", O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GT(fd, 0, "");
+    ASSERT_EQ(close(fd), 0, "");
+
+    mxtl::atomic_int done(0);
+    LookupArgs args[kNumThreads / 2];
+    thrd_t threads[kNumThreads / 2];
+    for (size_t i = 0; i < countof(threads); i++) {
+        args[i].done = &done;
+        ASSERT_EQ(thrd_create(&threads[i], lookup_thread, &args[i]), thrd_success, "");
+    }
+
+    for (size_t i = 0; i < 64; i++) {
+        char path[32];
+        snprintf(path, sizeof(path), "::lookup/churn%zu", i % 8);
+        fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fd, 0, "");
+        ASSERT_EQ(close(fd), 0, "");
+        ASSERT_EQ(unlink(path), 0, "");
+    }
+    done.store(1);
+
+    for (size_t i = 0; i < countof(threads); i++) {
+        int rc;
+        ASSERT_EQ(thrd_join(threads[i], &rc), thrd_success, "");
+        EXPECT_TRUE(args[i].ok, "lookup of a stable file failed");
+    }
+
+    ASSERT_EQ(unlink("::lookup/stable"), 0, "");
+    ASSERT_EQ(rmdir("::lookup"), 0, "");
+    END_TEST;
+}
+
+} // namespace
+
+RUN_FOR_ALL_FILESYSTEMS(threading_tests,
+    RUN_TEST_MEDIUM(test_concurrent_readers)
+    RUN_TEST_MEDIUM(test_lookup_during_unlink)
+)
@@ -8,9 +8,16 @@
 
 #include <elfload/elfload.h>
 
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
 #include <launchpad/launchpad.h>
 #include <launchpad/vmo.h>
 
+#include <magenta/device/dmctl.h>
 #include <magenta/process.h>
 #include <magenta/processargs.h>
 #include <magenta/syscalls.h>
@@ -78,6 +85,66 @@ static bool launchpad_test(void)
     END_TEST;
 }
 
+static bool get_loader_stats(dmctl_loader_stats_t* stats) {
+    int fd = open("/dev/misc/dmctl", O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t r = ioctl_dmctl_get_loader_stats(fd, stats);
+    close(fd);
+    return r == (ssize_t)sizeof(*stats);
+}
+
+// Measures how long it takes to launch this program (which links several
+// shared libraries) and wait for it to exit, with "launchpad-test bench".
+static int spawn_benchmark(void) {
+    const int iters = 200;
+    const char* args[] = { program_path, "exit" };
+
+    dmctl_loader_stats_t before, after;
+    bool have_stats = get_loader_stats(&before);
+
+    mx_time_t total = 0, min = MX_TIME_INFINITE, max = 0;
+    for (int i = 0; i < iters; i++) {
+        mx_time_t t = mx_time_get(MX_CLOCK_MONOTONIC);
+
+        launchpad_t* lp;
+        launchpad_create(MX_HANDLE_INVALID, test_inferior_child_name, &lp);
+        launchpad_load_from_file(lp, program_path);
+        launchpad_clone(lp, LP_CLONE_ALL);
+        launchpad_set_args(lp, countof(args), args);
+        mx_handle_t proc;
+        const char* errmsg;
+        mx_status_t status = launchpad_go(lp, &proc, &errmsg);
+        if (status != MX_OK) {
+            printf("launchpad_go failed: %d: %s\n", status, errmsg);
+            return -1;
+        }
+        mx_object_wait_one(proc, MX_PROCESS_TERMINATED, MX_TIME_INFINITE, NULL);
+        mx_handle_close(proc);
+
+        t = mx_time_get(MX_CLOCK_MONOTONIC) - t;
+        total += t;
+        if (t < min) {
+            min = t;
+        }
+        if (t > max) {
+            max = t;
+        }
+    }
+
+    printf("spawn: %d iterations, avg %" PRIu64 " usec, min %" PRIu64
+           " usec, max %" PRIu64 " usec\n",
+           iters, total / iters / 1000, min / 1000, max / 1000);
+    if (have_stats && get_loader_stats(&after)) {
+        printf("loader cache: %" PRIu64 " hits, %" PRIu64 " misses, %"
+               PRIu64 " libraries cached\n",
+               after.hits - before.hits, after.misses - before.misses,
+               after.entries);
+    }
+    return 0;
+}
+
 BEGIN_TEST_CASE(launchpad_tests)
 RUN_TEST(launchpad_test);
 END_TEST_CASE(launchpad_tests)
@@ -86,6 +153,16 @@ int main(int argc, char **argv)
 {
     program_path = argv[0];
 
+    if (argc > 1) {
+        if (!strcmp(argv[1], "exit")) {
+            // Launched by spawn_benchmark().
+            return 0;
+        }
+        if (!strcmp(argv[1], "bench")) {
+            return spawn_benchmark();
+        }
+    }
+
     bool success = unittest_run_all_tests(argc, argv);
 
     return success ? 0 : -1;
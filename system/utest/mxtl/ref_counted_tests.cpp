@@ -57,6 +57,53 @@ static bool ref_counted_test() {
     END_TEST;
 }
 
+// A RefCounted object which, like an entry in a cache, can be looked up
+// through a raw pointer while its last reference is being dropped.
+class UpgradeTracker : public mxtl::RefCounted<UpgradeTracker> {
+public:
+    explicit UpgradeTracker(UpgradeTracker** slot)
+        : slot_(slot) {}
+    ~UpgradeTracker() {
+        // While the destructor runs the count is zero, so the raw pointer
+        // cannot be upgraded to a new reference.
+        mxtl::RefPtr<UpgradeTracker> ptr = mxtl::MakeRefPtrUpgradeFromRaw(*slot_);
+        upgraded_in_destructor = (ptr != nullptr);
+        *slot_ = nullptr;
+    }
+
+    static bool upgraded_in_destructor;
+
+private:
+    UpgradeTracker** slot_;
+};
+
+bool UpgradeTracker::upgraded_in_destructor = false;
+
+static bool upgrade_from_raw_test() {
+    BEGIN_TEST;
+
+    UpgradeTracker* slot = nullptr;
+    EXPECT_NULL(mxtl::MakeRefPtrUpgradeFromRaw(slot).get(), "");
+
+    AllocChecker ac;
+    mxtl::RefPtr<UpgradeTracker> ptr = mxtl::AdoptRef(new (&ac) UpgradeTracker(&slot));
+    ASSERT_TRUE(ac.check(), "");
+    slot = ptr.get();
+
+    {
+        mxtl::RefPtr<UpgradeTracker> upgraded = mxtl::MakeRefPtrUpgradeFromRaw(slot);
+        EXPECT_EQ(slot, upgraded.get(), "live object should be upgradeable");
+    }
+    EXPECT_NONNULL(slot, "dropping the upgraded reference should not destroy the object");
+
+    ptr.reset();
+    EXPECT_NULL(slot, "object should have been destroyed");
+    EXPECT_FALSE(UpgradeTracker::upgraded_in_destructor,
+                 "dying object should not be upgradeable");
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(ref_counted_tests)
 RUN_NAMED_TEST("Ref Counted", ref_counted_test)
+RUN_NAMED_TEST("Upgrade From Raw", upgrade_from_raw_test)
 END_TEST_CASE(ref_counted_tests);
@@ -650,6 +650,142 @@ bool ramdisk_test_fifo_multiple_vmo_multithreaded(void) {
     END_TEST;
 }
 
+// Each connection to the device gets its own fifo server, and the servers
+// may be used concurrently.
+bool ramdisk_test_fifo_multiple_clients(void) {
+    BEGIN_TEST;
+    const size_t kBlockSize = 512;
+    char ramdisk_path[PATH_MAX];
+    ASSERT_EQ(create_ramdisk(kBlockSize, 1 << 18, ramdisk_path), 0, "");
+
+    const size_t num_clients = 4;
+    int fds[num_clients];
+    fifo_client_t* clients[num_clients];
+    for (size_t i = 0; i < num_clients; i++) {
+        fds[i] = open(ramdisk_path, O_RDWR);
+        ASSERT_GE(fds[i], 0, "Could not open ramdisk device");
+        mx_handle_t fifo;
+        ssize_t expected = sizeof(fifo);
+        ASSERT_EQ(ioctl_block_get_fifos(fds[i], &fifo), expected, "Failed to get FIFO");
+        ASSERT_EQ(block_fifo_create_client(fifo, &clients[i]), MX_OK, "");
+    }
+
+    // Several threads share each client, striping their VMOs across the disk.
+    const size_t num_threads = num_clients * 2;
+    test_vmo_object_t objs[num_threads];
+    thrd_t threads[num_threads];
+    test_thread_arg_t thread_args[num_threads];
+    for (size_t i = 0; i < num_threads; i++) {
+        thread_args[i].obj = &objs[i];
+        thread_args[i].i = i;
+        thread_args[i].objs = num_threads;
+        thread_args[i].fd = fds[i % num_clients];
+        thread_args[i].client = clients[i % num_clients];
+        thread_args[i].kBlockSize = kBlockSize;
+        ASSERT_EQ(thrd_create(&threads[i], fifo_vmo_thread, &thread_args[i]),
+                  thrd_success, "");
+    }
+
+    for (size_t i = 0; i < num_threads; i++) {
+        int res;
+        ASSERT_EQ(thrd_join(threads[i], &res), thrd_success, "");
+        ASSERT_EQ(res, 0, "");
+    }
+
+    block_stats_t stats;
+    ssize_t expected = sizeof(stats);
+    ASSERT_EQ(ioctl_block_get_stats(fds[0], &stats), expected, "Failed to get stats");
+    ASSERT_GT(stats.writes, 0u, "");
+    ASSERT_EQ(stats.writes, stats.reads, "");
+
+    for (size_t i = 0; i < num_clients; i++) {
+        block_fifo_release_client(clients[i]);
+    }
+    ASSERT_GE(ioctl_ramdisk_unlink(fds[0]), 0, "Could not unlink ramdisk device");
+    for (size_t i = 0; i < num_clients; i++) {
+        ASSERT_EQ(close(fds[i]), 0, "");
+    }
+    END_TEST;
+}
+
+// Contiguous requests sent out of order are merged, and a read of a block
+// observes a write to the same block earlier in the transaction.
+bool ramdisk_test_fifo_merge_and_order(void) {
+    BEGIN_TEST;
+    const size_t kBlockSize = 512;
+    const size_t kBlocks = 8;
+    int fd = get_ramdisk(kBlockSize, 1 << 10);
+    mx_handle_t fifo;
+    ssize_t expected = sizeof(fifo);
+    ASSERT_EQ(ioctl_block_get_fifos(fd, &fifo), expected, "Failed to get FIFO");
+    txnid_t txnid;
+    expected = sizeof(txnid_t);
+    ASSERT_EQ(ioctl_block_alloc_txn(fd, &txnid), expected, "Failed to allocate txn");
+    fifo_client_t* client;
+    ASSERT_EQ(block_fifo_create_client(fifo, &client), MX_OK, "");
+
+    // The first half of the VMO is written to disk; the second half is read back.
+    uint64_t vmo_size = kBlockSize * kBlocks * 2;
+    mx_handle_t vmo;
+    ASSERT_EQ(mx_vmo_create(vmo_size, 0, &vmo), MX_OK, "Failed to create VMO");
+    AllocChecker ac;
+    mxtl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[vmo_size]());
+    ASSERT_TRUE(ac.check(), "");
+    fill_random(buf.get(), vmo_size / 2);
+    size_t actual;
+    ASSERT_EQ(mx_vmo_write(vmo, buf.get(), 0, vmo_size, &actual), MX_OK, "");
+
+    vmoid_t vmoid;
+    expected = sizeof(vmoid_t);
+    mx_handle_t xfer_vmo;
+    ASSERT_EQ(mx_handle_duplicate(vmo, MX_RIGHT_SAME_RIGHTS, &xfer_vmo), MX_OK, "");
+    ASSERT_EQ(ioctl_block_attach_vmo(fd, &xfer_vmo, &vmoid), expected,
+              "Failed to attach vmo");
+
+    // Write each block in reverse order, then read it back in the same txn.
+    block_fifo_request_t requests[kBlocks * 2];
+    for (size_t b = 0; b < kBlocks; b++) {
+        size_t block = kBlocks - b - 1;
+        requests[b].txnid      = txnid;
+        requests[b].vmoid      = vmoid;
+        requests[b].opcode     = BLOCKIO_WRITE;
+        requests[b].length     = kBlockSize;
+        requests[b].vmo_offset = block * kBlockSize;
+        requests[b].dev_offset = block * kBlockSize;
+
+        requests[kBlocks + b] = requests[b];
+        requests[kBlocks + b].opcode = BLOCKIO_READ;
+        requests[kBlocks + b].vmo_offset = (kBlocks + block) * kBlockSize;
+    }
+    ASSERT_EQ(block_fifo_txn(client, &requests[0], mxtl::count_of(requests)), MX_OK, "");
+
+    mxtl::unique_ptr<uint8_t[]> out(new (&ac) uint8_t[vmo_size]);
+    ASSERT_TRUE(ac.check(), "");
+    ASSERT_EQ(mx_vmo_read(vmo, out.get(), 0, vmo_size, &actual), MX_OK, "");
+    ASSERT_EQ(memcmp(out.get(), out.get() + vmo_size / 2, vmo_size / 2), 0,
+              "Read did not observe preceding write");
+    ASSERT_EQ(memcmp(buf.get(), out.get(), vmo_size / 2), 0, "");
+
+    block_stats_t stats;
+    expected = sizeof(stats);
+    ASSERT_EQ(ioctl_block_get_stats(fd, &stats), expected, "Failed to get stats");
+    ASSERT_EQ(stats.writes, kBlocks, "");
+    ASSERT_EQ(stats.reads, kBlocks, "");
+    ASSERT_EQ(stats.bytes_written, kBlocks * kBlockSize, "");
+    ASSERT_EQ(stats.bytes_read, kBlocks * kBlockSize, "");
+    ASSERT_EQ(stats.device_ops + stats.merged, kBlocks * 2, "");
+    ASSERT_GT(stats.merged, 0u, "Contiguous requests were not merged");
+    ASSERT_GT(stats.max_queue_depth, 0u, "");
+
+    requests[0].opcode = BLOCKIO_CLOSE_VMO;
+    ASSERT_EQ(block_fifo_txn(client, &requests[0], 1), MX_OK, "");
+    ASSERT_EQ(mx_handle_close(vmo), MX_OK, "");
+    block_fifo_release_client(client);
+    ASSERT_GE(ioctl_ramdisk_unlink(fd), 0, "Could not unlink ramdisk device");
+    ASSERT_EQ(close(fd), 0, "");
+    END_TEST;
+}
+
 bool ramdisk_test_fifo_unclean_shutdown(void) {
     BEGIN_TEST;
     // Set up the ramdisk
@@ -1038,6 +1174,8 @@ RUN_TEST_SMALL(ramdisk_test_fifo_no_op)
 RUN_TEST_SMALL(ramdisk_test_fifo_basic)
 RUN_TEST_SMALL(ramdisk_test_fifo_multiple_vmo)
 RUN_TEST_SMALL(ramdisk_test_fifo_multiple_vmo_multithreaded)
+RUN_TEST_SMALL(ramdisk_test_fifo_multiple_clients)
+RUN_TEST_SMALL(ramdisk_test_fifo_merge_and_order)
 // TODO(smklein): Test ops across different vmos
 RUN_TEST_SMALL(ramdisk_test_fifo_unclean_shutdown)
 RUN_TEST_SMALL(ramdisk_test_fifo_large_ops_count)
@@ -7,6 +7,7 @@
 #include <inttypes.h>
 #include <sys/types.h>
 #include <stdlib.h>
+#include <threads.h>
 #include <unistd.h>
 
 #include <magenta/compiler.h>
@@ -33,6 +34,52 @@ inline mx_time_t time_it(T func) {
     return mx_time_get(MX_CLOCK_MONOTONIC) - t;
 }
 
+struct fault_args {
+    uintptr_t ptr;
+    size_t size;
+};
+
+static int write_fault_thread(void* arg) {
+    auto args = static_cast<fault_args*>(arg);
+    for (size_t i = 0; i < args->size; i += PAGE_SIZE) {
+        ((volatile char *)args->ptr)[i] = 99;
+    }
+    return 0;
+}
+
+static const size_t kMaxFaultThreads = 16;
+
+// write fault |count| separate mappings of |size| bytes each, one thread per mapping
+static mx_time_t parallel_write_fault(size_t count, size_t size) {
+    mx_handle_t vmos[kMaxFaultThreads];
+    fault_args args[kMaxFaultThreads];
+    thrd_t threads[kMaxFaultThreads];
+    if (count > kMaxFaultThreads)
+        __builtin_trap();
+
+    for (size_t i = 0; i < count; i++) {
+        mx_vmo_create(size, 0, &vmos[i]);
+        mx_vmar_map(mx_vmar_root_self(), 0, vmos[i], 0, size,
+                    MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE, &args[i].ptr);
+        args[i].size = size;
+    }
+
+    mx_time_t t = time_it([&](){
+        for (size_t i = 0; i < count; i++) {
+            thrd_create(&threads[i], write_fault_thread, &args[i]);
+        }
+        for (size_t i = 0; i < count; i++) {
+            thrd_join(threads[i], nullptr);
+        }
+    });
+
+    for (size_t i = 0; i < count; i++) {
+        mx_vmar_unmap(mx_vmar_root_self(), args[i].ptr, size);
+        mx_handle_close(vmos[i]);
+    }
+    return t;
+}
+
 int vmo_run_benchmark() {
     mx_time_t t;
     //mx_handle_t vmo;
@@ -175,6 +222,17 @@ int vmo_run_benchmark() {
 
     mx_handle_close(vmo);
 
+    // write fault the same number of pages from one thread, and then spread
+    // across 16 threads with a mapping each, which should not serialize
+    const size_t fault_size = 4*1024*1024;
+    const size_t fault_threads = kMaxFaultThreads;
+    t = parallel_write_fault(1, fault_size * fault_threads);
+    printf("\ttook %" PRIu64 " nsecs to write fault %zu pages from 1 thread\n", t,
+           fault_size * fault_threads / PAGE_SIZE);
+    t = parallel_write_fault(fault_threads, fault_size);
+    printf("\ttook %" PRIu64 " nsecs to write fault %zu pages from %zu threads in separate mappings\n",
+           t, fault_size * fault_threads / PAGE_SIZE, fault_threads);
+
     printf("done with benchmark\n");
 
     return 0;
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <unistd.h>
 
 #include <magenta/process.h>
@@ -613,6 +614,65 @@ bool vmo_zero_page_test() {
     END_TEST;
 }
 
+// Each thread faults in every page of its own mapping, reading half of them
+// first so that the zero page gets replaced, then checks that its writes
+// landed in its own vmo.
+static const size_t kFaultThreads = 16;
+static const size_t kFaultPages = 256;
+
+static int fault_thread(void* arg) {
+    const uint32_t id = (uint32_t)(uintptr_t)arg;
+    const size_t size = kFaultPages * PAGE_SIZE;
+
+    mx_handle_t vmo;
+    if (mx_vmo_create(size, 0, &vmo) != MX_OK)
+        return -1;
+
+    uintptr_t ptr;
+    if (mx_vmar_map(mx_vmar_root_self(), 0, vmo, 0, size,
+                    MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE, &ptr) != MX_OK) {
+        mx_handle_close(vmo);
+        return -1;
+    }
+
+    int result = 0;
+    for (size_t i = 0; i < kFaultPages; i++) {
+        volatile uint32_t* val = (volatile uint32_t*)(ptr + i * PAGE_SIZE);
+        if ((i & 1) && *val != 0)
+            result = -1;
+        *val = (id << 16) | (uint32_t)i;
+    }
+    for (size_t i = 0; i < kFaultPages; i++) {
+        uint32_t v = 0;
+        size_t actual;
+        if (mx_vmo_read(vmo, &v, i * PAGE_SIZE, sizeof(v), &actual) != MX_OK ||
+            v != ((id << 16) | (uint32_t)i))
+            result = -1;
+    }
+
+    mx_vmar_unmap(mx_vmar_root_self(), ptr, size);
+    mx_handle_close(vmo);
+    return result;
+}
+
+bool vmo_concurrent_fault_test() {
+    BEGIN_TEST;
+
+    thrd_t threads[kFaultThreads];
+    for (size_t i = 0; i < kFaultThreads; i++) {
+        ASSERT_EQ(thrd_create_with_name(&threads[i], fault_thread, (void*)(uintptr_t)i,
+                                        "fault"),
+                  thrd_success, "thread create");
+    }
+    for (size_t i = 0; i < kFaultThreads; i++) {
+        int result;
+        EXPECT_EQ(thrd_join(threads[i], &result), thrd_success, "thread join");
+        EXPECT_EQ(result, 0, "faulted pages");
+    }
+
+    END_TEST;
+}
+
 // test set 1: create a few clones, close them
 bool vmo_clone_test_1() {
     BEGIN_TEST;
@@ -1074,6 +1134,83 @@ bool vmo_clone_test_4() {
     END_TEST;
 }
 
+// a clone of a clone, whose middle link is closed before it is used
+bool vmo_clone_chain_test() {
+    BEGIN_TEST;
+
+    mx_handle_t vmo;
+    mx_handle_t clone_vmo[2];
+    size_t bytes_handled;
+    size_t val;
+
+    // create a vmo and fill it with stuff
+    const size_t size = PAGE_SIZE * 4;
+    EXPECT_EQ(MX_OK, mx_vmo_create(size, 0, &vmo), "vm_object_create");
+    for (size_t off = 0; off < size; off += sizeof(off)) {
+        mx_vmo_write(vmo, &off, off, sizeof(off), &bytes_handled);
+    }
+
+    // clone the first three pages, and give the clone a page of its own
+    EXPECT_EQ(MX_OK, mx_vmo_clone(vmo, MX_VMO_CLONE_COPY_ON_WRITE, 0, PAGE_SIZE * 3, &clone_vmo[0]), "vm_clone");
+    val = 99;
+    EXPECT_EQ(MX_OK, mx_vmo_write(clone_vmo[0], &val, 0, sizeof(val), &bytes_handled), "writing to clone");
+
+    // clone the clone, extending past its end, then close the middle one
+    EXPECT_EQ(MX_OK, mx_vmo_clone(clone_vmo[0], MX_VMO_CLONE_COPY_ON_WRITE, 0, size, &clone_vmo[1]), "vm_clone");
+    EXPECT_EQ(MX_OK, mx_handle_close(clone_vmo[0]), "handle_close");
+
+    // the page the middle clone wrote is still there
+    EXPECT_EQ(MX_OK, mx_vmo_read(clone_vmo[1], &val, 0, sizeof(val), &bytes_handled), "reading from clone");
+    EXPECT_EQ(99u, val, "reading back middle clone's page");
+    EXPECT_EQ(MX_OK, mx_vmo_read(clone_vmo[1], &val, sizeof(val), sizeof(val), &bytes_handled), "reading from clone");
+    EXPECT_EQ(sizeof(val), val, "reading back middle clone's page");
+
+    // the original shows through where the middle clone covered it
+    EXPECT_EQ(MX_OK, mx_vmo_read(clone_vmo[1], &val, PAGE_SIZE, sizeof(val), &bytes_handled), "reading from clone");
+    EXPECT_EQ(PAGE_SIZE, val, "reading back original");
+
+    // but not past the end of the middle clone
+    EXPECT_EQ(MX_OK, mx_vmo_read(clone_vmo[1], &val, PAGE_SIZE * 3, sizeof(val), &bytes_handled), "reading from clone");
+    EXPECT_EQ(0u, val, "reading past middle clone");
+
+    // changes to the original still show through
+    val = 100;
+    EXPECT_EQ(MX_OK, mx_vmo_write(vmo, &val, PAGE_SIZE * 2, sizeof(val), &bytes_handled), "writing to original");
+    EXPECT_EQ(MX_OK, mx_vmo_read(clone_vmo[1], &val, PAGE_SIZE * 2, sizeof(val), &bytes_handled), "reading from clone");
+    EXPECT_EQ(100u, val, "reading back original");
+
+    EXPECT_EQ(MX_OK, mx_vmo_op_range(vmo, MX_VMO_OP_DECOMMIT, PAGE_SIZE, PAGE_SIZE, NULL, 0), "decommit");
+    EXPECT_EQ(MX_OK, mx_vmo_read(clone_vmo[1], &val, PAGE_SIZE, sizeof(val), &bytes_handled), "reading from clone");
+    EXPECT_EQ(0u, val, "reading back decommitted original");
+
+    // and the original never saw the middle clone's write
+    EXPECT_EQ(MX_OK, mx_vmo_read(vmo, &val, 0, sizeof(val), &bytes_handled), "reading from original");
+    EXPECT_EQ(0u, val, "reading back original");
+
+    EXPECT_EQ(MX_OK, mx_handle_close(clone_vmo[1]), "handle_close");
+
+    // now a clone smaller than the middle one, which grows once the middle one is gone
+    EXPECT_EQ(MX_OK, mx_vmo_clone(vmo, MX_VMO_CLONE_COPY_ON_WRITE, 0, PAGE_SIZE * 3, &clone_vmo[0]), "vm_clone");
+    val = 101;
+    EXPECT_EQ(MX_OK, mx_vmo_write(clone_vmo[0], &val, PAGE_SIZE * 2, sizeof(val), &bytes_handled), "writing to clone");
+    EXPECT_EQ(MX_OK, mx_vmo_clone(clone_vmo[0], MX_VMO_CLONE_COPY_ON_WRITE, 0, PAGE_SIZE, &clone_vmo[1]), "vm_clone");
+    EXPECT_EQ(MX_OK, mx_handle_close(clone_vmo[0]), "handle_close");
+
+    EXPECT_EQ(MX_OK, mx_vmo_read(clone_vmo[1], &val, 0, sizeof(val), &bytes_handled), "reading from clone");
+    EXPECT_EQ(0u, val, "reading back original");
+
+    // growing it exposes zeroes, not the page the middle clone had there, nor the original's
+    // page behind that
+    EXPECT_EQ(MX_OK, mx_vmo_set_size(clone_vmo[1], PAGE_SIZE * 3), "extend the clone");
+    EXPECT_EQ(MX_OK, mx_vmo_read(clone_vmo[1], &val, PAGE_SIZE * 2, sizeof(val), &bytes_handled), "reading from clone");
+    EXPECT_EQ(0u, val, "reading past the clone's original size");
+
+    EXPECT_EQ(MX_OK, mx_handle_close(clone_vmo[1]), "handle_close");
+    EXPECT_EQ(MX_OK, mx_handle_close(vmo), "handle_close");
+
+    END_TEST;
+}
+
 bool vmo_clone_rights_test() {
     BEGIN_TEST;
 
@@ -1143,12 +1280,14 @@ RUN_TEST(vmo_commit_test);
 RUN_TEST(vmo_decommit_misaligned_test);
 RUN_TEST(vmo_cache_test);
 RUN_TEST(vmo_zero_page_test);
+RUN_TEST(vmo_concurrent_fault_test);
 RUN_TEST(vmo_clone_test_1);
 RUN_TEST(vmo_clone_test_2);
 RUN_TEST(vmo_clone_test_3);
 RUN_TEST(vmo_clone_test_4);
 RUN_TEST(vmo_clone_decommit_test);
 RUN_TEST(vmo_clone_commit_test);
+RUN_TEST(vmo_clone_chain_test);
 RUN_TEST(vmo_clone_rights_test);
 END_TEST_CASE(vmo_tests)
 
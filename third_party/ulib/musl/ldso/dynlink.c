@@ -352,9 +352,11 @@ static Sym* gnu_lookup_filtered(uint32_t h1, uint32_t* hashtab,
 #define ARCH_SYM_REJECT_UND(s) 0
 #endif
 
+// 'gh' is gnu_hash(s).
 __NO_SAFESTACK NO_ASAN
-static struct symdef find_sym(struct dso* dso, const char* s, int need_def) {
-    uint32_t h = 0, gh, gho, *ght;
+static struct symdef find_sym_hashed(struct dso* dso, const char* s,
+                                     uint32_t gh, int need_def) {
+    uint32_t h = 0, gho, *ght;
     size_t ghm = 0;
     struct symdef def = {};
     for (; dso; dso = dso->next) {
@@ -363,7 +365,6 @@ static struct symdef find_sym(struct dso* dso, const char* s, int need_def) {
             continue;
         if ((ght = dso->ghashtab)) {
             if (!ghm) {
-                gh = gnu_hash(s);
                 int maskbits = 8 * sizeof ghm;
                 gho = gh / maskbits;
                 ghm = 1ul << gh % maskbits;
@@ -397,6 +398,63 @@ static struct symdef find_sym(struct dso* dso, const char* s, int need_def) {
     return def;
 }
 
+__NO_SAFESTACK NO_ASAN
+static struct symdef find_sym(struct dso* dso, const char* s, int need_def) {
+    return find_sym_hashed(dso, s, gnu_hash(s), need_def);
+}
+
+// Most symbols are referenced from many DSOs (and many times from each),
+// so while relocating, the result of each global lookup is remembered in
+// a small direct-mapped table indexed by the name's GNU hash.  The table
+// is only valid for one batch of relocations: symcache_begin() starts a
+// new generation, which implicitly empties it, and the set of global
+// DSOs must not change until symcache_end().
+#define SYMCACHE_SIZE 512
+
+struct symcache_entry {
+    const char* name;
+    uint32_t gh;
+    // (generation << 1) | need_def; zero is never a valid tag.
+    uint32_t tag;
+    struct symdef def;
+};
+
+static struct symcache_entry symcache[SYMCACHE_SIZE];
+static uint32_t symcache_gen;
+static bool symcache_active;
+static size_t symcache_hits, symcache_misses;
+
+__NO_SAFESTACK NO_ASAN static void symcache_begin(void) {
+    if (++symcache_gen >= (1u << 31)) {
+        memset(symcache, 0, sizeof(symcache));
+        symcache_gen = 1;
+    }
+    symcache_active = true;
+}
+
+__NO_SAFESTACK NO_ASAN static void symcache_end(void) {
+    symcache_active = false;
+}
+
+// Equivalent to find_sym(head, s, need_def).
+__NO_SAFESTACK NO_ASAN
+static struct symdef find_sym_cached(const char* s, int need_def) {
+    uint32_t gh = gnu_hash(s);
+    uint32_t tag = (symcache_gen << 1) | (need_def != 0);
+    struct symcache_entry* e = &symcache[gh % SYMCACHE_SIZE];
+    if (e->tag == tag && e->gh == gh && !strcmp(e->name, s)) {
+        ++symcache_hits;
+        return e->def;
+    }
+    ++symcache_misses;
+    struct symdef def = find_sym_hashed(head, s, gh, need_def);
+    e->name = s;
+    e->gh = gh;
+    e->tag = tag;
+    e->def = def;
+    return def;
+}
+
 __attribute__((__visibility__("hidden"))) ptrdiff_t __tlsdesc_static(void), __tlsdesc_dynamic(void);
 
 __NO_SAFESTACK NO_ASAN static void do_relocs(struct dso* dso, size_t* rel,
@@ -435,8 +493,12 @@ __NO_SAFESTACK NO_ASAN static void do_relocs(struct dso* dso, size_t* rel,
             sym = syms + sym_index;
             name = strings + sym->st_name;
             ctx = type == REL_COPY ? head->next : head;
-            def = (sym->st_info & 0xf) == STT_SECTION ? (struct symdef){.dso = dso, .sym = sym}
-                                                      : find_sym(ctx, name, type == REL_PLT);
+            if ((sym->st_info & 0xf) == STT_SECTION)
+                def = (struct symdef){.dso = dso, .sym = sym};
+            else if (symcache_active && ctx == head)
+                def = find_sym_cached(name, type == REL_PLT);
+            else
+                def = find_sym(ctx, name, type == REL_PLT);
             if (!def.sym && (sym->st_shndx != SHN_UNDEF || sym->st_info >> 4 != STB_WEAK)) {
                 error("Error relocating %s: %s: symbol not found", dso->name, name);
                 if (runtime)
@@ -1571,6 +1633,8 @@ dl_start_return_t __dls2(
  * transfer control to its entry point. */
 
 __NO_SAFESTACK static void* dls3(mx_handle_t exec_vmo, int argc, char** argv) {
+    mx_time_t start_time = _mx_time_get(MX_CLOCK_MONOTONIC);
+
     // First load our own dependencies.  Usually this will be just the
     // vDSO, which is already loaded, so there will be nothing to do.
     // In a sanitized build, we'll depend on the sanitizer runtime DSO
@@ -1674,10 +1738,16 @@ __NO_SAFESTACK static void* dls3(mx_handle_t exec_vmo, int argc, char** argv) {
         }
     }
 
+    mx_time_t load_done = _mx_time_get(MX_CLOCK_MONOTONIC);
+
     /* The main program must be relocated LAST since it may contin
      * copy relocations which depend on libraries' relocations. */
+    symcache_begin();
     reloc_all(app.next);
     reloc_all(&app);
+    symcache_end();
+
+    mx_time_t reloc_done = _mx_time_get(MX_CLOCK_MONOTONIC);
 
     update_tls_size();
     static_tls_cnt = tls_cnt;
@@ -1711,8 +1781,14 @@ __NO_SAFESTACK static void* dls3(mx_handle_t exec_vmo, int argc, char** argv) {
 
     _dl_debug_state();
 
-    if (log_libs)
+    if (log_libs) {
         _dl_log_unlogged();
+        debugmsg("ldso: startup: load %" PRIu64 "us, relocate %" PRIu64
+                 "us, symbol cache %zu hits, %zu misses\n",
+                 (load_done - start_time) / 1000,
+                 (reloc_done - load_done) / 1000,
+                 symcache_hits, symcache_misses);
+    }
 
     if (trace_maps) {
         for (struct dso* p = &app; p != NULL; p = p->next) {
@@ -1909,6 +1985,7 @@ static void* dlopen_internal(mx_handle_t vmo, const char* file, int mode) {
     jmp_buf jb;
     rtld_fail = &jb;
     if (setjmp(*rtld_fail)) {
+        symcache_end();
         /* Clean up anything new that was (partially) loaded */
         if (p && p->deps)
             for (i = 0; p->deps[i]; i++)
@@ -1937,7 +2014,9 @@ static void* dlopen_internal(mx_handle_t vmo, const char* file, int mode) {
                     p->deps[i]->global = -1;
         if (!p->global)
             p->global = -1;
+        symcache_begin();
         reloc_all(p);
+        symcache_end();
         if (p->deps)
             for (i = 0; p->deps[i]; i++)
                 if (p->deps[i]->global < 0)